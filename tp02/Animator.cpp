@@ -4,7 +4,8 @@
 #include "Factories.h"
 
 
-Animator::Animator(): Component(ComponentType::ANIMATOR), m_skeleton(nullptr), m_currentAnimName(""), m_currentSkeletonName(""), m_isPlaying(false)
+Animator::Animator(): Component(ComponentType::ANIMATOR), m_skeleton(nullptr), m_currentAnimName(""), m_currentSkeletonName(""), m_isPlaying(false),
+m_updatePeriod(1), m_framesBeforeUpdate(0), m_previousPoseTime(0.f), m_nextPoseTime(0.f)
 {
 }
 
@@ -16,24 +17,137 @@ Animator::~Animator()
 void Animator::setSkeleton(Skeleton * skeleton)
 {
 	m_skeleton = skeleton;
+	m_pose = SkeletonPose();
+	m_previousPose.clear();
+	m_nextPose.clear();
+	m_updatePeriod = 1;
+	m_framesBeforeUpdate = 0;
+	bindAnimations();
 }
 
 void Animator::addAnimation(SkeletalAnimation * animation)
 {
 	m_animations[animation->getName()] = animation;
+	bindAnimation(animation->getName());
 }
 
 void Animator::removeAnimation(SkeletalAnimation * animation)
 {
 	auto findIt = std::find_if(m_animations.begin(), m_animations.end(), [&animation](const std::pair<std::string, SkeletalAnimation*>& key) { return key.second == animation; });
+	if (findIt == m_animations.end())
+		return;
+	m_animationBindings.erase(findIt->first);
 	m_animations.erase(findIt);
 	//m_animations.erase(std::remove(m_animations.begin(), m_animations.end(), animation), m_animations.end());
 }
 
 void Animator::updateAnimations(float timeInSecond)
 {
-	if (m_isPlaying && m_skeleton != nullptr && m_animations.find(m_currentAnimName) != m_animations.end())
-		m_skeleton->playAnimationStep(timeInSecond, *m_animations[m_currentAnimName]);
+	updateAnimations(timeInSecond, 1, 0.f);
+}
+
+bool Animator::updateAnimations(float timeInSecond, int updatePeriod, float deltaTime)
+{
+	if (!m_isPlaying || m_skeleton == nullptr)
+		return false;
+
+	//full rate :
+	if (updatePeriod <= 1)
+	{
+		m_updatePeriod = 1;
+		m_framesBeforeUpdate = 0;
+		return evaluatePose(timeInSecond, 0.f);
+	}
+
+	//the rate has changed, or the interpolation has reached the next pose :
+	bool needsEvaluation = (updatePeriod != m_updatePeriod || m_framesBeforeUpdate <= 0 || timeInSecond >= m_nextPoseTime);
+	if (needsEvaluation)
+	{
+		//continue from the pose displayed at the previous frame, or start from the current pose :
+		if (m_updatePeriod > 1 && m_nextPose.size() == m_skeleton->getBoneCount())
+			copyPose(m_previousPose);
+		else if (evaluatePose(timeInSecond, 0.f))
+			copyPose(m_previousPose);
+		else
+			return false;
+
+		float lookAhead = updatePeriod * std::max(deltaTime, 0.f);
+		if (!evaluatePose(timeInSecond, lookAhead))
+			return false;
+		copyPose(m_nextPose);
+
+		m_previousPoseTime = timeInSecond;
+		m_nextPoseTime = timeInSecond + lookAhead;
+		m_updatePeriod = updatePeriod;
+		m_framesBeforeUpdate = updatePeriod;
+	}
+
+	if (m_nextPose.size() != m_skeleton->getBoneCount() || m_previousPose.size() != m_nextPose.size())
+		return needsEvaluation;
+
+	float factor = (m_nextPoseTime > m_previousPoseTime) ? glm::clamp((timeInSecond - m_previousPoseTime) / (m_nextPoseTime - m_previousPoseTime), 0.f, 1.f) : 1.f;
+	for (int i = 0; i < m_nextPose.size(); i++)
+		m_pose.bonesTransform[i] = m_previousPose[i] * (1.f - factor) + m_nextPose[i] * factor;
+
+	m_framesBeforeUpdate--;
+	return needsEvaluation;
+}
+
+void Animator::freezeAnimations()
+{
+	//the interpolation is restarted from the current pose when the animator is updated again :
+	m_updatePeriod = 1;
+	m_framesBeforeUpdate = 0;
+}
+
+bool Animator::getIsPlaying() const
+{
+	return m_isPlaying;
+}
+
+const Skeleton* Animator::getSkeleton() const
+{
+	return m_skeleton;
+}
+
+const std::vector<glm::mat4>& Animator::getBonesTransform() const
+{
+	return m_pose.bonesTransform;
+}
+
+bool Animator::evaluatePose(float timeInSecond, float timeOffsetInSecond)
+{
+	auto foundAnimation = m_animations.find(m_currentAnimName);
+	auto foundBinding = m_animationBindings.find(m_currentAnimName);
+	if (foundAnimation == m_animations.end() || foundBinding == m_animationBindings.end())
+		return false;
+
+	m_skeleton->playAnimationStep(timeInSecond, *foundAnimation->second, foundBinding->second, m_pose, timeOffsetInSecond);
+	return true;
+}
+
+void Animator::copyPose(std::vector<glm::mat4>& outPose) const
+{
+	outPose = m_pose.bonesTransform;
+}
+
+void Animator::bindAnimation(const std::string& animationName)
+{
+	auto foundAnimation = m_animations.find(animationName);
+	if (m_skeleton == nullptr || foundAnimation == m_animations.end())
+	{
+		m_animationBindings.erase(animationName);
+		return;
+	}
+
+	foundAnimation->second->bindToSkeleton(*m_skeleton, m_animationBindings[animationName]);
+}
+
+void Animator::bindAnimations()
+{
+	m_animationBindings.clear();
+	for (auto& animation : m_animations)
+		bindAnimation(animation.first);
 }
 
 void Animator::play()
@@ -61,7 +175,7 @@ void Animator::drawUI(Scene & scene)
 			Mesh* tmpMesh = MeshFactory::get().get(m_skeletonName);
 			if (tmpMesh != nullptr) {
 				m_currentSkeletonName = m_skeletonName;
-				m_skeleton = tmpMesh->getSkeleton();
+				setSkeleton(tmpMesh->getSkeleton());
 			}
 		}
 	}
@@ -81,6 +195,7 @@ void Animator::drawUI(Scene & scene)
 				if (m_animations.find(m_currentAnimName) == m_animations.end())
 					m_currentAnimName = m_animationName;
 				m_animations[m_animationName] = tmpAnim;
+				bindAnimation(m_animationName);
 			}
 		}
 	}
@@ -95,6 +210,7 @@ void Animator::drawUI(Scene & scene)
 		if (ImGui::Button("remove")) {
 			if (m_currentAnimName == it->first)
 				m_currentAnimName = m_animations.size() > 0 ? m_animations.begin()->first : "";
+			m_animationBindings.erase(it->first);
 			it = m_animations.erase(it);
 		}
 		else
@@ -175,4 +291,6 @@ void Animator::load(Json::Value & componentRoot)
 	}
 
 	m_currentAnimName = componentRoot.get("currentAnimName", "").asString();
+
+	bindAnimations();
 }
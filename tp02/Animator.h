@@ -11,7 +11,20 @@ private:
 	std::string m_currentAnimName;
 	std::string m_currentSkeletonName;
 	std::map<std::string, SkeletalAnimation*> m_animations;
+	//channel of each skeleton node and keyframe cursors, for each animation. Resolved when an animation is paired with the skeleton :
+	std::map<std::string, SkeletalAnimationBinding> m_animationBindings;
 	bool m_isPlaying;
+	//pose of this instance, read by the mesh renderer of the entity :
+	SkeletonPose m_pose;
+
+	//update rate lod : the pose is evaluated every m_updatePeriod frames, ahead of time,
+	//and the bone transforms are interpolated between the previous pose and this next pose.
+	int m_updatePeriod;
+	int m_framesBeforeUpdate;
+	float m_previousPoseTime;
+	float m_nextPoseTime;
+	std::vector<glm::mat4> m_previousPose;
+	std::vector<glm::mat4> m_nextPose;
 
 	//for ui : 
 	std::string m_skeletonName;
@@ -25,6 +38,16 @@ public:
 	void addAnimation(SkeletalAnimation* animation);
 	void removeAnimation(SkeletalAnimation* animation);
 	void updateAnimations(float timeInSecond);
+	//evaluate the pose every updatePeriod frames, and interpolate the bone transforms in between.
+	//deltaTime is used to predict the time of the next evaluation. Return true if the pose has been evaluated this frame.
+	//Only this animator is modified, so different animators can be updated from different threads.
+	bool updateAnimations(float timeInSecond, int updatePeriod, float deltaTime);
+	//keep the current pose : the pose will be evaluated at the next update.
+	void freezeAnimations();
+	bool getIsPlaying() const;
+	const Skeleton* getSkeleton() const;
+	//bone transforms of the current pose. Empty if no pose has been evaluated yet.
+	const std::vector<glm::mat4>& getBonesTransform() const;
 
 	void play();
 	void play(const std::string& animationName);
@@ -38,5 +61,12 @@ public:
 
 	virtual void save(Json::Value& componentRoot) const override;
 	virtual void load(Json::Value& componentRoot) override;
+
+private:
+	void bindAnimation(const std::string& animationName);
+	void bindAnimations();
+	//evaluate the current animation in m_pose, timeOffsetInSecond after the current time. Return false if there is nothing to play.
+	bool evaluatePose(float timeInSecond, float timeOffsetInSecond);
+	void copyPose(std::vector<glm::mat4>& outPose) const;
 };
 
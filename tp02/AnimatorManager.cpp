@@ -0,0 +1,250 @@
+#include "AnimatorManager.h"
+#include "Frustum.h"
+//forwards :
+#include "Camera.h"
+#include "Entity.h"
+
+#include <algorithm>
+
+AnimationUpdateStats::AnimationUpdateStats() : fullRateCount(0), reducedRateCount(0), frozenCount(0), evaluatedPoseCount(0)
+{
+
+}
+
+AnimatorUpdateJob::AnimatorUpdateJob(Animator* _animator, int _updatePeriod) : animator(_animator), updatePeriod(_updatePeriod)
+{
+
+}
+
+AnimatorManager::AnimatorManager() : m_fullRateDistance(15.f), m_rateStepDistance(10.f), m_maxUpdatePeriod(8), m_freezeCulledAnimators(true),
+m_threadCount(0), m_stopWorkerThreads(false), m_batchIndex(0), m_busyWorkerCount(0), m_jobTime(0.f), m_jobDeltaTime(0.f), m_nextJob(0), m_evaluatedPoseCount(0)
+{
+}
+
+
+AnimatorManager::~AnimatorManager()
+{
+	stopWorkerThreads();
+}
+
+void AnimatorManager::update(float time, float deltaTime, const BaseCamera& camera, const std::vector<Animator*>& animators)
+{
+	m_stats = AnimationUpdateStats();
+	m_jobs.clear();
+
+	const glm::mat4 viewProjection = camera.getProjectionMatrix() * camera.getViewMatrix();
+	const glm::vec3 cameraPosition = camera.getCameraPosition();
+
+	const Frustum frustum(viewProjection);
+
+	for (int i = 0; i < animators.size(); i++)
+	{
+		Animator& animator = *animators[i];
+		if (!animator.getIsPlaying())
+			continue;
+
+		glm::vec3 center;
+		float radius;
+		computeBoundingSphere(animator, center, radius);
+
+		if (!frustum.testSphere(center, radius) && m_freezeCulledAnimators)
+		{
+			animator.freezeAnimations();
+			m_stats.frozenCount++;
+			continue;
+		}
+
+		int updatePeriod = computeUpdatePeriod(std::max(0.f, glm::length(center - cameraPosition) - radius));
+		if (updatePeriod > 1)
+			m_stats.reducedRateCount++;
+		else
+			m_stats.fullRateCount++;
+
+		m_jobs.push_back(AnimatorUpdateJob(&animator, updatePeriod));
+	}
+
+	//parallel stage :
+	m_jobTime = time;
+	m_jobDeltaTime = deltaTime;
+	m_nextJob = 0;
+	m_evaluatedPoseCount = 0;
+
+	const int workerCount = getWantedWorkerCount();
+	if (workerCount != m_workerThreads.size())
+	{
+		stopWorkerThreads();
+		startWorkerThreads(workerCount);
+	}
+
+	const bool isParallel = (!m_workerThreads.empty() && m_jobs.size() >= MIN_PARALLEL_JOB_COUNT);
+	if (isParallel)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_workMutex);
+			m_busyWorkerCount = m_workerThreads.size();
+			m_batchIndex++;
+		}
+		m_workCondition.notify_all();
+	}
+
+	//the main thread works too :
+	runJobs();
+
+	//all the poses must be ready before the rendering :
+	if (isParallel)
+	{
+		std::unique_lock<std::mutex> lock(m_workMutex);
+		m_doneCondition.wait(lock, [this]() { return m_busyWorkerCount == 0; });
+	}
+
+	m_stats.evaluatedPoseCount = m_evaluatedPoseCount;
+}
+
+void AnimatorManager::runJobs()
+{
+	const int jobCount = m_jobs.size();
+	int jobIndex = 0;
+	while ((jobIndex = m_nextJob++) < jobCount)
+	{
+		const AnimatorUpdateJob& job = m_jobs[jobIndex];
+		if (job.animator->updateAnimations(m_jobTime, job.updatePeriod, m_jobDeltaTime))
+			m_evaluatedPoseCount++;
+	}
+}
+
+int AnimatorManager::getWantedWorkerCount() const
+{
+	int threadCount = m_threadCount > 0 ? m_threadCount : (int)std::thread::hardware_concurrency();
+	return std::max(0, threadCount - 1);
+}
+
+void AnimatorManager::startWorkerThreads(int workerCount)
+{
+	if (!m_workerThreads.empty())
+		return;
+
+	m_stopWorkerThreads = false;
+	for (int i = 0; i < workerCount; i++)
+		m_workerThreads.push_back(std::thread(&AnimatorManager::workerThreadLoop, this, m_batchIndex));
+}
+
+void AnimatorManager::stopWorkerThreads()
+{
+	if (m_workerThreads.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_workMutex);
+		m_stopWorkerThreads = true;
+	}
+	m_workCondition.notify_all();
+
+	for (auto& thread : m_workerThreads)
+		thread.join();
+	m_workerThreads.clear();
+}
+
+void AnimatorManager::workerThreadLoop(int batchIndex)
+{
+	//batchIndex : the last batch started before this thread, the worker waits for the next one.
+	int lastBatchIndex = batchIndex;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_workMutex);
+			m_workCondition.wait(lock, [this, lastBatchIndex]() { return m_stopWorkerThreads || m_batchIndex != lastBatchIndex; });
+
+			if (m_stopWorkerThreads)
+				return;
+
+			lastBatchIndex = m_batchIndex;
+		}
+
+		runJobs();
+
+		{
+			std::lock_guard<std::mutex> lock(m_workMutex);
+			m_busyWorkerCount--;
+		}
+		m_doneCondition.notify_one();
+	}
+}
+
+int AnimatorManager::computeUpdatePeriod(float distanceToCamera) const
+{
+	if (distanceToCamera <= m_fullRateDistance || m_rateStepDistance <= 0.f)
+		return 1;
+
+	int updatePeriod = 2 + (int)((distanceToCamera - m_fullRateDistance) / m_rateStepDistance);
+	return std::min(updatePeriod, std::max(1, m_maxUpdatePeriod));
+}
+
+const AnimationUpdateStats& AnimatorManager::getStats() const
+{
+	return m_stats;
+}
+
+void AnimatorManager::setThreadCount(int threadCount)
+{
+	m_threadCount = std::max(0, threadCount);
+}
+
+int AnimatorManager::getThreadCount() const
+{
+	return m_threadCount;
+}
+
+void AnimatorManager::computeBoundingSphere(Animator& animator, glm::vec3& outCenter, float& outRadius) const
+{
+	Entity* entity = animator.entity();
+	if (entity == nullptr)
+	{
+		outCenter = glm::vec3(0, 0, 0);
+		outRadius = 0.f;
+		return;
+	}
+
+	glm::mat4 modelMatrix = entity->getModelMatrix();
+	MeshRenderer* meshRenderer = animator.getComponent<MeshRenderer>(Component::ComponentType::MESH_RENDERER);
+	Mesh* mesh = (meshRenderer != nullptr) ? meshRenderer->getMesh() : nullptr;
+	if (mesh == nullptr)
+	{
+		outCenter = glm::vec3(modelMatrix[3]);
+		outRadius = 0.f;
+		return;
+	}
+
+	glm::vec3 scale(glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2])));
+	outCenter = glm::vec3(modelMatrix * glm::vec4((mesh->topRight + mesh->bottomLeft) * 0.5f, 1.f));
+	outRadius = glm::length(mesh->topRight - mesh->bottomLeft) * 0.5f * std::max(scale.x, std::max(scale.y, scale.z));
+}
+
+void AnimatorManager::drawUI()
+{
+	ImGui::SliderFloat("full rate distance", &m_fullRateDistance, 0.f, 200.f);
+	ImGui::SliderFloat("rate step distance", &m_rateStepDistance, 0.1f, 100.f);
+	ImGui::SliderInt("max update period", &m_maxUpdatePeriod, 1, 30);
+	ImGui::Checkbox("freeze culled animators", &m_freezeCulledAnimators);
+	ImGui::SliderInt("animation threads (0 : auto)", &m_threadCount, 0, 32);
+
+	ImGui::Text("full rate : %d, reduced rate : %d, frozen : %d", m_stats.fullRateCount, m_stats.reducedRateCount, m_stats.frozenCount);
+	ImGui::Text("evaluated poses : %d, worker threads : %d", m_stats.evaluatedPoseCount, (int)m_workerThreads.size());
+}
+
+void AnimatorManager::save(Json::Value& rootComponent) const
+{
+	rootComponent["fullRateDistance"] = m_fullRateDistance;
+	rootComponent["rateStepDistance"] = m_rateStepDistance;
+	rootComponent["maxUpdatePeriod"] = m_maxUpdatePeriod;
+	rootComponent["freezeCulledAnimators"] = m_freezeCulledAnimators;
+	rootComponent["threadCount"] = m_threadCount;
+}
+
+void AnimatorManager::load(const Json::Value& rootComponent)
+{
+	m_fullRateDistance = rootComponent.get("fullRateDistance", 15.f).asFloat();
+	m_rateStepDistance = rootComponent.get("rateStepDistance", 10.f).asFloat();
+	m_maxUpdatePeriod = rootComponent.get("maxUpdatePeriod", 8).asInt();
+	m_freezeCulledAnimators = rootComponent.get("freezeCulledAnimators", true).asBool();
+	m_threadCount = rootComponent.get("threadCount", 0).asInt();
+}
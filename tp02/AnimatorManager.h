@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "Animator.h"
+
+#include "jsoncpp/json/json.h"
+
+//forwards :
+struct BaseCamera;
+
+//animators updated at the last frame, by update rate :
+struct AnimationUpdateStats
+{
+	int fullRateCount;
+	int reducedRateCount;
+	int frozenCount; //outside of the camera frustum
+	int evaluatedPoseCount; //animators whose pose has been evaluated (the others are interpolated or frozen)
+
+	AnimationUpdateStats();
+};
+
+//an animator to update during the parallel stage :
+struct AnimatorUpdateJob
+{
+	Animator* animator;
+	int updatePeriod;
+
+	AnimatorUpdateJob(Animator* _animator = nullptr, int _updatePeriod = 1);
+};
+
+//Update the animators of a scene with an update rate depending on their distance to the camera :
+//full rate under fullRateDistance, then one frame more between two evaluations every rateStepDistance, up to maxUpdatePeriod.
+//Animators outside of the camera frustum keep their pose.
+//The poses are evaluated in parallel by a pool of worker threads, each animator writing in its own pose. update returns once all the poses are ready.
+class AnimatorManager
+{
+public:
+	//under this number of animators to update, the poses are evaluated on the main thread only :
+	static const int MIN_PARALLEL_JOB_COUNT = 4;
+
+private:
+	float m_fullRateDistance;
+	float m_rateStepDistance;
+	int m_maxUpdatePeriod;
+	bool m_freezeCulledAnimators;
+
+	AnimationUpdateStats m_stats;
+
+	//parallel pose evaluation :
+	int m_threadCount; //threads evaluating the poses, including the main thread. 0 : one per core.
+	std::vector<std::thread> m_workerThreads;
+	std::mutex m_workMutex;
+	std::condition_variable m_workCondition; //a new batch of jobs is ready, or the workers must stop
+	std::condition_variable m_doneCondition; //all the workers have finished the batch
+	bool m_stopWorkerThreads;
+	int m_batchIndex;
+	int m_busyWorkerCount;
+	//current batch, only modified by the main thread while the workers are waiting :
+	std::vector<AnimatorUpdateJob> m_jobs;
+	float m_jobTime;
+	float m_jobDeltaTime;
+	std::atomic<int> m_nextJob;
+	std::atomic<int> m_evaluatedPoseCount;
+
+public:
+	AnimatorManager();
+	~AnimatorManager();
+	AnimatorManager(const AnimatorManager& other) = delete;
+	void operator=(const AnimatorManager& other) = delete;
+
+	void update(float time, float deltaTime, const BaseCamera& camera, const std::vector<Animator*>& animators);
+	int computeUpdatePeriod(float distanceToCamera) const;
+	const AnimationUpdateStats& getStats() const;
+	//threads evaluating the poses, including the main thread. 0 : one per core.
+	void setThreadCount(int threadCount);
+	int getThreadCount() const;
+
+	void drawUI();
+	void save(Json::Value& rootComponent) const;
+	void load(const Json::Value& rootComponent);
+
+private:
+	//bounding sphere of the animated entity, from its mesh renderer if it has one :
+	void computeBoundingSphere(Animator& animator, glm::vec3& outCenter, float& outRadius) const;
+
+	int getWantedWorkerCount() const;
+	void startWorkerThreads(int workerCount);
+	void stopWorkerThreads();
+	void workerThreadLoop(int batchIndex);
+	//update the animators of the current batch until there is no job left. Called by the workers and the main thread.
+	void runJobs();
+};
+
@@ -3,6 +3,7 @@
 #include "Factories.h"
 #include "Scene.h"
 #include "SerializeUtils.h"
+#include "GLStateCache.h"
 
 
 Billboard::Billboard(): Component(ComponentType::BILLBOARD), m_translation(0,0,0), m_scale(1,1), m_textureName("default"), m_color(1,1,1,1)
@@ -28,8 +29,8 @@ void Billboard::render(const glm::mat4 & projection, const glm::mat4 & view)
 
 	m_billboardMaterial->use();
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, m_texture->glId);
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_texture->glId);
 
 	m_billboardMaterial->setUniformMVP(MVP);
 	m_billboardMaterial->setUniformCameraRight(CameraRight);
@@ -0,0 +1,102 @@
+#include "BonePaletteBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+BonePaletteBuffer::BonePaletteBuffer() : m_ubo(0), m_paletteStride(MAX_BONE_COUNT * sizeof(glm::mat4)), m_paletteCount(0), m_bufferSize(0)
+{
+	clear();
+}
+
+BonePaletteBuffer::~BonePaletteBuffer()
+{
+	freeGl();
+}
+
+void BonePaletteBuffer::initGl()
+{
+	if (m_ubo != 0)
+		return;
+
+	GLint offsetAlignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+	offsetAlignment = std::max(1, offsetAlignment);
+
+	//a whole block is bound for each palette, even if the skeleton has less bones :
+	const int paletteSize = MAX_BONE_COUNT * sizeof(glm::mat4);
+	m_paletteStride = ((paletteSize + offsetAlignment - 1) / offsetAlignment) * offsetAlignment;
+	//the identity palette was added with the unaligned stride :
+	m_data.clear();
+	clear();
+
+	glGenBuffers(1, &m_ubo);
+	m_bufferSize = 0;
+}
+
+void BonePaletteBuffer::freeGl()
+{
+	if (m_ubo == 0)
+		return;
+
+	glDeleteBuffers(1, &m_ubo);
+	m_ubo = 0;
+	m_bufferSize = 0;
+}
+
+void BonePaletteBuffer::clear()
+{
+	m_paletteCount = 0;
+	add(std::vector<glm::mat4>(MAX_BONE_COUNT, glm::mat4(1.f)));
+}
+
+int BonePaletteBuffer::add(const std::vector<glm::mat4>& bonesTransform)
+{
+	const int paletteOffset = m_paletteCount * m_paletteStride;
+	if (m_data.size() < paletteOffset + m_paletteStride)
+		m_data.resize(paletteOffset + m_paletteStride);
+
+	//std140 mat4 arrays have the same layout as glm matrices :
+	const int boneCount = std::min((int)bonesTransform.size(), (int)MAX_BONE_COUNT);
+	if (boneCount > 0)
+		std::memcpy(&m_data[paletteOffset], &bonesTransform[0], boneCount * sizeof(glm::mat4));
+
+	m_paletteCount++;
+	return paletteOffset;
+}
+
+void BonePaletteBuffer::upload()
+{
+	if (m_ubo == 0)
+		return;
+
+	const int dataSize = m_paletteCount * m_paletteStride;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+	//the storage is orphaned each frame, so we don't wait for the draws of the previous frame :
+	if (dataSize > m_bufferSize)
+		m_bufferSize = dataSize;
+	glBufferData(GL_UNIFORM_BUFFER, m_bufferSize, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, dataSize, &m_data[0]);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	//the shaders declare the block even when nothing is skinned :
+	bind(IDENTITY_PALETTE_OFFSET);
+}
+
+void BonePaletteBuffer::bind(int paletteOffset) const
+{
+	assert(paletteOffset >= 0 && paletteOffset + m_paletteStride <= m_bufferSize);
+	glBindBufferRange(GL_UNIFORM_BUFFER, BINDING_POINT, m_ubo, paletteOffset, MAX_BONE_COUNT * sizeof(glm::mat4));
+}
+
+int BonePaletteBuffer::getPaletteCount() const
+{
+	return m_paletteCount;
+}
+
+void BonePaletteBuffer::bindProgram(GLuint glProgram)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(glProgram, "BonePalette");
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(glProgram, blockIndex, BINDING_POINT);
+}
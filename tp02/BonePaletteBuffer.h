@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include "glew/glew.h"
+#include "glm/glm.hpp"
+
+#include "Materials.h"
+
+//Bone palettes of the skinned instances of a frame, packed in a single uniform buffer (std140 block "BonePalette" of the shaders).
+//The palettes are added once per frame, uploaded in one call, and each instance binds its palette with a single glBindBufferRange,
+//for all its sub meshes and its shadow passes.
+class BonePaletteBuffer
+{
+public:
+	//uniform buffer binding point of the "BonePalette" block :
+	static const GLuint BINDING_POINT = 0;
+	//a palette of identity matrices is always stored first, and bound after the upload, so the block is never left unbound :
+	static const int IDENTITY_PALETTE_OFFSET = 0;
+
+private:
+	GLuint m_ubo;
+	//bytes between two palettes, a multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT :
+	int m_paletteStride;
+	int m_paletteCount;
+	int m_bufferSize;
+	std::vector<unsigned char> m_data;
+
+public:
+	BonePaletteBuffer();
+	~BonePaletteBuffer();
+
+	void initGl();
+	void freeGl();
+
+	//remove the palettes of the previous frame, only the identity palette is kept :
+	void clear();
+	//copy a palette (at most MAX_BONE_COUNT bones), return its offset in the buffer.
+	int add(const std::vector<glm::mat4>& bonesTransform);
+	//send all the palettes of the frame to the GPU, and bind the identity palette :
+	void upload();
+	//bind the palette at paletteOffset to BINDING_POINT.
+	void bind(int paletteOffset) const;
+
+	//number of palettes, including the identity palette :
+	int getPaletteCount() const;
+
+	//link the "BonePalette" block of a program to BINDING_POINT. Does nothing if the program hasn't this block.
+	static void bindProgram(GLuint glProgram);
+};
+
@@ -391,10 +391,10 @@ void BoxCollider::coverMesh(Mesh& mesh)
 void BoxCollider::cover(glm::vec3 min, glm::vec3 max, glm::vec3 _origin)
 {
 	origin = _origin;
-	glm::vec3 dimensions = (min - max);
+	glm::vec3 dimensions = (max - min)*scale;
 
 	offsetScale = dimensions;
-	offsetPosition = dimensions * 0.5f + origin*dimensions + min;// -translation;
+	offsetPosition = dimensions * 0.5f + origin*dimensions + min*scale;// -translation;
 
 	updateOffsetMatrix();
 	updateModelMatrix();
@@ -517,7 +517,7 @@ void CapsuleCollider::coverMesh(Mesh & mesh)
 void CapsuleCollider::cover(glm::vec3 min, glm::vec3 max, glm::vec3 _origin)
 {
 	origin = _origin;
-	glm::vec3 dimensions = (min - max)*scale;
+	glm::vec3 dimensions = (max - min)*scale;
 
 	offsetScale = dimensions;
 	offsetPosition = dimensions * 0.5f + origin*dimensions + min*scale;// -translation;
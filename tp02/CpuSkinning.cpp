@@ -0,0 +1,195 @@
+#include "CpuSkinning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <iostream>
+
+#include "glm/gtc/type_ptr.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CPU_SKINNING_USE_SSE 1
+#include <emmintrin.h>
+#else
+#define CPU_SKINNING_USE_SSE 0
+#endif
+
+namespace {
+	//sum of the weighted bone matrices of a vertex, as in the vertex shaders :
+	glm::mat4 blendBones(const VertexBoneData& boneData, const std::vector<glm::mat4>& bonesTransform)
+	{
+		glm::mat4 blended(0.f);
+		for (int i = 0; i < MAX_BONE_DATA_PER_VERTEX; i++)
+		{
+			if (boneData.weights[i] != 0.f && boneData.ids[i] < bonesTransform.size())
+				blended += bonesTransform[boneData.ids[i]] * boneData.weights[i];
+		}
+		return blended;
+	}
+
+	void normalize3(float* v)
+	{
+		float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (length > 0.f)
+		{
+			v[0] /= length;
+			v[1] /= length;
+			v[2] /= length;
+		}
+	}
+}
+
+void CpuSkinning::skin(const std::vector<float>& positions, const std::vector<float>& normals, const std::vector<VertexBoneData>& boneDatas, const std::vector<glm::mat4>& bonesTransform,
+	std::vector<float>& outPositions, std::vector<float>& outNormals)
+{
+#if CPU_SKINNING_USE_SSE
+	const int vertexCount = std::min((int)positions.size() / 3, (int)boneDatas.size());
+	const bool useNormals = (normals.size() >= vertexCount * 3);
+	const unsigned int boneCount = bonesTransform.size();
+
+	outPositions.resize(vertexCount * 3);
+	outNormals.resize(useNormals ? vertexCount * 3 : 0);
+
+	const float* bones = boneCount > 0 ? glm::value_ptr(bonesTransform[0]) : nullptr;
+	float result[4];
+
+	for (int v = 0; v < vertexCount; v++)
+	{
+		const VertexBoneData& boneData = boneDatas[v];
+
+		//blended matrix, one column per register :
+		__m128 column0 = _mm_setzero_ps();
+		__m128 column1 = _mm_setzero_ps();
+		__m128 column2 = _mm_setzero_ps();
+		__m128 column3 = _mm_setzero_ps();
+		for (int i = 0; i < MAX_BONE_DATA_PER_VERTEX; i++)
+		{
+			if (boneData.weights[i] == 0.f || boneData.ids[i] >= boneCount)
+				continue;
+
+			const float* bone = bones + boneData.ids[i] * 16;
+			const __m128 weight = _mm_set1_ps(boneData.weights[i]);
+			column0 = _mm_add_ps(column0, _mm_mul_ps(_mm_loadu_ps(bone), weight));
+			column1 = _mm_add_ps(column1, _mm_mul_ps(_mm_loadu_ps(bone + 4), weight));
+			column2 = _mm_add_ps(column2, _mm_mul_ps(_mm_loadu_ps(bone + 8), weight));
+			column3 = _mm_add_ps(column3, _mm_mul_ps(_mm_loadu_ps(bone + 12), weight));
+		}
+
+		const float* position = &positions[v * 3];
+		__m128 skinned = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(position[0])), _mm_mul_ps(column1, _mm_set1_ps(position[1]))),
+			_mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(position[2])), column3));
+		_mm_storeu_ps(result, skinned);
+		outPositions[v * 3] = result[0];
+		outPositions[v * 3 + 1] = result[1];
+		outPositions[v * 3 + 2] = result[2];
+
+		if (useNormals)
+		{
+			const float* normal = &normals[v * 3];
+			__m128 skinnedNormal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(normal[0])), _mm_mul_ps(column1, _mm_set1_ps(normal[1]))),
+				_mm_mul_ps(column2, _mm_set1_ps(normal[2])));
+			_mm_storeu_ps(result, skinnedNormal);
+			normalize3(result);
+			outNormals[v * 3] = result[0];
+			outNormals[v * 3 + 1] = result[1];
+			outNormals[v * 3 + 2] = result[2];
+		}
+	}
+#else
+	skinScalar(positions, normals, boneDatas, bonesTransform, outPositions, outNormals);
+#endif
+}
+
+void CpuSkinning::skinScalar(const std::vector<float>& positions, const std::vector<float>& normals, const std::vector<VertexBoneData>& boneDatas, const std::vector<glm::mat4>& bonesTransform,
+	std::vector<float>& outPositions, std::vector<float>& outNormals)
+{
+	const int vertexCount = std::min((int)positions.size() / 3, (int)boneDatas.size());
+	const bool useNormals = (normals.size() >= vertexCount * 3);
+
+	outPositions.resize(vertexCount * 3);
+	outNormals.resize(useNormals ? vertexCount * 3 : 0);
+
+	for (int v = 0; v < vertexCount; v++)
+	{
+		glm::mat4 blended = blendBones(boneDatas[v], bonesTransform);
+
+		glm::vec4 skinned = blended * glm::vec4(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2], 1.f);
+		outPositions[v * 3] = skinned.x;
+		outPositions[v * 3 + 1] = skinned.y;
+		outPositions[v * 3 + 2] = skinned.z;
+
+		if (useNormals)
+		{
+			glm::vec4 skinnedNormal = blended * glm::vec4(normals[v * 3], normals[v * 3 + 1], normals[v * 3 + 2], 0.f);
+			float result[3] = { skinnedNormal.x, skinnedNormal.y, skinnedNormal.z };
+			normalize3(result);
+			outNormals[v * 3] = result[0];
+			outNormals[v * 3 + 1] = result[1];
+			outNormals[v * 3 + 2] = result[2];
+		}
+	}
+}
+
+bool CpuSkinning::checkAgainstScalar(int vertexCount, int boneCount, float epsilon)
+{
+	//fixed seed, to reproduce a failure :
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<float> value(-1.f, 1.f);
+	std::uniform_int_distribution<int> boneId(0, boneCount); //boneCount itself is out of range, and has to be ignored
+
+	std::vector<glm::mat4> bonesTransform(boneCount);
+	for (auto& bone : bonesTransform)
+	{
+		for (int c = 0; c < 3; c++)
+			bone[c] = glm::vec4(value(generator), value(generator), value(generator), 0.f);
+		bone[3] = glm::vec4(value(generator) * 10.f, value(generator) * 10.f, value(generator) * 10.f, 1.f);
+	}
+
+	std::vector<float> positions(vertexCount * 3);
+	std::vector<float> normals(vertexCount * 3);
+	for (int i = 0; i < vertexCount * 3; i++)
+	{
+		positions[i] = value(generator) * 10.f;
+		normals[i] = value(generator);
+	}
+
+	std::vector<VertexBoneData> boneDatas(vertexCount);
+	for (auto& boneData : boneDatas)
+	{
+		float weightSum = 0.f;
+		for (int i = 0; i < MAX_BONE_DATA_PER_VERTEX; i++)
+		{
+			boneData.ids[i] = boneId(generator);
+			boneData.weights[i] = (value(generator) + 1.f) * 0.5f;
+			weightSum += boneData.weights[i];
+		}
+		for (int i = 0; i < MAX_BONE_DATA_PER_VERTEX; i++)
+			boneData.weights[i] /= weightSum;
+	}
+	//some vertices with unused influences :
+	for (int v = 0; v < vertexCount; v += 3)
+		boneDatas[v].weights[MAX_BONE_DATA_PER_VERTEX - 1] = 0.f;
+
+	std::vector<float> simdPositions, simdNormals, scalarPositions, scalarNormals;
+	skin(positions, normals, boneDatas, bonesTransform, simdPositions, simdNormals);
+	skinScalar(positions, normals, boneDatas, bonesTransform, scalarPositions, scalarNormals);
+
+	if (simdPositions.size() != scalarPositions.size() || simdNormals.size() != scalarNormals.size())
+	{
+		std::cout << "error, cpu skinning : the SIMD and scalar outputs don't have the same size." << std::endl;
+		return false;
+	}
+
+	for (int i = 0; i < scalarPositions.size(); i++)
+	{
+		//relative to the magnitude for the positions, which are far from the origin :
+		float scale = std::max(1.f, std::abs(scalarPositions[i]));
+		if (std::abs(simdPositions[i] - scalarPositions[i]) > epsilon * scale || std::abs(simdNormals[i] - scalarNormals[i]) > epsilon)
+		{
+			std::cout << "error, cpu skinning : the SIMD and scalar results differ at vertex " << i / 3 << "." << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Skeleton.h"
+
+//Skinning of the vertices on the CPU, with the same math as the vertex shaders : the vertex is transformed by the sum of its four weighted bone matrices.
+//Used when the deformed shape is needed outside of the GPU (ray picking, collider fitting, headless processing).
+class CpuSkinning
+{
+public:
+	//positions and normals : three floats per vertex, boneDatas : one per vertex. The normals are skipped if normals is empty.
+	//Bone ids out of bonesTransform are ignored. Uses SSE when it is available.
+	static void skin(const std::vector<float>& positions, const std::vector<float>& normals, const std::vector<VertexBoneData>& boneDatas, const std::vector<glm::mat4>& bonesTransform,
+		std::vector<float>& outPositions, std::vector<float>& outNormals);
+
+	//reference implementation, without SIMD, to check the results of skin :
+	static void skinScalar(const std::vector<float>& positions, const std::vector<float>& normals, const std::vector<VertexBoneData>& boneDatas, const std::vector<glm::mat4>& bonesTransform,
+		std::vector<float>& outPositions, std::vector<float>& outNormals);
+
+	//GPU free self check : skin random vertices with random bones and weights with both implementations, 
+	//return false if a position or a normal component differs by more than epsilon.
+	static bool checkAgainstScalar(int vertexCount = 256, int boneCount = 32, float epsilon = 1e-4f);
+};
+
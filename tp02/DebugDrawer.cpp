@@ -1,11 +1,12 @@
 #include "DebugDrawer.h"
 //forwards : 
 #include "Factories.h"
+#include "GLStateCache.h"
 
 DebugDrawer::DebugDrawer() : m_maxPoint(10000), m_material(nullptr)
 {
 	glGenVertexArrays(1, &m_vao);
-	glBindVertexArray(m_vao);
+	GLStateCache::get().bindVertexArray(m_vao);
 
 	glGenBuffers(1, &m_vboPositions);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vboPositions);
@@ -19,7 +20,7 @@ DebugDrawer::DebugDrawer() : m_maxPoint(10000), m_material(nullptr)
 	glEnableVertexAttribArray(1);
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 3, (void*)0);
 
-	glBindVertexArray(0);
+	GLStateCache::get().bindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	m_material = MaterialFactory::get().get<MaterialDebugDrawer>("debugDrawer");
@@ -51,11 +52,11 @@ void DebugDrawer::render_internal(const glm::mat4 & projection, const glm::mat4
 
 void DebugDrawer::draw_internal()
 {
-	glBindVertexArray(m_vao);
+	GLStateCache::get().bindVertexArray(m_vao);
 
 	glDrawArrays(GL_LINES, 0, m_points.size());
 
-	glBindVertexArray(0);
+	GLStateCache::get().bindVertexArray(0);
 }
 
 void DebugDrawer::clear_internal()
@@ -0,0 +1,418 @@
+#include "DynamicAABBTree.h"
+
+#include <algorithm>
+#include <cassert>
+
+//forwards :
+#include "Frustum.h"
+#include "Ray.h"
+
+namespace {
+	float surfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 extent = boundsMax - boundsMin;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+
+	bool contains(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& otherMin, const glm::vec3& otherMax)
+	{
+		return boundsMin.x <= otherMin.x && boundsMin.y <= otherMin.y && boundsMin.z <= otherMin.z
+			&& boundsMax.x >= otherMax.x && boundsMax.y >= otherMax.y && boundsMax.z >= otherMax.z;
+	}
+}
+
+DynamicAABBTreeNode::DynamicAABBTreeNode() : boundsMin(0, 0, 0), boundsMax(0, 0, 0), parent(-1), child1(-1), child2(-1), height(-1), component(nullptr)
+{
+
+}
+
+bool DynamicAABBTreeNode::isLeaf() const
+{
+	return child1 == -1;
+}
+
+DynamicAABBTree::DynamicAABBTree(float margin) : m_root(-1), m_freeList(-1), m_leafCount(0), m_margin(margin)
+{
+
+}
+
+void DynamicAABBTree::clear()
+{
+	m_nodes.clear();
+	m_root = -1;
+	m_freeList = -1;
+	m_leafCount = 0;
+}
+
+int DynamicAABBTree::insert(Component* component, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	int proxy = allocateNode();
+	DynamicAABBTreeNode& leaf = m_nodes[proxy];
+	leaf.boundsMin = boundsMin - glm::vec3(m_margin);
+	leaf.boundsMax = boundsMax + glm::vec3(m_margin);
+	leaf.component = component;
+	leaf.height = 0;
+
+	insertLeaf(proxy);
+	m_leafCount++;
+
+	return proxy;
+}
+
+void DynamicAABBTree::remove(int proxy)
+{
+	assert(proxy >= 0 && proxy < (int)m_nodes.size() && m_nodes[proxy].isLeaf());
+
+	removeLeaf(proxy);
+	freeNode(proxy);
+	m_leafCount--;
+}
+
+bool DynamicAABBTree::move(int proxy, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	assert(proxy >= 0 && proxy < (int)m_nodes.size() && m_nodes[proxy].isLeaf());
+
+	DynamicAABBTreeNode& leaf = m_nodes[proxy];
+	glm::vec3 fatMin = boundsMin - glm::vec3(m_margin);
+	glm::vec3 fatMax = boundsMax + glm::vec3(m_margin);
+
+	//still inside the fat bounds, and the fat bounds aren't too large (a light whose radius has been reduced for instance) :
+	if (contains(leaf.boundsMin, leaf.boundsMax, boundsMin, boundsMax)
+		&& contains(fatMin - glm::vec3(m_margin * 4.f), fatMax + glm::vec3(m_margin * 4.f), leaf.boundsMin, leaf.boundsMax))
+		return false;
+
+	removeLeaf(proxy);
+	leaf.boundsMin = fatMin;
+	leaf.boundsMax = fatMax;
+	insertLeaf(proxy);
+
+	return true;
+}
+
+Component* DynamicAABBTree::getComponent(int proxy) const
+{
+	assert(proxy >= 0 && proxy < (int)m_nodes.size());
+
+	return m_nodes[proxy].component;
+}
+
+void DynamicAABBTree::getFatBounds(int proxy, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+	assert(proxy >= 0 && proxy < (int)m_nodes.size());
+
+	boundsMin = m_nodes[proxy].boundsMin;
+	boundsMax = m_nodes[proxy].boundsMax;
+}
+
+int DynamicAABBTree::getLeafCount() const
+{
+	return m_leafCount;
+}
+
+int DynamicAABBTree::getHeight() const
+{
+	if (m_root == -1)
+		return 0;
+	return m_nodes[m_root].height;
+}
+
+void DynamicAABBTree::queryFrustum(const Frustum& frustum, std::vector<Component*>& results) const
+{
+	query([&frustum](const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		return frustum.testAABB(boundsMin, boundsMax);
+	}, results);
+}
+
+void DynamicAABBTree::querySphere(const glm::vec3& center, float radius, std::vector<Component*>& results) const
+{
+	query([&center, radius](const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		glm::vec3 closestPoint = glm::clamp(center, boundsMin, boundsMax);
+		glm::vec3 toCenter = center - closestPoint;
+		return glm::dot(toCenter, toCenter) <= radius * radius;
+	}, results);
+}
+
+void DynamicAABBTree::queryAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<Component*>& results) const
+{
+	query([&boundsMin, &boundsMax](const glm::vec3& nodeMin, const glm::vec3& nodeMax) {
+		return nodeMin.x <= boundsMax.x && nodeMax.x >= boundsMin.x
+			&& nodeMin.y <= boundsMax.y && nodeMax.y >= boundsMin.y
+			&& nodeMin.z <= boundsMax.z && nodeMax.z >= boundsMin.z;
+	}, results);
+}
+
+void DynamicAABBTree::queryRay(const Ray& ray, std::vector<Component*>& results, float maxDistance) const
+{
+	const glm::vec3 origin = ray.getOrigin();
+	const glm::vec3 direction = ray.getDirection();
+	glm::vec3 invDirection;
+	for (int axis = 0; axis < 3; axis++)
+		invDirection[axis] = (direction[axis] != 0.f) ? 1.f / direction[axis] : 0.f;
+
+	//slab test :
+	query([&origin, &direction, &invDirection, maxDistance](const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		float tNear = -std::numeric_limits<float>::max();
+		float tFar = std::numeric_limits<float>::max();
+		for (int axis = 0; axis < 3; axis++)
+		{
+			//a ray parallel to the slab never enters or leaves it, the origin has to be between the planes 
+			//(dividing by the zero component would give 0 * inf = NaN at the plane, and reject the node) :
+			if (direction[axis] == 0.f)
+			{
+				if (origin[axis] < boundsMin[axis] || origin[axis] > boundsMax[axis])
+					return false;
+				continue;
+			}
+
+			float t1 = (boundsMin[axis] - origin[axis]) * invDirection[axis];
+			float t2 = (boundsMax[axis] - origin[axis]) * invDirection[axis];
+			tNear = std::max(tNear, std::min(t1, t2));
+			tFar = std::min(tFar, std::max(t1, t2));
+		}
+		return tFar >= tNear && tFar >= 0.f && tNear <= maxDistance;
+	}, results);
+}
+
+int DynamicAABBTree::allocateNode()
+{
+	if (m_freeList == -1)
+	{
+		m_nodes.push_back(DynamicAABBTreeNode());
+		return m_nodes.size() - 1;
+	}
+
+	int nodeIndex = m_freeList;
+	m_freeList = m_nodes[nodeIndex].parent;
+	m_nodes[nodeIndex] = DynamicAABBTreeNode();
+	return nodeIndex;
+}
+
+void DynamicAABBTree::freeNode(int nodeIndex)
+{
+	m_nodes[nodeIndex] = DynamicAABBTreeNode();
+	m_nodes[nodeIndex].parent = m_freeList;
+	m_freeList = nodeIndex;
+}
+
+void DynamicAABBTree::insertLeaf(int leaf)
+{
+	if (m_root == -1)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = -1;
+		return;
+	}
+
+	const glm::vec3 leafMin = m_nodes[leaf].boundsMin;
+	const glm::vec3 leafMax = m_nodes[leaf].boundsMax;
+
+	//find the best sibling, going down while it is cheaper than stopping at the current node :
+	int index = m_root;
+	while (!m_nodes[index].isLeaf())
+	{
+		const DynamicAABBTreeNode& node = m_nodes[index];
+		float area = surfaceArea(node.boundsMin, node.boundsMax);
+		float combinedArea = surfaceArea(glm::min(node.boundsMin, leafMin), glm::max(node.boundsMax, leafMax));
+
+		//cost of a new parent for this node and the leaf :
+		float cost = 2.f * combinedArea;
+		//cost of growing this node to push the leaf down :
+		float inheritanceCost = 2.f * (combinedArea - area);
+
+		float childCosts[2];
+		int children[2] = { node.child1, node.child2 };
+		for (int i = 0; i < 2; i++)
+		{
+			const DynamicAABBTreeNode& child = m_nodes[children[i]];
+			float childCombinedArea = surfaceArea(glm::min(child.boundsMin, leafMin), glm::max(child.boundsMax, leafMax));
+			if (child.isLeaf())
+				childCosts[i] = childCombinedArea + inheritanceCost;
+			else
+				childCosts[i] = childCombinedArea - surfaceArea(child.boundsMin, child.boundsMax) + inheritanceCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+
+		index = (childCosts[0] < childCosts[1]) ? children[0] : children[1];
+	}
+
+	//new parent for the sibling and the leaf (the nodes can be reallocated, don't keep references before it) :
+	int sibling = index;
+	int newParent = allocateNode();
+	int oldParent = m_nodes[sibling].parent;
+
+	DynamicAABBTreeNode& parentNode = m_nodes[newParent];
+	parentNode.parent = oldParent;
+	parentNode.boundsMin = glm::min(m_nodes[sibling].boundsMin, leafMin);
+	parentNode.boundsMax = glm::max(m_nodes[sibling].boundsMax, leafMax);
+	parentNode.height = m_nodes[sibling].height + 1;
+	parentNode.child1 = sibling;
+	parentNode.child2 = leaf;
+
+	if (oldParent != -1)
+	{
+		if (m_nodes[oldParent].child1 == sibling)
+			m_nodes[oldParent].child1 = newParent;
+		else
+			m_nodes[oldParent].child2 = newParent;
+	}
+	else
+		m_root = newParent;
+
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	refitFrom(m_nodes[leaf].parent);
+}
+
+void DynamicAABBTree::removeLeaf(int leaf)
+{
+	if (leaf == m_root)
+	{
+		m_root = -1;
+		return;
+	}
+
+	//the sibling takes the place of the parent :
+	int parent = m_nodes[leaf].parent;
+	int grandParent = m_nodes[parent].parent;
+	int sibling = (m_nodes[parent].child1 == leaf) ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	if (grandParent != -1)
+	{
+		if (m_nodes[grandParent].child1 == parent)
+			m_nodes[grandParent].child1 = sibling;
+		else
+			m_nodes[grandParent].child2 = sibling;
+		m_nodes[sibling].parent = grandParent;
+		freeNode(parent);
+
+		refitFrom(grandParent);
+	}
+	else
+	{
+		m_root = sibling;
+		m_nodes[sibling].parent = -1;
+		freeNode(parent);
+	}
+}
+
+void DynamicAABBTree::refitFrom(int nodeIndex)
+{
+	int index = nodeIndex;
+	while (index != -1)
+	{
+		index = balance(index);
+
+		DynamicAABBTreeNode& node = m_nodes[index];
+		const DynamicAABBTreeNode& child1 = m_nodes[node.child1];
+		const DynamicAABBTreeNode& child2 = m_nodes[node.child2];
+		node.height = 1 + std::max(child1.height, child2.height);
+		node.boundsMin = glm::min(child1.boundsMin, child2.boundsMin);
+		node.boundsMax = glm::max(child1.boundsMax, child2.boundsMax);
+
+		index = node.parent;
+	}
+}
+
+int DynamicAABBTree::balance(int nodeIndex)
+{
+	const int iA = nodeIndex;
+	DynamicAABBTreeNode& A = m_nodes[iA];
+	if (A.isLeaf() || A.height < 2)
+		return iA;
+
+	const int iB = A.child1;
+	const int iC = A.child2;
+	DynamicAABBTreeNode& B = m_nodes[iB];
+	DynamicAABBTreeNode& C = m_nodes[iC];
+
+	const int heightDifference = C.height - B.height;
+
+	//rotate C up, A takes the place of its lowest child :
+	if (heightDifference > 1)
+	{
+		const int iF = C.child1;
+		const int iG = C.child2;
+		DynamicAABBTreeNode& F = m_nodes[iF];
+		DynamicAABBTreeNode& G = m_nodes[iG];
+
+		C.child1 = iA;
+		C.parent = A.parent;
+		A.parent = iC;
+
+		if (C.parent != -1)
+		{
+			if (m_nodes[C.parent].child1 == iA)
+				m_nodes[C.parent].child1 = iC;
+			else
+				m_nodes[C.parent].child2 = iC;
+		}
+		else
+			m_root = iC;
+
+		const bool keepF = F.height > G.height;
+		const int iKept = keepF ? iF : iG;
+		const int iMoved = keepF ? iG : iF;
+		DynamicAABBTreeNode& kept = m_nodes[iKept];
+		DynamicAABBTreeNode& moved = m_nodes[iMoved];
+
+		C.child2 = iKept;
+		A.child2 = iMoved;
+		moved.parent = iA;
+
+		A.boundsMin = glm::min(B.boundsMin, moved.boundsMin);
+		A.boundsMax = glm::max(B.boundsMax, moved.boundsMax);
+		C.boundsMin = glm::min(A.boundsMin, kept.boundsMin);
+		C.boundsMax = glm::max(A.boundsMax, kept.boundsMax);
+		A.height = 1 + std::max(B.height, moved.height);
+		C.height = 1 + std::max(A.height, kept.height);
+
+		return iC;
+	}
+
+	//rotate B up, A takes the place of its lowest child :
+	if (heightDifference < -1)
+	{
+		const int iD = B.child1;
+		const int iE = B.child2;
+		DynamicAABBTreeNode& D = m_nodes[iD];
+		DynamicAABBTreeNode& E = m_nodes[iE];
+
+		B.child1 = iA;
+		B.parent = A.parent;
+		A.parent = iB;
+
+		if (B.parent != -1)
+		{
+			if (m_nodes[B.parent].child1 == iA)
+				m_nodes[B.parent].child1 = iB;
+			else
+				m_nodes[B.parent].child2 = iB;
+		}
+		else
+			m_root = iB;
+
+		const bool keepD = D.height > E.height;
+		const int iKept = keepD ? iD : iE;
+		const int iMoved = keepD ? iE : iD;
+		DynamicAABBTreeNode& kept = m_nodes[iKept];
+		DynamicAABBTreeNode& moved = m_nodes[iMoved];
+
+		B.child2 = iKept;
+		A.child1 = iMoved;
+		moved.parent = iA;
+
+		A.boundsMin = glm::min(C.boundsMin, moved.boundsMin);
+		A.boundsMax = glm::max(C.boundsMax, moved.boundsMax);
+		B.boundsMin = glm::min(A.boundsMin, kept.boundsMin);
+		B.boundsMax = glm::max(A.boundsMax, kept.boundsMax);
+		A.height = 1 + std::max(C.height, moved.height);
+		B.height = 1 + std::max(A.height, kept.height);
+
+		return iB;
+	}
+
+	return iA;
+}
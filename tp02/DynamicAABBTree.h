@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+
+#include "glm/glm.hpp"
+
+//forwards :
+class Component;
+class Frustum;
+class Ray;
+
+//a node of the tree. Leafs have no children (child1 == -1) and hold a component.
+struct DynamicAABBTreeNode
+{
+	//fat bounds for the leafs, union of the children bounds for the internal nodes :
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	int parent; //next free node for the free nodes
+	int child1;
+	int child2;
+	int height; //0 for the leafs, -1 for the free nodes
+	Component* component;
+
+	DynamicAABBTreeNode();
+	bool isLeaf() const;
+};
+
+//Bounding volume tree over the scene components, updated incrementally (like btDbvt in bullet).
+//Each leaf stores fat bounds : the tight bounds grown by a margin, so that small moves don't change the tree.
+//A leaf is inserted next to the sibling which increases the least the surface of the tree, then the tree is rebalanced by rotations on the way back to the root.
+//Nodes are stored in a flat array with a free list, a proxy is the index of the leaf of a component.
+//Queries append the components whose fat bounds pass the test, it can be a bit more than the exact result.
+class DynamicAABBTree
+{
+private:
+	std::vector<DynamicAABBTreeNode> m_nodes;
+	int m_root;
+	int m_freeList;
+	int m_leafCount;
+	float m_margin;
+
+public:
+	DynamicAABBTree(float margin = 0.1f);
+
+	void clear();
+
+	//insert a component with its world bounds, return its proxy.
+	int insert(Component* component, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	void remove(int proxy);
+	//update the bounds of a proxy. The tree changes only if the bounds leave the fat bounds, or are much smaller than them. Return true in that case.
+	bool move(int proxy, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	Component* getComponent(int proxy) const;
+	void getFatBounds(int proxy, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+	int getLeafCount() const;
+	int getHeight() const;
+
+	//append the components intersecting the volume to results :
+	void queryFrustum(const Frustum& frustum, std::vector<Component*>& results) const;
+	void querySphere(const glm::vec3& center, float radius, std::vector<Component*>& results) const;
+	void queryAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<Component*>& results) const;
+	//append the components whose bounds are crossed by the ray before maxDistance :
+	void queryRay(const Ray& ray, std::vector<Component*>& results, float maxDistance = std::numeric_limits<float>::max()) const;
+
+private:
+	int allocateNode();
+	void freeNode(int nodeIndex);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	//recompute the bounds and the heights from a node to the root, rebalancing on the way :
+	void refitFrom(int nodeIndex);
+	//rotate the subtree under nodeIndex if one child is higher than the other by more than one, return the index of the new subtree root :
+	int balance(int nodeIndex);
+	//traverse the tree, keeping the subtrees whose bounds pass the test :
+	template<typename Test>
+	void query(const Test& test, std::vector<Component*>& results) const;
+};
+
+template<typename Test>
+void DynamicAABBTree::query(const Test& test, std::vector<Component*>& results) const
+{
+	if (m_root == -1)
+		return;
+
+	std::vector<int> stack;
+	stack.reserve(64);
+	stack.push_back(m_root);
+	while (!stack.empty())
+	{
+		const DynamicAABBTreeNode& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if (!test(node.boundsMin, node.boundsMax))
+			continue;
+
+		if (node.isLeaf())
+			results.push_back(node.component);
+		else
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
+
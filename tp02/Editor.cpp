@@ -5,6 +5,8 @@
 #include "Factories.h"
 #include "InputHandler.h"
 #include "Project.h"
+#include "CpuSkinning.h"
+#include "LightTileGrid.h"
 
 
 
@@ -444,6 +446,13 @@ void Editor::displayMenuBar(Project& project)
 				m_loadWindowOpen = true;
 				//ImGui::OpenPopup("load window");
 			}
+			//GPU free checks, the errors are printed by the checks :
+			if (ImGui::Selectable("run self checks"))
+			{
+				bool isCpuSkinningValid = CpuSkinning::checkAgainstScalar();
+				bool isLightTileGridValid = LightTileGrid::checkTileLists();
+				std::cout << "self checks : cpu skinning " << (isCpuSkinningValid ? "ok" : "failed") << ", light tile grid " << (isLightTileGridValid ? "ok" : "failed") << std::endl;
+			}
 
 			ImGui::EndMenu();
 		}
@@ -481,6 +490,19 @@ void Editor::displayMenuBar(Project& project)
 
 			ImGui::EndMenu();
 		}
+		if (ImGui::BeginMenu("animations"))
+		{
+			scene.getAnimatorManager().drawUI();
+
+			ImGui::EndMenu();
+		}
+		if (ImGui::BeginMenu("rendering"))
+		{
+			scene.getRenderer().drawUI();
+			ImGui::Text("spatial tree : %d proxies, height %d", scene.getSpatialTree().getLeafCount(), scene.getSpatialTree().getHeight());
+
+			ImGui::EndMenu();
+		}
 		if (ImGui::BeginMenu("Add default entities"))
 		{
 			if (ImGui::Button("add empty entity"))
@@ -1635,7 +1657,24 @@ void Editor::update(/*Camera & camera*/ Scene& scene, GLFWwindow* window)
 					Collider* collider = static_cast<Collider*>(entities[i]->getComponent(Component::ComponentType::COLLIDER));
 					if (entities[i]->getComponent(Component::ComponentType::COLLIDER) != nullptr)
 					{
-						if (ray.intersect(*collider, &distanceToIntersection))
+						bool isHit = ray.intersect(*collider, &distanceToIntersection);
+
+						//skinned meshes are refined with their current pose, which can be far from the collider :
+						MeshRenderer* meshRenderer = static_cast<MeshRenderer*>(entities[i]->getComponent(Component::ComponentType::MESH_RENDERER));
+						if (isHit && meshRenderer != nullptr && meshRenderer->getMesh() != nullptr && meshRenderer->getMesh()->getIsSkeletalMesh())
+						{
+							glm::mat4 inverseModelMatrix = glm::inverse(entities[i]->getModelMatrix());
+							glm::vec3 localOrigin = glm::vec3(inverseModelMatrix * glm::vec4(ray.getOrigin(), 1.f));
+							glm::vec3 localDirection = glm::normalize(glm::vec3(inverseModelMatrix * glm::vec4(ray.getDirection(), 0.f)));
+							Ray localRay(localOrigin, localDirection, ray.getLength());
+
+							MeshRayHit hit;
+							isHit = meshRenderer->isIntersectedByRay(localRay, hit);
+							if (isHit)
+								distanceToIntersection = glm::length(glm::vec3(entities[i]->getModelMatrix() * glm::vec4(hit.point, 1.f)) - ray.getOrigin());
+						}
+
+						if (isHit)
 						{
 							if (intersectedCount == 0 || distanceToIntersection < minDistanceToIntersection)
 							{
@@ -85,6 +85,7 @@ void Entity::applyTransform()
 	for (auto& c : m_components)
 	{
 		c->applyTransform(m_translation, m_scale, m_rotation);
+		m_scene->updateSpatialProxy(c);
 	}
 	for (auto& e : m_childs)
 	{
@@ -165,6 +166,7 @@ void Entity::applyTransformFromPhysicSimulation()
 	for (auto& c : m_components)
 	{
 		c->applyTransformFromPhysicSimulation(m_translation, m_rotation);
+		m_scene->updateSpatialProxy(c);
 	}
 	for (auto& e : m_childs)
 	{
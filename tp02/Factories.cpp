@@ -2,6 +2,8 @@
 //forwards : 
 #include "Utils.h"
 #include "imgui_extension.h"
+#include "Application.h"
+#include "GLStateCache.h"
 
 ProgramFactory::ProgramFactory()
 {
@@ -299,7 +301,7 @@ void ProgramFactory::clear()
 	{
 		if (std::find(m_defaults.begin(), m_defaults.end(), it->first) == m_defaults.end()) // we keep defaults alive
 		{
-			glDeleteProgram(it->second);
+			GLStateCache::get().deleteProgram(it->second);
 			it = m_programs.erase(it);
 		}
 		else
@@ -577,7 +579,42 @@ void CubeTextureFactory::load(Json::Value & entityRoot)
 
 /////////////////////////////////////////
 
-MeshFactory::MeshFactory()
+MeshImportRequest::MeshImportRequest(const std::string& _name, const std::string& _path) : name(_name), path(_path), mesh(nullptr), success(false), state(PENDING)
+{
+
+}
+
+MeshImportHandle::MeshImportHandle()
+{
+
+}
+
+MeshImportHandle::MeshImportHandle(std::shared_ptr<MeshImportRequest> request) : m_request(request)
+{
+
+}
+
+bool MeshImportHandle::isValid() const
+{
+	return m_request != nullptr;
+}
+
+bool MeshImportHandle::isReady() const
+{
+	return m_request != nullptr && m_request->state == MeshImportRequest::READY;
+}
+
+bool MeshImportHandle::hasFailed() const
+{
+	return m_request == nullptr || m_request->state == MeshImportRequest::FAILED;
+}
+
+Mesh* MeshImportHandle::getMesh() const
+{
+	return isReady() ? m_request->mesh : nullptr;
+}
+
+MeshFactory::MeshFactory() : m_stopImportThreads(false), m_uploadBudget(0.004)
 {
 	Mesh* cube = new Mesh(GL_TRIANGLES, (Mesh::USE_INDEX | Mesh::USE_VERTICES | Mesh::USE_NORMALS | Mesh::USE_UVS | Mesh::USE_TANGENTS));
 	cube->vertices = { 0.5,0.5,-0.5,  0.5,0.5,0.5,  0.5,-0.5,0.5,  0.5,-0.5,-0.5,
@@ -744,6 +781,11 @@ MeshFactory::MeshFactory()
 	m_defaults.push_back("quad");
 }
 
+MeshFactory::~MeshFactory()
+{
+	stopImportThreads();
+}
+
 void MeshFactory::add(const std::string& name, Mesh* mesh)
 {
 	if (std::find(m_defaults.begin(), m_defaults.end(), name) != m_defaults.end()) //can't override default key
@@ -764,6 +806,153 @@ void MeshFactory::add(const std::string & name, const std::string & path)
 	m_meshes[name] = newMesh;
 }
 
+MeshImportHandle MeshFactory::addAsync(const std::string& name, const std::string& path)
+{
+	if (std::find(m_defaults.begin(), m_defaults.end(), name) != m_defaults.end()) //can't override default key
+		return MeshImportHandle();
+
+	//already importing :
+	auto found = m_pendingImports.find(name);
+	if (found != m_pendingImports.end())
+		return MeshImportHandle(found->second);
+
+	std::shared_ptr<MeshImportRequest> request = std::make_shared<MeshImportRequest>(name, path);
+	m_pendingImports[name] = request;
+
+	startImportThreads();
+	{
+		std::lock_guard<std::mutex> lock(m_importMutex);
+		m_importQueue.push_back(request);
+	}
+	m_importCondition.notify_one();
+
+	return MeshImportHandle(request);
+}
+
+void MeshFactory::updateAsyncImports()
+{
+	double startTime = Application::get().getTime();
+
+	//at least one mesh per frame, to always make progress :
+	while (true)
+	{
+		std::shared_ptr<MeshImportRequest> request;
+		{
+			std::lock_guard<std::mutex> lock(m_importMutex);
+			if (m_uploadQueue.empty())
+				break;
+			request = m_uploadQueue.front();
+			m_uploadQueue.pop_front();
+		}
+
+		m_pendingImports.erase(request->name);
+
+		if (request->success)
+		{
+			auto found = m_meshes.find(request->name);
+			if (found != m_meshes.end() && found->second != nullptr)
+			{
+				//the mesh renderers keep their pointer to the previous mesh, the new datas are moved into it 
+				//and the previous datas are released with the imported mesh :
+				Mesh* previousMesh = found->second;
+				previousMesh->swapDatas(*request->mesh);
+				m_replacedSkeletons.push_back(request->mesh->skeleton);
+				request->mesh->skeleton = nullptr;
+				//the animations registered under this name are still used by the animators, finishImport replaces the ones with the same names :
+				request->mesh->name.clear();
+				delete request->mesh;
+				request->mesh = previousMesh;
+			}
+
+			request->mesh->finishImport();
+			m_meshes[request->name] = request->mesh;
+			request->state = MeshImportRequest::READY;
+		}
+		else
+		{
+			//the mesh hasn't registered any animation, don't let it clear the ones of a mesh with the same name :
+			request->mesh->name.clear();
+			delete request->mesh;
+			request->mesh = nullptr;
+			request->state = MeshImportRequest::FAILED;
+		}
+
+		if (Application::get().getTime() - startTime > m_uploadBudget)
+			break;
+	}
+}
+
+int MeshFactory::getPendingImportCount() const
+{
+	return m_pendingImports.size();
+}
+
+void MeshFactory::setUploadBudget(double budget)
+{
+	m_uploadBudget = budget;
+}
+
+double MeshFactory::getUploadBudget() const
+{
+	return m_uploadBudget;
+}
+
+void MeshFactory::startImportThreads()
+{
+	if (!m_importThreads.empty())
+		return;
+
+	//keep one core for the main thread :
+	int threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+	m_stopImportThreads = false;
+	for (int i = 0; i < threadCount; i++)
+		m_importThreads.push_back(std::thread(&MeshFactory::importThreadLoop, this));
+}
+
+void MeshFactory::stopImportThreads()
+{
+	if (m_importThreads.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_importMutex);
+		m_stopImportThreads = true;
+	}
+	m_importCondition.notify_all();
+
+	for (auto& thread : m_importThreads)
+		thread.join();
+	m_importThreads.clear();
+}
+
+void MeshFactory::importThreadLoop()
+{
+	while (true)
+	{
+		std::shared_ptr<MeshImportRequest> request;
+		{
+			std::unique_lock<std::mutex> lock(m_importMutex);
+			m_importCondition.wait(lock, [this]() { return m_stopImportThreads || !m_importQueue.empty(); });
+
+			if (m_stopImportThreads)
+				return;
+
+			request = m_importQueue.front();
+			m_importQueue.pop_front();
+		}
+
+		//assimp parsing and vertex processing, no gl calls here :
+		request->mesh = new Mesh(request->path, request->name, false);
+		request->success = request->mesh->importFromFile();
+
+		{
+			std::lock_guard<std::mutex> lock(m_importMutex);
+			m_uploadQueue.push_back(request);
+		}
+	}
+}
+
 Mesh* MeshFactory::get(const std::string& name)
 {
 	return m_meshes[name];
@@ -788,8 +977,10 @@ void MeshFactory::drawUI()
 	ImGui::SameLine();
 	if (ImGui::SmallButton("add"))
 	{
-		add(name, path); 
+		addAsync(name, path); 
 	}
+	if (getPendingImportCount() > 0)
+		ImGui::Text("importing %d meshes...", getPendingImportCount());
 
 
 	for (auto& m : m_meshes)
@@ -807,6 +998,25 @@ void MeshFactory::drawUI()
 
 void MeshFactory::clear()
 {
+	//cancel the background imports :
+	stopImportThreads();
+	for (auto& request : m_uploadQueue)
+	{
+		request->mesh->name.clear();
+		delete request->mesh;
+		request->mesh = nullptr;
+		request->state = MeshImportRequest::FAILED;
+	}
+	for (auto& request : m_importQueue)
+		request->state = MeshImportRequest::FAILED;
+	m_uploadQueue.clear();
+	m_importQueue.clear();
+	m_pendingImports.clear();
+
+	for (auto& skeleton : m_replacedSkeletons)
+		delete skeleton;
+	m_replacedSkeletons.clear();
+
 	for (auto& it = m_meshes.begin(); it != m_meshes.end();)
 	{
 		if (std::find(m_defaults.begin(), m_defaults.end(), it->first) == m_defaults.end()) // we keep defaults alive
@@ -895,6 +1105,8 @@ void SkeletalAnimationFactory::drawUI()
 				continue;
 
 			ImGui::Text( (mesh.first +"::"+ anim.first).c_str() );
+			ImGui::SameLine();
+			ImGui::Text("keys : %d -> %d bytes", (int)anim.second->getRawSize(), (int)anim.second->getCompressedSize());
 		}
 	}
 
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <map>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "stb/stb_image.h"
 
@@ -135,6 +140,37 @@ public:
 
 ///////////////////////////////
 
+//a mesh imported in background by the MeshFactory.
+struct MeshImportRequest
+{
+	enum ImportState { PENDING = 0, READY, FAILED };
+
+	std::string name;
+	std::string path;
+	Mesh* mesh;
+	bool success; //set by the import thread
+	ImportState state; //only modified on the main thread
+
+	MeshImportRequest(const std::string& _name, const std::string& _path);
+};
+
+//handle returned by MeshFactory::addAsync, it becomes ready when the mesh has been uploaded to the GPU and added to the factory.
+class MeshImportHandle
+{
+private:
+	std::shared_ptr<MeshImportRequest> m_request;
+
+public:
+	MeshImportHandle();
+	MeshImportHandle(std::shared_ptr<MeshImportRequest> request);
+
+	bool isValid() const;
+	bool isReady() const;
+	bool hasFailed() const;
+	//return nullptr while the mesh isn't ready.
+	Mesh* getMesh() const;
+};
+
 class MeshFactory : public ISerializable
 {
 
@@ -147,9 +183,28 @@ private:
 
 	std::vector<std::string> m_defaults;
 
+	//background import :
+	std::vector<std::thread> m_importThreads;
+	std::mutex m_importMutex;
+	std::condition_variable m_importCondition;
+	std::deque<std::shared_ptr<MeshImportRequest>> m_importQueue; //waiting for an import thread
+	std::deque<std::shared_ptr<MeshImportRequest>> m_uploadQueue; //imported, waiting for the gl upload on the main thread
+	std::map<std::string, std::shared_ptr<MeshImportRequest>> m_pendingImports;
+	//skeletons of meshes replaced by an import, the animators may still point to them. Deleted by clear :
+	std::vector<Skeleton*> m_replacedSkeletons;
+	bool m_stopImportThreads;
+	double m_uploadBudget; //time in seconds we can spent each frame to upload imported meshes
+
 public:
 	void add(const std::string& name, Mesh* mesh);
 	void add(const std::string& name, const std::string& path);
+	//import the mesh on a worker thread, the mesh is added to the factory by updateAsyncImports once it is uploaded to the GPU.
+	MeshImportHandle addAsync(const std::string& name, const std::string& path);
+	//upload the meshes imported in background, in the limit of the upload budget. Call it once per frame, on the main thread.
+	void updateAsyncImports();
+	int getPendingImportCount() const;
+	void setUploadBudget(double budget);
+	double getUploadBudget() const;
 	Mesh* get(const std::string& name);
 	bool contains(const std::string& name);
 	void drawUI();
@@ -161,6 +216,11 @@ public:
 	// singleton implementation :
 private:
 	MeshFactory();
+	~MeshFactory();
+
+	void startImportThreads();
+	void stopImportThreads();
+	void importThreadLoop();
 
 public:
 	inline static MeshFactory& get()
@@ -1,4 +1,5 @@
 #include "Flag.h"
+#include "Frustum.h"
 //forwards : 
 #include "Scene.h"
 #include "Entity.h"
@@ -938,6 +939,12 @@ namespace Physic {
 		return origin;
 	}
 
+	void Flag::getBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const
+	{
+		//the mesh bounds are the bounds of the points, the vertices are moved along the normals by 0.01 :
+		Frustum::transformAABB(m_mesh.bottomLeft - glm::vec3(0.01f), m_mesh.topRight + glm::vec3(0.01f), modelMatrix, boundsMin, boundsMax);
+	}
+
 	float Flag::getMass() const
 	{
 		return m_mass;
@@ -92,6 +92,9 @@ namespace Physic {
 		//Return the origin of the flag, which is normaly also the origin of the flag mesh.
 		glm::vec3 getOrigin() const;
 
+		//bounds of the flag shape at the last simulation step, in world space.
+		void getBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
 		float getMass() const;
 		float getRigidity() const;
 		float getViscosity() const;
@@ -0,0 +1,67 @@
+#include "Frustum.h"
+
+Frustum::Frustum()
+{
+	//infinite frustum, nothing is culled :
+	for (int i = 0; i < 6; i++)
+		m_planes[i] = glm::vec4(0.f, 0.f, 0.f, 1.f);
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	build(viewProjection);
+}
+
+void Frustum::build(const glm::mat4& viewProjection)
+{
+	glm::vec4 lastRow(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+	for (int i = 0; i < 3; i++)
+	{
+		glm::vec4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		m_planes[i * 2] = lastRow + row;
+		m_planes[i * 2 + 1] = lastRow - row;
+	}
+
+	for (int i = 0; i < 6; i++)
+	{
+		float length = glm::length(glm::vec3(m_planes[i]));
+		if (length > 0.f)
+			m_planes[i] /= length;
+	}
+}
+
+bool Frustum::testSphere(const glm::vec3& center, float radius) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (glm::dot(glm::vec3(m_planes[i]), center) + m_planes[i].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::testAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		//corner of the box the furthest along the plane normal :
+		glm::vec3 normal(m_planes[i]);
+		glm::vec3 positiveCorner(normal.x >= 0.f ? boundsMax.x : boundsMin.x, normal.y >= 0.f ? boundsMax.y : boundsMin.y, normal.z >= 0.f ? boundsMax.z : boundsMin.z);
+		if (glm::dot(normal, positiveCorner) + m_planes[i].w < 0.f)
+			return false;
+	}
+	return true;
+}
+
+void Frustum::transformAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& matrix, glm::vec3& outMin, glm::vec3& outMax)
+{
+	//transform the center, and project the extents on each axis (Arvo) :
+	glm::vec3 center = glm::vec3(matrix * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.f));
+	glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+	glm::vec3 newExtent(0.f);
+	for (int i = 0; i < 3; i++)
+		newExtent += glm::abs(glm::vec3(matrix[i])) * extent[i];
+
+	outMin = center - newExtent;
+	outMax = center + newExtent;
+}
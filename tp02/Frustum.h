@@ -0,0 +1,26 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+//Frustum of a camera, as six planes in world space extracted from the view projection matrix (Gribb / Hartmann).
+//The normals point toward the inside of the frustum. The tests are conservative : a volume near a corner can pass without being visible.
+class Frustum
+{
+private:
+	//normalized planes : dot(xyz, point) + w is the signed distance from the plane.
+	glm::vec4 m_planes[6];
+
+public:
+	Frustum();
+	Frustum(const glm::mat4& viewProjection);
+
+	void build(const glm::mat4& viewProjection);
+
+	//true if the volume is inside or intersects the frustum :
+	bool testSphere(const glm::vec3& center, float radius) const;
+	bool testAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+	//axis aligned bounds of a box transformed by a matrix :
+	static void transformAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& matrix, glm::vec3& outMin, glm::vec3& outMax);
+};
+
@@ -0,0 +1,258 @@
+#include "GLStateCache.h"
+
+#include "imgui/imgui.h"
+
+GLStateCacheStats::GLStateCacheStats() : issuedProgramCalls(0), skippedProgramCalls(0), issuedTextureCalls(0), skippedTextureCalls(0), issuedVertexArrayCalls(0), skippedVertexArrayCalls(0), issuedStateCalls(0), skippedStateCalls(0)
+{
+}
+
+int GLStateCacheStats::getIssuedCallCount() const
+{
+	return issuedProgramCalls + issuedTextureCalls + issuedVertexArrayCalls + issuedStateCalls;
+}
+
+int GLStateCacheStats::getSkippedCallCount() const
+{
+	return skippedProgramCalls + skippedTextureCalls + skippedVertexArrayCalls + skippedStateCalls;
+}
+
+GLStateCache::GLStateCache()
+{
+	invalidate();
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+	if (program == m_program)
+	{
+		m_stats.skippedProgramCalls++;
+		return;
+	}
+
+	glUseProgram(program);
+	m_program = program;
+	m_stats.issuedProgramCalls++;
+}
+
+void GLStateCache::activeTexture(GLenum textureUnit)
+{
+	GLuint unitIndex = textureUnit - GL_TEXTURE0;
+	if (unitIndex == m_activeTexture)
+	{
+		m_stats.skippedTextureCalls++;
+		return;
+	}
+
+	glActiveTexture(textureUnit);
+	m_activeTexture = unitIndex;
+	m_stats.issuedTextureCalls++;
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint texture)
+{
+	int targetIndex = getTextureTargetIndex(target);
+
+	//untracked targets and units are always issued :
+	if (targetIndex < 0 || m_activeTexture >= MAX_TEXTURE_UNIT_COUNT)
+	{
+		glBindTexture(target, texture);
+		m_stats.issuedTextureCalls++;
+		return;
+	}
+
+	GLuint& boundTexture = m_textures[m_activeTexture][targetIndex];
+	if (texture == boundTexture)
+	{
+		m_stats.skippedTextureCalls++;
+		return;
+	}
+
+	glBindTexture(target, texture);
+	boundTexture = texture;
+	m_stats.issuedTextureCalls++;
+}
+
+void GLStateCache::bindVertexArray(GLuint vertexArray)
+{
+	if (vertexArray == m_vertexArray)
+	{
+		m_stats.skippedVertexArrayCalls++;
+		return;
+	}
+
+	glBindVertexArray(vertexArray);
+	m_vertexArray = vertexArray;
+	m_stats.issuedVertexArrayCalls++;
+}
+
+void GLStateCache::enable(GLenum capability)
+{
+	setCapability(capability, true);
+}
+
+void GLStateCache::disable(GLenum capability)
+{
+	setCapability(capability, false);
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination)
+{
+	if (source == m_blendSource && destination == m_blendDestination)
+	{
+		m_stats.skippedStateCalls++;
+		return;
+	}
+
+	glBlendFunc(source, destination);
+	m_blendSource = source;
+	m_blendDestination = destination;
+	m_stats.issuedStateCalls++;
+}
+
+void GLStateCache::depthMask(GLboolean flag)
+{
+	int value = flag ? 1 : 0;
+	if (value == m_depthMask)
+	{
+		m_stats.skippedStateCalls++;
+		return;
+	}
+
+	glDepthMask(flag);
+	m_depthMask = value;
+	m_stats.issuedStateCalls++;
+}
+
+void GLStateCache::deleteProgram(GLuint program)
+{
+	//a program in use is only deleted when it isn't current anymore, we can't know when :
+	if (program == m_program)
+		m_program = UNKNOWN;
+
+	glDeleteProgram(program);
+}
+
+void GLStateCache::deleteTextures(GLsizei count, const GLuint* textures)
+{
+	//the bindings of the deleted textures revert to zero :
+	for (int i = 0; i < count; i++)
+	{
+		for (int unit = 0; unit < MAX_TEXTURE_UNIT_COUNT; unit++)
+		{
+			for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+			{
+				if (m_textures[unit][target] == textures[i])
+					m_textures[unit][target] = 0;
+			}
+		}
+	}
+
+	glDeleteTextures(count, textures);
+}
+
+void GLStateCache::deleteVertexArrays(GLsizei count, const GLuint* vertexArrays)
+{
+	//the binding of the deleted vertex array reverts to zero :
+	for (int i = 0; i < count; i++)
+	{
+		if (m_vertexArray == vertexArrays[i])
+			m_vertexArray = 0;
+	}
+
+	glDeleteVertexArrays(count, vertexArrays);
+}
+
+void GLStateCache::invalidate()
+{
+	m_program = UNKNOWN;
+	m_activeTexture = UNKNOWN;
+	for (int unit = 0; unit < MAX_TEXTURE_UNIT_COUNT; unit++)
+	{
+		for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+			m_textures[unit][target] = UNKNOWN;
+	}
+	m_vertexArray = UNKNOWN;
+	for (int i = 0; i < CAPABILITY_COUNT; i++)
+		m_capabilities[i] = -1;
+	m_blendSource = UNKNOWN;
+	m_blendDestination = UNKNOWN;
+	m_depthMask = -1;
+}
+
+const GLStateCacheStats& GLStateCache::getStats() const
+{
+	return m_stats;
+}
+
+void GLStateCache::resetStats()
+{
+	m_stats = GLStateCacheStats();
+}
+
+void GLStateCache::drawUI()
+{
+	ImGui::Text("gl calls : %d issued, %d skipped", m_stats.getIssuedCallCount(), m_stats.getSkippedCallCount());
+	ImGui::Text("programs : %d issued, %d skipped", m_stats.issuedProgramCalls, m_stats.skippedProgramCalls);
+	ImGui::Text("textures : %d issued, %d skipped", m_stats.issuedTextureCalls, m_stats.skippedTextureCalls);
+	ImGui::Text("vertex arrays : %d issued, %d skipped", m_stats.issuedVertexArrayCalls, m_stats.skippedVertexArrayCalls);
+	ImGui::Text("blend and depth states : %d issued, %d skipped", m_stats.issuedStateCalls, m_stats.skippedStateCalls);
+}
+
+int GLStateCache::getTextureTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:
+		return TEXTURE_2D;
+	case GL_TEXTURE_CUBE_MAP:
+		return TEXTURE_CUBE_MAP;
+	case GL_TEXTURE_2D_ARRAY:
+		return TEXTURE_2D_ARRAY;
+	case GL_TEXTURE_3D:
+		return TEXTURE_3D;
+	default:
+		return -1;
+	}
+}
+
+int GLStateCache::getCapabilityIndex(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_BLEND:
+		return BLEND;
+	case GL_DEPTH_TEST:
+		return DEPTH_TEST;
+	case GL_CULL_FACE:
+		return CULL_FACE;
+	case GL_SCISSOR_TEST:
+		return SCISSOR_TEST;
+	case GL_PROGRAM_POINT_SIZE:
+		return PROGRAM_POINT_SIZE;
+	case GL_RASTERIZER_DISCARD:
+		return RASTERIZER_DISCARD;
+	default:
+		return -1;
+	}
+}
+
+void GLStateCache::setCapability(GLenum capability, bool enabled)
+{
+	int capabilityIndex = getCapabilityIndex(capability);
+	int value = enabled ? 1 : 0;
+
+	if (capabilityIndex >= 0 && m_capabilities[capabilityIndex] == value)
+	{
+		m_stats.skippedStateCalls++;
+		return;
+	}
+
+	//untracked capabilities are always issued :
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+	if (capabilityIndex >= 0)
+		m_capabilities[capabilityIndex] = value;
+	m_stats.issuedStateCalls++;
+}
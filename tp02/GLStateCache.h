@@ -0,0 +1,91 @@
+#pragma once
+
+#include "glew/glew.h"
+
+//issued and skipped calls since the last resetStats :
+struct GLStateCacheStats
+{
+	int issuedProgramCalls;
+	int skippedProgramCalls;
+	int issuedTextureCalls; //glActiveTexture and glBindTexture
+	int skippedTextureCalls;
+	int issuedVertexArrayCalls;
+	int skippedVertexArrayCalls;
+	int issuedStateCalls; //glEnable, glDisable, glBlendFunc and glDepthMask
+	int skippedStateCalls;
+
+	GLStateCacheStats();
+	int getIssuedCallCount() const;
+	int getSkippedCallCount() const;
+};
+
+//Shadow copy of the bound program, textures, vertex array and of the blend / depth states.
+//The engine calls these functions instead of the gl ones, which are only issued if they change the GL state.
+//Code which changes the state without the cache (ImGui, external libraries) must be followed by a call to invalidate.
+class GLStateCache
+{
+public:
+	static const int MAX_TEXTURE_UNIT_COUNT = 32;
+
+private:
+	enum TextureTarget { TEXTURE_2D = 0, TEXTURE_CUBE_MAP, TEXTURE_2D_ARRAY, TEXTURE_3D, TEXTURE_TARGET_COUNT };
+	enum Capability { BLEND = 0, DEPTH_TEST, CULL_FACE, SCISSOR_TEST, PROGRAM_POINT_SIZE, RASTERIZER_DISCARD, CAPABILITY_COUNT };
+	//value of the unknown states, after invalidate :
+	static const GLuint UNKNOWN = 0xffffffff;
+
+	GLuint m_program;
+	GLenum m_activeTexture; //index of the active unit, UNKNOWN if unknown
+	GLuint m_textures[MAX_TEXTURE_UNIT_COUNT][TEXTURE_TARGET_COUNT];
+	GLuint m_vertexArray;
+	int m_capabilities[CAPABILITY_COUNT]; //1 enabled, 0 disabled, -1 unknown
+	GLenum m_blendSource;
+	GLenum m_blendDestination;
+	int m_depthMask; //-1 if unknown
+
+	GLStateCacheStats m_stats;
+
+public:
+	void useProgram(GLuint program);
+	void activeTexture(GLenum textureUnit);
+	void bindTexture(GLenum target, GLuint texture);
+	void bindVertexArray(GLuint vertexArray);
+	void enable(GLenum capability);
+	void disable(GLenum capability);
+	void blendFunc(GLenum source, GLenum destination);
+	void depthMask(GLboolean flag);
+
+	//deleted names can be reused by the next objects, so they are removed from the cache :
+	void deleteProgram(GLuint program);
+	void deleteTextures(GLsizei count, const GLuint* textures);
+	void deleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+
+	//forget the whole state, the next calls are issued.
+	void invalidate();
+
+	const GLStateCacheStats& getStats() const;
+	void resetStats();
+
+	//draw the counters.
+	void drawUI();
+
+private:
+	static int getTextureTargetIndex(GLenum target);
+	static int getCapabilityIndex(GLenum capability);
+	void setCapability(GLenum capability, bool enabled);
+
+// singleton implementation :
+private:
+	GLStateCache();
+
+public:
+	inline static GLStateCache& get()
+	{
+		static GLStateCache instance;
+
+		return instance;
+	}
+
+
+	GLStateCache(const GLStateCache& other) = delete;
+	void operator=(const GLStateCache& other) = delete;
+};
@@ -0,0 +1,97 @@
+#include "InstanceBuffer.h"
+
+#include <cassert>
+#include <cstddef>
+
+InstanceBuffer::InstanceBuffer() : m_vbo(0), m_bufferSize(0)
+{
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	freeGl();
+}
+
+void InstanceBuffer::initGl()
+{
+	if (m_vbo != 0)
+		return;
+
+	glGenBuffers(1, &m_vbo);
+	m_bufferSize = 0;
+}
+
+void InstanceBuffer::freeGl()
+{
+	if (m_vbo == 0)
+		return;
+
+	glDeleteBuffers(1, &m_vbo);
+	m_vbo = 0;
+	m_bufferSize = 0;
+}
+
+void InstanceBuffer::clear()
+{
+	m_data.clear();
+}
+
+int InstanceBuffer::add(const glm::mat4& modelMatrix, const glm::mat4& normalMatrix)
+{
+	InstanceData instance;
+	instance.modelMatrix = modelMatrix;
+	instance.normalMatrix = normalMatrix;
+	m_data.push_back(instance);
+
+	return m_data.size() - 1;
+}
+
+void InstanceBuffer::upload()
+{
+	if (m_vbo == 0 || m_data.empty())
+		return;
+
+	const int dataSize = m_data.size() * sizeof(InstanceData);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	//the storage is orphaned each frame, so we don't wait for the draws of the previous frame :
+	if (dataSize > m_bufferSize)
+		m_bufferSize = dataSize;
+	glBufferData(GL_ARRAY_BUFFER, m_bufferSize, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, dataSize, &m_data[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::bindAttributes(int firstInstance) const
+{
+	assert(firstInstance >= 0 && firstInstance < m_data.size());
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	const GLsizei stride = sizeof(InstanceData);
+	const size_t instanceOffset = firstInstance * sizeof(InstanceData);
+	for (int column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(MODEL_MATRIX_LOCATION + column);
+		glVertexAttribPointer(MODEL_MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)(instanceOffset + offsetof(InstanceData, modelMatrix) + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(MODEL_MATRIX_LOCATION + column, 1);
+
+		glEnableVertexAttribArray(NORMAL_MATRIX_LOCATION + column);
+		glVertexAttribPointer(NORMAL_MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)(instanceOffset + offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(NORMAL_MATRIX_LOCATION + column, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::unbindAttributes() const
+{
+	for (int column = 0; column < 4; column++)
+	{
+		glDisableVertexAttribArray(MODEL_MATRIX_LOCATION + column);
+		glDisableVertexAttribArray(NORMAL_MATRIX_LOCATION + column);
+	}
+}
+
+int InstanceBuffer::getInstanceCount() const
+{
+	return m_data.size();
+}
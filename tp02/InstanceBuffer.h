@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include "glew/glew.h"
+#include "glm/glm.hpp"
+
+//Per instance datas of the instanced draws of a frame : the model matrix and the normal matrix of each instance, packed in a single vertex buffer.
+//The instances are added once per frame and uploaded in one call. Before an instanced draw, the attributes are pointed to the first instance of the batch,
+//in the vao of the mesh (glDrawElementsInstancedBaseInstance isn't in OpenGL 4.1).
+class InstanceBuffer
+{
+public:
+	//attribute locations of the instanced shaders (see aogl.vert, shadowPass.vert and shadowPassOmni.vert), a mat4 uses four locations :
+	static const GLuint MODEL_MATRIX_LOCATION = 6;
+	static const GLuint NORMAL_MATRIX_LOCATION = 10;
+
+private:
+	struct InstanceData
+	{
+		glm::mat4 modelMatrix;
+		glm::mat4 normalMatrix;
+	};
+
+	GLuint m_vbo;
+	int m_bufferSize;
+	std::vector<InstanceData> m_data;
+
+public:
+	InstanceBuffer();
+	~InstanceBuffer();
+
+	void initGl();
+	void freeGl();
+
+	//remove the instances of the previous frame :
+	void clear();
+	//copy the matrices of an instance, return its index in the buffer.
+	int add(const glm::mat4& modelMatrix, const glm::mat4& normalMatrix);
+	//send all the instances of the frame to the GPU :
+	void upload();
+	//point the instanced attributes of the bound vao to the instances starting at firstInstance.
+	void bindAttributes(int firstInstance) const;
+	//disable the instanced attributes of the bound vao, for the next non instanced draws.
+	void unbindAttributes() const;
+
+	int getInstanceCount() const;
+};
@@ -1,4 +1,16 @@
 #include "LightManager.h"
+#include "GLStateCache.h"
+
+StaticShadowCache::StaticShadowCache() : frameBuffer(0), texture(0), isValid(false), lightTransform(1.f), castersHash(0)
+{
+}
+
+bool StaticShadowCache::matches(const glm::mat4& _lightTransform, unsigned long long _castersHash) const
+{
+	return isValid && castersHash == _castersHash && lightTransform == _lightTransform;
+}
+
+///////////////////////////////////////////////////
 
 ShadowMap::ShadowMap(int _textureWidth, int _textureHeight) : textureWidth(_textureWidth), textureHeight(_textureHeight)
 {
@@ -13,7 +25,7 @@ ShadowMap::ShadowMap(int _textureWidth, int _textureHeight) : textureWidth(_text
 
 	//initialyze shadow texture : 
 	glGenTextures(1, &shadowTexture);
-	glBindTexture(GL_TEXTURE_2D, shadowTexture);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, shadowTexture);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, textureWidth, textureHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -31,7 +43,7 @@ ShadowMap::ShadowMap(int _textureWidth, int _textureHeight) : textureWidth(_text
 		exit(EXIT_FAILURE);
 	}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, 0);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
@@ -42,12 +54,14 @@ ShadowMap::ShadowMap(ShadowMap&& other) noexcept
 	shadowFrameBuffer = other.shadowFrameBuffer;
 	shadowRenderBuffer = other.shadowRenderBuffer;
 	shadowTexture = other.shadowTexture;
+	staticCache = other.staticCache;
 
 	other.textureWidth = 0.f;
 	other.textureHeight = 0.f;
 	other.shadowFrameBuffer = 0;
 	other.shadowRenderBuffer = 0;
 	other.shadowTexture = 0;
+	other.staticCache = StaticShadowCache();
 }
 
 ShadowMap& ShadowMap::operator=(ShadowMap&& other) noexcept
@@ -61,12 +75,14 @@ ShadowMap& ShadowMap::operator=(ShadowMap&& other) noexcept
 		shadowFrameBuffer = other.shadowFrameBuffer;
 		shadowRenderBuffer = other.shadowRenderBuffer;
 		shadowTexture = other.shadowTexture;
+		staticCache = other.staticCache;
 
 		other.textureWidth = 0.f;
 		other.textureHeight = 0.f;
 		other.shadowFrameBuffer = 0;
 		other.shadowRenderBuffer = 0;
 		other.shadowTexture = 0;
+		other.staticCache = StaticShadowCache();
 	}
 
 	return *this;
@@ -74,9 +90,41 @@ ShadowMap& ShadowMap::operator=(ShadowMap&& other) noexcept
 
 ShadowMap::~ShadowMap()
 {
-	glDeleteTextures(1, &shadowTexture);
+	GLStateCache::get().deleteTextures(1, &shadowTexture);
 	glDeleteRenderbuffers(1, &shadowRenderBuffer);
 	glDeleteFramebuffers(1, &shadowFrameBuffer);
+	GLStateCache::get().deleteTextures(1, &staticCache.texture);
+	glDeleteFramebuffers(1, &staticCache.frameBuffer);
+}
+
+void ShadowMap::initStaticCache()
+{
+	if (staticCache.frameBuffer != 0)
+		return;
+
+	glGenFramebuffers(1, &staticCache.frameBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, staticCache.frameBuffer);
+
+	//same depth format as the shadow texture, to blit it :
+	glGenTextures(1, &staticCache.texture);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, staticCache.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, textureWidth, textureHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, staticCache.texture, 0);
+
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		fprintf(stderr, "Error on building static shadow framebuffer\n");
+		exit(EXIT_FAILURE);
+	}
+
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 ///////////////////////////////////////////////////
@@ -96,7 +144,7 @@ OmniShadowMap::OmniShadowMap(int _textureWidth, int _textureHeight) : textureWid
 
 	//initialyze shadow cube texture : 
 	glGenTextures(1, &shadowTexture);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, shadowTexture);
+	GLStateCache::get().bindTexture(GL_TEXTURE_CUBE_MAP, shadowTexture);
 	for (int i = 0; i < 6; i++)
 	{
 		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, textureWidth, textureHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
@@ -120,7 +168,7 @@ OmniShadowMap::OmniShadowMap(int _textureWidth, int _textureHeight) : textureWid
 		exit(EXIT_FAILURE);
 	}
 
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
@@ -132,12 +180,14 @@ OmniShadowMap::OmniShadowMap(OmniShadowMap&& other) noexcept
 	shadowFrameBuffer = other.shadowFrameBuffer;
 	shadowRenderBuffer = other.shadowRenderBuffer;
 	shadowTexture = other.shadowTexture;
+	staticCache = other.staticCache;
 
 	other.textureWidth = 0.f;
 	other.textureHeight = 0.f;
 	other.shadowFrameBuffer = 0;
 	other.shadowRenderBuffer = 0;
 	other.shadowTexture = 0;
+	other.staticCache = StaticShadowCache();
 }
 
 OmniShadowMap& OmniShadowMap::operator=(OmniShadowMap&& other) noexcept
@@ -151,12 +201,14 @@ OmniShadowMap& OmniShadowMap::operator=(OmniShadowMap&& other) noexcept
 		shadowFrameBuffer = other.shadowFrameBuffer;
 		shadowRenderBuffer = other.shadowRenderBuffer;
 		shadowTexture = other.shadowTexture;
+		staticCache = other.staticCache;
 
 		other.textureWidth = 0.f;
 		other.textureHeight = 0.f;
 		other.shadowFrameBuffer = 0;
 		other.shadowRenderBuffer = 0;
 		other.shadowTexture = 0;
+		other.staticCache = StaticShadowCache();
 	}
 
 	return *this;
@@ -164,20 +216,65 @@ OmniShadowMap& OmniShadowMap::operator=(OmniShadowMap&& other) noexcept
 
 OmniShadowMap::~OmniShadowMap()
 {
-	glDeleteTextures(1, &shadowTexture);
+	GLStateCache::get().deleteTextures(1, &shadowTexture);
 	glDeleteRenderbuffers(1, &shadowRenderBuffer);
 	glDeleteFramebuffers(1, &shadowFrameBuffer);
+	GLStateCache::get().deleteTextures(1, &staticCache.texture);
+	glDeleteFramebuffers(1, &staticCache.frameBuffer);
+}
+
+void OmniShadowMap::initStaticCache()
+{
+	if (staticCache.frameBuffer != 0)
+		return;
+
+	glGenFramebuffers(1, &staticCache.frameBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, staticCache.frameBuffer);
+
+	//same depth format as the shadow cube texture, to blit it :
+	glGenTextures(1, &staticCache.texture);
+	GLStateCache::get().bindTexture(GL_TEXTURE_CUBE_MAP, staticCache.texture);
+	for (int i = 0; i < 6; i++)
+	{
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, textureWidth, textureHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	//layered, the static casters are rendered with the omnidirectional shadow pass :
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticCache.texture, 0);
+
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		fprintf(stderr, "Error on building static shadow framebuffer\n");
+		exit(EXIT_FAILURE);
+	}
+
+	GLStateCache::get().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 
 
 ///////////////////////////////////////////////////////
 
-LightManager::LightManager() : directionalShadowMapViewportSize(128), directionalShadowMapViewportNear(0.1f), directionalShadowMapViewportFar(100.f)
+LightManager::LightManager() : directionalShadowMapViewportSize(128), directionalShadowMapViewportNear(0.1f), directionalShadowMapViewportFar(100.f), copyReadFrameBuffer(0), copyDrawFrameBuffer(0)
 {
 
 }
 
+LightManager::~LightManager()
+{
+	//the framebuffers of the static cache copies are only created if an omni shadow map has been cached :
+	if (copyReadFrameBuffer != 0)
+		glDeleteFramebuffers(1, &copyReadFrameBuffer);
+	if (copyDrawFrameBuffer != 0)
+		glDeleteFramebuffers(1, &copyDrawFrameBuffer);
+}
+
 void LightManager::init(GLuint glProgram_pointLight, GLuint glProgram_directionalLight, GLuint glProgram_spotLight)
 {
 	uniform_pointLight_pos = glGetUniformLocation(glProgram_pointLight, "pointLight.position");
@@ -265,17 +362,17 @@ void LightManager::bindShadowMapTexture(LightType lightType, int index)
 	if (lightType == LightType::SPOT)
 	{
 		assert(index >= 0 && index < spot_shadowMaps.size());
-		glBindTexture(GL_TEXTURE_2D, spot_shadowMaps[index].shadowTexture);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, spot_shadowMaps[index].shadowTexture);
 	}
 	else if (lightType == LightType::DIRECTIONAL)
 	{
 		assert(index >= 0 && index < directional_shadowMaps.size());
-		glBindTexture(GL_TEXTURE_2D, directional_shadowMaps[index].shadowTexture);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, directional_shadowMaps[index].shadowTexture);
 	}
 	else
 	{
 		assert(index >= 0 && index < point_shadowMaps.size());
-		glBindTexture(GL_TEXTURE_CUBE_MAP, point_shadowMaps[index].shadowTexture);
+		GLStateCache::get().bindTexture(GL_TEXTURE_CUBE_MAP, point_shadowMaps[index].shadowTexture);
 	}
 }
 
@@ -316,3 +413,90 @@ float LightManager::getDirectionalShadowMapViewportFar() const
 {
 	return directionalShadowMapViewportFar;
 }
+
+bool LightManager::isStaticShadowCacheValid(LightType lightType, int index, const glm::mat4& lightTransform, unsigned long long staticCastersHash)
+{
+	if (lightType == LightType::SPOT)
+	{
+		assert(index >= 0 && index < spot_shadowMaps.size());
+		return spot_shadowMaps[index].staticCache.matches(lightTransform, staticCastersHash);
+	}
+	else if (lightType == LightType::DIRECTIONAL)
+	{
+		assert(index >= 0 && index < directional_shadowMaps.size());
+		return directional_shadowMaps[index].staticCache.matches(lightTransform, staticCastersHash);
+	}
+	else
+	{
+		assert(index >= 0 && index < point_shadowMaps.size());
+		return point_shadowMaps[index].staticCache.matches(lightTransform, staticCastersHash);
+	}
+}
+
+void LightManager::bindStaticShadowMapFBO(LightType lightType, int index, const glm::mat4& lightTransform, unsigned long long staticCastersHash)
+{
+	StaticShadowCache* staticCache = nullptr;
+
+	if (lightType == LightType::SPOT || lightType == LightType::DIRECTIONAL)
+	{
+		std::vector<ShadowMap>& shadowMaps = (lightType == LightType::SPOT) ? spot_shadowMaps : directional_shadowMaps;
+		assert(index >= 0 && index < shadowMaps.size());
+		shadowMaps[index].initStaticCache();
+		glViewport(0, 0, shadowMaps[index].textureWidth, shadowMaps[index].textureHeight);
+		staticCache = &shadowMaps[index].staticCache;
+	}
+	else
+	{
+		assert(index >= 0 && index < point_shadowMaps.size());
+		point_shadowMaps[index].initStaticCache();
+		glViewport(0, 0, point_shadowMaps[index].textureWidth, point_shadowMaps[index].textureHeight);
+		staticCache = &point_shadowMaps[index].staticCache;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, staticCache->frameBuffer);
+	staticCache->isValid = true;
+	staticCache->lightTransform = lightTransform;
+	staticCache->castersHash = staticCastersHash;
+}
+
+void LightManager::copyStaticShadowMap(LightType lightType, int index)
+{
+	//the blit is clipped by the scissor test :
+	GLStateCache::get().disable(GL_SCISSOR_TEST);
+
+	if (lightType == LightType::SPOT || lightType == LightType::DIRECTIONAL)
+	{
+		std::vector<ShadowMap>& shadowMaps = (lightType == LightType::SPOT) ? spot_shadowMaps : directional_shadowMaps;
+		assert(index >= 0 && index < shadowMaps.size() && shadowMaps[index].staticCache.isValid);
+		const ShadowMap& shadowMap = shadowMaps[index];
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, shadowMap.staticCache.frameBuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadowMap.shadowFrameBuffer);
+		glBlitFramebuffer(0, 0, shadowMap.textureWidth, shadowMap.textureHeight, 0, 0, shadowMap.textureWidth, shadowMap.textureHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+	else
+	{
+		assert(index >= 0 && index < point_shadowMaps.size() && point_shadowMaps[index].staticCache.isValid);
+		const OmniShadowMap& shadowMap = point_shadowMaps[index];
+
+		if (copyReadFrameBuffer == 0)
+		{
+			glGenFramebuffers(1, &copyReadFrameBuffer);
+			glGenFramebuffers(1, &copyDrawFrameBuffer);
+		}
+
+		//a blit only copies the first layer of layered attachments, the faces are attached one by one :
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, copyReadFrameBuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, copyDrawFrameBuffer);
+		glReadBuffer(GL_NONE);
+		glDrawBuffer(GL_NONE);
+		for (int i = 0; i < 6; i++)
+		{
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, shadowMap.staticCache.texture, 0);
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, shadowMap.shadowTexture, 0);
+			glBlitFramebuffer(0, 0, shadowMap.textureWidth, shadowMap.textureHeight, 0, 0, shadowMap.textureWidth, shadowMap.textureHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -11,6 +11,22 @@
 
 #include "Lights.h"
 
+//depth of the static casters of a shadow map, rendered once and copied in the shadow map each frame while the light and the static casters don't change.
+//The GL objects are allocated on first use.
+struct StaticShadowCache
+{
+	GLuint frameBuffer;
+	GLuint texture;
+
+	//the light transform and the static casters hash the depth was rendered with :
+	bool isValid;
+	glm::mat4 lightTransform;
+	unsigned long long castersHash;
+
+	StaticShadowCache();
+	bool matches(const glm::mat4& _lightTransform, unsigned long long _castersHash) const;
+};
+
 struct ShadowMap
 {
 	int textureWidth;
@@ -20,6 +36,8 @@ struct ShadowMap
 	GLuint shadowRenderBuffer;
 	GLuint shadowTexture;
 
+	StaticShadowCache staticCache;
+
 	ShadowMap(int _textureWidth = 1024, int _textureHeight = 1024);
 	ShadowMap(ShadowMap&& other) noexcept;
 	ShadowMap& operator=(ShadowMap&& other) noexcept;
@@ -27,6 +45,8 @@ struct ShadowMap
 
 	ShadowMap(const ShadowMap& other) = delete;
 	ShadowMap& operator=(const ShadowMap& other) = delete;
+
+	void initStaticCache();
 };
 
 struct OmniShadowMap // omnidirectional shadow map for point lights
@@ -38,6 +58,8 @@ struct OmniShadowMap // omnidirectional shadow map for point lights
 	GLuint shadowRenderBuffer;
 	GLuint shadowTexture;
 
+	StaticShadowCache staticCache;
+
 	OmniShadowMap(int _textureWidth = 1024, int _textureHeight = 1024);
 	OmniShadowMap(OmniShadowMap&& other) noexcept;
 	OmniShadowMap& operator=(OmniShadowMap&& other) noexcept;
@@ -45,6 +67,8 @@ struct OmniShadowMap // omnidirectional shadow map for point lights
 
 	OmniShadowMap(const OmniShadowMap& other) = delete;
 	OmniShadowMap& operator=(const OmniShadowMap& other) = delete;
+
+	void initStaticCache();
 };
 
 class LightManager
@@ -77,9 +101,14 @@ private:
 	float directionalShadowMapViewportNear;
 	float directionalShadowMapViewportFar;
 
+	//to copy the faces of the omnidirectional static caches :
+	GLuint copyReadFrameBuffer;
+	GLuint copyDrawFrameBuffer;
+
 
 public:
 	LightManager();
+	~LightManager();
 	
 	void init(GLuint glProgram_pointLight, GLuint glProgram_directionalLight, GLuint glProgram_spotLight);
 
@@ -90,6 +119,14 @@ public:
 	void unbindShadowMapFBO(LightType lightType);
 	void bindShadowMapTexture(LightType lightType, int index);
 
+	//static shadow caches :
+	//true if the static depth of the shadow map was rendered with this light transform and these static casters.
+	bool isStaticShadowCacheValid(LightType lightType, int index, const glm::mat4& lightTransform, unsigned long long staticCastersHash);
+	//bind the static depth FBO and resize viewport. The cache is then considered valid for this light transform and these static casters.
+	void bindStaticShadowMapFBO(LightType lightType, int index, const glm::mat4& lightTransform, unsigned long long staticCastersHash);
+	//replace the depth of the shadow map by its static depth.
+	void copyStaticShadowMap(LightType lightType, int index);
+
 
 	void uniformPointLight(PointLight& light);
 	void uniformDirectionalLight(DirectionalLight& light);
@@ -0,0 +1,214 @@
+#include "LightTileGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+LightTileGrid::LightTileGrid(int tileSize) : m_tileSize(std::max(1, tileSize)), m_screenWidth(0), m_screenHeight(0), m_tileCountX(0), m_tileCountY(0), m_maxTileLightCount(0)
+{
+}
+
+void LightTileGrid::resize(int screenWidth, int screenHeight)
+{
+	m_screenWidth = std::max(0, screenWidth);
+	m_screenHeight = std::max(0, screenHeight);
+	m_tileCountX = (m_screenWidth + m_tileSize - 1) / m_tileSize;
+	m_tileCountY = (m_screenHeight + m_tileSize - 1) / m_tileSize;
+
+	m_tileLights.assign(m_tileCountX * m_tileCountY, glm::ivec2(0, 0));
+	m_lightIndices.clear();
+	m_maxTileLightCount = 0;
+}
+
+void LightTileGrid::build(const std::vector<glm::vec4>& viewports)
+{
+	std::fill(m_tileLights.begin(), m_tileLights.end(), glm::ivec2(0, 0));
+	m_lightIndices.clear();
+	m_maxTileLightCount = 0;
+
+	//count the lights of each tile :
+	m_lightTileRects.resize(viewports.size());
+	for (int lightIdx = 0; lightIdx < viewports.size(); lightIdx++)
+	{
+		glm::ivec4& tileRect = m_lightTileRects[lightIdx];
+		if (!getTileRect(viewports[lightIdx], tileRect))
+		{
+			tileRect = glm::ivec4(0, 0, -1, -1);
+			continue;
+		}
+
+		for (int y = tileRect.y; y <= tileRect.w; y++)
+		{
+			for (int x = tileRect.x; x <= tileRect.z; x++)
+				m_tileLights[y * m_tileCountX + x].y++;
+		}
+	}
+
+	//each tile gets a contiguous range in the light indices :
+	int offset = 0;
+	for (int tileIdx = 0; tileIdx < m_tileLights.size(); tileIdx++)
+	{
+		m_tileLights[tileIdx].x = offset;
+		offset += m_tileLights[tileIdx].y;
+		m_maxTileLightCount = std::max(m_maxTileLightCount, m_tileLights[tileIdx].y);
+		//the count is rebuilt while filling the ranges :
+		m_tileLights[tileIdx].y = 0;
+	}
+	m_lightIndices.resize(offset);
+
+	for (int lightIdx = 0; lightIdx < viewports.size(); lightIdx++)
+	{
+		const glm::ivec4& tileRect = m_lightTileRects[lightIdx];
+		for (int y = tileRect.y; y <= tileRect.w; y++)
+		{
+			for (int x = tileRect.x; x <= tileRect.z; x++)
+			{
+				glm::ivec2& tileLights = m_tileLights[y * m_tileCountX + x];
+				m_lightIndices[tileLights.x + tileLights.y] = lightIdx;
+				tileLights.y++;
+			}
+		}
+	}
+}
+
+int LightTileGrid::getTileSize() const
+{
+	return m_tileSize;
+}
+
+int LightTileGrid::getTileCountX() const
+{
+	return m_tileCountX;
+}
+
+int LightTileGrid::getTileCountY() const
+{
+	return m_tileCountY;
+}
+
+int LightTileGrid::getTileCount() const
+{
+	return m_tileCountX * m_tileCountY;
+}
+
+glm::ivec2 LightTileGrid::getTileLights(int tileX, int tileY) const
+{
+	if (tileX < 0 || tileX >= m_tileCountX || tileY < 0 || tileY >= m_tileCountY)
+		return glm::ivec2(0, 0);
+
+	return m_tileLights[tileY * m_tileCountX + tileX];
+}
+
+const std::vector<glm::ivec2>& LightTileGrid::getAllTileLights() const
+{
+	return m_tileLights;
+}
+
+const std::vector<int>& LightTileGrid::getLightIndices() const
+{
+	return m_lightIndices;
+}
+
+int LightTileGrid::getMaxTileLightCount() const
+{
+	return m_maxTileLightCount;
+}
+
+bool LightTileGrid::getTileRect(const glm::vec4& viewport, glm::ivec4& tileRect) const
+{
+	if (m_tileCountX == 0 || m_tileCountY == 0 || viewport.z <= 0.f || viewport.w <= 0.f)
+		return false;
+
+	//normalized device coordinates to pixels :
+	float minX = (viewport.x + 1.f) * 0.5f * m_screenWidth;
+	float minY = (viewport.y + 1.f) * 0.5f * m_screenHeight;
+	float maxX = (viewport.x + viewport.z + 1.f) * 0.5f * m_screenWidth;
+	float maxY = (viewport.y + viewport.w + 1.f) * 0.5f * m_screenHeight;
+
+	if (maxX <= 0.f || maxY <= 0.f || minX >= m_screenWidth || minY >= m_screenHeight)
+		return false;
+
+	//the tiles partially covered by the rectangle are kept :
+	tileRect.x = glm::clamp((int)std::floor(minX / m_tileSize), 0, m_tileCountX - 1);
+	tileRect.y = glm::clamp((int)std::floor(minY / m_tileSize), 0, m_tileCountY - 1);
+	tileRect.z = glm::clamp((int)std::ceil(maxX / m_tileSize) - 1, 0, m_tileCountX - 1);
+	tileRect.w = glm::clamp((int)std::ceil(maxY / m_tileSize) - 1, 0, m_tileCountY - 1);
+
+	return tileRect.x <= tileRect.z && tileRect.y <= tileRect.w;
+}
+
+bool LightTileGrid::checkTileLists()
+{
+	//4 x 4 tiles of 16 pixels, the pixel rectangles below are exact in normalized device coordinates :
+	const int screenSize = 64;
+	LightTileGrid grid(16);
+	grid.resize(screenSize, screenSize);
+
+	//light rectangles in pixels (min x, min y, max x, max y), and the tiles they should overlap (inclusive, min > max for none) :
+	const glm::vec4 pixelRects[] = {
+		glm::vec4(20, 20, 28, 28), //inside tile (1, 1)
+		glm::vec4(8, 8, 24, 40), //straddling tiles
+		glm::vec4(16, 0, 32, 16), //exactly on the borders of tile (1, 0)
+		glm::vec4(-20, -5, 10, 40), //partly off screen, on the left and the bottom
+		glm::vec4(50, 40, 100, 80), //partly off screen, on the right and the top
+		glm::vec4(70, 10, 90, 30), //off screen
+		glm::vec4(-10, -10, 200, 200), //covering the whole screen
+	};
+	const glm::ivec4 expectedTileRects[] = {
+		glm::ivec4(1, 1, 1, 1),
+		glm::ivec4(0, 0, 1, 2),
+		glm::ivec4(1, 0, 1, 0),
+		glm::ivec4(0, 0, 0, 2),
+		glm::ivec4(3, 2, 3, 3),
+		glm::ivec4(0, 0, -1, -1),
+		glm::ivec4(0, 0, 3, 3),
+	};
+	const int lightCount = sizeof(pixelRects) / sizeof(pixelRects[0]);
+
+	std::vector<glm::vec4> viewports;
+	for (int i = 0; i < lightCount; i++)
+	{
+		const glm::vec4& rect = pixelRects[i];
+		viewports.push_back(glm::vec4(rect.x, rect.y, rect.z - rect.x, rect.w - rect.y) * (2.f / screenSize) - glm::vec4(1.f, 1.f, 0.f, 0.f));
+	}
+	grid.build(viewports);
+
+	int expectedOffset = 0;
+	int expectedMaxCount = 0;
+	for (int y = 0; y < grid.getTileCountY(); y++)
+	{
+		for (int x = 0; x < grid.getTileCountX(); x++)
+		{
+			//the lights of a tile are listed in the order of the viewports :
+			std::vector<int> expectedLights;
+			for (int i = 0; i < lightCount; i++)
+			{
+				const glm::ivec4& tileRect = expectedTileRects[i];
+				if (x >= tileRect.x && x <= tileRect.z && y >= tileRect.y && y <= tileRect.w)
+					expectedLights.push_back(i);
+			}
+
+			const glm::ivec2 tileLights = grid.getTileLights(x, y);
+			bool isValid = (tileLights.x == expectedOffset && tileLights.y == expectedLights.size());
+			for (int i = 0; isValid && i < expectedLights.size(); i++)
+				isValid = (grid.getLightIndices()[tileLights.x + i] == expectedLights[i]);
+
+			if (!isValid)
+			{
+				std::cout << "error, light tile grid : wrong light list for the tile (" << x << ", " << y << ")." << std::endl;
+				return false;
+			}
+
+			expectedOffset += expectedLights.size();
+			expectedMaxCount = std::max(expectedMaxCount, (int)expectedLights.size());
+		}
+	}
+
+	if (grid.getLightIndices().size() != expectedOffset || grid.getMaxTileLightCount() != expectedMaxCount)
+	{
+		std::cout << "error, light tile grid : wrong light index count." << std::endl;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+//Assignment of lights to square screen tiles, for the tiled deferred lighting.
+//Each light is added to all the tiles overlapped by its screen rectangle, the light indices of a tile are contiguous in a single list.
+//Tiles are numbered from the bottom left corner of the screen, row by row (like gl_FragCoord).
+//It doesn't use OpenGL, the renderer uploads the lists.
+class LightTileGrid
+{
+private:
+	int m_tileSize;
+	int m_screenWidth;
+	int m_screenHeight;
+	int m_tileCountX;
+	int m_tileCountY;
+
+	//for each tile, offset of its first light index and light count :
+	std::vector<glm::ivec2> m_tileLights;
+	std::vector<int> m_lightIndices;
+	//tiles overlapped by each light, (min x, min y, max x, max y) inclusive, min > max if the light is out of the screen :
+	std::vector<glm::ivec4> m_lightTileRects;
+	int m_maxTileLightCount;
+
+public:
+	LightTileGrid(int tileSize = 16);
+
+	//set the screen size in pixels, the tile lists are empty until the next build.
+	void resize(int screenWidth, int screenHeight);
+	//fill the tile lists. viewports are the screen rectangles of the lights in normalized device coordinates (x, y, width, height), like the light culling viewports.
+	//The index of a light is its index in viewports.
+	void build(const std::vector<glm::vec4>& viewports);
+
+	int getTileSize() const;
+	int getTileCountX() const;
+	int getTileCountY() const;
+	int getTileCount() const;
+	//offset and count of the lights of a tile in the light indices :
+	glm::ivec2 getTileLights(int tileX, int tileY) const;
+	const std::vector<glm::ivec2>& getAllTileLights() const;
+	const std::vector<int>& getLightIndices() const;
+	int getMaxTileLightCount() const;
+
+	//tiles overlapped by a screen rectangle in normalized device coordinates, (min x, min y, max x, max y) inclusive. Return false if there is none.
+	bool getTileRect(const glm::vec4& viewport, glm::ivec4& tileRect) const;
+
+	//standalone check of the tile offsets and counts, for known light rectangles (inside a tile, straddling tiles, on tile borders, partly or fully off screen).
+	//Return false if a tile list doesn't match.
+	static bool checkTileLists();
+};
@@ -81,9 +81,15 @@ void PointLight::updateBoundingBox()
 void PointLight::drawUI(Scene& scene)
 {
 	if (ImGui::SliderFloat("light intensity", &intensity, 0.f, 50.f))
+	{
 		updateBoundingBox();
+		scene.updateSpatialProxy(this);
+	}
 	if (ImGui::ColorEdit3("light color", &color[0]))
+	{
 		updateBoundingBox();
+		scene.updateSpatialProxy(this);
+	}
 }
 
 void PointLight::applyTransform(const glm::vec3 & translation, const glm::vec3 & scale, const glm::quat & rotation)
@@ -246,9 +252,15 @@ void SpotLight::updateBoundingBox()
 void SpotLight::drawUI(Scene& scene)
 {
 	if (ImGui::SliderFloat("light intensity", &intensity, 0.f, 50.f))
+	{
 		updateBoundingBox();
+		scene.updateSpatialProxy(this);
+	}
 	if (ImGui::ColorEdit3("light color", &color[0]))
+	{
 		updateBoundingBox();
+		scene.updateSpatialProxy(this);
+	}
 
 	ImGui::SliderFloat("light angles", &angle, 0.f, glm::pi<float>());
 }
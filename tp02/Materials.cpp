@@ -1,5 +1,7 @@
 #include "Materials.h"
 #include "Factories.h"//forward
+#include "BonePaletteBuffer.h"
+#include "GLStateCache.h"
 
 Material::Material(GLuint _glProgram) : glProgram(_glProgram)
 {
@@ -18,9 +20,9 @@ Material3DObject::Material3DObject(GLuint _glProgram) : Material(_glProgram)
 {
 	uniform_MVP = glGetUniformLocation(glProgram, "MVP");
 	uniform_normalMatrix = glGetUniformLocation(glProgram, "NormalMatrix");
-	for (int i = 0; i < MAX_BONE_COUNT; i++)
-		uniform_bonesTransform[i] = glGetUniformLocation(glProgram, ("BonesTransform["+std::to_string(i)+"]").c_str() );
 	uniform_useSkeleton = glGetUniformLocation(glProgram, "UseSkeleton");
+	uniform_useInstancing = glGetUniformLocation(glProgram, "UseInstancing");
+	BonePaletteBuffer::bindProgram(glProgram);
 }
 
 
@@ -34,15 +36,19 @@ void Material3DObject::setUniform_normalMatrix(glm::mat4& normalMatrix)
 	glUniformMatrix4fv(uniform_normalMatrix, 1, false, glm::value_ptr(normalMatrix));
 }
 
-void Material3DObject::setUniformBonesTransform(unsigned int idx, const glm::mat4& boneTransform)
+void Material3DObject::setUniformUseSkeleton(bool useSkeleton)
 {
-	assert(idx < MAX_BONE_COUNT);
-	glUniformMatrix4fv(uniform_bonesTransform[idx], 1, false, glm::value_ptr(boneTransform));
+	glUniform1i(uniform_useSkeleton, useSkeleton);
 }
 
-void Material3DObject::setUniformUseSkeleton(bool useSkeleton)
+void Material3DObject::setUniformUseInstancing(bool useInstancing)
 {
-	glUniform1i(uniform_useSkeleton, useSkeleton);
+	glUniform1i(uniform_useInstancing, useInstancing);
+}
+
+bool Material3DObject::supportsInstancing() const
+{
+	return (GLint)uniform_useInstancing >= 0;
 }
 
 ///////////////////////////////////////////
@@ -127,15 +133,15 @@ float MaterialLit::getSpecularPower() const
 void MaterialLit::use()
 {
 	//bind shaders
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 
 	//bind textures into texture units
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textureDiffuse->glId);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, textureSpecular->glId);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, textureBump->glId);
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, textureDiffuse->glId);
+	GLStateCache::get().activeTexture(GL_TEXTURE1);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, textureSpecular->glId);
+	GLStateCache::get().activeTexture(GL_TEXTURE2);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, textureBump->glId);
 
 	//send uniforms
 	glUniform1f(uniform_specularPower, specularPower);
@@ -261,7 +267,7 @@ void MaterialUnlit::setUniform_color(glm::vec3 color)
 void MaterialUnlit::use()
 {
 	//bind shaders
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 }
 
 void MaterialUnlit::drawUI()
@@ -296,7 +302,7 @@ void MaterialInstancedUnlit::setUniform_VP(const glm::mat4& VP)
 void MaterialInstancedUnlit::use()
 {
 	//bind shaders
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 }
 
 void MaterialInstancedUnlit::drawUI()
@@ -324,7 +330,7 @@ void MaterialDebugDrawer::setUniform_MVP(const glm::mat4 & MVP)
 void MaterialDebugDrawer::use()
 {
 	//bind shaders
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 }
 
 void MaterialDebugDrawer::drawUI()
@@ -369,11 +375,11 @@ void MaterialSkybox::setUniform_VP(const glm::mat4 & vp)
 void MaterialSkybox::use()
 {
 	//bind shaders
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 
 	//bind textures into texture units
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureDiffuse->glId);
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_CUBE_MAP, textureDiffuse->glId);
 
 	//send uniforms
 	glUniform1i(uniform_textureDiffuse, 0);
@@ -429,7 +435,7 @@ MaterialShadow::MaterialShadow(GLuint _glProgram) : Material(_glProgram)
 void MaterialShadow::use()
 {
 	//bind shaders
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 }
 
 void MaterialShadow::drawUI()
@@ -490,16 +496,16 @@ MaterialTerrain::MaterialTerrain(GLuint _glProgram) :
 void MaterialTerrain::use()
 {
 	//bind shaders
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 
 	/*
 	//bind textures into texture units
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textureDiffuse->glId);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, textureSpecular->glId);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, textureBump->glId);
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, textureDiffuse->glId);
+	GLStateCache::get().activeTexture(GL_TEXTURE1);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, textureSpecular->glId);
+	GLStateCache::get().activeTexture(GL_TEXTURE2);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, textureBump->glId);
 
 	//send uniforms
 	glUniform1f(uniform_specularPower, specularPower);
@@ -641,7 +647,7 @@ void MaterialTerrainEdition::setUniformTextureRepetition(const glm::vec2& textur
 void MaterialTerrainEdition::use()
 {
 	//bind shaders
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 }
 
 void MaterialTerrainEdition::drawUI()
@@ -742,7 +748,7 @@ void MaterialDrawOnTexture::setUniformTextureToDrawOn(int textureId)
 
 void MaterialDrawOnTexture::use()
 {
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 }
 
 void MaterialDrawOnTexture::drawUI()
@@ -791,7 +797,7 @@ void MaterialGrassField::setUniformVP(const glm::mat4 & VP)
 
 void MaterialGrassField::use()
 {
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 }
 
 void MaterialGrassField::drawUI()
@@ -824,7 +830,7 @@ MaterialBillboard::MaterialBillboard(GLuint _glProgram) : Material(_glProgram)
 
 void MaterialBillboard::use()
 {
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 }
 
 void MaterialBillboard::drawUI()
@@ -894,7 +900,7 @@ MaterialParticlesCPU::MaterialParticlesCPU(GLuint _glProgram) : Material(_glProg
 
 void MaterialParticlesCPU::use()
 {
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 }
 
 void MaterialParticlesCPU::drawUI()
@@ -948,7 +954,7 @@ MaterialParticles::MaterialParticles(GLuint _glProgram) : Material(_glProgram)
 
 void MaterialParticles::use()
 {
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 }
 
 void MaterialParticles::drawUI()
@@ -1000,7 +1006,7 @@ void MaterialParticleSimulation::glUniform_deltaTime(float deltaTime)
 
 void MaterialParticleSimulation::use()
 {
-	glUseProgram(glProgram);
+	GLStateCache::get().useProgram(glProgram);
 }
 
 void MaterialParticleSimulation::drawUI()
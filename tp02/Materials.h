@@ -36,14 +36,18 @@ struct Material3DObject : public Material
 {
 	GLuint uniform_MVP;
 	GLuint uniform_normalMatrix;
-	GLuint uniform_bonesTransform[MAX_BONE_COUNT];
 	GLuint uniform_useSkeleton;
+	GLuint uniform_useInstancing;
 
 	Material3DObject(GLuint _glProgram = 0);
 	void setUniform_MVP(glm::mat4& mvp);
 	void setUniform_normalMatrix(glm::mat4& normalMatrix);
-	void setUniformBonesTransform(unsigned int idx, const glm::mat4& boneTransform);
+	//the bone transforms are in the "BonePalette" uniform block, bound by the renderer (see BonePaletteBuffer).
 	void setUniformUseSkeleton(bool useSkeleton);
+	//the model and normal matrices are per instance attributes, bound by the renderer (see InstanceBuffer).
+	void setUniformUseInstancing(bool useInstancing);
+	//true if the program can draw instances (it has the UseInstancing uniform).
+	bool supportsInstancing() const;
 };
 
 
@@ -4,9 +4,14 @@
 #include "Ray.h"
 #include "Utils.h"
 #include "Factories.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "GLStateCache.h"
 
-Mesh::Mesh(GLenum _primitiveType , unsigned int _vbo_usage, int _coordCountByVertex, GLenum _drawUsage) : primitiveType(_primitiveType), coordCountByVertex(_coordCountByVertex), vbo_usage(_vbo_usage), vbo_index(0), vbo_vertices(0), vbo_uvs(0), vbo_normals(0), vbo_tangents(0), drawUsage(_drawUsage), 
-skeleton(nullptr), isSkeletalMesh(false), importer(nullptr)
+#include "glm/gtc/packing.hpp"
+
+Mesh::Mesh(GLenum _primitiveType , unsigned int _vbo_usage, int _coordCountByVertex, GLenum _drawUsage) : primitiveType(_primitiveType), coordCountByVertex(_coordCountByVertex), vbo_usage(_vbo_usage), vbo_index(0), vbo_vertices(0), vbo_uvs(0), vbo_normals(0), vbo_tangents(0), vbo_bones(0), vbo_interleaved(0), vao(0), drawUsage(_drawUsage), vertexLayout(SEPARATED_FLOAT),
+skeleton(nullptr), isBVHBuilt(false), optimizeOnImport(true), importLodCount(4), lodCount(1), isSkeletalMesh(false), importer(nullptr)
 {
 	subMeshCount = 1;
 	totalTriangleCount = 0;
@@ -14,8 +19,8 @@ skeleton(nullptr), isSkeletalMesh(false), importer(nullptr)
 	indexOffsets.push_back(0);
 }
 
-Mesh::Mesh(const std::string& _path, const std::string& meshName) : primitiveType(GL_TRIANGLES), coordCountByVertex(3), vbo_usage(USE_INDEX | USE_VERTICES | USE_UVS | USE_NORMALS | USE_TANGENTS), vbo_index(0), vbo_vertices(0), vbo_uvs(0), vbo_normals(0), vbo_tangents(0), drawUsage(GL_STATIC_DRAW),
-skeleton(nullptr), isSkeletalMesh(false), name(meshName), importer(nullptr)
+Mesh::Mesh(const std::string& _path, const std::string& meshName, bool importNow) : primitiveType(GL_TRIANGLES), coordCountByVertex(3), vbo_usage(USE_INDEX | USE_VERTICES | USE_UVS | USE_NORMALS | USE_TANGENTS), vbo_index(0), vbo_vertices(0), vbo_uvs(0), vbo_normals(0), vbo_tangents(0), vbo_bones(0), vbo_interleaved(0), vao(0), drawUsage(GL_STATIC_DRAW), vertexLayout(SEPARATED_FLOAT),
+skeleton(nullptr), isBVHBuilt(false), optimizeOnImport(true), importLodCount(4), lodCount(1), isSkeletalMesh(false), name(meshName), importer(nullptr)
 {
 	path = _path;
 
@@ -24,17 +29,8 @@ skeleton(nullptr), isSkeletalMesh(false), name(meshName), importer(nullptr)
 	triangleCount.push_back(0);
 	indexOffsets.push_back(0);
 
-	bool Ret = false;
-	//Assimp::Importer Importer;
-	importer = new Assimp::Importer();
-	const aiScene* pScene = importer->ReadFile(path.c_str(), aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-
-	if (pScene) {
-		Ret = initFromScene(pScene, path);
-	}
-	else {
-		std::cout << "Error parsing " << path << " : " << importer->GetErrorString() << std::endl;
-	}
+	if (importNow && importFromFile())
+		finishImport();
 }
 
 Mesh::~Mesh()
@@ -46,6 +42,12 @@ void Mesh::clear()
 {
 	delete skeleton;
 	SkeletalAnimationFactory::get().clear(name);
+	for (auto& animation : importedAnimations)
+		delete animation;
+	importedAnimations.clear();
+
+	bvh.clear();
+	isBVHBuilt = false;
 
 	freeGl();
 
@@ -53,15 +55,112 @@ void Mesh::clear()
 		delete importer;
 }
 
+bool Mesh::importFromFile()
+{
+	//try the binary cache first, we only need assimp if the source has changed since the last import :
+	if (MeshCache::load(path, *this)) {
+		computeBoundingBox();
+		chooseVertexLayout();
+		return true;
+	}
+
+	bool Ret = false;
+	//Assimp::Importer Importer;
+	importer = new Assimp::Importer();
+	unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+	//vertices have to be shared between triangles for the cache to be reused, 
+	//and for the simplification (otherwise every edge is a border and every vertex is locked) :
+	if (optimizeOnImport || importLodCount > 1)
+		importFlags |= aiProcess_JoinIdenticalVertices;
+	const aiScene* pScene = importer->ReadFile(path.c_str(), importFlags);
+
+	if (pScene) {
+		Ret = initFromScene(pScene, path);
+		if (Ret) {
+			MeshCache::write(path, *this, pScene);
+			chooseVertexLayout();
+		}
+	}
+	else {
+		std::cout << "Error parsing " << path << " : " << importer->GetErrorString() << std::endl;
+	}
+
+	return Ret;
+}
+
+void Mesh::finishImport()
+{
+	initGl(); //don't forget to init mesh for opengl
+
+	for (auto& animation : importedAnimations)
+		SkeletalAnimationFactory::get().add(name, animation->getName(), animation);
+	importedAnimations.clear();
+}
+
+void Mesh::swapDatas(Mesh& other)
+{
+	std::swap(importer, other.importer);
+	std::swap(topRight, other.topRight);
+	std::swap(bottomLeft, other.bottomLeft);
+	std::swap(origin, other.origin);
+	std::swap(path, other.path);
+
+	std::swap(subMeshCount, other.subMeshCount);
+	std::swap(totalTriangleCount, other.totalTriangleCount);
+	std::swap(triangleCount, other.triangleCount);
+	std::swap(indexOffsets, other.indexOffsets);
+	std::swap(lodCount, other.lodCount);
+	std::swap(lodTriangleCount, other.lodTriangleCount);
+	std::swap(lodIndexOffsets, other.lodIndexOffsets);
+	std::swap(skeleton, other.skeleton);
+	std::swap(isSkeletalMesh, other.isSkeletalMesh);
+
+	std::swap(triangleIndex, other.triangleIndex);
+	std::swap(uvs, other.uvs);
+	std::swap(vertices, other.vertices);
+	std::swap(normals, other.normals);
+	std::swap(tangents, other.tangents);
+
+	std::swap(vbo_index, other.vbo_index);
+	std::swap(vbo_vertices, other.vbo_vertices);
+	std::swap(vbo_uvs, other.vbo_uvs);
+	std::swap(vbo_normals, other.vbo_normals);
+	std::swap(vbo_tangents, other.vbo_tangents);
+	std::swap(vbo_bones, other.vbo_bones);
+	std::swap(vbo_interleaved, other.vbo_interleaved);
+	std::swap(vao, other.vao);
+	std::swap(vbo_usage, other.vbo_usage);
+	std::swap(vertexLayout, other.vertexLayout);
+
+	std::swap(importedAnimations, other.importedAnimations);
+	std::swap(coordCountByVertex, other.coordCountByVertex);
+	std::swap(optimizeOnImport, other.optimizeOnImport);
+	std::swap(importLodCount, other.importLodCount);
+	std::swap(bvh, other.bvh);
+	std::swap(isBVHBuilt, other.isBVHBuilt);
+	std::swap(primitiveType, other.primitiveType);
+	std::swap(drawUsage, other.drawUsage);
+}
+
 //initialize vbos and vao, based on the informations of the mesh.
 void Mesh::initGl()
 {
-	totalTriangleCount = triangleIndex.size() / 3;
-	if(triangleCount.size() == 1) //only one mesh, we have to ensure it contains all triangles
-		triangleCount[0] = (vbo_usage & USE_INDEX) ? triangleIndex.size() / 3 : vertices.size() / 9;
+	if (lodCount > 1)
+	{
+		//the simplified levels are stored after the full resolution triangles, they aren't part of the whole mesh :
+		totalTriangleCount = 0;
+		for (int i = 0; i < triangleCount.size(); i++)
+			totalTriangleCount += triangleCount[i];
+	}
+	else
+	{
+		totalTriangleCount = triangleIndex.size() / 3;
+		if(triangleCount.size() == 1) //only one mesh, we have to ensure it contains all triangles
+			triangleCount[0] = (vbo_usage & USE_INDEX) ? triangleIndex.size() / 3 : vertices.size() / 9;
+	}
 
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	GLStateCache::get().bindVertexArray(vao);
 
 	if (USE_INDEX & vbo_usage)
 	{
@@ -70,6 +169,16 @@ void Mesh::initGl()
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangleIndex.size()*sizeof(int), &triangleIndex[0], GL_STATIC_DRAW);
 	}
 
+	if (vertexLayout == INTERLEAVED_PACKED)
+	{
+		initInterleavedGl();
+
+		GLStateCache::get().bindVertexArray(0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+
 	if (USE_VERTICES & vbo_usage)
 	{
 		glGenBuffers(1, &vbo_vertices);
@@ -112,8 +221,9 @@ void Mesh::initGl()
 		glBindBuffer(GL_ARRAY_BUFFER, vbo_bones);
 		glBufferData(GL_ARRAY_BUFFER, skeleton->getBoneDatas().size()*sizeof(VertexBoneData), &skeleton->getBoneDatas()[0], GL_STATIC_DRAW);
 
+		//ids are integers in the shader :
 		glEnableVertexAttribArray(BONE_IDS);
-		glVertexAttribPointer(BONE_IDS, MAX_BONE_DATA_PER_VERTEX, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData), (void*)offsetof(VertexBoneData, ids));
+		glVertexAttribIPointer(BONE_IDS, MAX_BONE_DATA_PER_VERTEX, GL_UNSIGNED_INT, sizeof(VertexBoneData), (void*)offsetof(VertexBoneData, ids));
 
 		glEnableVertexAttribArray(BONE_WEIGHTS);
 		glVertexAttribPointer(BONE_WEIGHTS, MAX_BONE_DATA_PER_VERTEX, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData), (void*)offsetof(VertexBoneData, weights));
@@ -140,7 +250,7 @@ void Mesh::initGl()
 		glVertexAttribPointer(INSTANCE_TRANSFORM+3, 4, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 4, (void*)0);
 	}*/
 
-	glBindVertexArray(0);
+	GLStateCache::get().bindVertexArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
@@ -165,11 +275,25 @@ void Mesh::freeGl()
 	if (vbo_bones != 0)
 		glDeleteBuffers(1, &vbo_bones);
 
-	glDeleteVertexArrays(1, &vao);
+	if (vbo_interleaved != 0)
+		glDeleteBuffers(1, &vbo_interleaved);
+
+	if (vao != 0)
+		GLStateCache::get().deleteVertexArrays(1, &vao);
 }
 
 void Mesh::updateVBO(Vbo_types type)
 {
+	if (type == Vbo_types::VERTICES || type == Vbo_types::INDEX)
+		isBVHBuilt = false;
+
+	//all attributes are in the same vbo :
+	if (vertexLayout == INTERLEAVED_PACKED && type != Vbo_types::INDEX)
+	{
+		updateInterleavedVBO();
+		return;
+	}
+
 	if (type == Vbo_types::INDEX && (USE_INDEX & vbo_usage))
 	{
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_index);
@@ -215,6 +339,20 @@ void Mesh::updateVBO(Vbo_types type)
 
 void Mesh::updateAllVBOs()
 {
+	isBVHBuilt = false;
+
+	if (vertexLayout == INTERLEAVED_PACKED)
+	{
+		if (USE_INDEX & vbo_usage)
+		{
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_index);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangleIndex.size()*sizeof(int), &triangleIndex[0], GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		}
+		updateInterleavedVBO();
+		return;
+	}
+
 	if (USE_INDEX & vbo_usage)
 	{
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_index);
@@ -258,25 +396,275 @@ void Mesh::updateAllVBOs()
 	}
 }
 
+void Mesh::chooseVertexLayout()
+{
+	vertexLayout = SEPARATED_FLOAT;
+
+	//dynamic meshes update their streams separately :
+	if (drawUsage != GL_STATIC_DRAW || !(USE_VERTICES & vbo_usage) || coordCountByVertex != 3)
+		return;
+
+	const int vertexCount = vertices.size() / 3;
+	if ((USE_NORMALS & vbo_usage) && normals.size() != vertexCount * 3)
+		return;
+	if ((USE_TANGENTS & vbo_usage) && tangents.size() != vertexCount * 3)
+		return;
+	if ((USE_UVS & vbo_usage) && uvs.size() != vertexCount * 2)
+		return;
+	//bone ids are stored on 8 bits :
+	if ((USE_BONES & vbo_usage) && (skeleton == nullptr || skeleton->getBoneCount() > 256 || skeleton->getBoneDatas().size() < vertexCount))
+		return;
+
+	vertexLayout = INTERLEAVED_PACKED;
+}
+
+int Mesh::getVertexSize() const
+{
+	if (vertexLayout == INTERLEAVED_PACKED)
+	{
+		std::vector<unsigned char> unused;
+		int offsets[6];
+		int stride = 0;
+		buildInterleavedVertices(unused, offsets, stride, true);
+		return stride;
+	}
+
+	int size = 0;
+	if (USE_VERTICES & vbo_usage) size += coordCountByVertex * sizeof(float);
+	if (USE_NORMALS & vbo_usage) size += 3 * sizeof(float);
+	if (USE_UVS & vbo_usage) size += 2 * sizeof(float);
+	if (USE_TANGENTS & vbo_usage) size += 3 * sizeof(float);
+	if ((USE_BONES & vbo_usage) && skeleton != nullptr) size += sizeof(VertexBoneData);
+	return size;
+}
+
+void Mesh::buildInterleavedVertices(std::vector<unsigned char>& out, int offsets[6], int& stride, bool layoutOnly) const
+{
+	const bool useBones = (USE_BONES & vbo_usage) && skeleton != nullptr;
+
+	stride = 0;
+	for (int i = 0; i < 6; i++)
+		offsets[i] = -1;
+
+	offsets[VERTICES] = stride; stride += 3 * sizeof(float);
+	if (USE_NORMALS & vbo_usage) { offsets[NORMALS] = stride; stride += sizeof(glm::uint32); }
+	if (USE_UVS & vbo_usage) { offsets[UVS] = stride; stride += 2 * sizeof(glm::uint16); }
+	if (USE_TANGENTS & vbo_usage) { offsets[TANGENTS] = stride; stride += sizeof(glm::uint32); }
+	if (useBones) { offsets[BONE_IDS] = stride; stride += 4; }
+	if (useBones) { offsets[BONE_WEIGHTS] = stride; stride += 4; }
+
+	//only the layout is asked :
+	if (layoutOnly || vertices.size() == 0)
+		return;
+
+	const int vertexCount = vertices.size() / 3;
+	out.resize(vertexCount * stride);
+
+	for (int i = 0; i < vertexCount; i++)
+	{
+		unsigned char* vertex = &out[i * stride];
+
+		memcpy(vertex + offsets[VERTICES], &vertices[i * 3], 3 * sizeof(float));
+
+		if (offsets[NORMALS] >= 0)
+		{
+			glm::uint32 packedNormal = glm::packSnorm3x10_1x2(glm::vec4(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2], 0.f));
+			memcpy(vertex + offsets[NORMALS], &packedNormal, sizeof(glm::uint32));
+		}
+		if (offsets[UVS] >= 0)
+		{
+			glm::uint16 packedUv[2] = { glm::packHalf1x16(uvs[i * 2]), glm::packHalf1x16(uvs[i * 2 + 1]) };
+			memcpy(vertex + offsets[UVS], packedUv, 2 * sizeof(glm::uint16));
+		}
+		if (offsets[TANGENTS] >= 0)
+		{
+			glm::uint32 packedTangent = glm::packSnorm3x10_1x2(glm::vec4(tangents[i * 3], tangents[i * 3 + 1], tangents[i * 3 + 2], 0.f));
+			memcpy(vertex + offsets[TANGENTS], &packedTangent, sizeof(glm::uint32));
+		}
+		if (useBones)
+		{
+			const VertexBoneData& boneData = skeleton->getBoneDatas()[i];
+			for (int k = 0; k < MAX_BONE_DATA_PER_VERTEX; k++)
+			{
+				vertex[offsets[BONE_IDS] + k] = (unsigned char)boneData.ids[k];
+				vertex[offsets[BONE_WEIGHTS] + k] = (unsigned char)(glm::clamp(boneData.weights[k], 0.f, 1.f) * 255.f + 0.5f);
+			}
+		}
+	}
+}
+
+void Mesh::initInterleavedGl()
+{
+	std::vector<unsigned char> interleavedVertices;
+	int offsets[6];
+	int stride = 0;
+	buildInterleavedVertices(interleavedVertices, offsets, stride);
+
+	glGenBuffers(1, &vbo_interleaved);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_interleaved);
+	glBufferData(GL_ARRAY_BUFFER, interleavedVertices.size(), interleavedVertices.size() > 0 ? &interleavedVertices[0] : nullptr, drawUsage);
+
+	//same attribute locations and types in the shaders, the GPU unpacks the normalized formats :
+	glEnableVertexAttribArray(VERTICES);
+	glVertexAttribPointer(VERTICES, 3, GL_FLOAT, GL_FALSE, stride, (void*)(size_t)offsets[VERTICES]);
+
+	if (offsets[NORMALS] >= 0)
+	{
+		glEnableVertexAttribArray(NORMALS);
+		glVertexAttribPointer(NORMALS, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(size_t)offsets[NORMALS]);
+	}
+	if (offsets[UVS] >= 0)
+	{
+		glEnableVertexAttribArray(UVS);
+		glVertexAttribPointer(UVS, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(size_t)offsets[UVS]);
+	}
+	if (offsets[TANGENTS] >= 0)
+	{
+		glEnableVertexAttribArray(TANGENTS);
+		glVertexAttribPointer(TANGENTS, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(size_t)offsets[TANGENTS]);
+	}
+	if (offsets[BONE_IDS] >= 0)
+	{
+		glEnableVertexAttribArray(BONE_IDS);
+		glVertexAttribIPointer(BONE_IDS, MAX_BONE_DATA_PER_VERTEX, GL_UNSIGNED_BYTE, stride, (void*)(size_t)offsets[BONE_IDS]);
+
+		glEnableVertexAttribArray(BONE_WEIGHTS);
+		glVertexAttribPointer(BONE_WEIGHTS, MAX_BONE_DATA_PER_VERTEX, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(size_t)offsets[BONE_WEIGHTS]);
+	}
+}
+
+void Mesh::updateInterleavedVBO()
+{
+	std::vector<unsigned char> interleavedVertices;
+	int offsets[6];
+	int stride = 0;
+	buildInterleavedVertices(interleavedVertices, offsets, stride);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_interleaved);
+	glBufferData(GL_ARRAY_BUFFER, interleavedVertices.size(), interleavedVertices.size() > 0 ? &interleavedVertices[0] : nullptr, drawUsage);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 // simply draw the vertices, using vao.
 void Mesh::draw()
 {
-	glBindVertexArray(vao);
+	GLStateCache::get().bindVertexArray(vao);
 	if (USE_INDEX & vbo_usage)
 		glDrawElements(primitiveType, totalTriangleCount * 3, GL_UNSIGNED_INT, (GLvoid*)0);
 	else
 		glDrawArrays(primitiveType, 0, vertices.size() / 3);
-	glBindVertexArray(0);
+	GLStateCache::get().bindVertexArray(0);
 }
 
 void Mesh::draw(int idx)
 {
-	glBindVertexArray(vao);
+	GLStateCache::get().bindVertexArray(vao);
 	if (USE_INDEX & vbo_usage)
 		glDrawElements(primitiveType, triangleCount[idx]*3, GL_UNSIGNED_INT, (void*)(indexOffsets[idx]*sizeof(unsigned int)) );
 	else
 		glDrawArrays(primitiveType, indexOffsets[idx], triangleCount[idx] * 3);
-	glBindVertexArray(0);
+	GLStateCache::get().bindVertexArray(0);
+}
+
+void Mesh::draw(int idx, int lod)
+{
+	if (lod <= 0 || lod >= lodCount)
+	{
+		draw(idx);
+		return;
+	}
+
+	GLStateCache::get().bindVertexArray(vao);
+	glDrawElements(primitiveType, getTriangleCount(idx, lod) * 3, GL_UNSIGNED_INT, (void*)(getIndexOffset(idx, lod) * sizeof(unsigned int)));
+	GLStateCache::get().bindVertexArray(0);
+}
+
+void Mesh::drawLod(int lod)
+{
+	if (lod <= 0 || lod >= lodCount)
+	{
+		draw();
+		return;
+	}
+
+	//the sub meshes of a level are contiguous :
+	int levelTriangleCount = 0;
+	for (int i = 0; i < subMeshCount; i++)
+		levelTriangleCount += getTriangleCount(i, lod);
+
+	GLStateCache::get().bindVertexArray(vao);
+	glDrawElements(primitiveType, levelTriangleCount * 3, GL_UNSIGNED_INT, (void*)(getIndexOffset(0, lod) * sizeof(unsigned int)));
+	GLStateCache::get().bindVertexArray(0);
+}
+
+void Mesh::bindVao()
+{
+	GLStateCache::get().bindVertexArray(vao);
+}
+
+void Mesh::drawBound(int idx, int lod)
+{
+	if (lod > 0 && lod < lodCount)
+		glDrawElements(primitiveType, getTriangleCount(idx, lod) * 3, GL_UNSIGNED_INT, (void*)(getIndexOffset(idx, lod) * sizeof(unsigned int)));
+	else if (USE_INDEX & vbo_usage)
+		glDrawElements(primitiveType, triangleCount[idx] * 3, GL_UNSIGNED_INT, (void*)(indexOffsets[idx] * sizeof(unsigned int)));
+	else
+		glDrawArrays(primitiveType, indexOffsets[idx], triangleCount[idx] * 3);
+}
+
+void Mesh::drawInstanced(int idx, int lod, int instanceCount)
+{
+	if (lod > 0 && lod < lodCount)
+		glDrawElementsInstanced(primitiveType, getTriangleCount(idx, lod) * 3, GL_UNSIGNED_INT, (void*)(getIndexOffset(idx, lod) * sizeof(unsigned int)), instanceCount);
+	else if (USE_INDEX & vbo_usage)
+		glDrawElementsInstanced(primitiveType, triangleCount[idx] * 3, GL_UNSIGNED_INT, (void*)(indexOffsets[idx] * sizeof(unsigned int)), instanceCount);
+	else
+		glDrawArraysInstanced(primitiveType, indexOffsets[idx], triangleCount[idx] * 3, instanceCount);
+}
+
+void Mesh::drawLodInstanced(int lod, int instanceCount)
+{
+	if (lod <= 0 || lod >= lodCount)
+	{
+		if (USE_INDEX & vbo_usage)
+			glDrawElementsInstanced(primitiveType, totalTriangleCount * 3, GL_UNSIGNED_INT, (GLvoid*)0, instanceCount);
+		else
+			glDrawArraysInstanced(primitiveType, 0, vertices.size() / 3, instanceCount);
+		return;
+	}
+
+	//the sub meshes of a level are contiguous :
+	int levelTriangleCount = 0;
+	for (int i = 0; i < subMeshCount; i++)
+		levelTriangleCount += getTriangleCount(i, lod);
+
+	glDrawElementsInstanced(primitiveType, levelTriangleCount * 3, GL_UNSIGNED_INT, (void*)(getIndexOffset(0, lod) * sizeof(unsigned int)), instanceCount);
+}
+
+int Mesh::getTriangleCount(int idx, int lod) const
+{
+	if (lod <= 0 || lod >= lodCount)
+		return triangleCount[idx];
+	return lodTriangleCount[(lod - 1) * subMeshCount + idx];
+}
+
+GLuint Mesh::getIndexOffset(int idx, int lod) const
+{
+	if (lod <= 0 || lod >= lodCount)
+		return indexOffsets[idx];
+	return lodIndexOffsets[(lod - 1) * subMeshCount + idx];
+}
+
+std::vector<int> Mesh::getFullResolutionIndices() const
+{
+	std::vector<int> indices;
+	indices.reserve(totalTriangleCount * 3);
+	for (int i = 0; i < subMeshCount; i++)
+	{
+		auto begin = triangleIndex.begin() + indexOffsets[i];
+		indices.insert(indices.end(), begin, begin + triangleCount[i] * 3);
+	}
+	return indices;
 }
 
 void Mesh::computeBoundingBox()
@@ -315,18 +703,35 @@ void Mesh::computeBoundingBox()
 
 bool Mesh::isIntersectedByRay(const Ray & ray, CollisionInfo & collisionInfo) const
 {
-	bool isColliding = false;
+	MeshRayHit hit;
+	if (!isIntersectedByRay(ray, hit))
+		return false;
 
-	for (int i = 0; i < triangleIndex.size(); i+=3)
-	{
-		glm::vec3 a = vertexFrom3Floats(vertices, i);
-		glm::vec3 b = vertexFrom3Floats(vertices, i+1);
-		glm::vec3 c = vertexFrom3Floats(vertices, i+2);
-		isColliding = ray.intersectTriangle(a, b, c, collisionInfo);
-		if (isColliding)
-			return true;
-	}
-	return false;
+	collisionInfo.point = hit.point;
+	collisionInfo.normal = hit.normal;
+	return true;
+}
+
+bool Mesh::isIntersectedByRay(const Ray & ray, MeshRayHit & hit) const
+{
+	//only triangle meshes with 3D positions can be hit :
+	if (primitiveType != GL_TRIANGLES || coordCountByVertex != 3)
+		return false;
+
+	if (!isBVHBuilt)
+		buildBVH();
+
+	return bvh.intersect(ray, hit);
+}
+
+void Mesh::buildBVH() const
+{
+	//only the full resolution level :
+	if (USE_INDEX & vbo_usage)
+		bvh.build(vertices, getFullResolutionIndices());
+	else
+		bvh.build(vertices, std::vector<int>());
+	isBVHBuilt = true;
 }
 
 Skeleton* Mesh::getSkeleton() const
@@ -350,32 +755,56 @@ bool Mesh::initFromScene(const aiScene* pScene, const std::string& Filename)
 	totalTriangleCount = 0;
 	triangleCount.clear();
 	indexOffsets.clear();
+	lodCount = 1;
+	lodTriangleCount.clear();
+	lodIndexOffsets.clear();
 	subMeshCount = pScene->mNumMeshes;
+	std::vector<int> firstVertices;
+	std::vector<int> vertexCounts;
 	
 	if (skeleton != nullptr)
 		delete skeleton;
 	skeleton = nullptr;
 
+	float acmrBefore = 0.f;
+	float acmrAfter = 0.f;
+
 	// Initialize the meshes in the scene one by one
 	for (unsigned int i = 0; i <subMeshCount; i++)
 	{
 		indexOffsets.push_back(totalTriangleCount*3);
+		const int firstVertex = vertices.size() / 3;
 		const aiMesh* paiMesh = pScene->mMeshes[i];
 		initMesh(i, paiMesh);
 		triangleCount.push_back((triangleIndex.size() / 3) - totalTriangleCount);
-		loadBones(i, paiMesh, pScene->mRootNode, totalTriangleCount*3);
+		loadBones(i, paiMesh, pScene->mRootNode, firstVertex);
+		firstVertices.push_back(firstVertex);
+		vertexCounts.push_back((vertices.size() / 3) - firstVertex);
+
+		if (optimizeOnImport)
+		{
+			float subMeshAcmrBefore = 0.f;
+			float subMeshAcmrAfter = 0.f;
+			optimizeSubMesh(i, firstVertex, (vertices.size() / 3) - firstVertex, subMeshAcmrBefore, subMeshAcmrAfter);
+			acmrBefore += subMeshAcmrBefore * triangleCount.back();
+			acmrAfter += subMeshAcmrAfter * triangleCount.back();
+		}
 		
 		totalTriangleCount += triangleCount.back();
 
 	}
 
+	if (optimizeOnImport && totalTriangleCount > 0)
+		std::cout << "mesh " << Filename << " optimized, ACMR : " << (acmrBefore / totalTriangleCount) << " -> " << (acmrAfter / totalTriangleCount) << std::endl;
+
+	generateLods(firstVertices, vertexCounts);
+
 	//automatically turn on/off bone usage is the mesh has/hasn't got skeleton
 	if (isSkeletalMesh)
 		vbo_usage |= (USE_BONES);
 	else
 		vbo_usage &= ~USE_BONES;
 
-	initGl(); //don't forget to init mesh for opengl
 	computeBoundingBox();
 
 	loadAnimations(pScene);
@@ -435,7 +864,8 @@ void Mesh::initMesh(unsigned int Index, const aiMesh* paiMesh)
 		origin = -glm::normalize(topRight - bottomLeft) * 0.5f;*/
 	}
 
-	int offsetGlIdx = triangleIndex.size();
+	//indices are relative to the first vertex of this sub mesh :
+	int offsetGlIdx = (vertices.size() / 3) - paiMesh->mNumVertices;
 	for (unsigned int i = 0; i < paiMesh->mNumFaces; i++) 
 	{
 		const aiFace& Face = paiMesh->mFaces[i];
@@ -447,6 +877,73 @@ void Mesh::initMesh(unsigned int Index, const aiMesh* paiMesh)
 
 }
 
+void Mesh::optimizeSubMesh(int subMeshIndex, int firstVertex, int vertexCount, float& acmrBefore, float& acmrAfter)
+{
+	const int firstIndex = indexOffsets[subMeshIndex];
+	const int indexCount = triangleCount[subMeshIndex] * 3;
+
+	std::vector<unsigned int> localIndices(indexCount);
+	for (int i = 0; i < indexCount; i++)
+		localIndices[i] = triangleIndex[firstIndex + i] - firstVertex;
+
+	acmrBefore = MeshOptimizer::computeACMR(localIndices);
+	MeshOptimizer::optimizeVertexCache(localIndices, vertexCount);
+	acmrAfter = MeshOptimizer::computeACMR(localIndices);
+
+	std::vector<unsigned int> remap;
+	MeshOptimizer::optimizeVertexFetch(localIndices, vertexCount, remap);
+
+	//the sub mesh keeps the same index and vertex ranges, so indexOffsets stay valid :
+	for (int i = 0; i < indexCount; i++)
+		triangleIndex[firstIndex + i] = localIndices[i] + firstVertex;
+
+	MeshOptimizer::remapStream(vertices, 3, firstVertex, remap);
+	MeshOptimizer::remapStream(normals, 3, firstVertex, remap);
+	MeshOptimizer::remapStream(uvs, 2, firstVertex, remap);
+	MeshOptimizer::remapStream(tangents, 3, firstVertex, remap);
+	if (skeleton != nullptr)
+		skeleton->remapVertices(firstVertex, remap);
+}
+
+void Mesh::generateLods(const std::vector<int>& firstVertices, const std::vector<int>& vertexCounts)
+{
+	lodCount = 1;
+	lodTriangleCount.clear();
+	lodIndexOffsets.clear();
+
+	if (importLodCount <= 1 || primitiveType != GL_TRIANGLES || !(USE_INDEX & vbo_usage))
+		return;
+
+	//each level is simplified from the previous one :
+	std::vector<std::vector<unsigned int>> previousLevel(subMeshCount);
+	for (int i = 0; i < subMeshCount; i++)
+	{
+		previousLevel[i].resize(triangleCount[i] * 3);
+		for (int k = 0; k < triangleCount[i] * 3; k++)
+			previousLevel[i][k] = triangleIndex[indexOffsets[i] + k] - firstVertices[i];
+	}
+
+	for (int lod = 1; lod < importLodCount; lod++)
+	{
+		for (int i = 0; i < subMeshCount; i++)
+		{
+			std::vector<unsigned int> simplified;
+			int targetIndexCount = std::max(3, ((triangleCount[i] >> lod) * 3));
+			MeshOptimizer::simplify(previousLevel[i], &vertices[firstVertices[i] * 3], vertexCounts[i], targetIndexCount, simplified);
+			if (optimizeOnImport)
+				MeshOptimizer::optimizeVertexCache(simplified, vertexCounts[i]);
+
+			lodIndexOffsets.push_back(triangleIndex.size());
+			lodTriangleCount.push_back(simplified.size() / 3);
+			for (int k = 0; k < simplified.size(); k++)
+				triangleIndex.push_back(simplified[k] + firstVertices[i]);
+
+			previousLevel[i].swap(simplified);
+		}
+		lodCount++;
+	}
+}
+
 void Mesh::loadBones(unsigned int meshIndex, const aiMesh * mesh, const aiNode * rootNode, unsigned int firstVertexId)
 {
 	if (mesh->mNumBones != 0) {
@@ -467,6 +964,6 @@ void Mesh::loadAnimations(const aiScene* scene)
 
 	for (int i = 0; i < scene->mNumAnimations; i++) {
 		SkeletalAnimation* newAnimation = new SkeletalAnimation( scene->mAnimations[i] );
-		SkeletalAnimationFactory::get().add(name, newAnimation->getName(), newAnimation);
+		importedAnimations.push_back(newAnimation);
 	}
 }
@@ -13,6 +13,7 @@
 #include <assimp/scene.h>
 
 #include "Skeleton.h"
+#include "MeshBVH.h"
 
 //forwards : 
 class Ray;
@@ -49,11 +50,19 @@ struct Mesh
 
 	enum Vbo_usage { USE_INDEX = 1 << 0, USE_VERTICES = 1 << 1, USE_UVS = 1 << 2, USE_NORMALS = 1 << 3, USE_TANGENTS = 1 << 4 , USE_BONES = 1 << 5/* , USE_INSTANTIATION = 1 << 5 */};
 	enum Vbo_types { VERTICES = 0, NORMALS, UVS, TANGENTS, BONE_IDS, BONE_WEIGHTS /* INSTANCE_TRANSFORM */, INDEX };
+	//SEPARATED_FLOAT : one float vbo per attribute. 
+	//INTERLEAVED_PACKED : a single vbo, with float positions, 10:10:10:2 normals and tangents, half float uvs, 8 bits bone ids and weights.
+	enum VertexLayout { SEPARATED_FLOAT = 0, INTERLEAVED_PACKED };
 
 	int subMeshCount;
 	int totalTriangleCount;
 	std::vector<int> triangleCount;
 	std::vector<GLuint> indexOffsets;
+	//simplified levels, stored after the full resolution triangles in triangleIndex. Level 0 is the full resolution mesh (triangleCount and indexOffsets).
+	//levels > 0 of sub mesh i are at [(lod - 1) * subMeshCount + i], each level is contiguous in the index buffer.
+	int lodCount;
+	std::vector<int> lodTriangleCount;
+	std::vector<GLuint> lodIndexOffsets;
 	Skeleton* skeleton;
 	bool isSkeletalMesh; //true if the mesh owns a skeleton.
 
@@ -71,22 +80,44 @@ struct Mesh
 	GLuint vbo_normals;
 	GLuint vbo_tangents;
 	GLuint vbo_bones;
+	GLuint vbo_interleaved; //only used with the INTERLEAVED_PACKED layout
 	//GLuint vbo_transforms[4];
 	GLuint vao;
 
 	unsigned int vbo_usage;
+	VertexLayout vertexLayout;
+
+	//animations loaded by importFromFile, registered in the SkeletalAnimationFactory by finishImport :
+	std::vector<SkeletalAnimation*> importedAnimations;
 
 	int coordCountByVertex;
 
+	//reorder the triangles and the vertices of each sub mesh for the vertex cache at import. Set it before importFromFile.
+	bool optimizeOnImport;
+	//number of levels of detail generated at import (1 : no simplification), each level has half the triangles of the previous one. Set it before importFromFile.
+	int importLodCount;
+
+	//triangle bvh used by the ray casts, built on the first query and invalidated when the vertices or the indices are updated :
+	mutable MeshBVH bvh;
+	mutable bool isBVHBuilt;
+
 	GLenum primitiveType;
 	GLenum drawUsage;
 
 	Mesh(GLenum _primitiveType = GL_TRIANGLES, unsigned int _vbo_usage = (USE_INDEX | USE_VERTICES | USE_UVS | USE_NORMALS), int _coordCountByVertex = 3, GLenum _drawUsage = GL_STATIC_DRAW);
-	Mesh(const std::string& _path, const std::string& meshName = "");
+	//if importNow is false, nothing is loaded : call importFromFile (on any thread) then finishImport (on the main thread).
+	Mesh(const std::string& _path, const std::string& meshName = "", bool importNow = true);
 
 	~Mesh();
 	void clear();
 
+	//load the cpu datas from the mesh cache, or with assimp (and then write the cache). No gl calls, can be called from a worker thread.
+	bool importFromFile();
+	//create the gl datas and register the animations of an imported mesh. Must be called on the main thread.
+	void finishImport();
+	//exchange all the datas of the two meshes but their names, so the users of this mesh see a new import without changing their pointer.
+	void swapDatas(Mesh& other);
+
 	//initialize vbos and vao, based on the informations of the mesh.
 	void initGl();
 	void freeGl();
@@ -96,21 +127,56 @@ struct Mesh
 	//update all vbos.
 	void updateAllVBOs();
 
+	//choose the layout of an imported mesh : packed if the mesh is static and can be packed without loss of attributes. Call it before initGl.
+	void chooseVertexLayout();
+	//size in bytes of one vertex on the GPU, for the current layout.
+	int getVertexSize() const;
+
 	// simply draw the vertices, using vao.
 	void draw();
 	//draw a specific sub mesh.
 	void draw(int idx);
+	//draw a specific sub mesh at a given level of detail.
+	void draw(int idx, int lod);
+	//draw all sub meshes at a given level of detail.
+	void drawLod(int lod);
+	//bind the vao, for consecutive calls to drawBound.
+	void bindVao();
+	//draw a specific sub mesh at a given level of detail, without binding the vao (see bindVao).
+	void drawBound(int idx, int lod);
+	//draw several instances of a sub mesh at a given level of detail, without binding the vao. The instanced attributes must be bound (see InstanceBuffer).
+	void drawInstanced(int idx, int lod, int instanceCount);
+	//draw several instances of all sub meshes at a given level of detail, without binding the vao.
+	void drawLodInstanced(int lod, int instanceCount);
+
+	int getTriangleCount(int idx, int lod) const;
+	GLuint getIndexOffset(int idx, int lod) const;
+	//indices of the full resolution triangles of all sub meshes (the level 0 ranges), without the simplified levels :
+	std::vector<int> getFullResolutionIndices() const;
 
 	void computeBoundingBox();
 
 	bool isIntersectedByRay(const Ray& ray, CollisionInfo& collisionInfo) const;
+	//closest hit along the ray, with the triangle index and the barycentric coordinates :
+	bool isIntersectedByRay(const Ray& ray, MeshRayHit& hit) const;
+	//build the bvh now instead of on the first ray cast. No gl calls, can be called from a worker thread.
+	void buildBVH() const;
 
 	Skeleton* getSkeleton() const;
 	bool getIsSkeletalMesh() const;
 
 private:
+	//fill the interleaved buffer from the float streams, and give the offset of each attribute in a vertex (-1 if not used) :
+	void buildInterleavedVertices(std::vector<unsigned char>& out, int offsets[6], int& stride, bool layoutOnly = false) const;
+	void initInterleavedGl();
+	void updateInterleavedVBO();
+
 	bool initFromScene(const aiScene* pScene, const std::string& Filename);
 	void initMesh(unsigned int Index, const aiMesh* paiMesh);
+	//vertex cache then vertex fetch optimization of a sub mesh, must be called after loadBones :
+	void optimizeSubMesh(int subMeshIndex, int firstVertex, int vertexCount, float& acmrBefore, float& acmrAfter);
+	//append importLodCount - 1 simplified levels of each sub mesh to the index buffer. firstVertices and vertexCounts give the vertex range of each sub mesh.
+	void generateLods(const std::vector<int>& firstVertices, const std::vector<int>& vertexCounts);
 	//Check if the mesh has bones. If true, create the appropriate skeleton :  
 	void loadBones(unsigned int meshIndex, const aiMesh * mesh, const aiNode * rootNode, unsigned int firstVertexId);
 	void loadAnimations(const aiScene* scene);
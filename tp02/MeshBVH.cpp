@@ -0,0 +1,387 @@
+#include "MeshBVH.h"
+
+#include <algorithm>
+#include <cmath>
+
+//forwards :
+#include "Ray.h"
+
+namespace {
+	const int BIN_COUNT = 16;
+	const int MAX_LEAF_SIZE = 8;
+	//the traversal stack is sized from it :
+	const int MAX_DEPTH = 48;
+
+	float surfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 extent = boundsMax - boundsMin;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+
+	//slab test, return the entry distance or max float if the box is missed.
+	//invDirection components are ignored where direction is zero :
+	float intersectBounds(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& invDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance)
+	{
+		float tNear = -std::numeric_limits<float>::max();
+		float tFar = std::numeric_limits<float>::max();
+		for (int axis = 0; axis < 3; axis++)
+		{
+			//a ray parallel to the slab never enters or leaves it, the origin has to be between the planes 
+			//(dividing by the zero component would give 0 * inf = NaN at the plane) :
+			if (direction[axis] == 0.f)
+			{
+				if (origin[axis] < boundsMin[axis] || origin[axis] > boundsMax[axis])
+					return std::numeric_limits<float>::max();
+				continue;
+			}
+
+			float t1 = (boundsMin[axis] - origin[axis]) * invDirection[axis];
+			float t2 = (boundsMax[axis] - origin[axis]) * invDirection[axis];
+			tNear = std::max(tNear, std::min(t1, t2));
+			tFar = std::min(tFar, std::max(t1, t2));
+		}
+
+		if (tFar >= tNear && tFar > 0.f && tNear < maxDistance)
+			return tNear;
+		return std::numeric_limits<float>::max();
+	}
+
+	struct Bin
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		int triangleCount;
+
+		Bin() : boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max()), triangleCount(0)
+		{}
+
+		void grow(const glm::vec3& point)
+		{
+			boundsMin = glm::min(boundsMin, point);
+			boundsMax = glm::max(boundsMax, point);
+		}
+
+		void grow(const Bin& other)
+		{
+			if (other.triangleCount == 0)
+				return;
+			boundsMin = glm::min(boundsMin, other.boundsMin);
+			boundsMax = glm::max(boundsMax, other.boundsMax);
+			triangleCount += other.triangleCount;
+		}
+	};
+}
+
+MeshRayHit::MeshRayHit() : t(std::numeric_limits<float>::max()), triangle(-1), barycentrics(0, 0), point(0, 0, 0), normal(0, 0, 0)
+{
+
+}
+
+void MeshBVH::build(const std::vector<float>& vertices, const std::vector<int>& indices)
+{
+	clear();
+
+	const int vertexCount = vertices.size() / 3;
+	const int triangleCount = indices.size() > 0 ? indices.size() / 3 : vertexCount / 3;
+	std::vector<glm::vec3> centroids;
+
+	m_triangleVertices.reserve(triangleCount * 3);
+	m_triangleIds.reserve(triangleCount);
+	centroids.reserve(triangleCount);
+
+	for (int i = 0; i < triangleCount; i++)
+	{
+		int ids[3];
+		bool isValid = true;
+		for (int k = 0; k < 3; k++)
+		{
+			ids[k] = indices.size() > 0 ? indices[i * 3 + k] : i * 3 + k;
+			isValid = isValid && ids[k] >= 0 && ids[k] < vertexCount;
+		}
+		if (!isValid)
+			continue;
+
+		glm::vec3 a(vertices[ids[0] * 3], vertices[ids[0] * 3 + 1], vertices[ids[0] * 3 + 2]);
+		glm::vec3 b(vertices[ids[1] * 3], vertices[ids[1] * 3 + 1], vertices[ids[1] * 3 + 2]);
+		glm::vec3 c(vertices[ids[2] * 3], vertices[ids[2] * 3 + 1], vertices[ids[2] * 3 + 2]);
+
+		m_triangleVertices.push_back(a);
+		m_triangleVertices.push_back(b);
+		m_triangleVertices.push_back(c);
+		m_triangleIds.push_back(i);
+		centroids.push_back((a + b + c) / 3.f);
+	}
+
+	if (m_triangleIds.size() == 0)
+		return;
+
+	//a binary tree has at most 2n-1 nodes :
+	m_nodes.reserve(m_triangleIds.size() * 2);
+
+	MeshBVHNode root;
+	root.leftOrFirst = 0;
+	root.triangleCount = m_triangleIds.size();
+	m_nodes.push_back(root);
+	updateNodeBounds(0);
+
+	//split the nodes in depth first order, without recursion :
+	std::vector<std::pair<int, int>> toSplit; // (node, depth)
+	toSplit.push_back(std::make_pair(0, 0));
+	while (!toSplit.empty())
+	{
+		int nodeIndex = toSplit.back().first;
+		int depth = toSplit.back().second;
+		toSplit.pop_back();
+
+		if (depth >= MAX_DEPTH || !splitNode(nodeIndex, centroids))
+			continue;
+
+		int leftIndex = m_nodes[nodeIndex].leftOrFirst;
+		toSplit.push_back(std::make_pair(leftIndex + 1, depth + 1));
+		toSplit.push_back(std::make_pair(leftIndex, depth + 1));
+	}
+}
+
+void MeshBVH::clear()
+{
+	m_nodes.clear();
+	m_triangleVertices.clear();
+	m_triangleIds.clear();
+}
+
+bool MeshBVH::isEmpty() const
+{
+	return m_nodes.empty();
+}
+
+int MeshBVH::getNodeCount() const
+{
+	return m_nodes.size();
+}
+
+int MeshBVH::getTriangleCount() const
+{
+	return m_triangleIds.size();
+}
+
+void MeshBVH::updateNodeBounds(int nodeIndex)
+{
+	MeshBVHNode& node = m_nodes[nodeIndex];
+	node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+
+	for (int i = node.leftOrFirst * 3; i < (node.leftOrFirst + node.triangleCount) * 3; i++)
+	{
+		node.boundsMin = glm::min(node.boundsMin, m_triangleVertices[i]);
+		node.boundsMax = glm::max(node.boundsMax, m_triangleVertices[i]);
+	}
+}
+
+bool MeshBVH::splitNode(int nodeIndex, std::vector<glm::vec3>& centroids)
+{
+	const int first = m_nodes[nodeIndex].leftOrFirst;
+	const int count = m_nodes[nodeIndex].triangleCount;
+
+	if (count <= 2)
+		return false;
+
+	glm::vec3 centroidMin(std::numeric_limits<float>::max());
+	glm::vec3 centroidMax(-std::numeric_limits<float>::max());
+	for (int i = first; i < first + count; i++)
+	{
+		centroidMin = glm::min(centroidMin, centroids[i]);
+		centroidMax = glm::max(centroidMax, centroids[i]);
+	}
+
+	//find the best split plane between bins, on the three axis :
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = std::numeric_limits<float>::max();
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.f)
+			continue;
+
+		Bin bins[BIN_COUNT];
+		float scale = BIN_COUNT / extent;
+		for (int i = first; i < first + count; i++)
+		{
+			int binIndex = std::min(BIN_COUNT - 1, (int)((centroids[i][axis] - centroidMin[axis]) * scale));
+			bins[binIndex].triangleCount++;
+			bins[binIndex].grow(m_triangleVertices[i * 3]);
+			bins[binIndex].grow(m_triangleVertices[i * 3 + 1]);
+			bins[binIndex].grow(m_triangleVertices[i * 3 + 2]);
+		}
+
+		//sweep from the right to get the cost of the right side of each plane :
+		float rightCosts[BIN_COUNT];
+		Bin right;
+		for (int i = BIN_COUNT - 1; i > 0; i--)
+		{
+			right.grow(bins[i]);
+			rightCosts[i] = right.triangleCount > 0 ? right.triangleCount * surfaceArea(right.boundsMin, right.boundsMax) : 0.f;
+		}
+
+		Bin left;
+		for (int i = 0; i < BIN_COUNT - 1; i++)
+		{
+			left.grow(bins[i]);
+			if (left.triangleCount == 0 || left.triangleCount == count)
+				continue;
+
+			float cost = left.triangleCount * surfaceArea(left.boundsMin, left.boundsMax) + rightCosts[i + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i + 1;
+			}
+		}
+	}
+
+	if (bestAxis < 0)
+		return false;
+
+	//keep the leaf if splitting doesn't pay, unless it is too big :
+	float leafCost = count * surfaceArea(m_nodes[nodeIndex].boundsMin, m_nodes[nodeIndex].boundsMax);
+	if (bestCost >= leafCost && count <= MAX_LEAF_SIZE)
+		return false;
+
+	//partition the triangles in place :
+	float scale = BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+	int i = first;
+	int j = first + count - 1;
+	while (i <= j)
+	{
+		int binIndex = std::min(BIN_COUNT - 1, (int)((centroids[i][bestAxis] - centroidMin[bestAxis]) * scale));
+		if (binIndex < bestSplit)
+		{
+			i++;
+		}
+		else
+		{
+			std::swap(centroids[i], centroids[j]);
+			std::swap(m_triangleIds[i], m_triangleIds[j]);
+			for (int k = 0; k < 3; k++)
+				std::swap(m_triangleVertices[i * 3 + k], m_triangleVertices[j * 3 + k]);
+			j--;
+		}
+	}
+
+	const int leftCount = i - first;
+	if (leftCount == 0 || leftCount == count)
+		return false;
+
+	const int leftIndex = m_nodes.size();
+	MeshBVHNode child;
+	child.leftOrFirst = first;
+	child.triangleCount = leftCount;
+	m_nodes.push_back(child);
+	child.leftOrFirst = i;
+	child.triangleCount = count - leftCount;
+	m_nodes.push_back(child);
+
+	updateNodeBounds(leftIndex);
+	updateNodeBounds(leftIndex + 1);
+
+	m_nodes[nodeIndex].leftOrFirst = leftIndex;
+	m_nodes[nodeIndex].triangleCount = 0;
+
+	return true;
+}
+
+bool MeshBVH::intersect(const Ray& ray, MeshRayHit& hit, float maxDistance) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	const glm::vec3 origin = ray.getOrigin();
+	const glm::vec3 direction = ray.getDirection();
+	glm::vec3 invDirection;
+	for (int axis = 0; axis < 3; axis++)
+		invDirection[axis] = (direction[axis] != 0.f) ? 1.f / direction[axis] : 0.f;
+
+	float closest = maxDistance;
+	int closestTriangle = -1;
+	glm::vec2 closestBarycentrics(0, 0);
+
+	int stack[MAX_DEPTH + 2];
+	int stackSize = 0;
+
+	if (intersectBounds(origin, direction, invDirection, m_nodes[0].boundsMin, m_nodes[0].boundsMax, closest) == std::numeric_limits<float>::max())
+		return false;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const MeshBVHNode& node = m_nodes[stack[--stackSize]];
+
+		if (node.triangleCount > 0)
+		{
+			//Moller-Trumbore, for both faces :
+			for (int i = node.leftOrFirst; i < node.leftOrFirst + node.triangleCount; i++)
+			{
+				const glm::vec3& a = m_triangleVertices[i * 3];
+				glm::vec3 edge1 = m_triangleVertices[i * 3 + 1] - a;
+				glm::vec3 edge2 = m_triangleVertices[i * 3 + 2] - a;
+
+				glm::vec3 p = glm::cross(direction, edge2);
+				float determinant = glm::dot(edge1, p);
+				if (std::abs(determinant) < 1e-12f)
+					continue;
+				float invDeterminant = 1.f / determinant;
+
+				glm::vec3 s = origin - a;
+				float u = glm::dot(s, p) * invDeterminant;
+				if (u < 0.f || u > 1.f)
+					continue;
+
+				glm::vec3 q = glm::cross(s, edge1);
+				float v = glm::dot(direction, q) * invDeterminant;
+				if (v < 0.f || u + v > 1.f)
+					continue;
+
+				float t = glm::dot(edge2, q) * invDeterminant;
+				if (t > 0.f && t < closest)
+				{
+					closest = t;
+					closestTriangle = i;
+					closestBarycentrics = glm::vec2(u, v);
+				}
+			}
+			continue;
+		}
+
+		//visit the nearest child first :
+		int leftIndex = node.leftOrFirst;
+		float tLeft = intersectBounds(origin, direction, invDirection, m_nodes[leftIndex].boundsMin, m_nodes[leftIndex].boundsMax, closest);
+		float tRight = intersectBounds(origin, direction, invDirection, m_nodes[leftIndex + 1].boundsMin, m_nodes[leftIndex + 1].boundsMax, closest);
+
+		int nearIndex = leftIndex;
+		int farIndex = leftIndex + 1;
+		if (tRight < tLeft)
+		{
+			std::swap(tLeft, tRight);
+			std::swap(nearIndex, farIndex);
+		}
+
+		if (tRight != std::numeric_limits<float>::max())
+			stack[stackSize++] = farIndex;
+		if (tLeft != std::numeric_limits<float>::max())
+			stack[stackSize++] = nearIndex;
+	}
+
+	if (closestTriangle < 0)
+		return false;
+
+	const glm::vec3& a = m_triangleVertices[closestTriangle * 3];
+	hit.t = closest;
+	hit.triangle = m_triangleIds[closestTriangle];
+	hit.barycentrics = closestBarycentrics;
+	hit.point = ray.at(closest);
+	hit.normal = glm::normalize(glm::cross(m_triangleVertices[closestTriangle * 3 + 1] - a, m_triangleVertices[closestTriangle * 3 + 2] - a));
+
+	return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+
+#include "glm/glm.hpp"
+
+//forwards :
+class Ray;
+
+//a node of the bvh. Internal nodes : leftOrFirst is the index of the left child, the right child is just after it.
+//Leafs (triangleCount > 0) : leftOrFirst is the first triangle of the leaf, in the bvh triangle order.
+struct MeshBVHNode
+{
+	glm::vec3 boundsMin;
+	int leftOrFirst;
+	glm::vec3 boundsMax;
+	int triangleCount;
+};
+
+//result of a ray cast against a mesh :
+struct MeshRayHit
+{
+	float t; //distance along the ray direction
+	int triangle; //index of the triangle in the mesh (triangleIndex[triangle*3 + k])
+	glm::vec2 barycentrics; //weights of the second and third vertices of the triangle
+	glm::vec3 point;
+	glm::vec3 normal; //geometric normal of the triangle
+
+	MeshRayHit();
+};
+
+//Bounding volume hierarchy over the triangles of a mesh, built with a binned surface area heuristic.
+//Nodes are stored in a flat array, in depth first order, and traversed with a small stack instead of recursion.
+class MeshBVH
+{
+private:
+	std::vector<MeshBVHNode> m_nodes;
+	//triangle positions, in the order of the leafs (three vertices per triangle) :
+	std::vector<glm::vec3> m_triangleVertices;
+	//index of each triangle in the mesh, in the order of the leafs :
+	std::vector<int> m_triangleIds;
+
+public:
+	//indices : three vertex indices per triangle. If empty, the vertices are read three by three.
+	void build(const std::vector<float>& vertices, const std::vector<int>& indices);
+	void clear();
+	bool isEmpty() const;
+
+	int getNodeCount() const;
+	int getTriangleCount() const;
+
+	//closest hit in ]0, maxDistance]. Return false if nothing is hit.
+	bool intersect(const Ray& ray, MeshRayHit& hit, float maxDistance = std::numeric_limits<float>::max()) const;
+
+private:
+	//compute the bounds of a node from its triangles :
+	void updateNodeBounds(int nodeIndex);
+	//try to split a node with the binned SAH. Return false if the node should stay a leaf.
+	bool splitNode(int nodeIndex, std::vector<glm::vec3>& centroids);
+};
@@ -0,0 +1,534 @@
+#include "MeshCache.h"
+
+#include <fstream>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Mesh.h"
+
+static const unsigned int MESH_CACHE_MAGIC = 0x4853454D; // "MESH"
+static const unsigned int MESH_CACHE_VERSION = 3;
+
+struct MeshCacheHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long sourceSize;
+	long long sourceTime;
+	unsigned long long sourceHash;
+
+	unsigned int vboUsage;
+	unsigned int subMeshCount;
+	unsigned int indexCount;
+	unsigned int vertexCount;
+	unsigned int isSkeletalMesh;
+	unsigned int animationCount;
+	unsigned int isOptimized; //buffers reordered by Mesh::optimizeSubMesh
+	unsigned int lodCount;
+};
+
+//a read only view of a whole file, mapped in memory.
+class MappedFile
+{
+private:
+	const char* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	HANDLE m_file;
+	HANDLE m_mapping;
+#else
+	int m_file;
+#endif
+
+public:
+	MappedFile(const std::string& path) : m_data(nullptr), m_size(0)
+	{
+#ifdef _WIN32
+		m_mapping = NULL;
+		m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (m_file == INVALID_HANDLE_VALUE)
+			return;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0)
+			return;
+
+		m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_mapping == NULL)
+			return;
+
+		m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		if (m_data != nullptr)
+			m_size = (size_t)fileSize.QuadPart;
+#else
+		m_file = open(path.c_str(), O_RDONLY);
+		if (m_file < 0)
+			return;
+
+		struct stat fileStat;
+		if (fstat(m_file, &fileStat) != 0 || fileStat.st_size == 0)
+			return;
+
+		void* data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+		if (data == MAP_FAILED)
+			return;
+
+		m_data = (const char*)data;
+		m_size = fileStat.st_size;
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (m_data != nullptr)
+			UnmapViewOfFile(m_data);
+		if (m_mapping != NULL)
+			CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file);
+#else
+		if (m_data != nullptr)
+			munmap((void*)m_data, m_size);
+		if (m_file >= 0)
+			close(m_file);
+#endif
+	}
+
+	MappedFile(const MappedFile& other) = delete;
+	void operator=(const MappedFile& other) = delete;
+
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+};
+
+//read sequentially in a mapped file, every read is bound checked.
+class CacheReader
+{
+private:
+	const char* m_cursor;
+	const char* m_end;
+
+public:
+	CacheReader(const char* data, size_t size) : m_cursor(data), m_end(data + size)
+	{}
+
+	bool readBytes(void* out, size_t size)
+	{
+		if ((size_t)(m_end - m_cursor) < size)
+			return false;
+		if (size > 0)
+			memcpy(out, m_cursor, size);
+		m_cursor += size;
+		return true;
+	}
+
+	template<typename T>
+	bool read(T& out)
+	{
+		return readBytes(&out, sizeof(T));
+	}
+
+	template<typename T>
+	bool readArray(std::vector<T>& out, size_t count)
+	{
+		if ((size_t)(m_end - m_cursor) / sizeof(T) < count)
+			return false;
+		out.resize(count);
+		return count == 0 || readBytes(&out[0], count * sizeof(T));
+	}
+
+	bool readString(std::string& out)
+	{
+		unsigned int length = 0;
+		if (!read(length) || (size_t)(m_end - m_cursor) < length)
+			return false;
+		out.assign(m_cursor, length);
+		m_cursor += length;
+		return true;
+	}
+};
+
+//write helpers :
+template<typename T>
+static void writeValue(std::ofstream& file, const T& value)
+{
+	file.write((const char*)&value, sizeof(T));
+}
+
+template<typename T>
+static void writeArray(std::ofstream& file, const T* values, size_t count)
+{
+	if (count > 0)
+		file.write((const char*)values, count * sizeof(T));
+}
+
+static void writeString(std::ofstream& file, const std::string& value)
+{
+	writeValue(file, (unsigned int)value.size());
+	file.write(value.data(), value.size());
+}
+
+//FNV-1a hash of the source file content.
+static bool computeSourceInfos(const std::string& sourcePath, unsigned long long& size, long long& time, unsigned long long& hash, bool computeHash)
+{
+	struct stat sourceStat;
+	if (stat(sourcePath.c_str(), &sourceStat) != 0)
+		return false;
+
+	size = sourceStat.st_size;
+	time = sourceStat.st_mtime;
+	hash = 0;
+
+	if (!computeHash)
+		return true;
+
+	MappedFile source(sourcePath);
+	if (source.data() == nullptr)
+		return false;
+
+	hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < source.size(); i++)
+	{
+		hash ^= (unsigned char)source.data()[i];
+		hash *= 1099511628211ULL;
+	}
+	return true;
+}
+
+static void writeNode(std::ofstream& file, const aiNode* node)
+{
+	writeString(file, node->mName.data);
+	writeValue(file, node->mTransformation);
+	writeValue(file, node->mNumChildren);
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		writeNode(file, node->mChildren[i]);
+}
+
+static aiNode* readNode(CacheReader& reader, aiNode* parent)
+{
+	std::string name;
+	aiMatrix4x4 transformation;
+	unsigned int childCount = 0;
+	if (!reader.readString(name) || !reader.read(transformation) || !reader.read(childCount))
+		return nullptr;
+
+	aiNode* node = new aiNode(name);
+	node->mTransformation = transformation;
+	node->mParent = parent;
+
+	if (childCount > 0)
+	{
+		node->mChildren = new aiNode*[childCount];
+		for (unsigned int i = 0; i < childCount; i++)
+		{
+			node->mChildren[i] = readNode(reader, node);
+			if (node->mChildren[i] == nullptr)
+			{
+				delete node;
+				return nullptr;
+			}
+			//only count valid children, so the aiNode destructor can release a partially read hierarchy :
+			node->mNumChildren = i + 1;
+		}
+	}
+
+	return node;
+}
+
+static void writeAnimation(std::ofstream& file, const aiAnimation* animation)
+{
+	writeString(file, animation->mName.data);
+	writeValue(file, animation->mDuration);
+	writeValue(file, animation->mTicksPerSecond);
+	writeValue(file, animation->mNumChannels);
+	for (unsigned int i = 0; i < animation->mNumChannels; i++)
+	{
+		const aiNodeAnim* channel = animation->mChannels[i];
+		writeString(file, channel->mNodeName.data);
+		writeValue(file, channel->mNumPositionKeys);
+		writeArray(file, channel->mPositionKeys, channel->mNumPositionKeys);
+		writeValue(file, channel->mNumRotationKeys);
+		writeArray(file, channel->mRotationKeys, channel->mNumRotationKeys);
+		writeValue(file, channel->mNumScalingKeys);
+		writeArray(file, channel->mScalingKeys, channel->mNumScalingKeys);
+	}
+}
+
+template<typename T>
+static bool readKeys(CacheReader& reader, T*& keys, unsigned int& keyCount)
+{
+	std::vector<T> tmpKeys;
+	if (!reader.read(keyCount) || !reader.readArray(tmpKeys, keyCount))
+	{
+		keyCount = 0;
+		return false;
+	}
+
+	keys = keyCount > 0 ? new T[keyCount] : nullptr;
+	for (unsigned int i = 0; i < keyCount; i++)
+		keys[i] = tmpKeys[i];
+	return true;
+}
+
+static aiAnimation* readAnimation(CacheReader& reader)
+{
+	std::string name;
+	aiAnimation* animation = new aiAnimation();
+	unsigned int channelCount = 0;
+	if (!reader.readString(name) || !reader.read(animation->mDuration) || !reader.read(animation->mTicksPerSecond) || !reader.read(channelCount))
+	{
+		delete animation;
+		return nullptr;
+	}
+	animation->mName.Set(name);
+
+	if (channelCount > 0)
+	{
+		animation->mChannels = new aiNodeAnim*[channelCount];
+		for (unsigned int i = 0; i < channelCount; i++)
+		{
+			aiNodeAnim* channel = new aiNodeAnim();
+			animation->mChannels[i] = channel;
+			animation->mNumChannels = i + 1;
+
+			std::string nodeName;
+			if (!reader.readString(nodeName)
+				|| !readKeys(reader, channel->mPositionKeys, channel->mNumPositionKeys)
+				|| !readKeys(reader, channel->mRotationKeys, channel->mNumRotationKeys)
+				|| !readKeys(reader, channel->mScalingKeys, channel->mNumScalingKeys))
+			{
+				delete animation;
+				return nullptr;
+			}
+			channel->mNodeName.Set(nodeName);
+		}
+	}
+
+	return animation;
+}
+
+std::string MeshCache::getCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".meshcache";
+}
+
+bool MeshCache::write(const std::string& sourcePath, const Mesh& mesh, const aiScene* scene)
+{
+	MeshCacheHeader header;
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	if (!computeSourceInfos(sourcePath, header.sourceSize, header.sourceTime, header.sourceHash, true))
+		return false;
+
+	header.vboUsage = mesh.vbo_usage;
+	header.subMeshCount = mesh.subMeshCount;
+	header.indexCount = mesh.triangleIndex.size();
+	header.vertexCount = mesh.vertices.size() / 3;
+	header.isSkeletalMesh = (mesh.isSkeletalMesh && mesh.skeleton != nullptr) ? 1 : 0;
+	header.animationCount = scene->HasAnimations() ? scene->mNumAnimations : 0;
+	header.isOptimized = mesh.optimizeOnImport ? 1 : 0;
+	header.lodCount = mesh.lodCount;
+
+	//all streams must have one element per vertex :
+	if (mesh.normals.size() != header.vertexCount * 3 || mesh.uvs.size() != header.vertexCount * 2 || mesh.tangents.size() != header.vertexCount * 3
+		|| mesh.triangleCount.size() != header.subMeshCount || mesh.indexOffsets.size() != header.subMeshCount
+		|| mesh.lodTriangleCount.size() != (header.lodCount - 1) * header.subMeshCount || mesh.lodIndexOffsets.size() != (header.lodCount - 1) * header.subMeshCount)
+		return false;
+
+	std::ofstream file(getCachePath(sourcePath), std::ios::out | std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cout << "warning, can't write mesh cache : " << getCachePath(sourcePath) << std::endl;
+		return false;
+	}
+
+	writeValue(file, header);
+
+	//sub meshes :
+	writeArray(file, &mesh.triangleCount[0], header.subMeshCount);
+	writeArray(file, &mesh.indexOffsets[0], header.subMeshCount);
+	if (header.lodCount > 1)
+	{
+		writeArray(file, &mesh.lodTriangleCount[0], mesh.lodTriangleCount.size());
+		writeArray(file, &mesh.lodIndexOffsets[0], mesh.lodIndexOffsets.size());
+	}
+
+	//vertex streams, one per attribute like the vbos :
+	writeArray(file, &mesh.triangleIndex[0], header.indexCount);
+	writeArray(file, &mesh.vertices[0], mesh.vertices.size());
+	writeArray(file, &mesh.normals[0], mesh.normals.size());
+	writeArray(file, &mesh.uvs[0], mesh.uvs.size());
+	writeArray(file, &mesh.tangents[0], mesh.tangents.size());
+
+	//skeleton :
+	if (header.isSkeletalMesh)
+	{
+		const Skeleton* skeleton = mesh.skeleton;
+
+		writeValue(file, (unsigned int)skeleton->getBoneMapping().size());
+		for (auto& bone : skeleton->getBoneMapping())
+		{
+			writeString(file, bone.first);
+			writeValue(file, bone.second);
+		}
+
+		writeValue(file, (unsigned int)skeleton->getBonesOffset().size());
+		writeArray(file, &skeleton->getBonesOffset()[0], skeleton->getBonesOffset().size());
+
+		writeValue(file, (unsigned int)skeleton->getBoneDatas().size());
+		writeArray(file, &skeleton->getBoneDatas()[0], skeleton->getBoneDatas().size());
+
+		writeNode(file, scene->mRootNode);
+	}
+
+	//animations :
+	for (unsigned int i = 0; i < header.animationCount; i++)
+		writeAnimation(file, scene->mAnimations[i]);
+
+	return file.good();
+}
+
+bool MeshCache::load(const std::string& sourcePath, Mesh& mesh)
+{
+	MappedFile cacheFile(getCachePath(sourcePath));
+	if (cacheFile.data() == nullptr)
+		return false;
+
+	CacheReader reader(cacheFile.data(), cacheFile.size());
+
+	MeshCacheHeader header;
+	if (!reader.read(header) || header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION)
+		return false;
+	//the cached buffers must match the import options :
+	if (header.isOptimized != (mesh.optimizeOnImport ? 1 : 0) || header.lodCount != std::max(1, mesh.importLodCount))
+		return false;
+
+	//invalidation : same size and timestamp is enough, else compare the content hash.
+	unsigned long long sourceSize = 0;
+	long long sourceTime = 0;
+	unsigned long long sourceHash = 0;
+	if (!computeSourceInfos(sourcePath, sourceSize, sourceTime, sourceHash, false))
+		return false;
+	if (sourceSize != header.sourceSize)
+		return false;
+	if (sourceTime != header.sourceTime)
+	{
+		if (!computeSourceInfos(sourcePath, sourceSize, sourceTime, sourceHash, true) || sourceHash != header.sourceHash)
+			return false;
+	}
+
+	//read everything in temporaries, the mesh is only modified if the whole cache is valid :
+	std::vector<int> triangleCount;
+	std::vector<GLuint> indexOffsets;
+	std::vector<int> lodTriangleCount;
+	std::vector<GLuint> lodIndexOffsets;
+	std::vector<int> triangleIndex;
+	std::vector<float> vertices;
+	std::vector<float> normals;
+	std::vector<float> uvs;
+	std::vector<float> tangents;
+
+	if (!reader.readArray(triangleCount, header.subMeshCount)
+		|| !reader.readArray(indexOffsets, header.subMeshCount)
+		|| !reader.readArray(lodTriangleCount, (header.lodCount - 1) * header.subMeshCount)
+		|| !reader.readArray(lodIndexOffsets, (header.lodCount - 1) * header.subMeshCount)
+		|| !reader.readArray(triangleIndex, header.indexCount)
+		|| !reader.readArray(vertices, header.vertexCount * 3)
+		|| !reader.readArray(normals, header.vertexCount * 3)
+		|| !reader.readArray(uvs, header.vertexCount * 2)
+		|| !reader.readArray(tangents, header.vertexCount * 3))
+		return false;
+
+	Skeleton* skeleton = nullptr;
+	if (header.isSkeletalMesh)
+	{
+		std::map<std::string, unsigned int> boneMapping;
+		std::vector<aiMatrix4x4> bonesOffset;
+		std::vector<VertexBoneData> boneDatas;
+		unsigned int count = 0;
+
+		if (!reader.read(count))
+			return false;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			std::string boneName;
+			unsigned int boneIndex = 0;
+			if (!reader.readString(boneName) || !reader.read(boneIndex))
+				return false;
+			boneMapping[boneName] = boneIndex;
+		}
+
+		if (!reader.read(count) || !reader.readArray(bonesOffset, count))
+			return false;
+		if (!reader.read(count) || !reader.readArray(boneDatas, count))
+			return false;
+
+		aiNode* rootNode = readNode(reader, nullptr);
+		if (rootNode == nullptr)
+			return false;
+
+		skeleton = new Skeleton(boneMapping, boneDatas, bonesOffset, rootNode);
+	}
+
+	std::vector<aiAnimation*> animations;
+	for (unsigned int i = 0; i < header.animationCount; i++)
+	{
+		aiAnimation* animation = readAnimation(reader);
+		if (animation == nullptr)
+		{
+			for (auto& a : animations)
+				delete a;
+			delete skeleton;
+			return false;
+		}
+		animations.push_back(animation);
+	}
+
+	//the cache is valid, fill the mesh :
+	mesh.vbo_usage = header.vboUsage;
+	mesh.subMeshCount = header.subMeshCount;
+	mesh.triangleCount.swap(triangleCount);
+	mesh.indexOffsets.swap(indexOffsets);
+	mesh.lodCount = header.lodCount;
+	mesh.lodTriangleCount.swap(lodTriangleCount);
+	mesh.lodIndexOffsets.swap(lodIndexOffsets);
+	mesh.triangleIndex.swap(triangleIndex);
+	mesh.vertices.swap(vertices);
+	mesh.normals.swap(normals);
+	mesh.uvs.swap(uvs);
+	mesh.tangents.swap(tangents);
+
+	mesh.totalTriangleCount = 0;
+	for (int i = 0; i < mesh.triangleCount.size(); i++)
+		mesh.totalTriangleCount += mesh.triangleCount[i];
+
+	if (mesh.skeleton != nullptr)
+		delete mesh.skeleton;
+	mesh.skeleton = skeleton;
+	mesh.isSkeletalMesh = (skeleton != nullptr);
+
+	//animations are registered in the factory by Mesh::finishImport, like the ones loaded by Mesh::loadAnimations.
+	//The SkeletalAnimation keeps a compressed copy of the keys :
+	for (auto& animation : animations)
+	{
+		mesh.importedAnimations.push_back(new SkeletalAnimation(animation));
+		delete animation;
+	}
+
+	return true;
+}
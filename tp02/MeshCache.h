@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+#include <assimp/scene.h>
+
+//forwards :
+struct Mesh;
+
+//Engine side binary version of an imported model : vertex streams, indices, sub meshes, bone weights, skeleton hierarchy and animations.
+//The cache is written next to the source file the first time it is imported with assimp, and then loaded with a single file mapping.
+//It is invalidated when the source file changes (size and timestamp, then content hash if the timestamp differs).
+class MeshCache
+{
+public:
+	//path of the cache file for a given source file.
+	static std::string getCachePath(const std::string& sourcePath);
+
+	//write the cache for a mesh freshly imported from the given scene. Return false if the cache can't be written.
+	static bool write(const std::string& sourcePath, const Mesh& mesh, const aiScene* scene);
+	//fill the cpu datas, the skeleton and the imported animations of the mesh from the cache. No gl calls are made.
+	//Return false if there is no valid cache for this source file, in which case the mesh is left untouched.
+	static bool load(const std::string& sourcePath, Mesh& mesh);
+};
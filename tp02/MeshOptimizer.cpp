@@ -0,0 +1,437 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "glm/glm.hpp"
+
+namespace {
+	//scoring constants from Tom Forsyth's article :
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	float computeVertexScore(int cachePosition, int remainingTriangles)
+	{
+		//no triangle left, the vertex isn't needed anymore :
+		if (remainingTriangles == 0)
+			return -1.f;
+
+		float score = 0.f;
+		if (cachePosition >= 0)
+		{
+			//the three vertices of the last triangle have a fixed score, to avoid using them again right away :
+			if (cachePosition < 3)
+				score = LAST_TRIANGLE_SCORE;
+			else
+				score = std::pow(1.f - (cachePosition - 3) / (float)(MeshOptimizer::VERTEX_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+		}
+
+		//boost the vertices with few triangles left, to finish them and avoid leaving lonely triangles :
+		score += VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+		return score;
+	}
+
+	const int MAX_SIMPLIFY_PASSES = 32;
+
+	//symmetric 4x4 matrix of the sum of the squared distances to a set of planes :
+	struct Quadric
+	{
+		double a2, ab, ac, ad;
+		double b2, bc, bd;
+		double c2, cd;
+		double d2;
+
+		Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0)
+		{}
+
+		void addPlane(const glm::vec3& normal, float distance, float weight)
+		{
+			double a = normal.x, b = normal.y, c = normal.z, d = distance;
+			a2 += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+			b2 += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+			c2 += weight * c * c; cd += weight * c * d;
+			d2 += weight * d * d;
+		}
+
+		void add(const Quadric& other)
+		{
+			a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+			b2 += other.b2; bc += other.bc; bd += other.bd;
+			c2 += other.c2; cd += other.cd;
+			d2 += other.d2;
+		}
+
+		double error(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+				+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+				+ c2 * z * z + 2 * cd * z
+				+ d2;
+		}
+	};
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double cost;
+
+		bool operator<(const Collapse& other) const
+		{
+			return cost < other.cost;
+		}
+	};
+
+	glm::vec3 getPosition(const float* positions, unsigned int vertex)
+	{
+		return glm::vec3(positions[vertex * 3], positions[vertex * 3 + 1], positions[vertex * 3 + 2]);
+	}
+
+	unsigned long long edgeKey(unsigned int a, unsigned int b)
+	{
+		return a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+	}
+}
+
+float MeshOptimizer::computeACMR(const std::vector<unsigned int>& indices, int cacheSize)
+{
+	if (indices.size() < 3)
+		return 0.f;
+
+	std::vector<unsigned int> cache;
+	int head = 0;
+	int missCount = 0;
+	for (int i = 0; i < indices.size(); i++)
+	{
+		if (std::find(cache.begin(), cache.end(), indices[i]) != cache.end())
+			continue;
+
+		missCount++;
+		if (cache.size() < cacheSize)
+		{
+			cache.push_back(indices[i]);
+		}
+		else
+		{
+			cache[head] = indices[i];
+			head = (head + 1) % cacheSize;
+		}
+	}
+
+	return missCount / (float)(indices.size() / 3);
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& indices, int vertexCount)
+{
+	const int triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	//triangles adjacent to each vertex, packed in a single array :
+	std::vector<int> adjacencyOffsets(vertexCount + 1, 0);
+	for (int i = 0; i < triangleCount * 3; i++)
+		adjacencyOffsets[indices[i] + 1]++;
+	for (int v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+	std::vector<int> adjacency(triangleCount * 3);
+	std::vector<int> remainingTriangles(vertexCount, 0);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[t * 3 + k];
+			adjacency[adjacencyOffsets[v] + remainingTriangles[v]] = t;
+			remainingTriangles[v]++;
+		}
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+		vertexScores[v] = computeVertexScore(-1, remainingTriangles[v]);
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> isEmitted(triangleCount, false);
+	for (int t = 0; t < triangleCount; t++)
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+	std::vector<unsigned int> newIndices;
+	newIndices.reserve(triangleCount * 3);
+
+	//the cache can temporarily hold the three vertices of the new triangle on top of the others :
+	std::vector<int> cache;
+	std::vector<int> newCache;
+	cache.reserve(VERTEX_CACHE_SIZE + 3);
+	newCache.reserve(VERTEX_CACHE_SIZE + 3);
+
+	int bestTriangle = -1;
+	int nextUnemitted = 0;
+
+	for (int emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		//no candidate around the cache : take the next triangle in the input order.
+		if (bestTriangle < 0)
+		{
+			while (isEmitted[nextUnemitted])
+				nextUnemitted++;
+			bestTriangle = nextUnemitted;
+		}
+
+		isEmitted[bestTriangle] = true;
+
+		//emit the triangle, and put its vertices at the front of the cache :
+		newCache.clear();
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[bestTriangle * 3 + k];
+			newIndices.push_back(v);
+			newCache.push_back(v);
+
+			//remove the triangle from the vertex adjacency :
+			int* begin = &adjacency[adjacencyOffsets[v]];
+			int* end = begin + remainingTriangles[v];
+			std::swap(*std::find(begin, end, bestTriangle), *(end - 1));
+			remainingTriangles[v]--;
+		}
+		for (int i = 0; i < cache.size(); i++)
+		{
+			int v = cache[i];
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+				newCache.push_back(v);
+		}
+
+		//vertices pushed out of the cache :
+		for (int i = VERTEX_CACHE_SIZE; i < newCache.size(); i++)
+		{
+			cachePositions[newCache[i]] = -1;
+			vertexScores[newCache[i]] = computeVertexScore(-1, remainingTriangles[newCache[i]]);
+		}
+		newCache.resize(std::min((int)newCache.size(), VERTEX_CACHE_SIZE));
+		std::swap(cache, newCache);
+
+		for (int i = 0; i < cache.size(); i++)
+		{
+			cachePositions[cache[i]] = i;
+			vertexScores[cache[i]] = computeVertexScore(i, remainingTriangles[cache[i]]);
+		}
+
+		//update the score of the triangles around the cache, and pick the best one for the next step :
+		bestTriangle = -1;
+		float bestScore = -1.f;
+		for (int i = 0; i < cache.size(); i++)
+		{
+			int v = cache[i];
+			for (int j = adjacencyOffsets[v]; j < adjacencyOffsets[v] + remainingTriangles[v]; j++)
+			{
+				int t = adjacency[j];
+				triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	indices.swap(newIndices);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<unsigned int>& indices, int vertexCount, std::vector<unsigned int>& remap)
+{
+	const unsigned int UNUSED = (unsigned int)-1;
+	remap.assign(vertexCount, UNUSED);
+
+	unsigned int nextVertex = 0;
+	for (int i = 0; i < indices.size(); i++)
+	{
+		if (remap[indices[i]] == UNUSED)
+			remap[indices[i]] = nextVertex++;
+		indices[i] = remap[indices[i]];
+	}
+
+	for (int v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == UNUSED)
+			remap[v] = nextVertex++;
+	}
+}
+
+void MeshOptimizer::simplify(const std::vector<unsigned int>& indices, const float* positions, int vertexCount, int targetIndexCount, std::vector<unsigned int>& outIndices)
+{
+	outIndices = indices;
+	if (outIndices.size() <= targetIndexCount || vertexCount == 0)
+		return;
+
+	//quadrics of the triangle planes, weighted by the triangle area :
+	std::vector<Quadric> quadrics(vertexCount);
+	for (int t = 0; t < outIndices.size() / 3; t++)
+	{
+		glm::vec3 a = getPosition(positions, outIndices[t * 3]);
+		glm::vec3 b = getPosition(positions, outIndices[t * 3 + 1]);
+		glm::vec3 c = getPosition(positions, outIndices[t * 3 + 2]);
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float doubleArea = glm::length(normal);
+		if (doubleArea <= 0.f)
+			continue;
+		normal /= doubleArea;
+
+		for (int k = 0; k < 3; k++)
+			quadrics[outIndices[t * 3 + k]].addPlane(normal, -glm::dot(normal, a), doubleArea * 0.5f);
+	}
+
+	//an edge used by a single triangle is on a border (or a seam, since split vertices aren't connected) :
+	std::unordered_map<unsigned long long, int> edgeUseCounts;
+	for (int t = 0; t < outIndices.size() / 3; t++)
+	{
+		for (int k = 0; k < 3; k++)
+			edgeUseCounts[edgeKey(outIndices[t * 3 + k], outIndices[t * 3 + (k + 1) % 3])]++;
+	}
+	std::vector<bool> isLocked(vertexCount, false);
+	for (int t = 0; t < outIndices.size() / 3; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int a = outIndices[t * 3 + k];
+			unsigned int b = outIndices[t * 3 + (k + 1) % 3];
+			if (edgeUseCounts[edgeKey(a, b)] == 1)
+			{
+				isLocked[a] = true;
+				isLocked[b] = true;
+			}
+		}
+	}
+
+	std::vector<int> adjacencyOffsets(vertexCount + 1);
+	std::vector<int> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<bool> isTouched(vertexCount);
+
+	for (int pass = 0; pass < MAX_SIMPLIFY_PASSES && outIndices.size() > targetIndexCount; pass++)
+	{
+		const int triangleCount = outIndices.size() / 3;
+
+		//triangles around each vertex :
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (int i = 0; i < triangleCount * 3; i++)
+			adjacencyOffsets[outIndices[i] + 1]++;
+		for (int v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		adjacency.resize(triangleCount * 3);
+		std::vector<int> fillCounts(vertexCount, 0);
+		for (int t = 0; t < triangleCount; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = outIndices[t * 3 + k];
+				adjacency[adjacencyOffsets[v] + fillCounts[v]++] = t;
+			}
+		}
+
+		//cost of moving each free vertex onto one of its neighbours :
+		collapses.clear();
+		for (int t = 0; t < triangleCount; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = outIndices[t * 3 + k];
+				unsigned int b = outIndices[t * 3 + (k + 1) % 3];
+				if (a == b)
+					continue;
+
+				Quadric quadric = quadrics[a];
+				quadric.add(quadrics[b]);
+
+				if (!isLocked[a])
+				{
+					Collapse collapse = { a, b, quadric.error(getPosition(positions, b)) };
+					collapses.push_back(collapse);
+				}
+				if (!isLocked[b])
+				{
+					Collapse collapse = { b, a, quadric.error(getPosition(positions, a)) };
+					collapses.push_back(collapse);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		for (int v = 0; v < vertexCount; v++)
+			remap[v] = v;
+		std::fill(isTouched.begin(), isTouched.end(), false);
+
+		//apply the cheapest collapses, with at most one change around each vertex per pass :
+		const int trianglesToRemove = (outIndices.size() - targetIndexCount + 2) / 3;
+		int removedTriangles = 0;
+		int collapseCount = 0;
+		for (int i = 0; i < collapses.size() && removedTriangles < trianglesToRemove; i++)
+		{
+			const unsigned int from = collapses[i].from;
+			const unsigned int to = collapses[i].to;
+			if (isTouched[from] || isTouched[to])
+				continue;
+
+			const glm::vec3 fromPosition = getPosition(positions, from);
+			const glm::vec3 toPosition = getPosition(positions, to);
+
+			bool isFlipping = false;
+			int collapsedTriangles = 0;
+			for (int j = adjacencyOffsets[from]; j < adjacencyOffsets[from + 1] && !isFlipping; j++)
+			{
+				const unsigned int* triangle = &outIndices[adjacency[j] * 3];
+				if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+				{
+					collapsedTriangles++;
+					continue;
+				}
+
+				//the two other vertices, in the winding order of the triangle :
+				int k = triangle[0] == from ? 0 : (triangle[1] == from ? 1 : 2);
+				glm::vec3 b = getPosition(positions, triangle[(k + 1) % 3]);
+				glm::vec3 c = getPosition(positions, triangle[(k + 2) % 3]);
+				glm::vec3 oldNormal = glm::cross(b - fromPosition, c - fromPosition);
+				glm::vec3 newNormal = glm::cross(b - toPosition, c - toPosition);
+				isFlipping = glm::dot(oldNormal, newNormal) <= 0.f;
+			}
+			if (isFlipping)
+				continue;
+
+			remap[from] = to;
+			quadrics[to].add(quadrics[from]);
+			removedTriangles += collapsedTriangles;
+			collapseCount++;
+
+			//the triangles around the collapsed vertex have changed, keep their vertices for the next pass :
+			for (int j = adjacencyOffsets[from]; j < adjacencyOffsets[from + 1]; j++)
+			{
+				for (int k = 0; k < 3; k++)
+					isTouched[outIndices[adjacency[j] * 3 + k]] = true;
+			}
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		//rebuild the index buffer without the degenerated triangles :
+		int writeIndex = 0;
+		for (int t = 0; t < triangleCount; t++)
+		{
+			unsigned int a = remap[outIndices[t * 3]];
+			unsigned int b = remap[outIndices[t * 3 + 1]];
+			unsigned int c = remap[outIndices[t * 3 + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+
+			outIndices[writeIndex++] = a;
+			outIndices[writeIndex++] = b;
+			outIndices[writeIndex++] = c;
+		}
+		outIndices.resize(writeIndex);
+	}
+}
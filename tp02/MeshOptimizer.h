@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+//Import time optimizations of the index and vertex buffers of a sub mesh.
+//The indices given to these functions are local to the sub mesh : in [0, vertexCount[.
+class MeshOptimizer
+{
+public:
+	//size of the post transform cache targeted by the triangle reordering, and simulated by computeACMR :
+	static const int VERTEX_CACHE_SIZE = 32;
+
+	//average cache miss ratio : number of transformed vertices per triangle, simulated with a FIFO cache.
+	//3 is the worst case, ~0.5 the best possible for a regular grid.
+	static float computeACMR(const std::vector<unsigned int>& indices, int cacheSize = VERTEX_CACHE_SIZE);
+
+	//reorder the triangles to maximize the post transform cache reuse (Tom Forsyth's linear speed algorithm).
+	static void optimizeVertexCache(std::vector<unsigned int>& indices, int vertexCount);
+
+	//reorder the vertices by first use in the index buffer, for the vertex fetch locality. The indices are updated.
+	//remap[oldVertex] = newVertex, unused vertices are moved at the end.
+	static void optimizeVertexFetch(std::vector<unsigned int>& indices, int vertexCount, std::vector<unsigned int>& remap);
+
+	//quadric error edge collapse simplification, until the index count is under targetIndexCount or nothing can be collapsed anymore.
+	//positions : three floats per vertex of the sub mesh. Vertices are only moved onto existing vertices, so the result uses the same vertex buffer.
+	//Border vertices (including uv and normal seams) are locked, and collapses which flip a triangle are rejected.
+	static void simplify(const std::vector<unsigned int>& indices, const float* positions, int vertexCount, int targetIndexCount, std::vector<unsigned int>& outIndices);
+
+	//apply a remap given by optimizeVertexFetch to a stream of componentCount values per vertex, starting at vertex firstVertex.
+	template<typename T>
+	static void remapStream(std::vector<T>& stream, int componentCount, int firstVertex, const std::vector<unsigned int>& remap);
+};
+
+template<typename T>
+void MeshOptimizer::remapStream(std::vector<T>& stream, int componentCount, int firstVertex, const std::vector<unsigned int>& remap)
+{
+	const int begin = firstVertex * componentCount;
+	if (stream.size() < begin + remap.size() * componentCount)
+		return;
+
+	std::vector<T> oldValues(stream.begin() + begin, stream.begin() + begin + remap.size() * componentCount);
+	for (int i = 0; i < remap.size(); i++)
+	{
+		for (int c = 0; c < componentCount; c++)
+			stream[begin + remap[i] * componentCount + c] = oldValues[i * componentCount + c];
+	}
+}
@@ -2,8 +2,11 @@
 #include "Scene.h"
 #include "Entity.h"
 #include "Factories.h"
+#include "Application.h"
+#include "CpuSkinning.h"
+#include "Frustum.h"
 
-MeshRenderer::MeshRenderer() : Component(MESH_RENDERER), mesh(MeshFactory::get().get("default")), meshName("default"), materialName("default")
+MeshRenderer::MeshRenderer() : Component(MESH_RENDERER), mesh(MeshFactory::get().get("default")), meshName("default"), materialName("default"), currentLod(0), lodScreenSize(0.5f), lodHysteresis(0.1f), shadowLodBias(1), staticShadowCaster(false), isSkinnedBVHBuilt(false), lastCpuSkinningTime(-1.f), cpuSkinningPeriod(0.1f)
 {
 	if(mesh != nullptr)
 		meshName = mesh->name;
@@ -12,7 +15,7 @@ MeshRenderer::MeshRenderer() : Component(MESH_RENDERER), mesh(MeshFactory::get()
 	material.push_back(MaterialFactory::get().get<Material3DObject>("default"));
 }
 
-MeshRenderer::MeshRenderer(Mesh* _mesh, Material3DObject* _material) : Component(MESH_RENDERER), mesh(_mesh), meshName("default"), materialName("default")
+MeshRenderer::MeshRenderer(Mesh* _mesh, Material3DObject* _material) : Component(MESH_RENDERER), mesh(_mesh), meshName("default"), materialName("default"), currentLod(0), lodScreenSize(0.5f), lodHysteresis(0.1f), shadowLodBias(1), staticShadowCaster(false), isSkinnedBVHBuilt(false), lastCpuSkinningTime(-1.f), cpuSkinningPeriod(0.1f)
 {
 	if (mesh != nullptr)
 		meshName = mesh->name;
@@ -87,8 +90,29 @@ void MeshRenderer::drawUI(Scene& scene)
 		if (MeshFactory::get().contains(tmpMeshName))
 		{
 			setMesh(MeshFactory::get().get(tmpMeshName));
+			scene.updateSpatialProxy(this);
 		}
 	}
+
+	if (mesh != nullptr && mesh->lodCount > 1)
+	{
+		int lodTriangleCount = 0;
+		for (int i = 0; i < mesh->subMeshCount; i++)
+			lodTriangleCount += mesh->getTriangleCount(i, currentLod);
+		ImGui::Text("lod : %d / %d, %d triangles", currentLod, mesh->lodCount - 1, lodTriangleCount);
+		ImGui::SliderFloat("lod screen size", &lodScreenSize, 0.01f, 2.f);
+		ImGui::SliderFloat("lod hysteresis", &lodHysteresis, 0.f, 0.5f);
+		ImGui::SliderInt("shadow lod bias", &shadowLodBias, 0, mesh->lodCount - 1);
+	}
+
+	ImGui::Checkbox("static shadow caster", &staticShadowCaster);
+
+	if (mesh != nullptr && mesh->getIsSkeletalMesh())
+	{
+		ImGui::SliderFloat("cpu skinning period", &cpuSkinningPeriod, 0.f, 1.f);
+		if (ImGui::Button("cover collider with pose"))
+			coverColliderWithPose();
+	}
 }
 
 void MeshRenderer::eraseFromScene(Scene & scene)
@@ -127,6 +151,12 @@ void MeshRenderer::setMesh(Mesh* _mesh)
 
 	mesh = _mesh;
 
+	skinnedVertices.clear();
+	skinnedNormals.clear();
+	skinnedBVH.clear();
+	isSkinnedBVHBuilt = false;
+	lastCpuSkinningTime = -1.f;
+
 	if (m_entity != nullptr)
 	{
 		auto collider = static_cast<Collider*>(m_entity->getComponent(Component::COLLIDER));
@@ -189,25 +219,40 @@ glm::vec3 MeshRenderer::getOrigin() const
 	return mesh->origin;
 }
 
-void MeshRenderer::render(const glm::mat4 & projection, const glm::mat4 & view)
+void MeshRenderer::prepareDraw(const glm::mat4& projection, const glm::mat4& view, glm::mat4& mvp, glm::mat4& normalMatrix)
 {
 	glm::mat4 modelMatrix = entity()->getModelMatrix(); //get modelMatrix
-	glm::mat4 normalMatrix = glm::transpose(glm::inverse(modelMatrix));
-	glm::mat4 mvp = projection * view * modelMatrix;
+	normalMatrix = glm::transpose(glm::inverse(modelMatrix));
+	mvp = projection * view * modelMatrix;
+
+	updateLod(projection, view, modelMatrix);
+}
 
+Material3DObject* MeshRenderer::getSubMeshMaterial(int subMeshIdx) const
+{
+	if (material.empty())
+		return nullptr;
+
+	return subMeshIdx < material.size() ? material[subMeshIdx] : material.back();
+}
+
+void MeshRenderer::render(const glm::mat4 & projection, const glm::mat4 & view)
+{
+	glm::mat4 normalMatrix;
+	glm::mat4 mvp;
+	prepareDraw(projection, view, mvp, normalMatrix);
+
+	//the bone palette of this instance is already bound by the renderer.
 	int minMatMeshCount = std::min((int)material.size(), mesh->subMeshCount);
 	for (int i = 0; i < minMatMeshCount; i++)
 	{
 		material[i]->use();
 		material[i]->setUniform_MVP(mvp);
 		material[i]->setUniform_normalMatrix(normalMatrix);
-		if (mesh->getIsSkeletalMesh()) {
-			for (int boneIdx = 0; boneIdx < mesh->getSkeleton()->getBoneCount(); boneIdx++)
-				material[i]->setUniformBonesTransform(boneIdx, mesh->getSkeleton()->getBoneTransform(boneIdx));
-		}
 		material[i]->setUniformUseSkeleton(mesh->getIsSkeletalMesh());
+		material[i]->setUniformUseInstancing(false);
 
-		mesh->draw(i);	
+		mesh->draw(i, currentLod);	
 	}
 	//if there are more sub mesh than materials draw them with the last material
 	for (int i = minMatMeshCount; i < mesh->subMeshCount; i++)
@@ -215,21 +260,193 @@ void MeshRenderer::render(const glm::mat4 & projection, const glm::mat4 & view)
 		material.back()->use();
 		material.back()->setUniform_MVP(mvp);
 		material.back()->setUniform_normalMatrix(normalMatrix);
-		if (mesh->getIsSkeletalMesh())
-			for (int boneIdx = 0; boneIdx < mesh->getSkeleton()->getBoneCount(); boneIdx++)
-				material[i]->setUniformBonesTransform(boneIdx, mesh->getSkeleton()->getBoneTransform(boneIdx));
-		material[i]->setUniformUseSkeleton(mesh->getIsSkeletalMesh());
+		material.back()->setUniformUseSkeleton(mesh->getIsSkeletalMesh());
+		material.back()->setUniformUseInstancing(false);
 
-		mesh->draw(i);
+		mesh->draw(i, currentLod);
 	}
 }
 
+const std::vector<glm::mat4>& MeshRenderer::getBonesTransform()
+{
+	//each animated instance has its own pose :
+	Animator* animator = getComponent<Animator>(Component::ComponentType::ANIMATOR);
+	if (animator != nullptr && animator->getSkeleton() == mesh->getSkeleton() && animator->getBonesTransform().size() == mesh->getSkeleton()->getBoneCount())
+		return animator->getBonesTransform();
+
+	return mesh->getSkeleton()->getBonesTransform();
+}
+
+void MeshRenderer::updateCpuSkinning(bool force)
+{
+	if (mesh == nullptr || !mesh->getIsSkeletalMesh() || mesh->getSkeleton() == nullptr)
+		return;
+
+	float time = (float)Application::get().getTime();
+	if (!force && lastCpuSkinningTime >= 0.f && time - lastCpuSkinningTime < cpuSkinningPeriod && skinnedVertices.size() == mesh->vertices.size())
+		return;
+
+	CpuSkinning::skin(mesh->vertices, mesh->normals, mesh->getSkeleton()->getBoneDatas(), getBonesTransform(), skinnedVertices, skinnedNormals);
+	lastCpuSkinningTime = time;
+	isSkinnedBVHBuilt = false;
+}
+
+const std::vector<float>& MeshRenderer::getDeformedVertices() const
+{
+	if (mesh->getIsSkeletalMesh() && skinnedVertices.size() == mesh->vertices.size())
+		return skinnedVertices;
+	return mesh->vertices;
+}
+
+const std::vector<float>& MeshRenderer::getDeformedNormals() const
+{
+	if (mesh->getIsSkeletalMesh() && skinnedVertices.size() == mesh->vertices.size())
+		return skinnedNormals;
+	return mesh->normals;
+}
+
+void MeshRenderer::getDeformedBounds(glm::vec3& min, glm::vec3& max)
+{
+	if (!mesh->getIsSkeletalMesh() || mesh->coordCountByVertex != 3)
+	{
+		min = mesh->bottomLeft;
+		max = mesh->topRight;
+		return;
+	}
+
+	updateCpuSkinning();
+	const std::vector<float>& vertices = getDeformedVertices();
+	if (vertices.size() < 3)
+	{
+		min = mesh->bottomLeft;
+		max = mesh->topRight;
+		return;
+	}
+
+	min = max = glm::vec3(vertices[0], vertices[1], vertices[2]);
+	for (int i = 3; i + 2 < vertices.size(); i += 3)
+	{
+		glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+		min = glm::min(min, position);
+		max = glm::max(max, position);
+	}
+}
+
+void MeshRenderer::getBounds(glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	Frustum::transformAABB(mesh->bottomLeft, mesh->topRight, entity()->getModelMatrix(), boundsMin, boundsMax);
+
+	if (mesh->getIsSkeletalMesh())
+	{
+		glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		float radius = glm::length(boundsMax - boundsMin) * 0.5f;
+		boundsMin = center - glm::vec3(radius);
+		boundsMax = center + glm::vec3(radius);
+	}
+}
+
+void MeshRenderer::coverColliderWithPose()
+{
+	if (m_entity == nullptr || mesh == nullptr)
+		return;
+
+	auto collider = static_cast<Collider*>(m_entity->getComponent(Component::COLLIDER));
+	if (collider == nullptr)
+		return;
+
+	//the pose is evaluated now, whatever the throttling :
+	updateCpuSkinning(true);
+	glm::vec3 min, max;
+	getDeformedBounds(min, max);
+	collider->cover(min, max, (min + max) * 0.5f);
+}
+
+bool MeshRenderer::isIntersectedByRay(const Ray& ray, MeshRayHit& hit)
+{
+	if (!mesh->getIsSkeletalMesh())
+		return mesh->isIntersectedByRay(ray, hit);
+
+	if (mesh->primitiveType != GL_TRIANGLES || mesh->coordCountByVertex != 3)
+		return false;
+
+	updateCpuSkinning();
+	if (!isSkinnedBVHBuilt)
+	{
+		//only the full resolution level, as Mesh::buildBVH :
+		if (Mesh::USE_INDEX & mesh->vbo_usage)
+			skinnedBVH.build(getDeformedVertices(), mesh->getFullResolutionIndices());
+		else
+			skinnedBVH.build(getDeformedVertices(), std::vector<int>());
+		isSkinnedBVHBuilt = true;
+	}
+
+	return skinnedBVH.intersect(ray, hit);
+}
+
+void MeshRenderer::updateLod(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& modelMatrix)
+{
+	if (mesh->lodCount <= 1)
+	{
+		currentLod = 0;
+		return;
+	}
+	currentLod = glm::clamp(currentLod, 0, mesh->lodCount - 1);
+
+	//bounding sphere of the mesh, in view space :
+	glm::vec3 scale(glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2])));
+	float radius = glm::length(mesh->topRight - mesh->bottomLeft) * 0.5f * std::max(scale.x, std::max(scale.y, scale.z));
+	glm::vec4 center = view * modelMatrix * glm::vec4((mesh->topRight + mesh->bottomLeft) * 0.5f, 1.f);
+	float distance = -center.z;
+
+	//inside the sphere : full resolution.
+	if (distance <= radius)
+	{
+		currentLod = 0;
+		return;
+	}
+	float screenSize = radius * projection[1][1] / distance;
+
+	//level lod is used under lodScreenSize / 2^(lod-1), with a margin to leave the current level :
+	while (currentLod < mesh->lodCount - 1 && screenSize < lodScreenSize * std::pow(0.5f, (float)currentLod) * (1.f - lodHysteresis))
+		currentLod++;
+	while (currentLod > 0 && screenSize > lodScreenSize * std::pow(0.5f, (float)(currentLod - 1)) * (1.f + lodHysteresis))
+		currentLod--;
+}
+
+int MeshRenderer::getCurrentLod() const
+{
+	return currentLod;
+}
+
+int MeshRenderer::getShadowLod() const
+{
+	if (mesh == nullptr)
+		return 0;
+	return std::min(currentLod + shadowLodBias, mesh->lodCount - 1);
+}
+
+bool MeshRenderer::isStaticShadowCaster() const
+{
+	return staticShadowCaster && mesh != nullptr && !mesh->getIsSkeletalMesh();
+}
+
+void MeshRenderer::setStaticShadowCaster(bool state)
+{
+	staticShadowCaster = state;
+}
+
 void MeshRenderer::save(Json::Value & rootComponent) const
 {
 	Component::save(rootComponent);
 
 	rootComponent["meshName"] = mesh->name;
 
+	rootComponent["lodScreenSize"] = lodScreenSize;
+	rootComponent["lodHysteresis"] = lodHysteresis;
+	rootComponent["shadowLodBias"] = shadowLodBias;
+	rootComponent["staticShadowCaster"] = staticShadowCaster;
+	rootComponent["cpuSkinningPeriod"] = cpuSkinningPeriod;
+
 	rootComponent["materialCount"] = material.size();
 	for (int i = 0; i < material.size(); i++)
 		rootComponent["materialName"][i] = material[i]->name;
@@ -241,6 +458,13 @@ void MeshRenderer::load(Json::Value & rootComponent)
 
 	meshName = rootComponent.get("meshName", "").asString();
 	mesh = MeshFactory::get().get(meshName);
+	lastCpuSkinningTime = -1.f;
+
+	lodScreenSize = rootComponent.get("lodScreenSize", 0.5f).asFloat();
+	lodHysteresis = rootComponent.get("lodHysteresis", 0.1f).asFloat();
+	shadowLodBias = rootComponent.get("shadowLodBias", 1).asInt();
+	staticShadowCaster = rootComponent.get("staticShadowCaster", false).asBool();
+	cpuSkinningPeriod = rootComponent.get("cpuSkinningPeriod", 0.1f).asFloat();
 
 	int materialCount = rootComponent.get("materialCount", 0).asInt();
 	material.clear();
@@ -7,6 +7,7 @@
 #include "imgui/imgui_impl_glfw_gl3.h"
 
 #include "Component.h"
+#include "MeshBVH.h"
 
 //forward
 class Entity;
@@ -21,6 +22,23 @@ private:
 	std::string meshName;
 	std::string materialName;
 
+	//level of detail :
+	int currentLod;
+	float lodScreenSize; //projected size (diameter / screen height) under which the first simplified level is used, halved for each next level
+	float lodHysteresis; //relative margin around the thresholds, to avoid popping back and forth
+	int shadowLodBias; //shadow passes use coarser levels
+
+	//static shadow casters are rendered once in the cached shadow maps, until they or the light change :
+	bool staticShadowCaster;
+
+	//cpu skinning, only computed when the deformed shape is queried (picking, collider fitting) :
+	std::vector<float> skinnedVertices;
+	std::vector<float> skinnedNormals;
+	MeshBVH skinnedBVH;
+	bool isSkinnedBVHBuilt;
+	float lastCpuSkinningTime; //negative if the skinned vertices are out of date
+	float cpuSkinningPeriod; //minimum delay in seconds between two cpu skinnings of the instance, the previous shape is reused in between
+
 public:
 	MeshRenderer();
 	MeshRenderer(Mesh* _mesh, Material3DObject* _material);
@@ -47,8 +65,41 @@ public:
 	glm::vec3 getOrigin() const;
 
 	void render(const glm::mat4& projection, const glm::mat4& view);
+	//select the level of detail and compute the matrices of the instance, before drawing its sub meshes (see render and RenderQueue).
+	void prepareDraw(const glm::mat4& projection, const glm::mat4& view, glm::mat4& mvp, glm::mat4& normalMatrix);
+	//material used to draw a sub mesh : the last material is used for the sub meshes without material. nullptr if there is no material.
+	Material3DObject* getSubMeshMaterial(int subMeshIdx) const;
+
+	//pose of the animator of the entity, or the bind pose of the skeleton if the entity isn't animated. The mesh must be a skeletal mesh.
+	const std::vector<glm::mat4>& getBonesTransform();
+
+	//skin the mesh on the cpu with the current pose, unless it was done less than cpuSkinningPeriod ago. Does nothing for non skeletal meshes.
+	void updateCpuSkinning(bool force = false);
+	//vertices and normals of the mesh in its current pose (the mesh datas if the mesh isn't skeletal). Call updateCpuSkinning before.
+	const std::vector<float>& getDeformedVertices() const;
+	const std::vector<float>& getDeformedNormals() const;
+	//bounds of the mesh in its current pose, in model space :
+	void getDeformedBounds(glm::vec3& min, glm::vec3& max);
+	//bounds of the mesh in world space. Skeletal meshes use the box around the sphere of their bind pose bounds, which the animations can leave.
+	void getBounds(glm::vec3& boundsMin, glm::vec3& boundsMax);
+	//resize the collider of the entity to the current pose of the mesh :
+	void coverColliderWithPose();
+	//ray cast against the mesh in its current pose. The ray is in model space.
+	bool isIntersectedByRay(const Ray& ray, MeshRayHit& hit);
+
+	int getCurrentLod() const;
+	//level used by the shadow passes, based on the level selected for the camera.
+	int getShadowLod() const;
+
+	//skeletal meshes are animated, they are never static shadow casters.
+	bool isStaticShadowCaster() const;
+	void setStaticShadowCaster(bool state);
 
 	virtual void save(Json::Value& rootComponent) const override;
 	virtual void load(Json::Value& rootComponent) override;
+
+private:
+	//select the level of detail from the projected size of the mesh bounds :
+	void updateLod(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& modelMatrix);
 };
 
@@ -2,6 +2,7 @@
 //forwards : 
 #include "Factories.h"
 #include "Materials.h"
+#include "GLStateCache.h"
 
 OctreeDrawer::OctreeDrawer() : material(MaterialFactory::get().get<MaterialInstancedUnlit>("wireframeInstanced"))
 {
@@ -56,7 +57,7 @@ void OctreeDrawer::initGl()
 	triangleCount = triangleIndex.size() / 3;
 
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	GLStateCache::get().bindVertexArray(vao);
 
 
 	glGenBuffers(1, &vbo_index);
@@ -81,7 +82,7 @@ void OctreeDrawer::initGl()
 	glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
 	glVertexAttribPointer(SIZES, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 3, (void*)0);
 
-	glBindVertexArray(0);
+	GLStateCache::get().bindVertexArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
@@ -141,7 +142,7 @@ void OctreeDrawer::draw()
 
 	int instanceCount = positions.size() / 3.f;
 
-	glBindVertexArray(vao);
+	GLStateCache::get().bindVertexArray(vao);
 
 	glVertexAttribDivisor(VERTICES, 0);
 	glVertexAttribDivisor(POSITIONS, 1);
@@ -149,5 +150,5 @@ void OctreeDrawer::draw()
 
 	glDrawElementsInstanced(GL_LINE_STRIP, triangleCount * 3, GL_UNSIGNED_INT, (GLvoid*)0, instanceCount);
 
-	glBindVertexArray(0);
+	GLStateCache::get().bindVertexArray(0);
 }
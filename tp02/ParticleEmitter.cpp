@@ -2,13 +2,14 @@
 #include "Scene.h"
 #include "Entity.h"
 #include "Factories.h"
+#include "GLStateCache.h"
 
 namespace Physic {
 
 
 	ParticleEmitter::ParticleEmitter() : Component(PARTICLE_EMITTER), 
 	m_maxParticleCount(10), m_aliveParticlesCount(0), m_lifeTimeInterval(3,5), m_initialVelocityInterval(0.1f, 0.5f), m_spawnFragment(0), m_particleCountBySecond(10), m_emitInShape(false), m_sortParticles(false),
-	m_translation(glm::vec3(0,0,0)), m_scale(1,1,1),
+	m_translation(glm::vec3(0,0,0)), m_scale(1,1,1), m_boundsMin(0,0,0), m_boundsMax(0,0,0),
 	m_materialParticules(MaterialFactory::get().get<MaterialParticlesCPU>("particlesCPU")),
 	//m_materialParticuleSimulation(MaterialFactory::get().get<MaterialParticleSimulation>("particleSimulation")),
 	m_triangleIndex({ 0, 1, 2, 2, 3, 0 }),
@@ -51,7 +52,7 @@ namespace Physic {
 		m_triangleCount = m_triangleIndex.size() / 3;
 
 		glGenVertexArrays(1, &m_vao);
-		glBindVertexArray(m_vao);
+		GLStateCache::get().bindVertexArray(m_vao);
 
 		glGenBuffers(1, &m_index);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index);
@@ -96,7 +97,7 @@ namespace Physic {
 		glVertexAttribPointer(SIZES, 2, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 2, (void*)0);
 
 
-		glBindVertexArray(0);
+		GLStateCache::get().bindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 		
@@ -247,6 +248,8 @@ namespace Physic {
 
 		//update particles : 
 		assert((m_aliveParticlesCount <= m_maxParticleCount));
+		m_boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		m_boundsMax = glm::vec3(-std::numeric_limits<float>::max());
 		for (int i = 0; i < m_aliveParticlesCount; i++)
 		{
 			assert(m_maxParticleCount == m_elapsedTimes.size());
@@ -282,6 +285,11 @@ namespace Physic {
 				assert(m_maxParticleCount == m_sizes.size());
 				m_sizes[i] = getInternalParticleSize(m_elapsedTimes[i], m_lifeTimes[i], m_positions[i]);
 
+				//a billboard stays in the sphere of its half diagonal :
+				float particleRadius = glm::length(m_sizes[i]) * 0.5f;
+				m_boundsMin = glm::min(m_boundsMin, m_positions[i] - glm::vec3(particleRadius));
+				m_boundsMax = glm::max(m_boundsMax, m_positions[i] + glm::vec3(particleRadius));
+
 				//update distance to camera : 
 				m_distanceToCamera[i] = glm::distance(m_positions[i], cameraPosition);
 			}
@@ -293,6 +301,16 @@ namespace Physic {
 		updateVbos();
 	}
 
+	bool ParticleEmitter::getBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const
+	{
+		if (m_aliveParticlesCount <= 0)
+			return false;
+
+		boundsMin = m_boundsMin;
+		boundsMax = m_boundsMax;
+		return true;
+	}
+
 	void ParticleEmitter::sortParticles() 
 	{
 		sorting_quickSort(0, m_aliveParticlesCount-1);
@@ -308,8 +326,8 @@ namespace Physic {
 
 		m_materialParticules->use();
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, m_particleTexture->glId);
+		GLStateCache::get().activeTexture(GL_TEXTURE0);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_particleTexture->glId);
 
 		m_materialParticules->glUniform_VP(VP);
 		m_materialParticules->setUniformCameraRight(CameraRight);
@@ -321,7 +339,7 @@ namespace Physic {
 
 	void ParticleEmitter::draw()
 	{
-		glBindVertexArray(m_vao);
+		GLStateCache::get().bindVertexArray(m_vao);
 
 
 		glVertexAttribDivisor(VERTICES, 0);
@@ -333,7 +351,7 @@ namespace Physic {
 
 		glDrawElementsInstanced(GL_TRIANGLES, m_triangleCount * 3, GL_UNSIGNED_INT, (GLvoid*)0, m_aliveParticlesCount);
 
-		glBindVertexArray(0);
+		GLStateCache::get().bindVertexArray(0);
 
 	}
 
@@ -55,6 +55,9 @@ namespace Physic{
 		std::vector<glm::vec4> m_colors;
 		std::vector<glm::vec2> m_sizes;
 		std::vector<float> m_distanceToCamera;
+		//bounds of the alive particles at the last update, in world space :
+		glm::vec3 m_boundsMin;
+		glm::vec3 m_boundsMax;
 
 		//model :
 		int m_triangleCount;
@@ -95,6 +98,8 @@ namespace Physic{
 		void draw();
 		void updateVbos();
 		void onChangeMaxParticleCount();
+		//bounds of the alive particles, with their size. Return false if there is no alive particle.
+		bool getBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const;
 
 		//TODO
 
@@ -1,6 +1,7 @@
 #include "Project.h"
 //forwards : 
 #include "DebugDrawer.h"
+#include "GLStateCache.h"
 
 void onWindowResize(GLFWwindow* window, int width, int height)
 {
@@ -253,12 +254,19 @@ void Project::edit()
 		t = glfwGetTime();
 		ImGui_ImplGlfwGL3_NewFrame();
 
+		//the GL state may have been changed out of the cache since the last frame, the counters measure this frame :
+		GLStateCache::get().invalidate();
+		GLStateCache::get().resetStats();
+
 		//get main camera : 
 		BaseCamera& currentCamera = editor.getCamera();
 		//get active camera before render scene : 
 		//currentCamera.updateScreenSize(width, height);
 		//scene.culling(currentCamera);
 
+		//finish the background imports : 
+		MeshFactory::get().updateAsyncImports();
+
 		//Physics : 
 		scene->updatePhysic(Application::get().getFixedDeltaTime(), currentCamera, editor.getIsPlaying());
 
@@ -274,7 +282,7 @@ void Project::edit()
 		//Update behaviours :
 		if (editor.getIsPlaying()) {
 			scene->updateControllers(Application::get().getFixedDeltaTime());
-			scene->updateAnimations(Application::get().getTime());
+			scene->updateAnimations(Application::get().getTime(), Application::get().getDeltaTime(), currentCamera);
 			scene->updateBehaviours();
 		}
 
@@ -298,7 +306,7 @@ void Project::edit()
 		DebugDrawer::render(currentCamera.getProjectionMatrix(), currentCamera.getViewMatrix());
 		DebugDrawer::clear();
 
-		glDisable(GL_DEPTH_TEST);
+		GLStateCache::get().disable(GL_DEPTH_TEST);
 		editor.renderGizmo();
 
 
@@ -316,8 +324,10 @@ void Project::edit()
 		editor.renderUI(*this);
 
 		ImGui::Render();
+		//ImGui changes the GL state without the cache :
+		GLStateCache::get().invalidate();
 
-		glDisable(GL_BLEND);
+		GLStateCache::get().disable(GL_BLEND);
 #endif
 
 
@@ -884,7 +894,7 @@ void Project::initDefaultAssets()
 	GLuint diffuseTexture;
 	glGenTextures(1, &diffuseTexture);
 
-	glBindTexture(GL_TEXTURE_2D, diffuseTexture);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, diffuseTexture);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, x, y, 0, GL_RGB, GL_UNSIGNED_BYTE, diffuse);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -896,7 +906,7 @@ void Project::initDefaultAssets()
 	GLuint specularTexture;
 	glGenTextures(1, &specularTexture);
 
-	glBindTexture(GL_TEXTURE_2D, specularTexture);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, specularTexture);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, x, y, 0, GL_RGB, GL_UNSIGNED_BYTE, specular);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -978,4 +988,5 @@ void Project::initProject()
 	m_renderer = new Renderer(lightManager, "aogl.vert", "aogl_gPass.frag", "aogl_lightPass.vert", "aogl_lightPass_pointLight.frag", "aogl_lightPass_directionalLight.frag", "aogl_lightPass_spotLight.frag"); // call lightManager.init()
 	m_renderer->initPostProcessQuad("blit.vert", "blit.frag");
 	m_renderer->initialyzeShadowMapping("shadowPass.vert", "shadowPass.frag", "shadowPassOmni.vert", "shadowPassOmni.frag", "shadowPassOmni.geom");
+	m_renderer->initTiledLighting("aogl_lightPass.vert", "aogl_lightPass_tiledPointLight.frag");
 }
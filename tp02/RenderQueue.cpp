@@ -0,0 +1,272 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+//forwards :
+#include "MeshRenderer.h"
+#include "Entity.h"
+#include "Mesh.h"
+#include "Materials.h"
+#include "BonePaletteBuffer.h"
+#include "InstanceBuffer.h"
+#include "GLStateCache.h"
+
+namespace {
+	const int PASS_SHIFT = 62;
+	const int PROGRAM_SHIFT = 52;
+	const int MATERIAL_SHIFT = 38;
+	const int MESH_SHIFT = 24;
+	const int SUB_MESH_SHIFT = 18;
+	const int LOD_SHIFT = 15;
+
+	const uint64_t PASS_MASK = (1ull << 2) - 1;
+	const uint64_t PROGRAM_MASK = (1ull << 10) - 1;
+	const uint64_t MATERIAL_MASK = (1ull << 14) - 1;
+	const uint64_t MESH_MASK = (1ull << 14) - 1;
+	const uint64_t SUB_MESH_MASK = (1ull << 6) - 1;
+	const uint64_t LOD_MASK = (1ull << 3) - 1;
+	const uint64_t DEPTH_MASK = (1ull << 15) - 1;
+
+	uint64_t makeKey(int pass, int programId, int materialId, int meshId, int subMeshIdx, int lod, float depth01)
+	{
+		uint64_t depth = (uint64_t)(glm::clamp(depth01, 0.f, 1.f) * DEPTH_MASK);
+
+		return (std::min((uint64_t)pass, PASS_MASK) << PASS_SHIFT)
+			| (std::min((uint64_t)programId, PROGRAM_MASK) << PROGRAM_SHIFT)
+			| (std::min((uint64_t)materialId, MATERIAL_MASK) << MATERIAL_SHIFT)
+			| (std::min((uint64_t)meshId, MESH_MASK) << MESH_SHIFT)
+			| (std::min((uint64_t)subMeshIdx, SUB_MESH_MASK) << SUB_MESH_SHIFT)
+			| (std::min((uint64_t)std::max(lod, 0), LOD_MASK) << LOD_SHIFT)
+			| depth;
+	}
+}
+
+RenderQueueInstance::RenderQueueInstance(MeshRenderer* _meshRenderer, int _bonePaletteOffset) : meshRenderer(_meshRenderer), lod(0), isSkinned(false), bonePaletteOffset(_bonePaletteOffset)
+{
+}
+
+RenderQueueStats::RenderQueueStats() : drawCount(0), materialChangeCount(0), meshChangeCount(0), instanceChangeCount(0), instancedDrawCount(0), instancedItemCount(0)
+{
+}
+
+RenderQueue::RenderQueue() : m_projection(1.f), m_view(1.f), m_farPlane(1.f)
+{
+}
+
+void RenderQueue::begin(const glm::mat4& projection, const glm::mat4& view, float farPlane)
+{
+	m_projection = projection;
+	m_view = view;
+	m_farPlane = farPlane;
+
+	m_instances.clear();
+	m_items.clear();
+	m_batches.clear();
+	m_programIds.clear();
+	m_materialIds.clear();
+	m_meshIds.clear();
+}
+
+void RenderQueue::add(MeshRenderer& meshRenderer, int bonePaletteOffset, int pass)
+{
+	Mesh* mesh = meshRenderer.getMesh();
+	if (mesh == nullptr || mesh->subMeshCount <= 0 || meshRenderer.getSubMeshMaterial(0) == nullptr)
+		return;
+
+	int instanceIdx = m_instances.size();
+	m_instances.push_back(RenderQueueInstance(&meshRenderer, bonePaletteOffset));
+	RenderQueueInstance& instance = m_instances.back();
+	meshRenderer.prepareDraw(m_projection, m_view, instance.mvp, instance.normalMatrix);
+	instance.modelMatrix = meshRenderer.entity()->getModelMatrix();
+	instance.lod = meshRenderer.getCurrentLod();
+	instance.isSkinned = mesh->getIsSkeletalMesh();
+
+	//view depth of the origin of the instance, the sub meshes are sorted together :
+	glm::vec4 viewOrigin = m_view * instance.modelMatrix * glm::vec4(0, 0, 0, 1);
+	float depth01 = m_farPlane > 0.f ? -viewOrigin.z / m_farPlane : 0.f;
+
+	int meshId = getId<const Mesh*>(m_meshIds, mesh);
+	for (int i = 0; i < mesh->subMeshCount; i++)
+	{
+		RenderQueueItem item;
+		item.material = meshRenderer.getSubMeshMaterial(i);
+		item.mesh = mesh;
+		item.subMeshIdx = i;
+		item.instanceIdx = instanceIdx;
+		item.key = makeKey(pass, getId<GLuint>(m_programIds, item.material->glProgram), getId<const Material3DObject*>(m_materialIds, item.material), meshId, i, instance.lod, depth01);
+
+		m_items.push_back(item);
+	}
+}
+
+void RenderQueue::sort()
+{
+	const int itemCount = m_items.size();
+	if (itemCount < 2)
+		return;
+
+	//least significant digit first, 8 bits per pass. The histograms of all the digits are computed in a single loop :
+	int histograms[8][256] = { 0 };
+	for (int i = 0; i < itemCount; i++)
+	{
+		uint64_t key = m_items[i].key;
+		for (int digit = 0; digit < 8; digit++)
+			histograms[digit][(key >> (digit * 8)) & 0xff]++;
+	}
+
+	m_sortBuffer.resize(itemCount);
+	std::vector<RenderQueueItem>* source = &m_items;
+	std::vector<RenderQueueItem>* destination = &m_sortBuffer;
+	for (int digit = 0; digit < 8; digit++)
+	{
+		int* histogram = histograms[digit];
+
+		//skip the digits shared by all the items (most of the high bits in practice) :
+		if (histogram[((*source)[0].key >> (digit * 8)) & 0xff] == itemCount)
+			continue;
+
+		int offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			int count = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += count;
+		}
+
+		for (int i = 0; i < itemCount; i++)
+		{
+			const RenderQueueItem& item = (*source)[i];
+			(*destination)[histogram[(item.key >> (digit * 8)) & 0xff]++] = item;
+		}
+
+		std::swap(source, destination);
+	}
+
+	if (source != &m_items)
+		m_items.swap(m_sortBuffer);
+}
+
+void RenderQueue::buildBatches(InstanceBuffer& instances, bool useInstancing)
+{
+	m_batches.clear();
+
+	int itemIdx = 0;
+	while (itemIdx < m_items.size())
+	{
+		const RenderQueueItem& firstItem = m_items[itemIdx];
+		const RenderQueueInstance& firstInstance = m_instances[firstItem.instanceIdx];
+
+		//the skinned instances have their own bone palette, they are drawn one by one :
+		int endItemIdx = itemIdx + 1;
+		if (useInstancing && !firstInstance.isSkinned && firstItem.material->supportsInstancing())
+		{
+			while (endItemIdx < m_items.size()
+				&& m_items[endItemIdx].material == firstItem.material
+				&& m_items[endItemIdx].mesh == firstItem.mesh
+				&& m_items[endItemIdx].subMeshIdx == firstItem.subMeshIdx
+				&& m_instances[m_items[endItemIdx].instanceIdx].lod == firstInstance.lod)
+				endItemIdx++;
+		}
+
+		RenderQueueBatch batch;
+		batch.firstItem = itemIdx;
+		batch.itemCount = endItemIdx - itemIdx;
+		batch.firstInstance = -1;
+		if (batch.itemCount > 1)
+		{
+			for (int i = itemIdx; i < endItemIdx; i++)
+			{
+				const RenderQueueInstance& instance = m_instances[m_items[i].instanceIdx];
+				int instanceIdx = instances.add(instance.modelMatrix, instance.normalMatrix);
+				if (i == itemIdx)
+					batch.firstInstance = instanceIdx;
+			}
+		}
+		m_batches.push_back(batch);
+
+		itemIdx = endItemIdx;
+	}
+}
+
+void RenderQueue::submit(const BonePaletteBuffer& bonePalettes, const InstanceBuffer& instances)
+{
+	m_stats = RenderQueueStats();
+
+	Material3DObject* currentMaterial = nullptr;
+	Mesh* currentMesh = nullptr;
+	int currentInstanceIdx = -1;
+	int currentPaletteOffset = -1;
+
+	for (int batchIdx = 0; batchIdx < m_batches.size(); batchIdx++)
+	{
+		const RenderQueueBatch& batch = m_batches[batchIdx];
+		const RenderQueueItem& item = m_items[batch.firstItem];
+		RenderQueueInstance& instance = m_instances[item.instanceIdx];
+
+		if (item.material != currentMaterial)
+		{
+			item.material->use();
+			currentMaterial = item.material;
+			//the uniforms of the instance have to be sent to the new program :
+			currentInstanceIdx = -1;
+			m_stats.materialChangeCount++;
+		}
+
+		if (item.mesh != currentMesh)
+		{
+			item.mesh->bindVao();
+			currentMesh = item.mesh;
+			m_stats.meshChangeCount++;
+		}
+
+		if (batch.firstInstance >= 0)
+		{
+			//the model and normal matrices come from the instance buffer :
+			glm::mat4 viewProjection = m_projection * m_view;
+			currentMaterial->setUniform_MVP(viewProjection);
+			currentMaterial->setUniformUseSkeleton(false);
+			currentMaterial->setUniformUseInstancing(true);
+			currentInstanceIdx = -1;
+
+			instances.bindAttributes(batch.firstInstance);
+			item.mesh->drawInstanced(item.subMeshIdx, instance.lod, batch.itemCount);
+			instances.unbindAttributes();
+
+			m_stats.instancedDrawCount++;
+			m_stats.instancedItemCount += batch.itemCount;
+			m_stats.drawCount++;
+			continue;
+		}
+
+		if (item.instanceIdx != currentInstanceIdx)
+		{
+			currentMaterial->setUniform_MVP(instance.mvp);
+			currentMaterial->setUniform_normalMatrix(instance.normalMatrix);
+			currentMaterial->setUniformUseSkeleton(instance.isSkinned);
+			currentMaterial->setUniformUseInstancing(false);
+			currentInstanceIdx = item.instanceIdx;
+			m_stats.instanceChangeCount++;
+		}
+
+		if (instance.bonePaletteOffset >= 0 && instance.bonePaletteOffset != currentPaletteOffset)
+		{
+			bonePalettes.bind(instance.bonePaletteOffset);
+			currentPaletteOffset = instance.bonePaletteOffset;
+		}
+
+		item.mesh->drawBound(item.subMeshIdx, instance.lod);
+		m_stats.drawCount++;
+	}
+
+	GLStateCache::get().bindVertexArray(0);
+}
+
+int RenderQueue::getItemCount() const
+{
+	return m_items.size();
+}
+
+const RenderQueueStats& RenderQueue::getStats() const
+{
+	return m_stats;
+}
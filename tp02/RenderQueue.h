@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "glew/glew.h"
+#include "glm/glm.hpp"
+
+//forwards :
+class MeshRenderer;
+class Mesh;
+struct Material3DObject;
+class BonePaletteBuffer;
+class InstanceBuffer;
+
+//matrices and states shared by all the sub meshes of a mesh renderer :
+struct RenderQueueInstance
+{
+	MeshRenderer* meshRenderer;
+	glm::mat4 modelMatrix;
+	glm::mat4 mvp;
+	glm::mat4 normalMatrix;
+	int lod;
+	bool isSkinned;
+	int bonePaletteOffset; //-1 if the mesh isn't skinned
+
+	RenderQueueInstance(MeshRenderer* _meshRenderer, int _bonePaletteOffset);
+};
+
+//a draw call of a sub mesh :
+struct RenderQueueItem
+{
+	uint64_t key;
+	Material3DObject* material;
+	Mesh* mesh;
+	int subMeshIdx;
+	int instanceIdx;
+};
+
+//consecutive items drawn with a single draw call. Batches of several items are instanced draws.
+struct RenderQueueBatch
+{
+	int firstItem;
+	int itemCount;
+	int firstInstance; //in the instance buffer, -1 if the batch isn't instanced
+};
+
+//state changes done by the last submit :
+struct RenderQueueStats
+{
+	int drawCount;
+	int materialChangeCount;
+	int meshChangeCount;
+	int instanceChangeCount;
+	int instancedDrawCount;
+	int instancedItemCount;
+
+	RenderQueueStats();
+};
+
+//Draw calls of a frame, sorted to minimize the state changes.
+//The 64 bits key of an item is, from the most significant bits : pass (2 bits), program (10 bits), material (14 bits), mesh (14 bits), sub mesh (6 bits), level of detail (3 bits), depth (15 bits).
+//The items sharing a program, then a material, then a mesh are contiguous, and drawn from front to back.
+//The runs of non skinned items sharing a material, a sub mesh and a level of detail are drawn with a single instanced draw.
+//Programs, materials and meshes get a small id the first time they are added in the frame. Ids over the size of their field are clamped,
+//it only breaks the grouping, because the submit compares the real states.
+class RenderQueue
+{
+private:
+	std::vector<RenderQueueInstance> m_instances;
+	std::vector<RenderQueueItem> m_items;
+	std::vector<RenderQueueItem> m_sortBuffer;
+	std::vector<RenderQueueBatch> m_batches;
+
+	glm::mat4 m_projection;
+	glm::mat4 m_view;
+	float m_farPlane;
+
+	std::unordered_map<GLuint, int> m_programIds;
+	std::unordered_map<const Material3DObject*, int> m_materialIds;
+	std::unordered_map<const Mesh*, int> m_meshIds;
+
+	RenderQueueStats m_stats;
+
+public:
+	RenderQueue();
+
+	//remove the items of the previous frame, and set the camera of the new one :
+	void begin(const glm::mat4& projection, const glm::mat4& view, float farPlane);
+	//add the sub meshes of a mesh renderer, select its level of detail and compute its matrices. pass is in [0, 3], the passes are drawn in increasing order.
+	void add(MeshRenderer& meshRenderer, int bonePaletteOffset, int pass = 0);
+	//radix sort of the items on their keys :
+	void sort();
+	//group the items in draw calls, after sort. If useInstancing is true, the matrices of the instanced batches are added to instances, which must be uploaded before submit.
+	void buildBatches(InstanceBuffer& instances, bool useInstancing);
+	//draw the batches in order, the materials, the meshes, the matrices and the bone palettes are only changed when they differ from the previous batch.
+	void submit(const BonePaletteBuffer& bonePalettes, const InstanceBuffer& instances);
+
+	int getItemCount() const;
+	const RenderQueueStats& getStats() const;
+
+private:
+	template<typename Key>
+	static int getId(std::unordered_map<Key, int>& ids, const Key& key);
+};
+
+template<typename Key>
+int RenderQueue::getId(std::unordered_map<Key, int>& ids, const Key& key)
+{
+	auto findIt = ids.find(key);
+	if (findIt != ids.end())
+		return findIt->second;
+
+	int id = ids.size();
+	ids[key] = id;
+	return id;
+}
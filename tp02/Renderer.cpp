@@ -1,7 +1,29 @@
 #include "Renderer.h"
 #include "Factories.h" //forward
+#include "GLStateCache.h"
 
-Renderer::Renderer(LightManager* _lightManager, std::string programGPass_vert_path, std::string programGPass_frag_path, std::string programLightPass_vert_path, std::string programLightPass_frag_path_pointLight, std::string programLightPass_frag_path_directionalLight, std::string programLightPass_frag_path_spotLight)  : quadMesh(GL_TRIANGLES, (Mesh::USE_INDEX | Mesh::USE_VERTICES), 2)
+RenderCullingStats::RenderCullingStats() : visibleMeshRendererCount(0), culledMeshRendererCount(0), visibleFlagCount(0), culledFlagCount(0), visibleParticleEmitterCount(0), culledParticleEmitterCount(0), visibleLightCount(0), culledLightCount(0), visibleShadowCasterCount(0), culledShadowCasterCount(0)
+{
+
+}
+
+ShadowCacheStats::ShadowCacheStats() : hitCount(0), missCount(0), uncachedCount(0)
+{
+
+}
+
+//FNV-1a hash of a block of memory, accumulated in hash :
+static void hashBytes(unsigned long long& hash, const void* data, int size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (int i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+}
+
+Renderer::Renderer(LightManager* _lightManager, std::string programGPass_vert_path, std::string programGPass_frag_path, std::string programLightPass_vert_path, std::string programLightPass_frag_path_pointLight, std::string programLightPass_frag_path_directionalLight, std::string programLightPass_frag_path_spotLight)  : quadMesh(GL_TRIANGLES, (Mesh::USE_INDEX | Mesh::USE_VERTICES), 2), frustumCulling(true), sortGPassQueue(true), useInstancing(true), shadowCaching(true), shadowCasterCulling(true), tiledLighting(true), glProgram_lightPass_tiledPointLight(0)
 {
 
 	int width = Application::get().getWindowWidth(), height = Application::get().getWindowHeight();
@@ -31,6 +53,7 @@ Renderer::Renderer(LightManager* _lightManager, std::string programGPass_vert_pa
 	unformScreenToWorld[POINT] = glGetUniformLocation(glProgram_lightPass_pointLight, "ScreenToWorld");
 	uniformCameraPosition[POINT] = glGetUniformLocation(glProgram_lightPass_pointLight, "CameraPosition");
 	uniformTextureShadow[POINT] = glGetUniformLocation(glProgram_lightPass_pointLight, "Shadow");
+	uniformLightViewport[POINT] = glGetUniformLocation(glProgram_lightPass_pointLight, "Viewport");
 	uniformLightFarPlane = glGetUniformLocation(glProgram_lightPass_pointLight, "FarPlane");
 
 	//check uniform errors : 
@@ -56,6 +79,7 @@ Renderer::Renderer(LightManager* _lightManager, std::string programGPass_vert_pa
 	unformScreenToWorld[DIRECTIONAL] = glGetUniformLocation(glProgram_lightPass_directionalLight, "ScreenToWorld");
 	uniformCameraPosition[DIRECTIONAL] = glGetUniformLocation(glProgram_lightPass_directionalLight, "CameraPosition");
 	uniformTextureShadow[DIRECTIONAL] = glGetUniformLocation(glProgram_lightPass_directionalLight, "Shadow");
+	uniformLightViewport[DIRECTIONAL] = glGetUniformLocation(glProgram_lightPass_directionalLight, "Viewport");
 	uniformWorldToLightScreen_directional = glGetUniformLocation(glProgram_lightPass_directionalLight, "WorldToLightScreen");
 
 	//check uniform errors : 
@@ -81,6 +105,7 @@ Renderer::Renderer(LightManager* _lightManager, std::string programGPass_vert_pa
 	unformScreenToWorld[SPOT] = glGetUniformLocation(glProgram_lightPass_spotLight, "ScreenToWorld");
 	uniformCameraPosition[SPOT] = glGetUniformLocation(glProgram_lightPass_spotLight, "CameraPosition"); 
 	uniformTextureShadow[SPOT] = glGetUniformLocation(glProgram_lightPass_spotLight, "Shadow");
+	uniformLightViewport[SPOT] = glGetUniformLocation(glProgram_lightPass_spotLight, "Viewport");
 	uniformWorldToLightScreen_spot = glGetUniformLocation(glProgram_lightPass_spotLight, "WorldToLightScreen");
 
 	//check uniform errors : 
@@ -111,7 +136,7 @@ Renderer::Renderer(LightManager* _lightManager, std::string programGPass_vert_pa
 	GLuint gbufferDrawBuffers[2];
 
 	// Create color texture
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -119,7 +144,7 @@ Renderer::Renderer(LightManager* _lightManager, std::string programGPass_vert_pa
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
 	// Create normal texture
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16, width, height, 0, GL_RGBA, GL_FLOAT, 0);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -127,7 +152,7 @@ Renderer::Renderer(LightManager* _lightManager, std::string programGPass_vert_pa
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
 	// Create depth texture
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -163,6 +188,10 @@ Renderer::Renderer(LightManager* _lightManager, std::string programGPass_vert_pa
 	lightManager->setShadowMapCount(LightManager::SPOT, 10);
 	lightManager->setShadowMapCount(LightManager::DIRECTIONAL, 5);
 	lightManager->setShadowMapCount(LightManager::POINT, 10);
+
+	////////////////////// BONE PALETTES AND INSTANCES /////////////////////////
+	bonePalettes.initGl();
+	instanceBuffer.initGl();
 }
 
 Renderer::~Renderer()
@@ -188,13 +217,13 @@ void Renderer::onResizeWindow()
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	//delete old textures
-	glDeleteTextures(3, gbufferTextures);
+	GLStateCache::get().deleteTextures(3, gbufferTextures);
 
 	//generate new textures
 	glGenTextures(3, gbufferTextures);
 
 	// Create color texture
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -202,7 +231,7 @@ void Renderer::onResizeWindow()
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
 	// Create normal texture
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16, width, height, 0, GL_RGBA, GL_FLOAT, 0);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -210,7 +239,7 @@ void Renderer::onResizeWindow()
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
 	// Create depth texture
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -278,6 +307,9 @@ void Renderer::initialyzeShadowMapping(std::string progamShadowPass_vert_path, s
 		exit(1);
 
 	uniformShadowMVP = glGetUniformLocation(glProgram_shadowPass, "MVP");
+	uniformShadowUseSkeleton = glGetUniformLocation(glProgram_shadowPass, "UseSkeleton");
+	uniformShadowUseInstancing = glGetUniformLocation(glProgram_shadowPass, "UseInstancing");
+	BonePaletteBuffer::bindProgram(glProgram_shadowPass);
 
 	//check uniform errors : 
 	if (!checkError("Uniforms"))
@@ -305,6 +337,10 @@ void Renderer::initialyzeShadowMapping(std::string progamShadowPass_vert_path, s
 	}
 	uniformShadowOmniLightPos = glGetUniformLocation(glProgram_shadowPassOmni, "LightPos");
 	uniformShadowOmniFarPlane = glGetUniformLocation(glProgram_shadowPassOmni, "FarPlane");
+	uniformShadowOmniUseSkeleton = glGetUniformLocation(glProgram_shadowPassOmni, "UseSkeleton");
+	uniformShadowOmniUseInstancing = glGetUniformLocation(glProgram_shadowPassOmni, "UseInstancing");
+	uniformShadowOmniFaceMask = glGetUniformLocation(glProgram_shadowPassOmni, "FaceMask");
+	BonePaletteBuffer::bindProgram(glProgram_shadowPassOmni);
 
 	//check uniform errors : 
 	if (!checkError("Uniforms"))
@@ -341,6 +377,120 @@ void Renderer::initialyzeShadowMapping(std::string progamShadowPass_vert_path, s
 
 }
 
+void Renderer::initTiledLighting(std::string programTiledPointLight_vert_path, std::string programTiledPointLight_frag_path)
+{
+	//////////////////// 3D lightPass tiled point light shader ////////////////////////
+	GLuint vertShaderId_lightPass_tiledPoint = compile_shader_from_file(GL_VERTEX_SHADER, programTiledPointLight_vert_path.c_str());
+	GLuint fragShaderId_lightPass_tiledPoint = compile_shader_from_file(GL_FRAGMENT_SHADER, programTiledPointLight_frag_path.c_str());
+
+	glProgram_lightPass_tiledPointLight = glCreateProgram();
+	glAttachShader(glProgram_lightPass_tiledPointLight, vertShaderId_lightPass_tiledPoint);
+	glAttachShader(glProgram_lightPass_tiledPointLight, fragShaderId_lightPass_tiledPoint);
+
+	glLinkProgram(glProgram_lightPass_tiledPointLight);
+	if (check_link_error(glProgram_lightPass_tiledPointLight) < 0)
+		exit(1);
+
+	uniformTiledTextureColor = glGetUniformLocation(glProgram_lightPass_tiledPointLight, "ColorBuffer");
+	uniformTiledTextureNormal = glGetUniformLocation(glProgram_lightPass_tiledPointLight, "NormalBuffer");
+	uniformTiledTextureDepth = glGetUniformLocation(glProgram_lightPass_tiledPointLight, "DepthBuffer");
+	uniformTiledScreenToWorld = glGetUniformLocation(glProgram_lightPass_tiledPointLight, "ScreenToWorld");
+	uniformTiledCameraPosition = glGetUniformLocation(glProgram_lightPass_tiledPointLight, "CameraPosition");
+	uniformTiledLights = glGetUniformLocation(glProgram_lightPass_tiledPointLight, "Lights");
+	uniformTiledTileLights = glGetUniformLocation(glProgram_lightPass_tiledPointLight, "TileLights");
+	uniformTiledLightIndices = glGetUniformLocation(glProgram_lightPass_tiledPointLight, "LightIndices");
+	uniformTiledTileSize = glGetUniformLocation(glProgram_lightPass_tiledPointLight, "TileSize");
+	uniformTiledTileCountX = glGetUniformLocation(glProgram_lightPass_tiledPointLight, "TileCountX");
+	uniformTiledViewport = glGetUniformLocation(glProgram_lightPass_tiledPointLight, "Viewport");
+
+	//check uniform errors : 
+	if (!checkError("Uniforms"))
+		exit(1);
+
+	//////////////////// lights and tiles texture buffers ////////////////////////
+	//GL 4.1 has no storage buffer, the lists are read with texelFetch :
+	const GLenum tiledLightFormats[3] = { GL_RGBA32F, GL_RG32I, GL_R32I };
+
+	glGenBuffers(3, tiledLightBuffers);
+	glGenTextures(3, tiledLightTextures);
+	for (int i = 0; i < 3; i++)
+	{
+		//the storage is reallocated by each upload, the texture keeps pointing to the buffer :
+		glBindBuffer(GL_TEXTURE_BUFFER, tiledLightBuffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+		GLStateCache::get().bindTexture(GL_TEXTURE_BUFFER, tiledLightTextures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, tiledLightFormats[i], tiledLightBuffers[i]);
+	}
+	GLStateCache::get().bindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void Renderer::renderTiledPointLights(int firstLight, const glm::mat4& screenToWorld, const glm::vec3& cameraPosition, std::vector<PointLight*>& pointLights)
+{
+	tiledLightViewports.clear();
+	tiledLightData.clear();
+	for (int i = firstLight; i < pointLightCount; i++)
+	{
+		const PointLight& light = *pointLights[pointLightCullingInfos[i].idx];
+		tiledLightViewports.push_back(pointLightCullingInfos[i].viewport);
+		tiledLightData.push_back(glm::vec4(light.position, light.intensity));
+		tiledLightData.push_back(glm::vec4(light.color, 0.f));
+	}
+
+	lightTileGrid.resize(Application::get().getWindowWidth(), Application::get().getWindowHeight());
+	lightTileGrid.build(tiledLightViewports);
+
+	if (lightTileGrid.getLightIndices().empty())
+		return;
+
+	const std::vector<glm::ivec2>& tileLights = lightTileGrid.getAllTileLights();
+	const std::vector<int>& lightIndices = lightTileGrid.getLightIndices();
+
+	//the storages are orphaned each frame, so we don't wait for the lighting of the previous frame :
+	glBindBuffer(GL_TEXTURE_BUFFER, tiledLightBuffers[0]);
+	glBufferData(GL_TEXTURE_BUFFER, tiledLightData.size() * sizeof(glm::vec4), &tiledLightData[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, tiledLightBuffers[1]);
+	glBufferData(GL_TEXTURE_BUFFER, tileLights.size() * sizeof(glm::ivec2), &tileLights[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, tiledLightBuffers[2]);
+	glBufferData(GL_TEXTURE_BUFFER, lightIndices.size() * sizeof(int), &lightIndices[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	GLStateCache::get().useProgram(glProgram_lightPass_tiledPointLight);
+
+	glUniformMatrix4fv(uniformTiledScreenToWorld, 1, false, glm::value_ptr(screenToWorld));
+	glUniform3fv(uniformTiledCameraPosition, 1, glm::value_ptr(cameraPosition));
+	glUniform1i(uniformTiledTileSize, lightTileGrid.getTileSize());
+	glUniform1i(uniformTiledTileCountX, lightTileGrid.getTileCountX());
+
+	//geometry informations :
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
+	GLStateCache::get().activeTexture(GL_TEXTURE1);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
+	GLStateCache::get().activeTexture(GL_TEXTURE2);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
+
+	glUniform1i(uniformTiledTextureColor, 0);
+	glUniform1i(uniformTiledTextureNormal, 1);
+	glUniform1i(uniformTiledTextureDepth, 2);
+
+	//lights and tiles :
+	GLStateCache::get().activeTexture(GL_TEXTURE4);
+	GLStateCache::get().bindTexture(GL_TEXTURE_BUFFER, tiledLightTextures[0]);
+	GLStateCache::get().activeTexture(GL_TEXTURE5);
+	GLStateCache::get().bindTexture(GL_TEXTURE_BUFFER, tiledLightTextures[1]);
+	GLStateCache::get().activeTexture(GL_TEXTURE6);
+	GLStateCache::get().bindTexture(GL_TEXTURE_BUFFER, tiledLightTextures[2]);
+
+	glUniform1i(uniformTiledLights, 4);
+	glUniform1i(uniformTiledTileLights, 5);
+	glUniform1i(uniformTiledLightIndices, 6);
+
+	//a single quad over the whole screen, the tiles without light are discarded :
+	glUniform4f(uniformTiledViewport, -1.f, -1.f, 2.f, 2.f);
+	quadMesh.draw();
+}
+
 void Renderer::renderShadows(const glm::mat4& lightProjection, const glm::mat4& lightView, MeshRenderer& meshRenderer)
 {
 	glm::mat4 modelMatrix = meshRenderer.entity()->getModelMatrix(); //get modelMatrix
@@ -353,9 +503,11 @@ void Renderer::renderShadows(const glm::mat4& lightProjection, const glm::mat4&
 	glm::mat4 worldToLightScreen = lightProjection * lightView;
 
 	glUniformMatrix4fv(uniformShadowMVP, 1, false, glm::value_ptr(objectToLightScreen));
+	glUniform1i(uniformShadowUseSkeleton, meshRenderer.getMesh()->getIsSkeletalMesh());
+	glUniform1i(uniformShadowUseInstancing, false);
 
-	//draw mesh : 
-	meshRenderer.getMesh()->draw();
+	//draw mesh, with the coarser shadow level of detail : 
+	meshRenderer.getMesh()->drawLod(meshRenderer.getShadowLod());
 
 }
 
@@ -373,104 +525,439 @@ void Renderer::renderShadows(float farPlane, const glm::vec3 & lightPos, const s
 	glUniformMatrix4fv(uniformShadowOmniModelMatrix, 1, false, glm::value_ptr(modelMatrix)); 
 	glUniform3fv(uniformShadowOmniLightPos, 1, glm::value_ptr(lightPos));
 	glUniform1f(uniformShadowOmniFarPlane, farPlane);
+	glUniform1i(uniformShadowOmniUseSkeleton, meshRenderer.getMesh()->getIsSkeletalMesh());
+	glUniform1i(uniformShadowOmniUseInstancing, false);
 
-	//draw mesh : 
-	meshRenderer.getMesh()->draw();
+	//draw mesh, with the coarser shadow level of detail : 
+	meshRenderer.getMesh()->drawLod(meshRenderer.getShadowLod());
 }
 
-
-void Renderer::render(const BaseCamera& camera, std::vector<MeshRenderer*>& meshRenderers, std::vector<PointLight*>& pointLights, std::vector<DirectionalLight*>& directionalLights, std::vector<SpotLight*>& spotLights, Terrain& terrain, Skybox& skybox, std::vector<Physic::Flag*>& flags, std::vector<Billboard*>& billboards, std::vector<Physic::ParticleEmitter*>& particleEmitters)
+void Renderer::updateShadowViews(const BaseCamera& camera, std::vector<MeshRenderer*>& meshRenderers, std::vector<PointLight*>& pointLights, std::vector<DirectionalLight*>& directionalLights, std::vector<SpotLight*>& spotLights, const DynamicAABBTree& spatialTree)
 {
-	int width = Application::get().getWindowWidth(), height = Application::get().getWindowHeight();
 	glm::vec3 cameraPosition = camera.getCameraPosition();
 	glm::vec3 cameraForward = camera.getCameraForward();
 
-	////////////////////////// begin scene rendering 
-
+	//the hashes of the static casters are computed once, each shadow view sums the hashes of its own static casters :
+	staticCasterHashes.clear();
+	int casterCount = 0;
+	for (int i = 0; i < meshRenderers.size(); i++)
+	{
+		const MeshRenderer* caster = meshRenderers[i];
+		if (caster->getMesh() == nullptr)
+			continue;
+		casterCount++;
 
-	//////// begin shadow pass
-	glEnable(GL_DEPTH_TEST);
+		if (caster->isStaticShadowCaster())
+		{
+			const Mesh* mesh = caster->getMesh();
+			const int shadowLod = caster->getShadowLod();
+			const glm::mat4 modelMatrix = caster->entity()->getModelMatrix();
+
+			unsigned long long casterHash = 14695981039346656037ULL;
+			hashBytes(casterHash, &caster, sizeof(caster));
+			hashBytes(casterHash, &mesh, sizeof(mesh));
+			hashBytes(casterHash, &shadowLod, sizeof(shadowLod));
+			hashBytes(casterHash, glm::value_ptr(modelMatrix), sizeof(modelMatrix));
+			staticCasterHashes[caster] = casterHash;
+		}
+	}
 
-	//culling for lights : 
-	updateCulling(camera, pointLights, spotLights, pointLightCullingInfos, spotLightCullingInfos);
+	shadowViews.clear();
+	shadowBatches.clear();
+	cullingStats.visibleShadowCasterCount = 0;
+	cullingStats.culledShadowCasterCount = 0;
 
 	//TODO : check if shadow map count and light count match
 
 	//for spot lights : 
-	glUseProgram(glProgram_shadowPass);
-	for (int shadowIdx = 0; shadowIdx < spotLightCount; shadowIdx++)
+	for (int shadowIdx = 0; shadowIdx < spotLightCount && shadowIdx < lightManager->getShadowMapCount(LightManager::SPOT); shadowIdx++)
+	{
+		const SpotLight& light = *spotLights[spotLightCullingInfos[shadowIdx].idx];
+
+		ShadowView shadowView;
+		shadowView.lightType = LightManager::SPOT;
+		shadowView.shadowIdx = shadowIdx;
+		shadowView.lightProjection = glm::perspective(light.angle*2.f, 1.f, 0.1f, 100.f);
+		shadowView.lightView = glm::lookAt(light.position, light.position + light.direction, light.up);
+		shadowView.lightPosition = light.position;
+		shadowView.farPlane = 100.f;
+
+		cullShadowCasters(shadowView, getShadowRange(light.boundingBox, shadowView.farPlane), meshRenderers, spatialTree);
+		addShadowView(shadowView);
+	}
+
+	//for directional lights : 
+	for (int lightIdx = 0; lightIdx < directionalLights.size() && lightIdx < lightManager->getShadowMapCount(LightManager::DIRECTIONAL); lightIdx++)
+	{
+		const DirectionalLight& light = *directionalLights[lightIdx];
+
+		//the shadow box follows the camera :
+		float directionalShadowMapRadius = lightManager->getDirectionalShadowMapViewportSize()*0.5f;
+		float directionalShadowMapNear = lightManager->getDirectionalShadowMapViewportNear();
+		float directionalShadowMapFar = lightManager->getDirectionalShadowMapViewportFar();
+		glm::vec3 orig = glm::vec3(cameraForward.x, 0, cameraForward.z)*directionalShadowMapRadius + glm::vec3(cameraPosition.x, light.position.y /*directionalShadowMapFar*0.5f*/, cameraPosition.z);
+		glm::vec3 eye = -light.direction + orig;
+
+		ShadowView shadowView;
+		shadowView.lightType = LightManager::DIRECTIONAL;
+		shadowView.shadowIdx = lightIdx;
+		shadowView.lightProjection = glm::ortho(-directionalShadowMapRadius, directionalShadowMapRadius, -directionalShadowMapRadius, directionalShadowMapRadius, directionalShadowMapNear, directionalShadowMapFar);
+		shadowView.lightView = glm::lookAt(eye, orig, light.up);
+		shadowView.lightPosition = eye;
+		shadowView.farPlane = directionalShadowMapFar;
+
+		cullShadowCasters(shadowView, 0.f, meshRenderers, spatialTree);
+		addShadowView(shadowView);
+	}
+
+	//for point lights : 
+	for (int shadowIdx = 0; shadowIdx < pointLightCount && shadowIdx < lightManager->getShadowMapCount(LightManager::POINT); shadowIdx++)
+	{
+		const PointLight& light = *pointLights[pointLightCullingInfos[shadowIdx].idx];
+
+		ShadowView shadowView;
+		shadowView.lightType = LightManager::POINT;
+		shadowView.shadowIdx = shadowIdx;
+		shadowView.lightProjection = glm::perspective(glm::radians(90.f), 1.f, 1.f, 100.f);
+		shadowView.lightView = glm::mat4(1.f);
+		shadowView.lightPosition = light.position;
+		shadowView.farPlane = 100.f;
+		shadowView.lightVPs.push_back(shadowView.lightProjection * glm::lookAt(light.position, light.position + glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, -1.f, 0.f)));
+		shadowView.lightVPs.push_back(shadowView.lightProjection * glm::lookAt(light.position, light.position + glm::vec3(-1.f, 0.f, 0.f), glm::vec3(0.f, -1.f, 0.f)));
+		shadowView.lightVPs.push_back(shadowView.lightProjection * glm::lookAt(light.position, light.position + glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, 0.f, 1.f)));
+		shadowView.lightVPs.push_back(shadowView.lightProjection * glm::lookAt(light.position, light.position + glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f, 0.f, -1.f)));
+		shadowView.lightVPs.push_back(shadowView.lightProjection * glm::lookAt(light.position, light.position + glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, -1.f, 0.f)));
+		shadowView.lightVPs.push_back(shadowView.lightProjection * glm::lookAt(light.position, light.position + glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, -1.f, 0.f)));
+
+		cullShadowCasters(shadowView, getShadowRange(light.boundingBox, shadowView.farPlane), meshRenderers, spatialTree);
+		addShadowView(shadowView);
+	}
+
+	for (int viewIdx = 0; viewIdx < shadowViews.size(); viewIdx++)
+		cullingStats.culledShadowCasterCount += casterCount;
+	cullingStats.culledShadowCasterCount -= cullingStats.visibleShadowCasterCount;
+}
+
+float Renderer::getShadowRange(const BoxCollider& boundingBox, float farPlane) const
+{
+	//the bounding box of the light covers its radius of influence :
+	glm::vec3 halfSize = glm::abs(boundingBox.topRight - boundingBox.bottomLeft) * 0.5f;
+	return std::min(std::max(halfSize.x, std::max(halfSize.y, halfSize.z)), farPlane);
+}
+
+void Renderer::cullShadowCasters(const ShadowView& shadowView, float range, std::vector<MeshRenderer*>& meshRenderers, const DynamicAABBTree& spatialTree)
+{
+	shadowCasters.clear();
+
+	if (!shadowCasterCulling)
+	{
+		for (int i = 0; i < meshRenderers.size(); i++)
+		{
+			if (meshRenderers[i]->getMesh() != nullptr)
+				shadowCasters.push_back(meshRenderers[i]);
+		}
+		return;
+	}
+
+	//directional lights use their orthographic box, spot and point lights the sphere of their range :
+	const Frustum lightFrustum(shadowView.lightProjection * shadowView.lightView);
+	shadowCasterComponents.clear();
+	if (shadowView.lightType == LightManager::DIRECTIONAL)
+		spatialTree.queryFrustum(lightFrustum, shadowCasterComponents);
+	else
+		spatialTree.querySphere(shadowView.lightPosition, range, shadowCasterComponents);
+
+	glm::vec3 boundsMin, boundsMax;
+	for (int i = 0; i < shadowCasterComponents.size(); i++)
 	{
-		int lightIdx = spotLightCullingInfos[shadowIdx].idx;
+		if (shadowCasterComponents[i]->type() != Component::MESH_RENDERER)
+			continue;
 
-		if (shadowIdx < lightManager->getShadowMapCount(LightManager::SPOT))
+		MeshRenderer* caster = static_cast<MeshRenderer*>(shadowCasterComponents[i]);
+		if (caster->getMesh() == nullptr)
+			continue;
+
+		//spot lights also test their cone :
+		if (shadowView.lightType == LightManager::SPOT)
 		{
-			lightManager->bindShadowMapFBO(LightManager::SPOT, shadowIdx);
-			glClear(GL_DEPTH_BUFFER_BIT);
-			glm::mat4 lightProjection = glm::perspective(spotLights[lightIdx]->angle*2.f, 1.f, 0.1f, 100.f);
-			glm::mat4 lightView = glm::lookAt(spotLights[lightIdx]->position, spotLights[lightIdx]->position + spotLights[lightIdx]->direction, spotLights[lightIdx]->up);
+			caster->getBounds(boundsMin, boundsMax);
+			if (!lightFrustum.testAABB(boundsMin, boundsMax))
+				continue;
+		}
 
-			for (int meshIdx = 0; meshIdx < meshRenderers.size(); meshIdx++)
+		shadowCasters.push_back(caster);
+	}
+}
+
+void Renderer::addShadowView(ShadowView& shadowView)
+{
+	shadowView.firstBatch = shadowBatches.size();
+	shadowView.staticBatchCount = 0;
+	shadowView.staticCastersHash = 0;
+
+	//the casters of a batch are contiguous, the static casters first :
+	std::sort(shadowCasters.begin(), shadowCasters.end(), [](const MeshRenderer* a, const MeshRenderer* b)
+	{
+		if (a->isStaticShadowCaster() != b->isStaticShadowCaster())
+			return a->isStaticShadowCaster();
+		if (a->getMesh() != b->getMesh())
+			return std::less<Mesh*>()(a->getMesh(), b->getMesh());
+		return a->getShadowLod() < b->getShadowLod();
+	});
+
+	//the hashes of the static casters are summed, so their order doesn't matter :
+	for (int i = 0; i < shadowCasters.size() && shadowCasters[i]->isStaticShadowCaster(); i++)
+		shadowView.staticCastersHash += staticCasterHashes[shadowCasters[i]];
+
+	//omnidirectional shadow maps : a batch is only emitted on the cube faces seen by one of its casters :
+	const bool useFaceCulling = shadowView.lightType == LightManager::POINT && shadowCasterCulling;
+	Frustum faceFrustums[6];
+	if (useFaceCulling)
+	{
+		for (int face = 0; face < 6; face++)
+			faceFrustums[face].build(shadowView.lightVPs[face]);
+	}
+
+	glm::vec3 boundsMin, boundsMax;
+	int casterIdx = 0;
+	while (casterIdx < shadowCasters.size())
+	{
+		MeshRenderer* firstCaster = shadowCasters[casterIdx];
+
+		//the skinned casters have their own bone palette, they are drawn one by one :
+		int endCasterIdx = casterIdx + 1;
+		if (useInstancing && !firstCaster->getMesh()->getIsSkeletalMesh())
+		{
+			while (endCasterIdx < shadowCasters.size()
+				&& shadowCasters[endCasterIdx]->isStaticShadowCaster() == firstCaster->isStaticShadowCaster()
+				&& shadowCasters[endCasterIdx]->getMesh() == firstCaster->getMesh()
+				&& shadowCasters[endCasterIdx]->getShadowLod() == firstCaster->getShadowLod())
+				endCasterIdx++;
+		}
+
+		ShadowBatch batch;
+		batch.mesh = firstCaster->getMesh();
+		batch.lod = firstCaster->getShadowLod();
+		batch.meshRenderer = firstCaster;
+		batch.firstInstance = -1;
+		batch.instanceCount = endCasterIdx - casterIdx;
+		batch.faceMask = ShadowBatch::ALL_FACES;
+		if (useFaceCulling)
+		{
+			batch.faceMask = 0;
+			for (int i = casterIdx; i < endCasterIdx; i++)
 			{
-				renderShadows(lightProjection, lightView, *meshRenderers[meshIdx]);
+				shadowCasters[i]->getBounds(boundsMin, boundsMax);
+				for (int face = 0; face < 6; face++)
+				{
+					if (faceFrustums[face].testAABB(boundsMin, boundsMax))
+						batch.faceMask |= (1 << face);
+				}
 			}
-			lightManager->unbindShadowMapFBO(LightManager::SPOT);
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		}
-	}
 
-	
-	//for directional lights : 
-	glUseProgram(glProgram_shadowPass);
-	for (int lightIdx = 0; lightIdx < directionalLights.size(); lightIdx++)
-	{
-		if (lightIdx < lightManager->getShadowMapCount(LightManager::DIRECTIONAL))
+		//casters in the range of a point light, but out of all its faces (too close to the light) :
+		if (batch.faceMask == 0)
 		{
-			lightManager->bindShadowMapFBO(LightManager::DIRECTIONAL, lightIdx);
-			glClear(GL_DEPTH_BUFFER_BIT);
-			float directionalShadowMapRadius = lightManager->getDirectionalShadowMapViewportSize()*0.5f;
-			float directionalShadowMapNear = lightManager->getDirectionalShadowMapViewportNear();
-			float directionalShadowMapFar = lightManager->getDirectionalShadowMapViewportFar();
-			glm::vec3 orig = glm::vec3(cameraForward.x, 0, cameraForward.z)*directionalShadowMapRadius + glm::vec3(cameraPosition.x, directionalLights[lightIdx]->position.y /*directionalShadowMapFar*0.5f*/, cameraPosition.z);
-			glm::vec3 eye = -directionalLights[lightIdx]->direction + orig;
-			glm::mat4 lightProjection = glm::ortho(-directionalShadowMapRadius, directionalShadowMapRadius, -directionalShadowMapRadius, directionalShadowMapRadius, directionalShadowMapNear, directionalShadowMapFar);
-			glm::mat4 lightView = glm::lookAt(eye, orig, directionalLights[lightIdx]->up);
-
-			for (int meshIdx = 0; meshIdx < meshRenderers.size(); meshIdx++)
+			casterIdx = endCasterIdx;
+			continue;
+		}
+
+		if (batch.instanceCount > 1)
+		{
+			//the normal matrices aren't used by the shadow passes :
+			for (int i = casterIdx; i < endCasterIdx; i++)
 			{
-				renderShadows(lightProjection, lightView, *meshRenderers[meshIdx]);
+				int instanceIdx = instanceBuffer.add(shadowCasters[i]->entity()->getModelMatrix(), glm::mat4(1.f));
+				if (i == casterIdx)
+					batch.firstInstance = instanceIdx;
 			}
-			lightManager->unbindShadowMapFBO(LightManager::DIRECTIONAL);
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		}
+		shadowBatches.push_back(batch);
+		if (firstCaster->isStaticShadowCaster())
+			shadowView.staticBatchCount++;
+
+		casterIdx = endCasterIdx;
 	}
-	
 
-	//for point lights : 
-	glUseProgram(glProgram_shadowPassOmni);
-	for (int shadowIdx = 0; shadowIdx < pointLightCount; shadowIdx++)
+	shadowView.batchCount = shadowBatches.size() - shadowView.firstBatch;
+	cullingStats.visibleShadowCasterCount += shadowCasters.size();
+	shadowViews.push_back(shadowView);
+}
+
+void Renderer::renderShadowBatches(const glm::mat4& lightProjection, const glm::mat4& lightView, int firstBatch, int endBatch)
+{
+	for (int batchIdx = firstBatch; batchIdx < endBatch; batchIdx++)
+	{
+		const ShadowBatch& batch = shadowBatches[batchIdx];
+		if (batch.firstInstance < 0)
+		{
+			bindBonePalette(*batch.meshRenderer);
+			renderShadows(lightProjection, lightView, *batch.meshRenderer);
+			continue;
+		}
+
+		//the model matrices come from the instance buffer :
+		glm::mat4 worldToLightScreen = lightProjection * lightView;
+		glUniformMatrix4fv(uniformShadowMVP, 1, false, glm::value_ptr(worldToLightScreen));
+		glUniform1i(uniformShadowUseSkeleton, false);
+		glUniform1i(uniformShadowUseInstancing, true);
+
+		batch.mesh->bindVao();
+		instanceBuffer.bindAttributes(batch.firstInstance);
+		batch.mesh->drawLodInstanced(batch.lod, batch.instanceCount);
+		instanceBuffer.unbindAttributes();
+		GLStateCache::get().bindVertexArray(0);
+	}
+}
+
+void Renderer::renderShadowBatches(float farPlane, const glm::vec3& lightPos, const std::vector<glm::mat4>& lightVPs, int firstBatch, int endBatch)
+{
+	for (int batchIdx = firstBatch; batchIdx < endBatch; batchIdx++)
 	{
-		int lightIdx = pointLightCullingInfos[shadowIdx].idx;
+		const ShadowBatch& batch = shadowBatches[batchIdx];
+		glUniform1i(uniformShadowOmniFaceMask, batch.faceMask);
+		if (batch.firstInstance < 0)
+		{
+			bindBonePalette(*batch.meshRenderer);
+			renderShadows(farPlane, lightPos, lightVPs, *batch.meshRenderer);
+			continue;
+		}
+
+		for (int i = 0; i < 6; i++)
+			glUniformMatrix4fv(uniformShadowOmniVPLight[i], 1, false, glm::value_ptr(lightVPs[i]));
+		glUniform3fv(uniformShadowOmniLightPos, 1, glm::value_ptr(lightPos));
+		glUniform1f(uniformShadowOmniFarPlane, farPlane);
+		glUniform1i(uniformShadowOmniUseSkeleton, false);
+		//the model matrices come from the instance buffer :
+		glUniform1i(uniformShadowOmniUseInstancing, true);
+
+		batch.mesh->bindVao();
+		instanceBuffer.bindAttributes(batch.firstInstance);
+		batch.mesh->drawLodInstanced(batch.lod, batch.instanceCount);
+		instanceBuffer.unbindAttributes();
+		GLStateCache::get().bindVertexArray(0);
+	}
+}
 
-		if (shadowIdx < lightManager->getShadowMapCount(LightManager::POINT))
+void Renderer::renderShadowBatches(const ShadowView& shadowView, int firstBatch, int endBatch)
+{
+	if (shadowView.lightType == LightManager::POINT)
+		renderShadowBatches(shadowView.farPlane, shadowView.lightPosition, shadowView.lightVPs, firstBatch, endBatch);
+	else
+		renderShadowBatches(shadowView.lightProjection, shadowView.lightView, firstBatch, endBatch);
+}
+
+void Renderer::renderShadowMap(const ShadowView& shadowView)
+{
+	const int endBatch = shadowView.firstBatch + shadowView.batchCount;
+	int firstDynamicBatch = shadowView.firstBatch;
+
+	if (shadowCaching && shadowView.staticBatchCount > 0)
+	{
+		//the transforms of the omnidirectional faces only depend on the position and the range of the light :
+		const glm::mat4 lightTransform = (shadowView.lightType == LightManager::POINT) ? shadowView.lightVPs[0] : shadowView.lightProjection * shadowView.lightView;
+		if (lightManager->isStaticShadowCacheValid(shadowView.lightType, shadowView.shadowIdx, lightTransform, shadowView.staticCastersHash))
+		{
+			shadowCacheStats.hitCount++;
+		}
+		else
 		{
-			lightManager->bindShadowMapFBO(LightManager::POINT, shadowIdx);
+			lightManager->bindStaticShadowMapFBO(shadowView.lightType, shadowView.shadowIdx, lightTransform, shadowView.staticCastersHash);
 			glClear(GL_DEPTH_BUFFER_BIT);
-			glm::mat4 lightProjection = glm::perspective(glm::radians(90.f), 1.f, 1.f, 100.f);
-			std::vector<glm::mat4> lightVPs;
-			lightVPs.push_back(lightProjection * glm::lookAt(pointLights[lightIdx]->position, pointLights[lightIdx]->position + glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, -1.f, 0.f)) );
-			lightVPs.push_back(lightProjection * glm::lookAt(pointLights[lightIdx]->position, pointLights[lightIdx]->position + glm::vec3(-1.f, 0.f, 0.f), glm::vec3(0.f, -1.f, 0.f)));
-			lightVPs.push_back(lightProjection * glm::lookAt(pointLights[lightIdx]->position, pointLights[lightIdx]->position + glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, 0.f, 1.f)));
-			lightVPs.push_back(lightProjection * glm::lookAt(pointLights[lightIdx]->position, pointLights[lightIdx]->position + glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f, 0.f, -1.f)));
-			lightVPs.push_back(lightProjection * glm::lookAt(pointLights[lightIdx]->position, pointLights[lightIdx]->position + glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, -1.f, 0.f)));
-			lightVPs.push_back(lightProjection * glm::lookAt(pointLights[lightIdx]->position, pointLights[lightIdx]->position + glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, -1.f, 0.f)) );
-
-			for (int meshIdx = 0; meshIdx < meshRenderers.size(); meshIdx++)
-			{
-				renderShadows(100.f, pointLights[lightIdx]->position, lightVPs, *meshRenderers[meshIdx]); // draw shadow for the first spot light
-			}
-			lightManager->unbindShadowMapFBO(LightManager::POINT);
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			renderShadowBatches(shadowView, shadowView.firstBatch, shadowView.firstBatch + shadowView.staticBatchCount);
+			shadowCacheStats.missCount++;
 		}
+
+		//the static depth replaces the clear :
+		lightManager->copyStaticShadowMap(shadowView.lightType, shadowView.shadowIdx);
+		lightManager->bindShadowMapFBO(shadowView.lightType, shadowView.shadowIdx);
+		firstDynamicBatch += shadowView.staticBatchCount;
+	}
+	else
+	{
+		lightManager->bindShadowMapFBO(shadowView.lightType, shadowView.shadowIdx);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		shadowCacheStats.uncachedCount++;
+	}
+
+	renderShadowBatches(shadowView, firstDynamicBatch, endBatch);
+	lightManager->unbindShadowMapFBO(shadowView.lightType);
+}
+
+void Renderer::updateBonePalettes(std::vector<MeshRenderer*>& meshRenderers)
+{
+	bonePalettes.clear();
+	bonePaletteOffsets.clear();
+
+	for (int i = 0; i < meshRenderers.size(); i++)
+	{
+		Mesh* mesh = meshRenderers[i]->getMesh();
+		if (mesh != nullptr && mesh->getIsSkeletalMesh())
+			bonePaletteOffsets[meshRenderers[i]] = bonePalettes.add(meshRenderers[i]->getBonesTransform());
+	}
+
+	bonePalettes.upload();
+}
+
+void Renderer::bindBonePalette(const MeshRenderer& meshRenderer)
+{
+	int paletteOffset = getBonePaletteOffset(meshRenderer);
+	if (paletteOffset >= 0)
+		bonePalettes.bind(paletteOffset);
+}
+
+int Renderer::getBonePaletteOffset(const MeshRenderer& meshRenderer) const
+{
+	auto findIt = bonePaletteOffsets.find(&meshRenderer);
+	return findIt != bonePaletteOffsets.end() ? findIt->second : -1;
+}
+
+void Renderer::render(const BaseCamera& camera, std::vector<MeshRenderer*>& meshRenderers, std::vector<PointLight*>& pointLights, std::vector<DirectionalLight*>& directionalLights, std::vector<SpotLight*>& spotLights, Terrain& terrain, Skybox& skybox, std::vector<Physic::Flag*>& flags, std::vector<Billboard*>& billboards, std::vector<Physic::ParticleEmitter*>& particleEmitters, const DynamicAABBTree& spatialTree)
+{
+	int width = Application::get().getWindowWidth(), height = Application::get().getWindowHeight();
+	glm::vec3 cameraPosition = camera.getCameraPosition();
+	glm::vec3 cameraForward = camera.getCameraForward();
+
+	////////////////////////// begin scene rendering 
+
+	//the poses are ready, send them once for all the passes :
+	updateBonePalettes(meshRenderers);
+
+	//culling for objects, the shadow casters are culled per light later, with the volume of each light :
+	updateObjectCulling(camera, meshRenderers, flags, particleEmitters, spatialTree);
+
+	//gather the draws of the visible meshes, sorted to change the programs, materials and meshes as little as possible. 
+	//It selects the levels of detail, used by the shadow batches :
+	instanceBuffer.clear();
+	gPassQueue.begin(camera.getProjectionMatrix(), camera.getViewMatrix(), camera.getFar());
+	for (int i = 0; i < visibleMeshRenderers.size(); i++)
+		gPassQueue.add(*visibleMeshRenderers[i], getBonePaletteOffset(*visibleMeshRenderers[i]));
+	if (sortGPassQueue)
+		gPassQueue.sort();
+	gPassQueue.buildBatches(instanceBuffer, useInstancing);
+
+	//culling for lights, the shadow maps go to the first visible lights : 
+	updateCulling(camera, pointLights, spotLights, pointLightCullingInfos, spotLightCullingInfos);
+
+	//casters of each shadow map, culled by the volume of its light :
+	updateShadowViews(camera, meshRenderers, pointLights, directionalLights, spotLights, spatialTree);
+
+	//the instances are ready, send them once for all the passes :
+	instanceBuffer.upload();
+
+
+	//////// begin shadow pass
+	GLStateCache::get().enable(GL_DEPTH_TEST);
+
+	shadowCacheStats = ShadowCacheStats();
+	for (int viewIdx = 0; viewIdx < shadowViews.size(); viewIdx++)
+	{
+		const ShadowView& shadowView = shadowViews[viewIdx];
+
+		GLStateCache::get().useProgram(shadowView.lightType == LightManager::POINT ? glProgram_shadowPassOmni : glProgram_shadowPass);
+		renderShadowMap(shadowView);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 	
 	//////// end shadow pass
@@ -501,30 +988,18 @@ void Renderer::render(const BaseCamera& camera, std::vector<MeshRenderer*>& mesh
 	glBindFramebuffer(GL_FRAMEBUFFER, gbufferFbo);
 
 	// Default states
-	glEnable(GL_DEPTH_TEST);
+	GLStateCache::get().enable(GL_DEPTH_TEST);
 
 	// Clear the front buffer
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	//render meshes
-	for (int i = 0; i < meshRenderers.size(); i++)
-	{
-		//glm::mat4 modelMatrix = meshRenderers[i]->entity()->getModelMatrix(); //get modelMatrix
-		//glm::mat4 normalMatrix = glm::transpose(glm::inverse(modelMatrix));
-		//glm::mat4 mvp = projection * worldToView * modelMatrix;
-
-		//meshRenderers[i]->getMaterial()->use();
-		//meshRenderers[i]->getMaterial()->setUniform_MVP(mvp);
-		//meshRenderers[i]->getMaterial()->setUniform_normalMatrix(normalMatrix);
-
-		//meshRenderers[i]->getMesh()->draw();
-		meshRenderers[i]->render(projection, worldToView);
-	}
+	//render visible meshes :
+	gPassQueue.submit(bonePalettes, instanceBuffer);
 
 	//render physic flags : 
-	for (int i = 0; i < flags.size(); i++)
+	for (int i = 0; i < visibleFlags.size(); i++)
 	{
-		flags[i]->render(projection, worldToView);
+		visibleFlags[i]->render(projection, worldToView);
 	}
 
 	//render terrain :
@@ -540,36 +1015,42 @@ void Renderer::render(const BaseCamera& camera, std::vector<MeshRenderer*>& mesh
 
 	///// begin light pass
 	// Disable the depth test
-	glDisable(GL_DEPTH_TEST);
+	GLStateCache::get().disable(GL_DEPTH_TEST);
 	// Enable blending
-	glEnable(GL_BLEND);
+	GLStateCache::get().enable(GL_BLEND);
 	// Setup additive blending
-	glBlendFunc(GL_ONE, GL_ONE);
+	GLStateCache::get().blendFunc(GL_ONE, GL_ONE);
 
 
 	// Render quad
 	glm::vec4 viewport; 
 	
 	//point light : 
-	glUseProgram(glProgram_lightPass_pointLight);
+	GLStateCache::get().useProgram(glProgram_lightPass_pointLight);
 
 	// send screen to world matrix : 
 	glUniformMatrix4fv(unformScreenToWorld[POINT], 1, false, glm::value_ptr(screenToWorld));
 	glUniform3fv(uniformCameraPosition[POINT], 1, glm::value_ptr(camera.getCameraPosition()));
 
 	//geometry informations :
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
+	GLStateCache::get().activeTexture(GL_TEXTURE1);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
+	GLStateCache::get().activeTexture(GL_TEXTURE2);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
 
 	glUniform1i(uniformTexturePosition[POINT], 0);
 	glUniform1i(uniformTextureNormal[POINT], 1);
 	glUniform1i(uniformTextureDepth[POINT], 2);
+	glUniform1i(uniformTextureShadow[POINT], 3); //shadow texture, bound for each light
+	glUniform1f(uniformLightFarPlane, 100.f);
+
+	//in tiled mode, only the lights with a shadow map have their own quad :
+	const bool useTiledLighting = tiledLighting && glProgram_lightPass_tiledPointLight != 0;
+	const int quadPointLightCount = useTiledLighting ? std::min(pointLightCount, lightManager->getShadowMapCount(LightManager::POINT)) : pointLightCount;
 
-	for (int i = 0; i < pointLightCount; i++)
+	for (int i = 0; i < quadPointLightCount; i++)
 	{
 		int lightIdx = pointLightCullingInfos[i].idx;
 		viewport = pointLightCullingInfos[i].viewport;
@@ -577,42 +1058,40 @@ void Renderer::render(const BaseCamera& camera, std::vector<MeshRenderer*>& mesh
 		if (i < lightManager->getShadowMapCount(LightManager::POINT))
 		{
 			//active the shadow map texture
-			glActiveTexture(GL_TEXTURE3);
+			GLStateCache::get().activeTexture(GL_TEXTURE3);
 			lightManager->bindShadowMapTexture(LightManager::POINT, i);
-			glUniform1i(uniformTextureShadow[POINT], 3); // send shadow texture
 		}
 
-		//if (passCullingTest(viewport, projection, worldToView, camera.eye, pointLights[i]->boundingBox)) // optimisation test
-		{
-			//resize viewport
-			resizeBlitQuad(viewport);
+		//screen rectangle of the light, applied to the static quad by the vertex shader :
+		glUniform4fv(uniformLightViewport[POINT], 1, glm::value_ptr(viewport));
 
-			glUniform1f(uniformLightFarPlane, 100.f);
-
-			lightManager->uniformPointLight(*pointLights[lightIdx]);
-			quadMesh.draw();
-		}
+		lightManager->uniformPointLight(*pointLights[lightIdx]);
+		quadMesh.draw();
 	}
 
+	if (useTiledLighting)
+		renderTiledPointLights(quadPointLightCount, screenToWorld, camera.getCameraPosition(), pointLights);
+
 	//spot lights : 
 
-	glUseProgram(glProgram_lightPass_spotLight);
+	GLStateCache::get().useProgram(glProgram_lightPass_spotLight);
 
 	// send screen to world matrix : 
 	glUniformMatrix4fv(unformScreenToWorld[SPOT], 1, false, glm::value_ptr(screenToWorld));
 	glUniform3fv(uniformCameraPosition[SPOT], 1, glm::value_ptr(cameraPosition));
 
 	//geometry informations :
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
+	GLStateCache::get().activeTexture(GL_TEXTURE1);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
+	GLStateCache::get().activeTexture(GL_TEXTURE2);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
 
 	glUniform1i(uniformTexturePosition[SPOT], 0);
 	glUniform1i(uniformTextureNormal[SPOT], 1);
 	glUniform1i(uniformTextureDepth[SPOT], 2);
+	glUniform1i(uniformTextureShadow[SPOT], 3); //shadow texture, bound for each light
 
 	for (int i = 0; i < spotLightCount; i++)
 	{
@@ -623,59 +1102,49 @@ void Renderer::render(const BaseCamera& camera, std::vector<MeshRenderer*>& mesh
 		if (i < lightManager->getShadowMapCount(LightManager::SPOT))
 		{
 			//active the shadow map texture
-			glActiveTexture(GL_TEXTURE3);
+			GLStateCache::get().activeTexture(GL_TEXTURE3);
 			lightManager->bindShadowMapTexture(LightManager::SPOT, i);
-			glUniform1i(uniformTextureShadow[SPOT], 3); // send shadow texture
 		}
 
-		//if (passCullingTest(viewport , projection, worldToView, camera.eye, spotLights[i]->boundingBox)) // optimisation test
-		{
-			//resize viewport
-			resizeBlitQuad(viewport);
+		//screen rectangle of the light, applied to the static quad by the vertex shader :
+		glUniform4fv(uniformLightViewport[SPOT], 1, glm::value_ptr(viewport));
 
-			glm::mat4 projectionSpotLight = glm::perspective(spotLights[lightIdx]->angle*2.f, 1.f, 0.1f, 100.f);
-			glm::mat4 worldToLightSpotLight = glm::lookAt(spotLights[lightIdx]->position, spotLights[lightIdx]->position + spotLights[lightIdx]->direction, spotLights[lightIdx]->up);
-			glm::mat4 WorldToLightScreen = projectionSpotLight * worldToLightSpotLight;
-			glUniformMatrix4fv(uniformWorldToLightScreen_spot, 1, false, glm::value_ptr(WorldToLightScreen));
+		glm::mat4 projectionSpotLight = glm::perspective(spotLights[lightIdx]->angle*2.f, 1.f, 0.1f, 100.f);
+		glm::mat4 worldToLightSpotLight = glm::lookAt(spotLights[lightIdx]->position, spotLights[lightIdx]->position + spotLights[lightIdx]->direction, spotLights[lightIdx]->up);
+		glm::mat4 WorldToLightScreen = projectionSpotLight * worldToLightSpotLight;
+		glUniformMatrix4fv(uniformWorldToLightScreen_spot, 1, false, glm::value_ptr(WorldToLightScreen));
 
-			lightManager->uniformSpotLight(*spotLights[lightIdx]);
-			quadMesh.draw();
-		}
+		lightManager->uniformSpotLight(*spotLights[lightIdx]);
+		quadMesh.draw();
 	}
 
-	//make sure that the blit quat cover all the screen : 
-	resizeBlitQuad();
-
-	//// update in CG : 
-	//glBindBuffer(GL_ARRAY_BUFFER, quadMesh.vbo_vertices);
-	//glBufferData(GL_ARRAY_BUFFER, quadMesh.vertices.size() * sizeof(float), &(quadMesh.vertices)[0], GL_STATIC_DRAW);
-	//glBindBuffer(GL_ARRAY_BUFFER, 0);
-
 	//directionals : 
-	glUseProgram(glProgram_lightPass_directionalLight);
+	GLStateCache::get().useProgram(glProgram_lightPass_directionalLight);
+	//make sure that the quad cover all the screen : 
+	glUniform4f(uniformLightViewport[DIRECTIONAL], -1.f, -1.f, 2.f, 2.f);
 	// send screen to world matrix : 
 	glUniformMatrix4fv(unformScreenToWorld[DIRECTIONAL], 1, false, glm::value_ptr(screenToWorld));
 	glUniform3fv(uniformCameraPosition[DIRECTIONAL], 1, glm::value_ptr(cameraPosition));
 
 	//geometry informations :
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[0]);
+	GLStateCache::get().activeTexture(GL_TEXTURE1);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[1]);
+	GLStateCache::get().activeTexture(GL_TEXTURE2);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[2]);
 
 	glUniform1i(uniformTexturePosition[DIRECTIONAL], 0);
 	glUniform1i(uniformTextureNormal[DIRECTIONAL], 1);
 	glUniform1i(uniformTextureDepth[DIRECTIONAL], 2);
+	glUniform1i(uniformTextureShadow[DIRECTIONAL], 3); //shadow texture, bound for each light
 	for (int i = 0; i < directionalLights.size(); i++)
 	{
 		if (i < lightManager->getShadowMapCount(LightManager::DIRECTIONAL))
 		{
 			//active the shadow map texture
-			glActiveTexture(GL_TEXTURE3);
+			GLStateCache::get().activeTexture(GL_TEXTURE3);
 			lightManager->bindShadowMapTexture(LightManager::DIRECTIONAL, i);
-			glUniform1i(uniformTextureShadow[DIRECTIONAL], 3); // send shadow texture
 		}
 
 		//glm::mat4 projectionDirectionalLight = glm::ortho(-16.f, 16.f, -16.f, 16.f, 1.f, 100.f);
@@ -696,8 +1165,8 @@ void Renderer::render(const BaseCamera& camera, std::vector<MeshRenderer*>& mesh
 	}
 
 	// Disable blending
-	glDisable(GL_BLEND);	
-	glEnable(GL_DEPTH_TEST);
+	GLStateCache::get().disable(GL_BLEND);	
+	GLStateCache::get().enable(GL_DEPTH_TEST);
 
 	///// end light pass
 
@@ -724,16 +1193,16 @@ void Renderer::render(const BaseCamera& camera, std::vector<MeshRenderer*>& mesh
 	//render skybox : 
 	skybox.render(projection, worldToView);
 
-	glEnable(GL_BLEND);
-	glDepthMask(GL_FALSE);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLStateCache::get().enable(GL_BLEND);
+	GLStateCache::get().depthMask(GL_FALSE);
+	GLStateCache::get().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	for (int i = 0; i < billboards.size(); i++)
 		billboards[i]->render(projection, worldToView);
 
-	for (int i = 0; i < particleEmitters.size(); i++)
-		particleEmitters[i]->render(projection, worldToView);
-	glDepthMask(GL_TRUE);
-	glDisable(GL_BLEND);
+	for (int i = 0; i < visibleParticleEmitters.size(); i++)
+		visibleParticleEmitters[i]->render(projection, worldToView);
+	GLStateCache::get().depthMask(GL_TRUE);
+	GLStateCache::get().disable(GL_BLEND);
 }
 
 void Renderer::debugDrawColliders(const BaseCamera& camera, const std::vector<Entity*>& entities)
@@ -765,17 +1234,17 @@ void Renderer::debugDrawDeferred()
 	int width = Application::get().getWindowWidth(), height = Application::get().getWindowHeight();
 
 	///////////// begin draw blit quad
-	glDisable(GL_DEPTH_TEST);
+	GLStateCache::get().disable(GL_DEPTH_TEST);
 
-	glUseProgram(glProgram_blit);
+	GLStateCache::get().useProgram(glProgram_blit);
 
 	for (int i = 0; i < 3; i++)
 	{
 		glViewport((width * i) / 4, 0, width / 4, height / 4);
 
-		glActiveTexture(GL_TEXTURE0);
+		GLStateCache::get().activeTexture(GL_TEXTURE0);
 		// Bind gbuffer color texture
-		glBindTexture(GL_TEXTURE_2D, gbufferTextures[i]);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, gbufferTextures[i]);
 		glUniform1i(uniformTextureBlit, 0);
 
 		quadMesh.draw();
@@ -785,7 +1254,7 @@ void Renderer::debugDrawDeferred()
 	if (lightManager->getShadowMapCount(LightManager::DIRECTIONAL) > 0)
 	{
 		glViewport((width * 3) / 4, 0, width / 4, height / 4);
-		glActiveTexture(GL_TEXTURE0);
+		GLStateCache::get().activeTexture(GL_TEXTURE0);
 		lightManager->bindShadowMapTexture(LightManager::DIRECTIONAL, 0);
 		glUniform1i(uniformTextureBlit, 0);
 
@@ -795,7 +1264,7 @@ void Renderer::debugDrawDeferred()
 
 	glViewport(0, 0, width, height);
 
-	glEnable(GL_DEPTH_TEST);
+	GLStateCache::get().enable(GL_DEPTH_TEST);
 	///////////// end draw blit quad
 }
 
@@ -819,128 +1288,56 @@ void Renderer::debugDrawLights(const BaseCamera& camera, const std::vector<Point
 }
 
 
-bool Renderer::passCullingTest(glm::vec4& viewport, const glm::mat4& projection, const glm::mat4& view, const glm::vec3 cameraPosition, BoxCollider& collider)
+bool Renderer::passCullingTest(glm::vec4& viewport, const Frustum& frustum, const glm::mat4& projection, const glm::mat4& view, const glm::vec3 cameraPosition, BoxCollider& collider)
 {
-	glm::vec3 topRight = collider.topRight;
-	glm::vec3 bottomLeft = collider.bottomLeft;
+	glm::vec3 topRight = glm::max(collider.topRight, collider.bottomLeft);
+	glm::vec3 bottomLeft = glm::min(collider.topRight, collider.bottomLeft);
 
-	bool insideFrustum = false;
+	//the whole screen by default :
+	viewport = glm::vec4(-1, -1, 2, 2);
 
-	float maxX = 1;
-	float maxY = 1;
-	float minX = -1;
-	float minY = -1;
+	//first optimisation : we don't have to draw the light if its bounding box is outside the camera frustum
+	if (frustumCulling && !frustum.testAABB(bottomLeft, topRight))
+		return false;
 
-	//first optimisation : test if the light is inside camera frustum 
-
-	//is camera outside light bounding box ? 
-	if (!(cameraPosition.x > bottomLeft.x && cameraPosition.x < topRight.x &&
+	//we draw the light on the whole screen if we are inside its bounding box
+	if (cameraPosition.x > bottomLeft.x && cameraPosition.x < topRight.x &&
 		cameraPosition.y > bottomLeft.y && cameraPosition.y < topRight.y &&
-		cameraPosition.z > bottomLeft.z && cameraPosition.z < topRight.z))
-	{
-
-		// ce code semble plus optimis que celui retenu, mais je n'ai pas russi  le faire marcher convenablement pour deux raisons : 
-		// le carr gnr est trop petit, il n'englobe pas tout le champs d'action de la lumire
-		// il y a des bugs lorsqu'on place la camera au dessus ou en dessous de la lumire, la rotation s'effectue mal et le collider se deforme.
-		
-		/*
-		// permet au collider d'tre toujours face  la camera. 
-		//cela permet d'viter les erreurs du au caractre "AABB" du collider.
-		//en effet, on stock le collider avec une seule diagonale (deux points), il faut qu'une fois projet en repre ecrant cette diagonale soit aussi celle du carr projet.
-		glm::vec3 camToCollider = glm::normalize(collider.translation - cameraPosition);
-		glm::mat4 facingCameraRotation = glm::lookAt(camToCollider, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
-		facingCameraRotation = glm::inverse(glm::mat4(facingCameraRotation));
-
-		collider.applyRotation(glm::quat(facingCameraRotation));
-
-		glm::vec4 tmpTopRight = projection * view  * glm::vec4(topRight, 1);
-		glm::vec4 tmpBottomLeft = projection * view  * glm::vec4(bottomLeft, 1);
-
-		topRight = glm::vec3(tmpTopRight.x / tmpTopRight.w, tmpTopRight.y / tmpTopRight.w, tmpTopRight.z / tmpTopRight.w);
-		bottomLeft = glm::vec3(tmpBottomLeft.x / tmpBottomLeft.w, tmpBottomLeft.y / tmpBottomLeft.w, tmpBottomLeft.z / tmpBottomLeft.w);
-		//now, topRight and bottom left are in screen space, and their coordinates are between -1 and 1 on all axis.
-
-		//is light outside the camera frustum ? 
-		if ((topRight.x < -1 && bottomLeft.x < -1) || (topRight.y < -1 && bottomLeft.y < -1)
-			|| (topRight.x > 1 && bottomLeft.x > 1) || (topRight.y > 1 && bottomLeft.y > 1))
-		{
-			//we don't have to draw the light if its bounding box is outside the camera frustum
-			insideFrustum = false;
-		}
-		*/
-
-		//compute 8 points of 3D collider : 
+		cameraPosition.z > bottomLeft.z && cameraPosition.z < topRight.z)
+		return true;
 
-		float colliderWidth = glm::abs(topRight.x - bottomLeft.x);
-		float colliderDepth = glm::abs(topRight.z - bottomLeft.z);
-
-		glm::vec3 colliderPoints[8] = { bottomLeft, glm::vec3(bottomLeft.x, bottomLeft.y, bottomLeft.z + colliderDepth), glm::vec3(bottomLeft.x + colliderWidth, bottomLeft.y, bottomLeft.z), glm::vec3(bottomLeft.x + colliderWidth, bottomLeft.y, bottomLeft.z + colliderDepth),
-										topRight, glm::vec3(topRight.x, topRight.y, topRight.z - colliderDepth), glm::vec3(topRight.x - colliderWidth, topRight.y, topRight.z), glm::vec3(topRight.x - colliderWidth, topRight.y, topRight.z - colliderDepth) };
-
-		glm::mat4 vp = projection * view;
-		glm::vec4 tmpColliderPoint;
-		maxX = -1;
-		maxY = -1;
-		minX = 1;
-		minY = 1;
-		for (int i = 0; i < 8; i++)
-		{
-			tmpColliderPoint = projection * view * glm::vec4(colliderPoints[i], 1);
-			colliderPoints[i] = glm::vec3(tmpColliderPoint.x / tmpColliderPoint.w, tmpColliderPoint.y / tmpColliderPoint.w, tmpColliderPoint.z / tmpColliderPoint.w);
-		
-			if (colliderPoints[i].x > maxX)
-				maxX = colliderPoints[i].x;
-			if(colliderPoints[i].x < minX)
-				minX = colliderPoints[i].x;
-
-			if (colliderPoints[i].y > maxY)
-				maxY = colliderPoints[i].y;
-			if (colliderPoints[i].y < minY)
-				minY = colliderPoints[i].y;
-		}
-
-		//is light outside the camera frustum ? 
-		if ((maxX < -1 && minX < -1) || (maxY < -1 && minY < -1)
-			|| (maxX > 1 && minX > 1) || (maxY > 1 && minY > 1))
-		{
-			//we don't have to draw the light if its bounding box is outside the camera frustum
-			insideFrustum = false;
-		}
+	//second optimisation : we reduce the quad to the screen rectangle of the bounding box
+	glm::mat4 vp = projection * view;
+	float maxX = -1;
+	float maxY = -1;
+	float minX = 1;
+	float minY = 1;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 colliderPoint((i & 1) ? topRight.x : bottomLeft.x, (i & 2) ? topRight.y : bottomLeft.y, (i & 4) ? topRight.z : bottomLeft.z);
+		glm::vec4 tmpColliderPoint = vp * glm::vec4(colliderPoint, 1);
 
+		//a point behind the camera has no valid projection, keep the whole screen :
+		if (tmpColliderPoint.w <= 0.f)
+			return true;
 
-		//we have to draw the light if its boudning box is inside/intersect the camera frustum
-		insideFrustum = true;
+		minX = std::min(minX, tmpColliderPoint.x / tmpColliderPoint.w);
+		maxX = std::max(maxX, tmpColliderPoint.x / tmpColliderPoint.w);
+		minY = std::min(minY, tmpColliderPoint.y / tmpColliderPoint.w);
+		maxY = std::max(maxY, tmpColliderPoint.y / tmpColliderPoint.w);
 	}
-	//we draw the light if we are inside its bounding box
-	insideFrustum = true;
 
+	minX = glm::clamp(minX, -1.f, 1.f);
+	maxX = glm::clamp(maxX, -1.f, 1.f);
+	minY = glm::clamp(minY, -1.f, 1.f);
+	maxY = glm::clamp(maxY, -1.f, 1.f);
 
+	//the box can pass the plane tests near a corner of the frustum and still be out of the screen :
+	if (frustumCulling && (maxX <= minX || maxY <= minY))
+		return false;
 
-
-	//second optimisation : we modify the quad verticies such that it is reduce to the area of the light
-	if (insideFrustum)
-	{
-		float width = maxX - minX;
-		float height = maxY - minY;
-		viewport = glm::vec4(minX, minY, width, height);
-
-		//quadMesh.vertices = { minX, minY, minX + width, minY, minX, minY + height, minX + width , minY + height };
-		//// update in CG : 
-		//glBindBuffer(GL_ARRAY_BUFFER, quadMesh.vbo_vertices);
-		//glBufferData(GL_ARRAY_BUFFER, quadMesh.vertices.size() * sizeof(float), &(quadMesh.vertices)[0], GL_STATIC_DRAW);
-		//glBindBuffer(GL_ARRAY_BUFFER, 0);
-	}
-
-	return insideFrustum;
-}
-
-void Renderer::resizeBlitQuad(const glm::vec4 & viewport)
-{
-	quadMesh.vertices = { viewport.x, viewport.y, viewport.x + viewport.z, viewport.y, viewport.x, viewport.y + viewport.w, viewport.x + viewport.z , viewport.y + viewport.w };
-	// update in CG : 
-	glBindBuffer(GL_ARRAY_BUFFER, quadMesh.vbo_vertices);
-	glBufferData(GL_ARRAY_BUFFER, quadMesh.vertices.size() * sizeof(float), &(quadMesh.vertices)[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	viewport = glm::vec4(minX, minY, maxX - minX, maxY - minY);
+	return true;
 }
 
 
@@ -949,179 +1346,116 @@ void Renderer::resizeBlitQuad(const glm::vec4 & viewport)
 void Renderer::updateCulling(const BaseCamera& camera, std::vector<PointLight*>& pointLights, std::vector<SpotLight*>& spotLights, std::vector<LightCullingInfo>& pointLightCullingInfos, std::vector<LightCullingInfo>& spotLightCullingInfos )
 {
 	glm::vec3 cameraPosition = camera.getCameraPosition();
-
-
-	if (!pointLightCullingInfos.empty())
-		pointLightCullingInfos.clear();
-	if (!spotLightCullingInfos.empty())
-		spotLightCullingInfos.clear();
-
-	bool insideFrustum = false;
-
-	float maxX = 1;
-	float maxY = 1;
-	float minX = -1;
-	float minY = -1;
-
-	pointLightCount = 0;
-	spotLightCount = 0;
-
-	int width = Application::get().getWindowWidth();
-	int height = Application::get().getWindowHeight();
-
 	glm::mat4 projection = camera.getProjectionMatrix(); //glm::perspective(45.0f, (float)width / (float)height, 0.1f, 1000.f);
 	glm::mat4 view = camera.getViewMatrix(); //glm::lookAt(camera.eye, camera.o, camera.up);
+	Frustum frustum(projection * view);
 
-	int lastId = pointLights.size() - 1;;
+	pointLightCullingInfos.clear();
+	spotLightCullingInfos.clear();
+
+	glm::vec4 viewport;
 	for (int i = 0; i < pointLights.size(); i++)
 	{
-
-		BoxCollider& collider = pointLights[i]->boundingBox;
-		glm::vec3 topRight = collider.topRight;
-		glm::vec3 bottomLeft = collider.bottomLeft;
-
-
-		if (!(cameraPosition.x > bottomLeft.x && cameraPosition.x < topRight.x && cameraPosition.y > bottomLeft.y && cameraPosition.y < topRight.y && cameraPosition.z > bottomLeft.z && cameraPosition.z < topRight.z))
-		{
-
-			//compute 8 points of 3D collider : 
-
-			float colliderWidth = glm::abs(topRight.x - bottomLeft.x);
-			float colliderDepth = glm::abs(topRight.z - bottomLeft.z);
-
-			glm::vec3 colliderPoints[8] = { bottomLeft, glm::vec3(bottomLeft.x, bottomLeft.y, bottomLeft.z + colliderDepth), glm::vec3(bottomLeft.x + colliderWidth, bottomLeft.y, bottomLeft.z), glm::vec3(bottomLeft.x + colliderWidth, bottomLeft.y, bottomLeft.z + colliderDepth),
-				topRight, glm::vec3(topRight.x, topRight.y, topRight.z - colliderDepth), glm::vec3(topRight.x - colliderWidth, topRight.y, topRight.z), glm::vec3(topRight.x - colliderWidth, topRight.y, topRight.z - colliderDepth) };
-
-			glm::mat4 vp = projection * view;
-			glm::vec4 tmpColliderPoint;
-			maxX = -1;
-			maxY = -1;
-			minX = 1;
-			minY = 1;
-			for (int i = 0; i < 8; i++)
-			{
-				tmpColliderPoint = projection * view * glm::vec4(colliderPoints[i], 1);
-				colliderPoints[i] = glm::vec3(tmpColliderPoint.x / tmpColliderPoint.w, tmpColliderPoint.y / tmpColliderPoint.w, tmpColliderPoint.z / tmpColliderPoint.w);
-
-				if (colliderPoints[i].x > maxX)
-					maxX = colliderPoints[i].x;
-				if (colliderPoints[i].x < minX)
-					minX = colliderPoints[i].x;
-
-				if (colliderPoints[i].y > maxY)
-					maxY = colliderPoints[i].y;
-				if (colliderPoints[i].y < minY)
-					minY = colliderPoints[i].y;
-			}
-
-
-			//is light outside the camera frustum ? 
-			if ((maxX < -1 && minX < -1) || (maxY < -1 && minY < -1)
-				|| (maxX > 1 && minX > 1) || (maxY > 1 && minY > 1))
-			{
-				//PointLight* tmpLight = pointLights[i];
-				//pointLights[i] = pointLights[lastId];
-				//pointLights[lastId] = tmpLight;
-
-				//lastId--;
-				//i--;
-
-				//we don't have to draw the light if its bounding box is outside the camera frustum
-				insideFrustum = false;
-			}
-
-			//we have to draw the light if its boudning box is inside/intersect the camera frustum
-			insideFrustum = true;
-		}
-		//we draw the light if we are inside its bounding box
-		insideFrustum = true;
-
-		//second optimisation : we modify the quad verticies such that it is reduce to the area of the light
-		if (insideFrustum)
-		{
-			float width = maxX - minX;
-			float height = maxY - minY;
-			
-			pointLightCullingInfos.push_back(LightCullingInfo(glm::vec4(minX, minY, width, height), i));
-		}
-
+		if (passCullingTest(viewport, frustum, projection, view, cameraPosition, pointLights[i]->boundingBox))
+			pointLightCullingInfos.push_back(LightCullingInfo(viewport, i));
 	}
 
-	//lastId = spotLights.size() - 1;
 	for (int i = 0; i < spotLights.size(); i++)
 	{
+		if (passCullingTest(viewport, frustum, projection, view, cameraPosition, spotLights[i]->boundingBox))
+			spotLightCullingInfos.push_back(LightCullingInfo(viewport, i));
+	}
 
-		BoxCollider& collider = spotLights[i]->boundingBox;
-		glm::vec3 topRight = collider.topRight;
-		glm::vec3 bottomLeft = collider.bottomLeft;
-
-
-		if (!(cameraPosition.x > bottomLeft.x && cameraPosition.x < topRight.x && cameraPosition.y > bottomLeft.y && cameraPosition.y < topRight.y && cameraPosition.z > bottomLeft.z && cameraPosition.z < topRight.z))
-		{
-			//compute 8 points of 3D collider : 
-
-			float colliderWidth = glm::abs(topRight.x - bottomLeft.x);
-			float colliderDepth = glm::abs(topRight.z - bottomLeft.z);
+	spotLightCount = spotLightCullingInfos.size();
+	pointLightCount = pointLightCullingInfos.size();
 
-			glm::vec3 colliderPoints[8] = { bottomLeft, glm::vec3(bottomLeft.x, bottomLeft.y, bottomLeft.z + colliderDepth), glm::vec3(bottomLeft.x + colliderWidth, bottomLeft.y, bottomLeft.z), glm::vec3(bottomLeft.x + colliderWidth, bottomLeft.y, bottomLeft.z + colliderDepth),
-				topRight, glm::vec3(topRight.x, topRight.y, topRight.z - colliderDepth), glm::vec3(topRight.x - colliderWidth, topRight.y, topRight.z), glm::vec3(topRight.x - colliderWidth, topRight.y, topRight.z - colliderDepth) };
+	cullingStats.visibleLightCount = pointLightCount + spotLightCount;
+	cullingStats.culledLightCount = (pointLights.size() + spotLights.size()) - cullingStats.visibleLightCount;
+}
 
-			glm::mat4 vp = projection * view;
-			glm::vec4 tmpColliderPoint;
-			maxX = -1;
-			maxY = -1;
-			minX = 1;
-			minY = 1;
-			for (int i = 0; i < 8; i++)
-			{
-				tmpColliderPoint = projection * view * glm::vec4(colliderPoints[i], 1);
-				colliderPoints[i] = glm::vec3(tmpColliderPoint.x / tmpColliderPoint.w, tmpColliderPoint.y / tmpColliderPoint.w, tmpColliderPoint.z / tmpColliderPoint.w);
-
-				if (colliderPoints[i].x > maxX)
-					maxX = colliderPoints[i].x;
-				if (colliderPoints[i].x < minX)
-					minX = colliderPoints[i].x;
-
-				if (colliderPoints[i].y > maxY)
-					maxY = colliderPoints[i].y;
-				if (colliderPoints[i].y < minY)
-					minY = colliderPoints[i].y;
-			}
+void Renderer::updateObjectCulling(const BaseCamera& camera, std::vector<MeshRenderer*>& meshRenderers, std::vector<Physic::Flag*>& flags, std::vector<Physic::ParticleEmitter*>& particleEmitters, const DynamicAABBTree& spatialTree)
+{
+	visibleMeshRenderers.clear();
+	visibleFlags.clear();
+	visibleParticleEmitters.clear();
 
+	if (frustumCulling)
+	{
+		//only the subtrees intersecting the frustum are visited :
+		visibleComponents.clear();
+		spatialTree.queryFrustum(Frustum(camera.getProjectionMatrix() * camera.getViewMatrix()), visibleComponents);
 
-			//is light outside the camera frustum ? 
-			if ((maxX < -1 && minX < -1) || (maxY < -1 && minY < -1)
-				|| (maxX > 1 && minX > 1) || (maxY > 1 && minY > 1))
+		glm::vec3 boundsMin, boundsMax;
+		for (int i = 0; i < visibleComponents.size(); i++)
+		{
+			switch (visibleComponents[i]->type())
 			{
-				//SpotLight* tmpLight = spotLights[i];
-				//spotLights[i] = spotLights[lastId];
-				//spotLights[lastId] = tmpLight;
-
-				//lastId--;
-				//i--;
-
-				//we don't have to draw the light if its bounding box is outside the camera frustum
-				insideFrustum = false;
+			case Component::MESH_RENDERER:
+				visibleMeshRenderers.push_back(static_cast<MeshRenderer*>(visibleComponents[i]));
+				break;
+			case Component::FLAG:
+				visibleFlags.push_back(static_cast<Physic::Flag*>(visibleComponents[i]));
+				break;
+			case Component::PARTICLE_EMITTER:
+				//an emitter without alive particles has nothing to draw :
+				if (static_cast<Physic::ParticleEmitter*>(visibleComponents[i])->getBounds(boundsMin, boundsMax))
+					visibleParticleEmitters.push_back(static_cast<Physic::ParticleEmitter*>(visibleComponents[i]));
+				break;
+			default:
+				//lights are culled by updateCulling
+				break;
 			}
-
-			//we have to draw the light if its boudning box is inside/intersect the camera frustum
-			insideFrustum = true;
 		}
+	}
+	else
+	{
+		visibleMeshRenderers = meshRenderers;
+		visibleFlags = flags;
+		visibleParticleEmitters = particleEmitters;
+	}
 
-		//we draw the light if we are inside its bounding box
-		insideFrustum = true;
-
-		//second optimisation : we modify the quad verticies such that it is reduce to the area of the light
-		if (insideFrustum)
-		{
-			float width = maxX - minX;
-			float height = maxY - minY;
+	cullingStats.visibleMeshRendererCount = visibleMeshRenderers.size();
+	cullingStats.culledMeshRendererCount = meshRenderers.size() - visibleMeshRenderers.size();
+	cullingStats.visibleFlagCount = visibleFlags.size();
+	cullingStats.culledFlagCount = flags.size() - visibleFlags.size();
+	cullingStats.visibleParticleEmitterCount = visibleParticleEmitters.size();
+	cullingStats.culledParticleEmitterCount = particleEmitters.size() - visibleParticleEmitters.size();
+}
 
-			spotLightCullingInfos.push_back(LightCullingInfo(glm::vec4(minX, minY, width, height), i));
-		}
-	}
+const RenderCullingStats& Renderer::getCullingStats() const
+{
+	return cullingStats;
+}
 
-	spotLightCount = spotLightCullingInfos.size();
-	pointLightCount = pointLightCullingInfos.size();
+const ShadowCacheStats& Renderer::getShadowCacheStats() const
+{
+	return shadowCacheStats;
+}
 
-}
\ No newline at end of file
+void Renderer::drawUI()
+{
+	ImGui::Checkbox("frustum culling", &frustumCulling);
+	ImGui::Text("meshes : %d visible, %d culled", cullingStats.visibleMeshRendererCount, cullingStats.culledMeshRendererCount);
+	ImGui::Text("flags : %d visible, %d culled", cullingStats.visibleFlagCount, cullingStats.culledFlagCount);
+	ImGui::Text("particle emitters : %d visible, %d culled", cullingStats.visibleParticleEmitterCount, cullingStats.culledParticleEmitterCount);
+	ImGui::Text("point and spot lights : %d visible, %d culled", cullingStats.visibleLightCount, cullingStats.culledLightCount);
+
+	ImGui::Checkbox("sort gPass draws", &sortGPassQueue);
+	const RenderQueueStats& queueStats = gPassQueue.getStats();
+	ImGui::Text("gPass : %d draws, %d material changes, %d mesh changes", queueStats.drawCount, queueStats.materialChangeCount, queueStats.meshChangeCount);
+
+	ImGui::Checkbox("instancing", &useInstancing);
+	ImGui::Text("gPass : %d instanced draws for %d sub meshes", queueStats.instancedDrawCount, queueStats.instancedItemCount);
+	ImGui::Checkbox("shadow caster culling", &shadowCasterCulling);
+	ImGui::Text("shadows : %d draws for %d shadow maps", (int)shadowBatches.size(), (int)shadowViews.size());
+	ImGui::Text("shadow casters : %d kept, %d culled (all shadow maps)", cullingStats.visibleShadowCasterCount, cullingStats.culledShadowCasterCount);
+
+	ImGui::Checkbox("shadow caching", &shadowCaching);
+	ImGui::Text("shadow caches : %d hits, %d misses, %d uncached", shadowCacheStats.hitCount, shadowCacheStats.missCount, shadowCacheStats.uncachedCount);
+
+	ImGui::Checkbox("tiled lighting", &tiledLighting);
+	ImGui::Text("tiles : %d x %d of %d pixels", lightTileGrid.getTileCountX(), lightTileGrid.getTileCountY(), lightTileGrid.getTileSize());
+	ImGui::Text("tiled point lights : %d, at most %d per tile", (int)tiledLightViewports.size(), lightTileGrid.getMaxTileLightCount());
+
+	GLStateCache::get().drawUI();
+}
@@ -12,6 +12,15 @@
 #include "Materials.h"
 #include "Flag.h"
 #include "ParticleEmitter.h"
+#include "BonePaletteBuffer.h"
+#include "Frustum.h"
+#include "DynamicAABBTree.h"
+#include "RenderQueue.h"
+#include "InstanceBuffer.h"
+#include "LightTileGrid.h"
+
+#include <unordered_map>
+#include <algorithm>
 
 struct LightCullingInfo
 {
@@ -21,6 +30,63 @@ struct LightCullingInfo
 	inline LightCullingInfo(const glm::vec4& _viewport, int _idx) : viewport(_viewport), idx(_idx) {}
 };
 
+//shadow casters sharing a mesh and a shadow level of detail, drawn with a single instanced draw :
+struct ShadowBatch
+{
+	static const int ALL_FACES = 63;
+
+	Mesh* mesh;
+	int lod;
+	MeshRenderer* meshRenderer; //the caster of the batches which aren't instanced (single or skinned casters)
+	int firstInstance; //in the instance buffer, -1 if the batch isn't instanced
+	int instanceCount;
+	int faceMask; //omnidirectional shadow maps : one bit per cube face seen by the casters of the batch
+};
+
+//a shadow map rendered at this frame : the matrices of its light and the batches of the casters inside the light volume.
+struct ShadowView
+{
+	LightManager::LightType lightType;
+	int shadowIdx;
+	glm::mat4 lightProjection;
+	glm::mat4 lightView; //identity for point lights
+	glm::vec3 lightPosition;
+	float farPlane;
+	std::vector<glm::mat4> lightVPs; //point lights, one per cube face
+
+	int firstBatch; //in the shadow batches of the renderer
+	int staticBatchCount; //the batches of the static casters come first
+	int batchCount;
+	unsigned long long staticCastersHash; //changes with the static casters of the view, their meshes, levels of detail and transforms
+};
+
+//objects and lights kept or rejected by the camera frustum at the last frame :
+struct RenderCullingStats
+{
+	int visibleMeshRendererCount;
+	int culledMeshRendererCount;
+	int visibleFlagCount;
+	int culledFlagCount;
+	int visibleParticleEmitterCount;
+	int culledParticleEmitterCount;
+	int visibleLightCount; //point and spot lights, directional lights are never culled
+	int culledLightCount;
+	int visibleShadowCasterCount; //summed over the shadow maps
+	int culledShadowCasterCount;
+
+	RenderCullingStats();
+};
+
+//shadow maps drawn at the last frame, by use of their static cache :
+struct ShadowCacheStats
+{
+	int hitCount; //the static depth was only copied
+	int missCount; //the static depth was rendered again, after a change of the light or of a static caster
+	int uncachedCount; //caching disabled or no static caster, all the casters were rendered
+
+	ShadowCacheStats();
+};
+
 
 class Renderer
 {
@@ -36,12 +102,17 @@ private:
 
 	//uniform for unidirectional shadow map
 	GLuint uniformShadowMVP;
+	GLuint uniformShadowUseSkeleton;
+	GLuint uniformShadowUseInstancing;
 
 	//uniforms for omniDirectional shadow map : 
 	GLuint uniformShadowOmniModelMatrix;
 	GLuint uniformShadowOmniVPLight[6];
 	GLuint uniformShadowOmniFarPlane;
 	GLuint uniformShadowOmniLightPos;
+	GLuint uniformShadowOmniUseSkeleton;
+	GLuint uniformShadowOmniUseInstancing;
+	GLuint uniformShadowOmniFaceMask;
 
 	GLuint uniformTexturePosition[3];
 	GLuint uniformTextureNormal[3];
@@ -52,6 +123,7 @@ private:
 	GLuint uniformWorldToLightScreen_spot;
 	GLuint uniformWorldToLightScreen_directional;
 	GLuint uniformLightFarPlane;
+	GLuint uniformLightViewport[3]; //screen rectangle of the light, the quad mesh is never resized
 
 	Mesh quadMesh;
 
@@ -74,6 +146,59 @@ private:
 	std::vector<LightCullingInfo> pointLightCullingInfos;
 	std::vector<LightCullingInfo> spotLightCullingInfos;
 
+	//for object culling :
+	bool frustumCulling;
+	std::vector<Component*> visibleComponents; //result of the frustum query in the spatial tree
+	std::vector<MeshRenderer*> visibleMeshRenderers;
+	std::vector<Physic::Flag*> visibleFlags;
+	std::vector<Physic::ParticleEmitter*> visibleParticleEmitters;
+	RenderCullingStats cullingStats;
+
+	//bone palettes of the skinned meshes, packed once per frame and shared by the gPass and the shadow passes :
+	BonePaletteBuffer bonePalettes;
+	std::unordered_map<const MeshRenderer*, int> bonePaletteOffsets; //offset of the palette of each skinned mesh renderer
+
+	//draw calls of the gPass, sorted by program, material, mesh and depth :
+	RenderQueue gPassQueue;
+	bool sortGPassQueue;
+
+	//model matrices of the instanced draws of the gPass and the shadow passes, packed once per frame :
+	InstanceBuffer instanceBuffer;
+	bool useInstancing;
+	std::vector<MeshRenderer*> shadowCasters;
+	std::vector<ShadowBatch> shadowBatches;
+
+	//shadow caching : the static casters are rendered in a cached depth per shadow map, copied each frame before the dynamic casters :
+	bool shadowCaching;
+	ShadowCacheStats shadowCacheStats;
+
+	//per light shadow caster culling, each shadow map only draws the casters inside the volume of its light :
+	bool shadowCasterCulling;
+	std::vector<ShadowView> shadowViews;
+	std::vector<Component*> shadowCasterComponents; //result of the light volume query in the spatial tree
+	std::unordered_map<const MeshRenderer*, unsigned long long> staticCasterHashes;
+
+	//tiled deferred lighting : the point lights without shadow map are binned in screen tiles and drawn in a single fullscreen pass :
+	bool tiledLighting;
+	LightTileGrid lightTileGrid;
+	GLuint glProgram_lightPass_tiledPointLight;
+	GLuint uniformTiledTextureColor;
+	GLuint uniformTiledTextureNormal;
+	GLuint uniformTiledTextureDepth;
+	GLuint uniformTiledScreenToWorld;
+	GLuint uniformTiledCameraPosition;
+	GLuint uniformTiledLights;
+	GLuint uniformTiledTileLights;
+	GLuint uniformTiledLightIndices;
+	GLuint uniformTiledTileSize;
+	GLuint uniformTiledTileCountX;
+	GLuint uniformTiledViewport;
+	//texture buffers of the lights, of the tiles (offset and count) and of the light indices :
+	GLuint tiledLightBuffers[3];
+	GLuint tiledLightTextures[3];
+	std::vector<glm::vec4> tiledLightViewports;
+	std::vector<glm::vec4> tiledLightData; //position and intensity, then color, for each light
+
 	////shadows : 
 	//GLuint shadowFrameBuffer;
 	//GLuint shadowRenderBuffer;
@@ -91,14 +216,52 @@ public:
 
 	void initialyzeShadowMapping(std::string progamShadowPass_vert_path, std::string progamShadowPass_frag_path, std::string progamShadowPassOmni_vert_path, std::string progamShadowPassOmni_frag_path, std::string progamShadowPassOmni_geom_path);
 
+	//initialyze the program and the texture buffers of the tiled point light pass.
+	void initTiledLighting(std::string programTiledPointLight_vert_path, std::string programTiledPointLight_frag_path);
+
+	//bin the point lights from firstLight in the screen tiles, upload the tile lists and render them with a single fullscreen quad.
+	void renderTiledPointLights(int firstLight, const glm::mat4& screenToWorld, const glm::vec3& cameraPosition, std::vector<PointLight*>& pointLights);
+
 	//render a shadow on a shadow map
 	void renderShadows(const glm::mat4& lightProjection, const glm::mat4& lightView, MeshRenderer& meshRenderer);
 
 	//render a shadow on a shadow map
 	void renderShadows(float farPlane, const glm::vec3 & lightPos, const std::vector<glm::mat4>& lightVPs, MeshRenderer & meshRenderer);
 
+	//fill the shadow views of the shadowed lights, with the batches of the casters inside their volumes. Call it after updateCulling.
+	void updateShadowViews(const BaseCamera& camera, std::vector<MeshRenderer*>& meshRenderers, std::vector<PointLight*>& pointLights, std::vector<DirectionalLight*>& directionalLights, std::vector<SpotLight*>& spotLights, const DynamicAABBTree& spatialTree);
+
+	//radius of influence of a light, from its bounding box, at most farPlane.
+	float getShadowRange(const BoxCollider& boundingBox, float farPlane) const;
+
+	//fill shadowCasters with the casters inside the volume of the light : orthographic box for directional lights, range sphere for point lights, range sphere and cone for spot lights.
+	void cullShadowCasters(const ShadowView& shadowView, float range, std::vector<MeshRenderer*>& meshRenderers, const DynamicAABBTree& spatialTree);
+
+	//group shadowCasters by staticity, mesh and shadow level of detail in the shadow batches of the view, and add the model matrices of the instanced batches in the instance buffer.
+	void addShadowView(ShadowView& shadowView);
+
+	//render the shadow batches from firstBatch to endBatch (excluded) on a shadow map
+	void renderShadowBatches(const glm::mat4& lightProjection, const glm::mat4& lightView, int firstBatch, int endBatch);
+
+	//render the shadow batches from firstBatch to endBatch (excluded) on an omnidirectional shadow map
+	void renderShadowBatches(float farPlane, const glm::vec3& lightPos, const std::vector<glm::mat4>& lightVPs, int firstBatch, int endBatch);
+
+	//render the shadow batches from firstBatch to endBatch (excluded) with the matrices of a shadow view
+	void renderShadowBatches(const ShadowView& shadowView, int firstBatch, int endBatch);
+
+	//render a shadow map : copy of its static cache (rendered again if it is out of date), then the dynamic casters.
+	void renderShadowMap(const ShadowView& shadowView);
+
+	//pack the bone palettes of the skinned mesh renderers in the bone palette buffer, and upload it.
+	void updateBonePalettes(std::vector<MeshRenderer*>& meshRenderers);
+
+	//bind the bone palette of a mesh renderer, if it is skinned.
+	void bindBonePalette(const MeshRenderer& meshRenderer);
+	//offset of the bone palette of a mesh renderer in the bone palette buffer, -1 if it isn't skinned.
+	int getBonePaletteOffset(const MeshRenderer& meshRenderer) const;
+
 	//render all entities of the scene, using deferred shading.
-	void render(const BaseCamera& camera, std::vector<MeshRenderer*>& meshRenderers, std::vector<PointLight*>& pointLights, std::vector<DirectionalLight*>& directionalLights, std::vector<SpotLight*>& spotLights, Terrain& terrain, Skybox& skybox, std::vector<Physic::Flag*>& flags, std::vector<Billboard*>& billboards, std::vector<Physic::ParticleEmitter*>& particleEmitters);
+	void render(const BaseCamera& camera, std::vector<MeshRenderer*>& meshRenderers, std::vector<PointLight*>& pointLights, std::vector<DirectionalLight*>& directionalLights, std::vector<SpotLight*>& spotLights, Terrain& terrain, Skybox& skybox, std::vector<Physic::Flag*>& flags, std::vector<Billboard*>& billboards, std::vector<Physic::ParticleEmitter*>& particleEmitters, const DynamicAABBTree& spatialTree);
 
 	//draw colliders on scene.
 	void debugDrawColliders(const BaseCamera& camera, const std::vector<Entity*>& entities);
@@ -109,13 +272,20 @@ public:
 	//draw lights bounding box.
 	void debugDrawLights(const BaseCamera& camera, const std::vector<PointLight*>& pointLights, const std::vector<SpotLight*>& spotLights);
 
-	//check if a light bounding box has to be drawn, in that case it scales the blit quad to render only what is influenced by the light.
-	bool passCullingTest(glm::vec4& viewport, const glm::mat4& projection, const glm::mat4& view, const glm::vec3 cameraPosition, BoxCollider& collider);
+	//check if a light bounding box has to be drawn, in that case it gives the viewport of the light quad to render only what is influenced by the light.
+	bool passCullingTest(glm::vec4& viewport, const Frustum& frustum, const glm::mat4& projection, const glm::mat4& view, const glm::vec3 cameraPosition, BoxCollider& collider);
 
-	//resize the blit quad, changing its vertices coordinates
-	void resizeBlitQuad(const glm::vec4& viewport = glm::vec4(-1,-1,2,2));
 
 	// Camera culling for light
 	void updateCulling(const BaseCamera& camera, std::vector<PointLight*>& pointLights, std::vector<SpotLight*>& spotLights, std::vector<LightCullingInfo>& pointLightCullingInfos, std::vector<LightCullingInfo>& spotLightCullingInfos);
+
+	// Camera culling for objects, fill the visible lists used by the gPass and the forward pass with a frustum query in the spatial tree of the scene
+	void updateObjectCulling(const BaseCamera& camera, std::vector<MeshRenderer*>& meshRenderers, std::vector<Physic::Flag*>& flags, std::vector<Physic::ParticleEmitter*>& particleEmitters, const DynamicAABBTree& spatialTree);
+
+	const RenderCullingStats& getCullingStats() const;
+	const ShadowCacheStats& getShadowCacheStats() const;
+
+	//draw the culling, render queue, shadow cache, tiled lighting and GL state options and counters.
+	void drawUI();
 };
 
@@ -3,6 +3,46 @@
 #include "OctreeDrawer.h"
 #include "PhysicManager.h"
 
+namespace {
+	//world bounds of the components stored in the spatial tree :
+	void computeSpatialBounds(Component* component, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		switch (component->type())
+		{
+		case Component::MESH_RENDERER:
+		{
+			MeshRenderer* meshRenderer = static_cast<MeshRenderer*>(component);
+			if (meshRenderer->getMesh() != nullptr)
+			{
+				meshRenderer->getBounds(boundsMin, boundsMax);
+				return;
+			}
+			break;
+		}
+		case Component::FLAG:
+			static_cast<Physic::Flag*>(component)->getBounds(boundsMin, boundsMax);
+			return;
+		case Component::PARTICLE_EMITTER:
+			//an emitter without alive particle is kept at the position of its entity :
+			if (static_cast<Physic::ParticleEmitter*>(component)->getBounds(boundsMin, boundsMax))
+				return;
+			break;
+		case Component::POINT_LIGHT:
+		case Component::SPOT_LIGHT:
+		{
+			BoxCollider& boundingBox = (component->type() == Component::POINT_LIGHT) ? static_cast<PointLight*>(component)->boundingBox : static_cast<SpotLight*>(component)->boundingBox;
+			boundsMin = glm::min(boundingBox.bottomLeft, boundingBox.topRight);
+			boundsMax = glm::max(boundingBox.bottomLeft, boundingBox.topRight);
+			return;
+		}
+		default:
+			break;
+		}
+
+		boundsMin = boundsMax = (component->entity() != nullptr) ? component->entity()->getTranslation() : glm::vec3(0, 0, 0);
+	}
+}
+
 
 Scene::Scene(Renderer* renderer, const std::string& sceneName) : m_renderer(renderer), m_name(sceneName), m_areCollidersVisible(true), m_isDebugDeferredVisible(true), m_isDebugPhysicVisible(true)
 {
@@ -82,6 +122,8 @@ void Scene::clear()
 	m_entities.clear();
 
 	//clear systems : 
+	m_spatialTree.clear();
+	m_spatialProxies.clear();
 	m_terrain.clear();
 	m_physicManager->clear();
 	delete m_physicManager;
@@ -102,6 +144,7 @@ Scene& Scene::add(Entity * entity)
 Scene& Scene::add(PointLight * pointLight)
 {
 	m_pointLights.push_back(pointLight);
+	addSpatialProxy(pointLight);
 	return *this;
 }
 
@@ -114,6 +157,7 @@ Scene& Scene::add(DirectionalLight * directionalLight)
 Scene& Scene::add(SpotLight * spotLight)
 {
 	m_spotLights.push_back(spotLight);
+	addSpatialProxy(spotLight);
 	return *this;
 }
 
@@ -126,18 +170,21 @@ Scene& Scene::add(Collider * collider)
 Scene& Scene::add(MeshRenderer * meshRenderer)
 {
 	m_meshRenderers.push_back(meshRenderer);
+	addSpatialProxy(meshRenderer);
 	return *this;
 }
 
 Scene& Scene::add(Physic::Flag * flag)
 {
 	m_flags.push_back(flag);
+	addSpatialProxy(flag);
 	return *this;
 }
 
 Scene & Scene::add(Physic::ParticleEmitter * particleEmitter)
 {
 	m_particleEmitters.push_back(particleEmitter);
+	addSpatialProxy(particleEmitter);
 	return *this;
 }
 
@@ -209,6 +256,7 @@ Scene & Scene::erase(PointLight * pointLight)
 
 	if (findIt != m_pointLights.end())
 	{
+		eraseSpatialProxy(pointLight);
 		delete *findIt;
 		m_pointLights.erase(findIt);
 	}
@@ -235,6 +283,7 @@ Scene & Scene::erase(SpotLight * spotLight)
 
 	if (findIt != m_spotLights.end())
 	{
+		eraseSpatialProxy(spotLight);
 		delete *findIt;
 		m_spotLights.erase(findIt);
 	}
@@ -261,6 +310,7 @@ Scene & Scene::erase(MeshRenderer * meshRenderer)
 
 	if (findIt != m_meshRenderers.end())
 	{
+		eraseSpatialProxy(meshRenderer);
 		delete meshRenderer;
 		m_meshRenderers.erase(findIt);
 	}
@@ -274,6 +324,7 @@ Scene & Scene::erase(Physic::Flag * flag)
 
 	if (findIt != m_flags.end())
 	{
+		eraseSpatialProxy(flag);
 		delete flag;
 		m_flags.erase(findIt);
 	}
@@ -287,6 +338,7 @@ Scene & Scene::erase(Physic::ParticleEmitter * particleEmitter)
 
 	if (findIt != m_particleEmitters.end())
 	{
+		eraseSpatialProxy(particleEmitter);
 		delete particleEmitter;
 		m_particleEmitters.erase(findIt);
 	}
@@ -394,7 +446,10 @@ Scene & Scene::erase(Behavior * behavior)
 
 void Scene::render(const BaseCamera& camera)
 {
-	m_renderer->render(camera, m_meshRenderers, m_pointLights, m_directionalLights, m_spotLights, m_terrain, m_skybox, m_flags, m_billboards, m_particleEmitters);
+	//stream terrain tiles around the camera before rendering :
+	m_terrain.updateStreaming(camera.getCameraPosition());
+
+	m_renderer->render(camera, m_meshRenderers, m_pointLights, m_directionalLights, m_spotLights, m_terrain, m_skybox, m_flags, m_billboards, m_particleEmitters, m_spatialTree);
 }
 
 void Scene::renderColliders(const BaseCamera & camera)
@@ -438,19 +493,18 @@ void Scene::renderDebugPhysic(const BaseCamera & camera)
 void Scene::updatePhysic(float deltaTime, const BaseCamera& camera)
 {
 	m_physicManager->update(deltaTime, camera, m_flags, m_terrain, m_windZones, m_particleEmitters);
+	updateSimulatedSpatialProxies();
 }
 
 void Scene::updatePhysic(float deltaTime, const BaseCamera& camera, bool updateInEditMode)
 {
 	m_physicManager->update(deltaTime, camera, m_flags, m_terrain, m_windZones, m_particleEmitters, updateInEditMode);
+	updateSimulatedSpatialProxies();
 }
 
-void Scene::updateAnimations(float time)
+void Scene::updateAnimations(float time, float deltaTime, const BaseCamera& camera)
 {
-	// TODO animatorManager ? 
-	for (int i = 0; i < m_animators.size(); i++) {
-		m_animators[i]->updateAnimations(time);
-	}
+	m_animatorManager.update(time, deltaTime, camera, m_animators);
 }
 
 void Scene::updateControllers(float deltaTime)
@@ -578,6 +632,58 @@ Physic::PhysicManager& Scene::getPhysicManager()
 	return *m_physicManager;
 }
 
+AnimatorManager& Scene::getAnimatorManager()
+{
+	return m_animatorManager;
+}
+
+void Scene::addSpatialProxy(Component* component)
+{
+	glm::vec3 boundsMin, boundsMax;
+	computeSpatialBounds(component, boundsMin, boundsMax);
+	m_spatialProxies[component] = m_spatialTree.insert(component, boundsMin, boundsMax);
+}
+
+void Scene::eraseSpatialProxy(Component* component)
+{
+	auto findIt = m_spatialProxies.find(component);
+	if (findIt != m_spatialProxies.end())
+	{
+		m_spatialTree.remove(findIt->second);
+		m_spatialProxies.erase(findIt);
+	}
+}
+
+void Scene::updateSpatialProxy(Component* component)
+{
+	auto findIt = m_spatialProxies.find(component);
+	if (findIt == m_spatialProxies.end())
+		return;
+
+	glm::vec3 boundsMin, boundsMax;
+	computeSpatialBounds(component, boundsMin, boundsMax);
+	m_spatialTree.move(findIt->second, boundsMin, boundsMax);
+}
+
+void Scene::updateSimulatedSpatialProxies()
+{
+	for (int i = 0; i < m_flags.size(); i++)
+		updateSpatialProxy(m_flags[i]);
+	for (int i = 0; i < m_particleEmitters.size(); i++)
+		updateSpatialProxy(m_particleEmitters[i]);
+}
+
+void Scene::updateAllSpatialProxies()
+{
+	for (auto& proxy : m_spatialProxies)
+		updateSpatialProxy(proxy.first);
+}
+
+const DynamicAABBTree& Scene::getSpatialTree() const
+{
+	return m_spatialTree;
+}
+
 std::string Scene::getName() const
 {
 	return m_name;
@@ -613,6 +719,7 @@ void Scene::save(const std::string & path)
 	//TODO
 	m_terrain.save(root["terrain"]);
 	m_skybox.save(root["skybox"]);
+	m_animatorManager.save(root["animatorManager"]);
 	
 	//DEBUG
 	//std::cout << root;
@@ -679,6 +786,10 @@ void Scene::load(const std::string & path)
 	m_terrain.load(root["terrain"]);
 	//m_terrain.initPhysics(m_physicManager.getBulletDynamicSimulation()); //TODO automatize this process in loading ? 
 	m_skybox.load(root["skybox"]);
+	m_animatorManager.load(root["animatorManager"]);
+
+	//the components are added to the scene before being loaded :
+	updateAllSpatialProxies();
 
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 
 #include "Entity.h"
 #include "Lights.h"
@@ -20,6 +21,8 @@
 #include "Terrain.h"
 #include "Skybox.h"
 #include "BehaviorManager.h"
+#include "AnimatorManager.h"
+#include "DynamicAABBTree.h"
 
 #include "jsoncpp/json/json.h"
 #include <iostream>
@@ -90,6 +93,11 @@ private:
 	Physic::PhysicManager* m_physicManager;
 	PathManager m_pathManager;
 	BehaviorManager m_behaviorManager;
+	AnimatorManager m_animatorManager;
+
+	//spatial tree over the mesh renderers, flags, particle emitters, point lights and spot lights :
+	DynamicAABBTree m_spatialTree;
+	std::unordered_map<Component*, int> m_spatialProxies; //proxy of each component in the spatial tree
 	//TODO
 	//CloudSystem m_cloudSystem;
 
@@ -154,7 +162,7 @@ public:
 	void updatePhysic(float deltaTime, const BaseCamera& camera);
 	void updatePhysic(float deltaTime, const BaseCamera& camera, bool updateInEditMode);
 
-	void updateAnimations(float time);
+	void updateAnimations(float time, float deltaTime, const BaseCamera& camera);
 	void updateControllers(float deltaTime);
 	void updateBehaviours();
 
@@ -176,11 +184,18 @@ public:
 
 	void culling(const BaseCamera& camera);
 
+	//update the bounds of a component in the spatial tree, after it has moved or changed its shape. Does nothing if the component isn't in the tree.
+	void updateSpatialProxy(Component* component);
+	//update the bounds of all the components in the spatial tree.
+	void updateAllSpatialProxies();
+	const DynamicAABBTree& getSpatialTree() const;
+
 	Terrain& getTerrain();
 	Skybox& getSkybox();
 	PathManager& getPathManager();
 	Renderer& getRenderer();
 	Physic::PhysicManager& getPhysicManager();
+	AnimatorManager& getAnimatorManager();
 
 	std::string getName() const;
 
@@ -193,5 +208,11 @@ public:
 
 	BaseCamera* getMainCamera() const;
 
+private:
+	void addSpatialProxy(Component* component);
+	void eraseSpatialProxy(Component* component);
+	//the simulation changes the shape of the flags and of the particle clouds :
+	void updateSimulatedSpatialProxies();
+
 };
 
@@ -1,48 +1,406 @@
 #include "SkeletalAnimation.h"
 //forwards :
 #include "Application.h"
+#include "Skeleton.h"
 
+#include <algorithm>
+#include <cmath>
 
-SkeletalAnimation::SkeletalAnimation(aiAnimation* animation): Animation(0.0, true), m_animation(animation)
+namespace {
+	//a cursor can move a few keys forward before we search the whole track :
+	const unsigned int MAX_CURSOR_STEPS = 4;
+
+	//compression tolerances, in the units of the tracks (radians for the rotations) :
+	const float POSITION_TOLERANCE = 0.001f;
+	const float ROTATION_TOLERANCE = 0.001f;
+	const float SCALING_TOLERANCE = 0.0001f;
+	//bound the number of keys dropped in a row, to bound the compression cost of long linear tracks :
+	const unsigned int MAX_DROPPED_KEYS = 128;
+
+	const float SMALLEST_THREE_RANGE = 0.70710678f; // 1/sqrt(2)
+	const unsigned int SMALLEST_THREE_MAX = (1 << 15) - 1;
+
+	//index i of the key such that times[i] <= time < times[i + 1], in [0, keyCount - 2]. keyCount must be >= 2.
+	unsigned int findKey(const float* times, unsigned int keyCount, float time, unsigned int& cursor)
+	{
+		if (cursor > keyCount - 2)
+			cursor = 0;
+
+		//forward playback : the key is usually the current one or one of the next ones.
+		if (time >= times[cursor])
+		{
+			for (unsigned int step = 0; step < MAX_CURSOR_STEPS; step++)
+			{
+				if (cursor == keyCount - 2 || time < times[cursor + 1])
+					return cursor;
+				cursor++;
+			}
+		}
+
+		//seek or loop :
+		const float* nextKey = std::upper_bound(times, times + keyCount, time);
+		int index = (int)(nextKey - times) - 1;
+		cursor = (unsigned int)std::max(0, std::min(index, (int)keyCount - 2));
+		return cursor;
+	}
+
+	float interpolationFactor(const float* times, unsigned int index, float time)
+	{
+		float deltaTime = times[index + 1] - times[index];
+		if (deltaTime <= 0.f)
+			return 0.f;
+		return std::max(0.f, std::min(1.f, (time - times[index]) / deltaTime));
+	}
+
+	float distance(const aiVector3D& a, const aiVector3D& b)
+	{
+		return (a - b).Length();
+	}
+
+	//angle between two rotations :
+	float angle(const aiQuaternion& a, const aiQuaternion& b)
+	{
+		double dot = std::abs((double)a.w * b.w + (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z);
+		return (float)(2.0 * std::acos(std::min(1.0, dot)));
+	}
+
+	//select the keys to keep : a key is dropped if it can be rebuilt within the tolerance by interpolating the kept keys around it.
+	//isWithinTolerance(start, end, k) tells if key k is rebuilt correctly from keys start and end.
+	template<typename ToleranceTest>
+	void selectKeys(unsigned int keyCount, ToleranceTest isWithinTolerance, std::vector<unsigned int>& outKeys)
+	{
+		outKeys.clear();
+		if (keyCount == 0)
+			return;
+
+		outKeys.push_back(0);
+		unsigned int start = 0;
+		for (unsigned int end = 2; end < keyCount; end++)
+		{
+			bool canDrop = (end - start - 1) <= MAX_DROPPED_KEYS;
+			for (unsigned int k = start + 1; k < end && canDrop; k++)
+				canDrop = isWithinTolerance(start, end, k);
+
+			//keep the last key which could be reached :
+			if (!canDrop)
+			{
+				start = end - 1;
+				outKeys.push_back(start);
+			}
+		}
+		if (keyCount > 1)
+			outKeys.push_back(keyCount - 1);
+	}
+
+	unsigned short quantize(float value, float rangeMin, float rangeExtent)
+	{
+		if (rangeExtent <= 0.f)
+			return 0;
+		float normalized = std::max(0.f, std::min(1.f, (value - rangeMin) / rangeExtent));
+		return (unsigned short)(normalized * 65535.f + 0.5f);
+	}
+}
+
+AnimationTrackCursor::AnimationTrackCursor() : position(0), rotation(0), scaling(0)
+{
+
+}
+
+SkeletalAnimation::SkeletalAnimation(const aiAnimation* animation): Animation(0.0, true), m_name(animation->mName.data),
+m_durationInTick((float)animation->mDuration), m_ticksPerSecond((float)animation->mTicksPerSecond), m_rawSize(0), m_compressedSize(0)
 {
 	float ticksPerSecond = getTicksPerSecond() == 0 ? 25 : getTicksPerSecond();
 	m_duration = getDurationInTick() / ticksPerSecond;
+
+	m_channels.resize(animation->mNumChannels);
+	for (unsigned int i = 0; i < animation->mNumChannels; i++)
+	{
+		const aiNodeAnim* nodeAnim = animation->mChannels[i];
+		Channel& channel = m_channels[i];
+
+		channel.nodeName = nodeAnim->mNodeName.data;
+		compressVectorTrack(nodeAnim->mPositionKeys, nodeAnim->mNumPositionKeys, POSITION_TOLERANCE, aiVector3D(0, 0, 0), channel.positions);
+		compressRotationTrack(nodeAnim->mRotationKeys, nodeAnim->mNumRotationKeys, ROTATION_TOLERANCE, channel.rotations);
+		compressVectorTrack(nodeAnim->mScalingKeys, nodeAnim->mNumScalingKeys, SCALING_TOLERANCE, aiVector3D(1, 1, 1), channel.scalings);
+
+		m_rawSize += nodeAnim->mNumPositionKeys * sizeof(aiVectorKey) + nodeAnim->mNumRotationKeys * sizeof(aiQuatKey) + nodeAnim->mNumScalingKeys * sizeof(aiVectorKey);
+		m_compressedSize += (channel.positions.times.size() + channel.rotations.times.size() + channel.scalings.times.size()) * sizeof(float)
+			+ (channel.positions.values.size() + channel.rotations.values.size() + channel.scalings.values.size()) * sizeof(unsigned short)
+			+ 4 * sizeof(aiVector3D);
+	}
 }
 
 SkeletalAnimation::~SkeletalAnimation()
 {
-	delete m_animation;
+
 }
 
 std::string SkeletalAnimation::getName() const
 {
-	return m_animation->mName.data;
+	return m_name;
 }
 
 float SkeletalAnimation::getTicksPerSecond() const
 {
-	return m_animation->mTicksPerSecond;
+	return m_ticksPerSecond;
+}
+
+int SkeletalAnimation::getChannelCount() const
+{
+	return m_channels.size();
+}
+
+const std::string& SkeletalAnimation::getChannelNodeName(int channelIndex) const
+{
+	assert(channelIndex >= 0 && channelIndex < m_channels.size());
+	return m_channels[channelIndex].nodeName;
+}
+
+size_t SkeletalAnimation::getRawSize() const
+{
+	return m_rawSize;
+}
+
+size_t SkeletalAnimation::getCompressedSize() const
+{
+	return m_compressedSize;
+}
+
+void SkeletalAnimation::bindToSkeleton(const Skeleton& skeleton, SkeletalAnimationBinding& outBinding) const
+{
+	const std::vector<SkeletonNode>& nodes = skeleton.getNodes();
+	std::vector<int>& outNodeChannels = outBinding.nodeChannels;
+	outNodeChannels.assign(nodes.size(), -1);
+	outBinding.cursors.assign(m_channels.size(), AnimationTrackCursor());
+
+	for (int i = 0; i < nodes.size(); i++)
+	{
+		for (int channelIndex = 0; channelIndex < m_channels.size(); channelIndex++)
+		{
+			if (m_channels[channelIndex].nodeName == nodes[i].name)
+			{
+				outNodeChannels[i] = channelIndex;
+				break;
+			}
+		}
+	}
+}
+
+void SkeletalAnimation::sampleChannel(int channelIndex, float animationTime, AnimationTrackCursor& cursor, aiVector3D& outScaling, aiQuaternion& outRotation, aiVector3D& outPosition) const
+{
+	const Channel& channel = m_channels[channelIndex];
+
+	const VectorTrack& scalings = channel.scalings;
+	if (scalings.times.size() == 1) {
+		outScaling = decodeVector(scalings, 0);
+	}
+	else {
+		unsigned int index = findKey(&scalings.times[0], scalings.times.size(), animationTime, cursor.scaling);
+		float factor = interpolationFactor(&scalings.times[0], index, animationTime);
+		aiVector3D start = decodeVector(scalings, index);
+		aiVector3D end = decodeVector(scalings, index + 1);
+		outScaling = start + factor * (end - start);
+	}
+
+	const RotationTrack& rotations = channel.rotations;
+	if (rotations.times.size() == 1) {
+		outRotation = decodeRotation(rotations, 0);
+	}
+	else {
+		unsigned int index = findKey(&rotations.times[0], rotations.times.size(), animationTime, cursor.rotation);
+		float factor = interpolationFactor(&rotations.times[0], index, animationTime);
+		aiQuaternion::Interpolate(outRotation, decodeRotation(rotations, index), decodeRotation(rotations, index + 1), factor);
+		outRotation = outRotation.Normalize();
+	}
+
+	const VectorTrack& positions = channel.positions;
+	if (positions.times.size() == 1) {
+		outPosition = decodeVector(positions, 0);
+	}
+	else {
+		unsigned int index = findKey(&positions.times[0], positions.times.size(), animationTime, cursor.position);
+		float factor = interpolationFactor(&positions.times[0], index, animationTime);
+		aiVector3D start = decodeVector(positions, index);
+		aiVector3D end = decodeVector(positions, index + 1);
+		outPosition = start + factor * (end - start);
+	}
+}
+
+void SkeletalAnimation::compressVectorTrack(const aiVectorKey* keys, unsigned int keyCount, float tolerance, const aiVector3D& defaultValue, VectorTrack& outTrack)
+{
+	std::vector<unsigned int> selectedKeys;
+
+	//constant track : a single key.
+	bool isConstant = true;
+	for (unsigned int k = 1; k < keyCount && isConstant; k++)
+		isConstant = distance(keys[k].mValue, keys[0].mValue) <= tolerance;
+
+	if (keyCount == 0)
+	{
+		outTrack.times.assign(1, 0.f);
+		outTrack.rangeMin = defaultValue;
+		outTrack.rangeExtent = aiVector3D(0, 0, 0);
+		outTrack.values.assign(3, 0);
+		return;
+	}
+	else if (isConstant)
+	{
+		selectedKeys.push_back(0);
+	}
+	else
+	{
+		selectKeys(keyCount, [keys, tolerance](unsigned int start, unsigned int end, unsigned int k)
+		{
+			float deltaTime = (float)(keys[end].mTime - keys[start].mTime);
+			float factor = deltaTime > 0.f ? (float)(keys[k].mTime - keys[start].mTime) / deltaTime : 0.f;
+			aiVector3D rebuilt = keys[start].mValue + factor * (keys[end].mValue - keys[start].mValue);
+			return distance(rebuilt, keys[k].mValue) <= tolerance;
+		}, selectedKeys);
+	}
+
+	//quantization range :
+	aiVector3D rangeMax = keys[selectedKeys[0]].mValue;
+	outTrack.rangeMin = rangeMax;
+	for (unsigned int k : selectedKeys)
+	{
+		const aiVector3D& value = keys[k].mValue;
+		outTrack.rangeMin = aiVector3D(std::min(outTrack.rangeMin.x, value.x), std::min(outTrack.rangeMin.y, value.y), std::min(outTrack.rangeMin.z, value.z));
+		rangeMax = aiVector3D(std::max(rangeMax.x, value.x), std::max(rangeMax.y, value.y), std::max(rangeMax.z, value.z));
+	}
+	outTrack.rangeExtent = rangeMax - outTrack.rangeMin;
+
+	outTrack.times.clear();
+	outTrack.values.clear();
+	for (unsigned int k : selectedKeys)
+	{
+		outTrack.times.push_back((float)keys[k].mTime);
+		outTrack.values.push_back(quantize(keys[k].mValue.x, outTrack.rangeMin.x, outTrack.rangeExtent.x));
+		outTrack.values.push_back(quantize(keys[k].mValue.y, outTrack.rangeMin.y, outTrack.rangeExtent.y));
+		outTrack.values.push_back(quantize(keys[k].mValue.z, outTrack.rangeMin.z, outTrack.rangeExtent.z));
+	}
+}
+
+void SkeletalAnimation::compressRotationTrack(const aiQuatKey* keys, unsigned int keyCount, float tolerance, RotationTrack& outTrack)
+{
+	std::vector<unsigned int> selectedKeys;
+
+	bool isConstant = true;
+	for (unsigned int k = 1; k < keyCount && isConstant; k++)
+		isConstant = angle(keys[k].mValue, keys[0].mValue) <= tolerance;
+
+	if (keyCount == 0)
+	{
+		selectedKeys.clear();
+	}
+	else if (isConstant)
+	{
+		selectedKeys.push_back(0);
+	}
+	else
+	{
+		selectKeys(keyCount, [keys, tolerance](unsigned int start, unsigned int end, unsigned int k)
+		{
+			float deltaTime = (float)(keys[end].mTime - keys[start].mTime);
+			float factor = deltaTime > 0.f ? (float)(keys[k].mTime - keys[start].mTime) / deltaTime : 0.f;
+			aiQuaternion rebuilt;
+			aiQuaternion::Interpolate(rebuilt, keys[start].mValue, keys[end].mValue, factor);
+			return angle(rebuilt.Normalize(), keys[k].mValue) <= tolerance;
+		}, selectedKeys);
+	}
+
+	outTrack.times.clear();
+	outTrack.values.clear();
+
+	//no key : identity.
+	std::vector<aiQuaternion> rotations;
+	if (keyCount == 0)
+	{
+		outTrack.times.push_back(0.f);
+		rotations.push_back(aiQuaternion());
+	}
+	for (unsigned int k : selectedKeys)
+	{
+		outTrack.times.push_back((float)keys[k].mTime);
+		rotations.push_back(keys[k].mValue);
+	}
+
+	for (aiQuaternion rotation : rotations)
+	{
+		rotation.Normalize();
+		float components[4] = { rotation.w, rotation.x, rotation.y, rotation.z };
+
+		//drop the largest component, it is rebuilt from the unit length. q and -q are the same rotation, so it is made positive :
+		int largest = 0;
+		for (int c = 1; c < 4; c++)
+		{
+			if (std::abs(components[c]) > std::abs(components[largest]))
+				largest = c;
+		}
+		float sign = components[largest] < 0.f ? -1.f : 1.f;
+
+		unsigned long long packed = (unsigned long long)largest;
+		int shift = 2;
+		for (int c = 0; c < 4; c++)
+		{
+			if (c == largest)
+				continue;
+			float normalized = (sign * components[c] / SMALLEST_THREE_RANGE) * 0.5f + 0.5f;
+			unsigned long long quantized = (unsigned long long)(std::max(0.f, std::min(1.f, normalized)) * SMALLEST_THREE_MAX + 0.5f);
+			packed |= quantized << shift;
+			shift += 15;
+		}
+
+		outTrack.values.push_back((unsigned short)(packed & 0xFFFF));
+		outTrack.values.push_back((unsigned short)((packed >> 16) & 0xFFFF));
+		outTrack.values.push_back((unsigned short)((packed >> 32) & 0xFFFF));
+	}
 }
 
-aiNodeAnim* SkeletalAnimation::getNodeAnim(const std::string& nodeName) const
+aiVector3D SkeletalAnimation::decodeVector(const VectorTrack& track, unsigned int keyIndex)
 {
-	for (int i = 0; i < m_animation->mNumChannels; i++) {
-		if (m_animation->mChannels[i]->mNodeName.data == nodeName)
-			return m_animation->mChannels[i];
+	const unsigned short* values = &track.values[keyIndex * 3];
+	return aiVector3D(track.rangeMin.x + (values[0] / 65535.f) * track.rangeExtent.x,
+		track.rangeMin.y + (values[1] / 65535.f) * track.rangeExtent.y,
+		track.rangeMin.z + (values[2] / 65535.f) * track.rangeExtent.z);
+}
+
+aiQuaternion SkeletalAnimation::decodeRotation(const RotationTrack& track, unsigned int keyIndex)
+{
+	const unsigned short* values = &track.values[keyIndex * 3];
+	unsigned long long packed = (unsigned long long)values[0] | ((unsigned long long)values[1] << 16) | ((unsigned long long)values[2] << 32);
+
+	int largest = (int)(packed & 3);
+	float components[4];
+	float sumOfSquares = 0.f;
+	int shift = 2;
+	for (int c = 0; c < 4; c++)
+	{
+		if (c == largest)
+			continue;
+		float normalized = ((packed >> shift) & SMALLEST_THREE_MAX) / (float)SMALLEST_THREE_MAX;
+		components[c] = (normalized * 2.f - 1.f) * SMALLEST_THREE_RANGE;
+		sumOfSquares += components[c] * components[c];
+		shift += 15;
 	}
-	return nullptr;
+	components[largest] = std::sqrt(std::max(0.f, 1.f - sumOfSquares));
+
+	return aiQuaternion(components[0], components[1], components[2], components[3]);
 }
 
-float SkeletalAnimation::getAnimationTime() const
+float SkeletalAnimation::getAnimationTime(float timeOffsetInSecond) const
 {
 	float ticksPerSecond = getTicksPerSecond() != 0 ? getTicksPerSecond() : 25.0f;
-	float timeInTicks = getElapsedTime() * ticksPerSecond;
+	float elapsedTime = getElapsedTime() + timeOffsetInSecond;
+	float timeInTicks = elapsedTime * ticksPerSecond;
+	//a clip which doesn't loop holds its last pose, the fmod would bring it back to the first one :
+	if (!getIsLooping())
+		return std::min(timeInTicks, getDurationInTick());
 	return fmod(timeInTicks, getDurationInTick()); //note : the fmod is normally not necessary since getElapsedTime already loop the time of the animation.
 }
 
 float SkeletalAnimation::getDurationInTick() const
 {
-	return m_animation->mDuration;
+	return m_durationInTick;
 }
 
 void SkeletalAnimation::setIsLooping(bool isLooping)
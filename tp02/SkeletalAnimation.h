@@ -1,21 +1,95 @@
 #pragma once
 #include "Animation.h"
 
+#include <vector>
+#include <string>
+
 #include <assimp/anim.h>
 
+//forwards :
+class Skeleton;
+
+//position of the playback in the three tracks of a channel : index of the key just before the current time.
+struct AnimationTrackCursor
+{
+	unsigned int position;
+	unsigned int rotation;
+	unsigned int scaling;
+
+	AnimationTrackCursor();
+};
+
+//an animation played on a skeleton : the channel of each node, and the keyframe cursors of this playback.
+struct SkeletalAnimationBinding
+{
+	std::vector<int> nodeChannels; //channel index of each skeleton node, -1 if the node isn't animated
+	std::vector<AnimationTrackCursor> cursors; //one per channel
+};
+
+//Animation clip of a skeleton, compressed at import :
+//constant tracks are stripped, keys which can be rebuilt by interpolation within a tolerance are dropped,
+//rotations are stored in the smallest three form on 48 bits, and positions and scalings on 16 bits per component, relative to the range of their track.
 class SkeletalAnimation: public Animation
 {
-	aiAnimation* m_animation;
+	//positions or scalings :
+	struct VectorTrack
+	{
+		std::vector<float> times;
+		std::vector<unsigned short> values; //three per key
+		aiVector3D rangeMin;
+		aiVector3D rangeExtent;
+	};
+
+	struct RotationTrack
+	{
+		std::vector<float> times;
+		std::vector<unsigned short> values; //three per key : 2 bits for the index of the dropped component, then three components on 15 bits
+	};
+
+	struct Channel
+	{
+		std::string nodeName;
+		VectorTrack positions;
+		RotationTrack rotations;
+		VectorTrack scalings;
+	};
+
+	std::string m_name;
+	float m_durationInTick;
+	float m_ticksPerSecond;
+	std::vector<Channel> m_channels;
+
+	//memory used by the keys, for stats :
+	size_t m_rawSize;
+	size_t m_compressedSize;
 	
 public:
-	SkeletalAnimation(aiAnimation* animation);
+	//the animation is compressed from the assimp one, which isn't kept (it still belongs to the caller).
+	SkeletalAnimation(const aiAnimation* animation);
 	~SkeletalAnimation();
 
 	float getDurationInTick() const;
-	float getAnimationTime() const;
+	//time in ticks, timeOffsetInSecond after the current time of the playback :
+	float getAnimationTime(float timeOffsetInSecond = 0.f) const;
 	void setIsLooping(bool isLooping);
 	std::string getName() const;
 	float getTicksPerSecond() const;
-	aiNodeAnim* getNodeAnim(const std::string& nodeName) const;
-};
+	int getChannelCount() const;
+	const std::string& getChannelNodeName(int channelIndex) const;
+	size_t getRawSize() const;
+	size_t getCompressedSize() const;
+
+	//resolve the channel of each node of the skeleton, and reset the cursors.
+	//The binding belongs to the pair (animation, skeleton), so one animation can be shared by several skeletons.
+	void bindToSkeleton(const Skeleton& skeleton, SkeletalAnimationBinding& outBinding) const;
 
+	//interpolated transform of a channel at animationTime (in ticks). The cursor moves forward during the playback,
+	//and the keys are found with a binary search after a seek or a loop.
+	void sampleChannel(int channelIndex, float animationTime, AnimationTrackCursor& cursor, aiVector3D& outScaling, aiQuaternion& outRotation, aiVector3D& outPosition) const;
+
+private:
+	static void compressVectorTrack(const aiVectorKey* keys, unsigned int keyCount, float tolerance, const aiVector3D& defaultValue, VectorTrack& outTrack);
+	static void compressRotationTrack(const aiQuatKey* keys, unsigned int keyCount, float tolerance, RotationTrack& outTrack);
+	static aiVector3D decodeVector(const VectorTrack& track, unsigned int keyIndex);
+	static aiQuaternion decodeRotation(const RotationTrack& track, unsigned int keyIndex);
+};
@@ -1,8 +1,14 @@
 #include "Skeleton.h"
 //forwards : 
 #include "Utils.h"
+#include "MeshOptimizer.h"
 
 
+SkeletonNode::SkeletonNode(const std::string& _name, int _parentIndex, int _boneIndex, const aiMatrix4x4& _transformation)
+	: name(_name), parentIndex(_parentIndex), boneIndex(_boneIndex), transformation(_transformation)
+{
+
+}
 
 Skeleton::Skeleton(const aiMesh* pMesh, const aiNode* rootNode, unsigned int firstVertexId): m_rootNode(rootNode), m_boneCount(0)
 {
@@ -12,6 +18,17 @@ Skeleton::Skeleton(const aiMesh* pMesh, const aiNode* rootNode, unsigned int fir
 	loadBones(pMesh, firstVertexId);
 }
 
+Skeleton::Skeleton(const std::map<std::string, unsigned int>& boneMapping, const std::vector<VertexBoneData>& boneDatas, const std::vector<aiMatrix4x4>& bonesOffset, const aiNode* rootNode)
+	: m_rootNode(rootNode), m_boneCount(boneMapping.size()), m_boneMapping(boneMapping), m_boneDatas(boneDatas), m_bonesOffset(bonesOffset)
+{
+	m_globalInverseTransform = rootNode->mTransformation;
+	m_globalInverseTransform.Inverse();
+
+	m_bonesTransform.resize(m_bonesOffset.size(), glm::mat4(1));
+
+	compileHierarchy();
+}
+
 Skeleton::~Skeleton()
 {
 	delete m_rootNode;
@@ -43,195 +60,151 @@ const std::vector<VertexBoneData>& Skeleton::getBoneDatas() const
 	return m_boneDatas;
 }
 
-void Skeleton::playAnimationStep(float timeInSecond, const SkeletalAnimation& animation)
+const std::map<std::string, unsigned int>& Skeleton::getBoneMapping() const
 {
-	float animationTime = animation.getAnimationTime();
-
-	aiMatrix4x4 identity;
-	readNodeHierarchy(animationTime, animation, m_rootNode, identity );
+	return m_boneMapping;
 }
 
-void Skeleton::loadBones(const aiMesh* pMesh, unsigned int firstVertexId)
+const aiNode* Skeleton::getRootNode() const
 {
-	m_bonesTransform.resize(pMesh->mNumBones, glm::mat4(1));
-	m_bonesOffset.resize(pMesh->mNumBones);
-
-	for (unsigned int i = 0; i < pMesh->mNumBones; i++) {
-		std::string boneName = pMesh->mBones[i]->mName.data;
-		unsigned int boneIndex = 0;
+	return m_rootNode;
+}
 
-		if (m_boneMapping.find(boneName) == m_boneMapping.end()) {
-			boneIndex = m_boneCount++;
+const std::vector<SkeletonNode>& Skeleton::getNodes() const
+{
+	return m_nodes;
+}
 
-			m_boneMapping[boneName] = boneIndex;
-			m_bonesOffset[boneIndex] = pMesh->mBones[i]->mOffsetMatrix;
-		}
-		else {
-			boneIndex = m_boneMapping[boneName];
-			m_bonesOffset[boneIndex] = pMesh->mBones[i]->mOffsetMatrix;
-		}
+void Skeleton::compileHierarchy()
+{
+	m_nodes.clear();
 
-		for (unsigned int j = 0; j < pMesh->mBones[i]->mNumWeights; j++) {
-			float weight = pMesh->mBones[i]->mWeights[j].mWeight;
-			if (weight == 0)
-				continue;
+	//depth first, so a parent is always before its children :
+	std::vector<std::pair<const aiNode*, int>> toVisit; // (node, parent index)
+	toVisit.push_back(std::make_pair(m_rootNode, -1));
+	while (!toVisit.empty())
+	{
+		const aiNode* node = toVisit.back().first;
+		int parentIndex = toVisit.back().second;
+		toVisit.pop_back();
 
-			unsigned int vertexId = pMesh->mBones[i]->mWeights[j].mVertexId + firstVertexId;
+		std::string nodeName = node->mName.data;
+		auto foundBone = m_boneMapping.find(nodeName);
+		int boneIndex = (foundBone != m_boneMapping.end()) ? foundBone->second : -1;
 
-			if (vertexId + 1 > m_boneDatas.size())
-				m_boneDatas.resize(vertexId + 1);
+		int nodeIndex = m_nodes.size();
+		m_nodes.push_back(SkeletonNode(nodeName, parentIndex, boneIndex, node->mTransformation));
 
-			for (int k = 0; k < MAX_BONE_DATA_PER_VERTEX; k++) {
-				if (m_boneDatas[vertexId].weights[k] == 0) {
-					m_boneDatas[vertexId].ids[k] = boneIndex;
-					m_boneDatas[vertexId].weights[k] = weight;
-					break;
-				}
-			}
-		}
+		//pushed in reverse order to keep the children order of the tree :
+		for (int i = (int)node->mNumChildren - 1; i >= 0; i--)
+			toVisit.push_back(std::make_pair(node->mChildren[i], nodeIndex));
 	}
 }
 
-unsigned int Skeleton::findPosition(float AnimationTime, const aiNodeAnim* pNodeAnim)
+void Skeleton::playAnimationStep(float timeInSecond, const SkeletalAnimation& animation, SkeletalAnimationBinding& binding, SkeletonPose& outPose, float timeOffsetInSecond) const
 {
-	for (unsigned int i = 0; i < pNodeAnim->mNumPositionKeys - 1; i++) {
-		if (AnimationTime < (float)pNodeAnim->mPositionKeys[i + 1].mTime) {
-			return i;
-		}
-	}
+	const std::vector<int>& nodeChannels = binding.nodeChannels;
 
-	assert(0);
+	//the binding is out of date :
+	assert(nodeChannels.size() == m_nodes.size());
+	if (nodeChannels.size() != m_nodes.size())
+		return;
 
-	return 0;
-}
+	float animationTime = animation.getAnimationTime(timeOffsetInSecond);
 
+	std::vector<aiMatrix4x4>& nodeGlobalTransforms = outPose.nodeGlobalTransforms;
+	std::vector<glm::mat4>& bonesTransform = outPose.bonesTransform;
+	nodeGlobalTransforms.resize(m_nodes.size());
+	bonesTransform.resize(m_bonesTransform.size(), glm::mat4(1));
 
-unsigned int Skeleton::findRotation(float AnimationTime, const aiNodeAnim* pNodeAnim)
-{
-	assert(pNodeAnim->mNumRotationKeys > 0);
+	for (int i = 0; i < m_nodes.size(); i++)
+	{
+		const SkeletonNode& node = m_nodes[i];
+		const int channelIndex = nodeChannels[i];
+		aiMatrix4x4 nodeTransformation = node.transformation;
 
-	for (unsigned int i = 0; i < pNodeAnim->mNumRotationKeys - 1; i++) {
-		if (AnimationTime < (float)pNodeAnim->mRotationKeys[i + 1].mTime) {
-			return i;
-		}
-	}
+		if (channelIndex >= 0) {
 
-	assert(0);
+			aiVector3D scaling;
+			aiQuaternion rotationQ;
+			aiVector3D translation;
+			animation.sampleChannel(channelIndex, animationTime, binding.cursors[channelIndex], scaling, rotationQ, translation);
 
-	return 0;
-}
+			aiMatrix4x4 scalingM;
+			aiMatrix4x4::Scaling(scaling, scalingM);
 
+			aiMatrix4x4 rotationM = aiMatrix4x4(rotationQ.GetMatrix());
 
-unsigned int Skeleton::findScaling(float AnimationTime, const aiNodeAnim* pNodeAnim)
-{
-	assert(pNodeAnim->mNumScalingKeys > 0);
+			aiMatrix4x4 translationM;
+			aiMatrix4x4::Translation(translation, translationM);
 
-	for (unsigned int i = 0; i < pNodeAnim->mNumScalingKeys - 1; i++) {
-		if (AnimationTime < (float)pNodeAnim->mScalingKeys[i + 1].mTime) {
-			return i;
+			nodeTransformation = translationM * rotationM * scalingM;
 		}
-	}
 
-	assert(0);
+		//the parent has already been evaluated :
+		if (node.parentIndex >= 0)
+			nodeGlobalTransforms[i] = nodeGlobalTransforms[node.parentIndex] * nodeTransformation;
+		else
+			nodeGlobalTransforms[i] = nodeTransformation;
 
-	return 0;
-}
-
-
-void Skeleton::computeInterpolatedPosition(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
-{
-	if (pNodeAnim->mNumPositionKeys == 1) {
-		Out = pNodeAnim->mPositionKeys[0].mValue;
-		return;
+		if (node.boneIndex >= 0)
+			bonesTransform[node.boneIndex] = assimpMat4ToglmMat4(m_globalInverseTransform * nodeGlobalTransforms[i] * m_bonesOffset[node.boneIndex]);
 	}
-
-	unsigned int PositionIndex = findPosition(AnimationTime, pNodeAnim);
-	unsigned int NextPositionIndex = (PositionIndex + 1);
-	assert(NextPositionIndex < pNodeAnim->mNumPositionKeys);
-	float DeltaTime = (float)(pNodeAnim->mPositionKeys[NextPositionIndex].mTime - pNodeAnim->mPositionKeys[PositionIndex].mTime);
-	float Factor = (AnimationTime - (float)pNodeAnim->mPositionKeys[PositionIndex].mTime) / DeltaTime;
-	assert(Factor >= 0.0f && Factor <= 1.0f);
-	const aiVector3D& Start = pNodeAnim->mPositionKeys[PositionIndex].mValue;
-	const aiVector3D& End = pNodeAnim->mPositionKeys[NextPositionIndex].mValue;
-	aiVector3D Delta = End - Start;
-	Out = Start + Factor * Delta;
 }
 
-
-void Skeleton::computeInterpolatedRotation(aiQuaternion& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
+void Skeleton::remapVertices(unsigned int firstVertexId, const std::vector<unsigned int>& remap)
 {
-	if (pNodeAnim->mNumRotationKeys == 1) {
-		Out = pNodeAnim->mRotationKeys[0].mValue;
-		return;
-	}
+	//vertices without bones at the end of the range may not have bone datas yet :
+	if (m_boneDatas.size() < firstVertexId + remap.size())
+		m_boneDatas.resize(firstVertexId + remap.size());
 
-	unsigned int RotationIndex = findRotation(AnimationTime, pNodeAnim);
-	unsigned int NextRotationIndex = (RotationIndex + 1);
-	assert(NextRotationIndex < pNodeAnim->mNumRotationKeys);
-	float DeltaTime = (float)(pNodeAnim->mRotationKeys[NextRotationIndex].mTime - pNodeAnim->mRotationKeys[RotationIndex].mTime);
-	float Factor = (AnimationTime - (float)pNodeAnim->mRotationKeys[RotationIndex].mTime) / DeltaTime;
-	assert(Factor >= 0.0f && Factor <= 1.0f);
-	const aiQuaternion& StartRotationQ = pNodeAnim->mRotationKeys[RotationIndex].mValue;
-	const aiQuaternion& EndRotationQ = pNodeAnim->mRotationKeys[NextRotationIndex].mValue;
-	aiQuaternion::Interpolate(Out, StartRotationQ, EndRotationQ, Factor);
-	Out = Out.Normalize();
+	MeshOptimizer::remapStream(m_boneDatas, 1, firstVertexId, remap);
 }
 
-
-void Skeleton::computeInterpolatedScaling(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
-{
-	if (pNodeAnim->mNumScalingKeys == 1) {
-		Out = pNodeAnim->mScalingKeys[0].mValue;
-		return;
-	}
-
-	unsigned int ScalingIndex = findScaling(AnimationTime, pNodeAnim);
-	unsigned int NextScalingIndex = (ScalingIndex + 1);
-	assert(NextScalingIndex < pNodeAnim->mNumScalingKeys);
-	float DeltaTime = (float)(pNodeAnim->mScalingKeys[NextScalingIndex].mTime - pNodeAnim->mScalingKeys[ScalingIndex].mTime);
-	float Factor = (AnimationTime - (float)pNodeAnim->mScalingKeys[ScalingIndex].mTime) / DeltaTime;
-	assert(Factor >= 0.0f && Factor <= 1.0f);
-	const aiVector3D& Start = pNodeAnim->mScalingKeys[ScalingIndex].mValue;
-	const aiVector3D& End = pNodeAnim->mScalingKeys[NextScalingIndex].mValue;
-	aiVector3D Delta = End - Start;
-	Out = Start + Factor * Delta;
-}
-
-void Skeleton::readNodeHierarchy(float animationTime, const SkeletalAnimation& animation, const aiNode* node, const aiMatrix4x4& parentTransform)
+void Skeleton::loadBones(const aiMesh* pMesh, unsigned int firstVertexId)
 {
-	std::string nodeName = node->mName.data;
-	aiNodeAnim* nodeAnim = animation.getNodeAnim(nodeName);
-	aiMatrix4x4 nodeTransformation = node->mTransformation;
-
-	if (nodeAnim) {
+	//bones can be shared with the previous sub meshes, keep the ones already loaded :
+	m_bonesTransform.resize(m_boneCount + pMesh->mNumBones, glm::mat4(1));
+	m_bonesOffset.resize(m_boneCount + pMesh->mNumBones);
 
-		aiVector3D scaling;
-		computeInterpolatedScaling(scaling, animationTime, nodeAnim);
-		aiMatrix4x4 scalingM;
-		aiMatrix4x4::Scaling(scaling, scalingM);
+	for (unsigned int i = 0; i < pMesh->mNumBones; i++) {
+		std::string boneName = pMesh->mBones[i]->mName.data;
+		unsigned int boneIndex = 0;
 
-		aiQuaternion rotationQ;
-		computeInterpolatedRotation(rotationQ, animationTime, nodeAnim);
-		aiMatrix4x4 rotationM = aiMatrix4x4(rotationQ.GetMatrix());
+		if (m_boneMapping.find(boneName) == m_boneMapping.end()) {
+			boneIndex = m_boneCount++;
 
-		aiVector3D translation;
-		computeInterpolatedPosition(translation, animationTime, nodeAnim);
-		aiMatrix4x4 translationM;
-		aiMatrix4x4::Translation(translation, translationM);
+			m_boneMapping[boneName] = boneIndex;
+			m_bonesOffset[boneIndex] = pMesh->mBones[i]->mOffsetMatrix;
+		}
+		else {
+			boneIndex = m_boneMapping[boneName];
+			m_bonesOffset[boneIndex] = pMesh->mBones[i]->mOffsetMatrix;
+		}
 
-		nodeTransformation = translationM * rotationM * scalingM;
-	}
+		for (unsigned int j = 0; j < pMesh->mBones[i]->mNumWeights; j++) {
+			float weight = pMesh->mBones[i]->mWeights[j].mWeight;
+			if (weight == 0)
+				continue;
 
-	aiMatrix4x4 globalTransformation = parentTransform * nodeTransformation;
+			unsigned int vertexId = pMesh->mBones[i]->mWeights[j].mVertexId + firstVertexId;
 
-	if (m_boneMapping.find(nodeName) != m_boneMapping.end()) {
+			if (vertexId + 1 > m_boneDatas.size())
+				m_boneDatas.resize(vertexId + 1);
 
-		unsigned int boneIndex = m_boneMapping[nodeName];
-		m_bonesTransform[boneIndex] = assimpMat4ToglmMat4( m_globalInverseTransform * globalTransformation * m_bonesOffset[boneIndex]);
+			for (int k = 0; k < MAX_BONE_DATA_PER_VERTEX; k++) {
+				if (m_boneDatas[vertexId].weights[k] == 0) {
+					m_boneDatas[vertexId].ids[k] = boneIndex;
+					m_boneDatas[vertexId].weights[k] = weight;
+					break;
+				}
+			}
+		}
 	}
 
-	for (unsigned int i = 0; i < node->mNumChildren; i++) {
+	m_bonesTransform.resize(m_boneCount);
+	m_bonesOffset.resize(m_boneCount);
 
-		readNodeHierarchy(animationTime, animation, node->mChildren[i], globalTransformation);
-	}
+	//new bones may be driven by existing nodes :
+	compileHierarchy();
 }
@@ -30,18 +30,38 @@ struct VertexBoneData {
 	}
 };
 
+//a node of the flattened hierarchy. Parents are always stored before their children.
+struct SkeletonNode {
+	std::string name;
+	int parentIndex; //-1 for the root
+	int boneIndex; //-1 if the node doesn't drive a bone
+	aiMatrix4x4 transformation; //local transform of the bind pose
+
+	SkeletonNode(const std::string& _name = "", int _parentIndex = -1, int _boneIndex = -1, const aiMatrix4x4& _transformation = aiMatrix4x4());
+};
+
+//pose of one instance of a skeleton. Each animated instance owns its pose, so instances sharing a skeleton can be evaluated in parallel.
+struct SkeletonPose {
+	std::vector<aiMatrix4x4> nodeGlobalTransforms; //one per node
+	std::vector<glm::mat4> bonesTransform; //one per bone, sent to the shaders
+};
+
 class Skeleton
 {
 	unsigned int m_boneCount;
 	std::map<std::string, unsigned int> m_boneMapping;
 	std::vector<VertexBoneData> m_boneDatas;
 	std::vector<aiMatrix4x4> m_bonesOffset;
-	std::vector<glm::mat4> m_bonesTransform;
+	std::vector<glm::mat4> m_bonesTransform; //bind pose, used by the instances which aren't animated
 	const aiNode* m_rootNode;
 	aiMatrix4x4 m_globalInverseTransform;
+	//the node tree, compiled once so the pose is evaluated without recursion nor name lookups :
+	std::vector<SkeletonNode> m_nodes;
 
 public:
 	Skeleton(const aiMesh* pMesh, const aiNode* rootNode, unsigned int firstVertexId);
+	//build a skeleton from datas which are already processed (used by the mesh cache), the skeleton takes the ownership of rootNode :
+	Skeleton(const std::map<std::string, unsigned int>& boneMapping, const std::vector<VertexBoneData>& boneDatas, const std::vector<aiMatrix4x4>& bonesOffset, const aiNode* rootNode);
 	~Skeleton();
 
 	unsigned int getBoneCount() const;
@@ -49,18 +69,20 @@ public:
 	const std::vector<glm::mat4>& getBonesTransform() const;
 	const glm::mat4& getBoneTransform(int i) const;
 	const std::vector<VertexBoneData>& getBoneDatas() const;
+	const std::map<std::string, unsigned int>& getBoneMapping() const;
+	const aiNode* getRootNode() const;
+	const std::vector<SkeletonNode>& getNodes() const;
 
-	void playAnimationStep(float timeInSecond, const SkeletalAnimation& animation);
+	//binding : the binding of the animation to this skeleton, given by SkeletalAnimation::bindToSkeleton. Its cursors are updated.
+	//timeOffsetInSecond : the pose is evaluated this time after the current time of the animation.
+	//The skeleton isn't modified, so several poses can be evaluated at the same time from different threads.
+	void playAnimationStep(float timeInSecond, const SkeletalAnimation& animation, SkeletalAnimationBinding& binding, SkeletonPose& outPose, float timeOffsetInSecond = 0.f) const;
 	void loadBones(const aiMesh* pMesh, unsigned int firstVertexId);
+	//move the bone datas of the vertices [firstVertexId, firstVertexId + remap.size()[ after a vertex reordering : remap[oldVertex] = newVertex.
+	void remapVertices(unsigned int firstVertexId, const std::vector<unsigned int>& remap);
 
 private:
-	void readNodeHierarchy(float animationTime, const SkeletalAnimation& animation, const aiNode* node, const aiMatrix4x4& parentTransform);
-
-	unsigned int findPosition(float AnimationTime, const aiNodeAnim* pNodeAnim);
-	unsigned int findRotation(float AnimationTime, const aiNodeAnim* pNodeAnim);
-	unsigned int findScaling(float AnimationTime, const aiNodeAnim* pNodeAnim);
-	void computeInterpolatedPosition(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
-	void computeInterpolatedRotation(aiQuaternion& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
-	void computeInterpolatedScaling(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
+	//flatten the aiNode tree in m_nodes, in depth first order. Must be called again when bones are added.
+	void compileHierarchy();
 };
 
@@ -3,6 +3,7 @@
 #include "Application.h"
 #include "Factories.h" 
 #include "Ray.h"
+#include "GLStateCache.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb/stb_image_write.h"
 
@@ -118,7 +119,7 @@ GrassField::~GrassField()
 	if (vbo_animPos != 0)
 		glDeleteBuffers(1, &vbo_pos);
 
-	glDeleteVertexArrays(1, &vao);
+	GLStateCache::get().deleteVertexArrays(1, &vao);
 }
 
 //initialize vbos and vao, based on the informations of the mesh.
@@ -127,7 +128,7 @@ void GrassField::initGl()
 	triangleCount = triangleIndex.size() / 3;
 
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	GLStateCache::get().bindVertexArray(vao);
 
 
 	glGenBuffers(1, &vbo_index);
@@ -169,7 +170,7 @@ void GrassField::initGl()
 	glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
 	glVertexAttribPointer(ANIM_POS, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 3, (void*)0);
 
-	glBindVertexArray(0);
+	GLStateCache::get().bindVertexArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
@@ -182,7 +183,7 @@ void GrassField::freeGl()
 	glDeleteBuffers(1, &vbo_normals);
 	glDeleteBuffers(1, &vbo_animPos);
 	glDeleteBuffers(1, &vbo_pos);
-	glDeleteVertexArrays(1, &vao);
+	GLStateCache::get().deleteVertexArrays(1, &vao);
 }
 
 void GrassField::clear()
@@ -270,7 +271,7 @@ void GrassField::draw()
 
 	int instanceCount = positions.size()/3.f;
 
-	glBindVertexArray(vao);
+	GLStateCache::get().bindVertexArray(vao);
 
 	glVertexAttribDivisor(VERTICES, 0);
 	glVertexAttribDivisor(NORMALS, 0);
@@ -280,15 +281,15 @@ void GrassField::draw()
 
 	glDrawElementsInstanced(GL_TRIANGLES, triangleCount * 3, GL_UNSIGNED_INT, (GLvoid*)0, instanceCount);
 
-	glBindVertexArray(0);
+	GLStateCache::get().bindVertexArray(0);
 }
 
 void GrassField::render(const glm::mat4 & projection, const glm::mat4 & view)
 {
 	glm::mat4 VP = projection * view;
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, grassTexture->glId);
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, grassTexture->glId);
 
 	materialGrassField.use();
 	materialGrassField.setUniformTime(0); //TODO : ADD TIME
@@ -472,7 +473,9 @@ Terrain::Terrain(float width, float height, float depth, int subdivision, glm::v
 			m_noiseTexture(1024, 1024, glm::vec4(0.f,0.f,0.f,255.f)), m_terrainDiffuse(1024, 1024), //textures
 			m_terrainBump(1024, 1024), m_terrainSpecular(1024, 1024), m_drawMatTexture(1024, 1024),
 			m_terrainCollider(nullptr), m_terrainRigidbody(nullptr), m_ptrToPhysicWorld(nullptr), m_triangleIndexVertexArray(nullptr), //physic
-			m_aabbMin(-1000, -1000, -1000), m_aabbMax(1000, 1000, 1000) //aabb
+			m_aabbMin(-1000, -1000, -1000), m_aabbMax(1000, 1000, 1000), //aabb
+			m_isTiled(false), m_exportTileCount(4), //tile streaming
+			m_useCpuTextureBaker(false) //texture baking
 {
 	//filter texture initialisation : 
 	m_filterTexture = new Texture(1024, 1024);
@@ -480,6 +483,8 @@ Terrain::Terrain(float width, float height, float depth, int subdivision, glm::v
 	// initialyze the texture name : 
 	m_newLayoutName[0] = '\0';
 	m_newGrassTextureName[0] = '\0';
+	strncpy(m_tileDirectoryName, m_streamer.getTileDirectory().c_str(), sizeof(m_tileDirectoryName) - 1);
+	m_tileDirectoryName[sizeof(m_tileDirectoryName) - 1] = '\0';
 
 	//grass layout initialization : 
 	m_grassLayoutWidth = m_width / (float)m_grassLayoutDelta;
@@ -620,12 +625,13 @@ void Terrain::drawMaterialOnTerrain(glm::vec3 position, float radius, int textur
 	glBindFramebuffer(GL_FRAMEBUFFER, m_materialLayoutsFBO);
 	//we don't want to clear the texture attached to the framebuffer
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, m_filterTexture->glId); //we read and write on the same texture
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_filterTexture->glId); //we read and write on the same texture
 
 	m_drawOnTextureMaterial.use();
 	m_drawOnTextureMaterial.setUniformColorToDraw(glm::vec4(greyValue, greyValue, greyValue,1));
-	m_drawOnTextureMaterial.setUniformDrawPosition(glm::vec2((position.x + (m_width*0.5f/(float)m_subdivision) - m_width*0.5f) / (float)(m_width*.5f), (position.z + (m_depth*0.5f/ (float)m_subdivision) - m_depth*0.5f) / (float)(m_depth*.5f))); //position in tex coords, between 0 and 1
+	glm::vec2 drawPosition((position.x + (m_width*0.5f/(float)m_subdivision) - m_width*0.5f) / (float)(m_width*.5f), (position.z + (m_depth*0.5f/ (float)m_subdivision) - m_depth*0.5f) / (float)(m_depth*.5f));
+	m_drawOnTextureMaterial.setUniformDrawPosition(drawPosition); //position in tex coords, between 0 and 1
 	m_drawOnTextureMaterial.setUniformDrawRadius(radius);
 	m_drawOnTextureMaterial.setUniformTextureToDrawOn(0);
 
@@ -633,9 +639,60 @@ void Terrain::drawMaterialOnTerrain(glm::vec3 position, float radius, int textur
 	
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+	//keep the CPU copy of the filter up to date :
+	drawMaterialOnFilterPixels(drawPosition, radius, greyValue);
+
 	//generateTerrainTexture();
 }
 
+void Terrain::drawMaterialOnFilterPixels(const glm::vec2& drawPosition, float radius, float greyValue)
+{
+	if (radius <= 0.f)
+		return;
+
+	const int width = m_filterTexture->w;
+	const int height = m_filterTexture->h;
+
+	//the filter has been created on GPU only, its storage starts cleared :
+	if (m_filterTexture->pixels == nullptr)
+	{
+		m_filterTexture->pixels = new unsigned char[width * height * 4]();
+		m_filterTexture->comp = 4;
+		m_filterTexture->format = GL_RGBA;
+		m_filterTexture->type = GL_UNSIGNED_BYTE;
+	}
+	else if (m_filterTexture->type != GL_UNSIGNED_BYTE)
+		return;
+
+	const int channels = (m_filterTexture->format == GL_RGBA) ? 4 : 3;
+	const float drawValue = greyValue * 255.f;
+
+	//only the pixels under the brush :
+	const int minX = glm::clamp((int)std::floor((drawPosition.x - radius + 1.f) * 0.5f * width), 0, width - 1);
+	const int maxX = glm::clamp((int)std::ceil((drawPosition.x + radius + 1.f) * 0.5f * width), 0, width - 1);
+	const int minY = glm::clamp((int)std::floor((drawPosition.y - radius + 1.f) * 0.5f * height), 0, height - 1);
+	const int maxY = glm::clamp((int)std::ceil((drawPosition.y + radius + 1.f) * 0.5f * height), 0, height - 1);
+
+	for (int j = minY; j <= maxY; j++)
+	{
+		for (int i = minX; i <= maxX; i++)
+		{
+			glm::vec2 pixelPosition(((i + 0.5f) / width) * 2.f - 1.f, ((j + 0.5f) / height) * 2.f - 1.f);
+			float d = glm::length(pixelPosition - drawPosition);
+			if (d >= radius)
+				continue;
+
+			//linear attenuation from 0.9*radius to radius, as in the shader :
+			float blend = (d < 0.9f * radius) ? 1.f : 1.f - (d - 0.9f * radius) / (0.1f * radius);
+			unsigned char* pixel = &m_filterTexture->pixels[(j * width + i) * channels];
+			for (int c = 0; c < 3; c++)
+				pixel[c] = (unsigned char)(drawValue * blend + pixel[c] * (1.f - blend) + 0.5f);
+			if (channels == 4)
+				pixel[3] = (unsigned char)(255.f * blend + pixel[3] * (1.f - blend) + 0.5f);
+		}
+	}
+}
+
 void Terrain::drawMaterialOnTerrain(glm::vec3 position)
 {
 	if (m_currentMaterialToDrawIdx < 0 || m_currentMaterialToDrawIdx >= m_terrainLayouts.size())
@@ -661,6 +718,12 @@ bool Terrain::isIntersectedByRay(const Ray & ray, CollisionInfo & collisionInfo)
 
 void Terrain::generateTerrainTexture() 
 {
+	if (m_useCpuTextureBaker)
+	{
+		bakeTerrainTextureOnCPU();
+		return;
+	}
+
 	//m_material.textureRepetition = glm::vec2(1.f / (float)m_subdivision, 1.f / (float)m_subdivision);
 
 	
@@ -671,22 +734,22 @@ void Terrain::generateTerrainTexture()
 
 	m_terrainMaterial.use();
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, m_filterTexture->glId);
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_filterTexture->glId);
 
 	for (int i = 0; i < m_terrainLayouts.size(); i++)
 	{
 
 
 		//diffuse
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getDiffuse()->glId);
+		GLStateCache::get().activeTexture(GL_TEXTURE1);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getDiffuse()->glId);
 		//bump
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getBump()->glId);
+		GLStateCache::get().activeTexture(GL_TEXTURE2);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getBump()->glId);
 		//specular
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getSpecular()->glId);
+		GLStateCache::get().activeTexture(GL_TEXTURE3);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getSpecular()->glId);
 
 		//filter texture : 
 		m_terrainMaterial.setUniformFilterTexture(0);
@@ -727,6 +790,74 @@ void Terrain::generateTerrainTexture()
 }
 
 
+void Terrain::bakeTerrainTextureOnCPU()
+{
+	//get the filter : from its pixels (the draw material tool paints them too), else from the height map :
+	std::vector<unsigned char> filterPixels;
+	const unsigned char* filter = nullptr;
+	int filterChannels = 4;
+	int filterWidth = m_filterTexture->w;
+	int filterHeight = m_filterTexture->h;
+
+	if (m_filterTexture->pixels != nullptr && m_filterTexture->type == GL_UNSIGNED_BYTE)
+	{
+		filter = m_filterTexture->pixels;
+		filterChannels = (m_filterTexture->format == GL_RGBA) ? 4 : 3;
+	}
+	else
+	{
+		TerrainTextureBaker::filterFromHeights(m_heightMap, m_subdivision, m_subdivision, filterWidth, filterHeight, filterPixels);
+		filter = &filterPixels[0];
+		filterChannels = 1;
+	}
+
+	std::vector<TerrainBakeLayout> layouts;
+	for (int i = 0; i < m_terrainLayouts.size(); i++)
+		layouts.push_back(TerrainBakeLayout(m_terrainLayouts[i]->getDiffuse(), m_terrainLayouts[i]->getBump(), m_terrainLayouts[i]->getSpecular(), m_textureRepetitions[i]));
+
+	//bake directly in the terrain textures :
+	Texture* outputs[3] = { &m_terrainDiffuse, &m_terrainBump, &m_terrainSpecular };
+	for (int i = 0; i < 3; i++)
+	{
+		if (outputs[i]->pixels == nullptr || outputs[i]->comp != 4)
+		{
+			delete[] outputs[i]->pixels;
+			outputs[i]->pixels = new unsigned char[outputs[i]->w * outputs[i]->h * 4];
+		}
+		//the pixels are RGBA8, keep the description of the texture consistent with them :
+		outputs[i]->comp = 4;
+		outputs[i]->format = GL_RGBA;
+		outputs[i]->type = GL_UNSIGNED_BYTE;
+	}
+
+	m_textureBaker.bake(filter, filterChannels, filterWidth, filterHeight, layouts, m_terrainDiffuse.w, m_terrainDiffuse.h, m_terrainDiffuse.pixels, m_terrainBump.pixels, m_terrainSpecular.pixels);
+
+	//upload :
+	for (int i = 0; i < 3; i++)
+	{
+		if (outputs[i]->glId <= 0)
+			continue;
+
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, outputs[i]->glId);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, outputs[i]->w, outputs[i]->h, GL_RGBA, GL_UNSIGNED_BYTE, outputs[i]->pixels);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, 0);
+	}
+}
+
+void Terrain::setUseCpuTextureBaker(bool useCpuTextureBaker)
+{
+	if (useCpuTextureBaker == m_useCpuTextureBaker)
+		return;
+
+	m_useCpuTextureBaker = useCpuTextureBaker;
+	generateTerrainTexture();
+}
+
+bool Terrain::getUseCpuTextureBaker() const
+{
+	return m_useCpuTextureBaker;
+}
+
 void Terrain::computeNoiseTexture(Perlin2D& perlin2D)
 {
 	//redraw the noise texture
@@ -990,8 +1121,9 @@ void Terrain::updateCollider()
 
 	m_terrainRigidbody->setCollisionShape(m_terrainCollider);
 
-	//push to simulation :
-	m_ptrToPhysicWorld->addRigidBody(m_terrainRigidbody);
+	//push to simulation, the tiles have their own colliders in tiled mode :
+	if (!m_isTiled)
+		m_ptrToPhysicWorld->addRigidBody(m_terrainRigidbody);
 }
 
 btBvhTriangleMeshShape * Terrain::getColliderShape() const
@@ -1047,7 +1179,7 @@ void Terrain::initGl()
 {
 
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	GLStateCache::get().bindVertexArray(vao);
 
 
 	glGenBuffers(1, &vbo_index);
@@ -1083,14 +1215,14 @@ void Terrain::initGl()
 	glVertexAttribPointer(UVS, 2, GL_FLOAT , GL_FALSE, sizeof(GL_FLOAT) * 2, (void*)0);
 
 
-	glBindVertexArray(0);
+	GLStateCache::get().bindVertexArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void Terrain::freeGl()
 {
-	glDeleteVertexArrays(1, &vao);
+	GLStateCache::get().deleteVertexArrays(1, &vao);
 	glDeleteBuffers(1, &vbo_index);
 	glDeleteBuffers(1, &vbo_vertices);
 	glDeleteBuffers(1, &vbo_uvs);
@@ -1127,6 +1259,10 @@ void Terrain::clear()
 	//grassfield :
 	m_grassField.clear();
 
+	//tiles :
+	m_streamer.clear();
+	m_streamer.setPhysicWorld(nullptr);
+
 	//physic :
 	if (m_ptrToPhysicWorld != nullptr && m_terrainRigidbody != nullptr) {
 		m_ptrToPhysicWorld->removeRigidBody(m_terrainRigidbody);
@@ -1158,7 +1294,10 @@ void Terrain::initPhysics(btDiscreteDynamicsWorld* physicWorld)
 	//generate terrain rigidbody :
 	m_terrainRigidbody = new btRigidBody(0, nullptr, m_terrainCollider);
 	//add the terrain rigidbody to the simulation : 
-	m_ptrToPhysicWorld->addRigidBody(m_terrainRigidbody);
+	if (!m_isTiled)
+		m_ptrToPhysicWorld->addRigidBody(m_terrainRigidbody);
+	//the streamed tiles are added to the same simulation :
+	m_streamer.setPhysicWorld(m_ptrToPhysicWorld);
 }
 
 void Terrain::drawGrassOnTerrain(const glm::vec3 position)
@@ -1237,6 +1376,113 @@ Terrain::TerrainTools Terrain::getCurrentTerrainTool() const
 	return m_currentTerrainTool;
 }
 
+void Terrain::setIsTiled(bool isTiled)
+{
+	if (isTiled == m_isTiled)
+		return;
+
+	m_isTiled = isTiled;
+
+	if (m_ptrToPhysicWorld != nullptr && m_terrainRigidbody != nullptr)
+	{
+		if (m_isTiled && m_terrainRigidbody->isInWorld())
+			m_ptrToPhysicWorld->removeRigidBody(m_terrainRigidbody);
+		else if (!m_isTiled && !m_terrainRigidbody->isInWorld())
+			m_ptrToPhysicWorld->addRigidBody(m_terrainRigidbody);
+	}
+
+	//release all tiles when we go back to the whole terrain :
+	if (!m_isTiled)
+		m_streamer.clear();
+}
+
+bool Terrain::getIsTiled() const
+{
+	return m_isTiled;
+}
+
+void Terrain::updateStreaming(const glm::vec3& cameraPosition)
+{
+	if (!m_isTiled)
+		return;
+
+	m_streamer.update(cameraPosition);
+}
+
+void Terrain::exportTiles(const std::string& directory, int tileCountPerSide)
+{
+	if (tileCountPerSide <= 0 || m_subdivision < 2)
+		return;
+
+	//tiles are squares, the grid start at the terrain offset :
+	const float tileSize = m_width / (float)tileCountPerSide;
+	const int tileCountZ = std::ceil(m_depth / tileSize);
+	const int resolution = std::max(2, m_subdivision / tileCountPerSide + 1);
+	const float step = tileSize / (float)(resolution - 1);
+
+	//read back the filter texture, each tile get its own part :
+	const int texWidth = m_filterTexture->w;
+	const int texHeight = m_filterTexture->h;
+	const int splatResolution = std::max(1, texWidth / tileCountPerSide);
+	std::vector<unsigned char> filterPixels(texWidth*texHeight * 4);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_filterTexture->glId);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &filterPixels[0]);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, 0);
+
+	for (int tj = 0; tj < tileCountZ; tj++)
+	{
+		for (int ti = 0; ti < tileCountPerSide; ti++)
+		{
+			TerrainTileData data;
+			data.resolution = resolution;
+			data.splatResolution = splatResolution;
+			data.tileSize = tileSize;
+			data.origin = glm::vec3(m_offset.x + ti*tileSize, m_offset.y, m_offset.z + tj*tileSize);
+
+			//heights and normals, borders are shared with the neighbour tiles :
+			for (int j = 0; j < resolution; j++)
+			{
+				for (int i = 0; i < resolution; i++)
+				{
+					float x = ti*tileSize + i*step;
+					float z = tj*tileSize + j*step;
+
+					data.heights.push_back(getHeight(x, z));
+
+					glm::vec3 normal(getHeight(x - step, z) - getHeight(x + step, z), 2.f*step, getHeight(x, z - step) - getHeight(x, z + step));
+					normal = glm::normalize(normal);
+					data.normals.push_back(normal.x);
+					data.normals.push_back(normal.y);
+					data.normals.push_back(normal.z);
+				}
+			}
+
+			//splat :
+			for (int j = 0; j < splatResolution; j++)
+			{
+				for (int i = 0; i < splatResolution; i++)
+				{
+					float u = (ti*tileSize + ((i + 0.5f) / (float)splatResolution)*tileSize) / m_width;
+					float v = (tj*tileSize + ((j + 0.5f) / (float)splatResolution)*tileSize) / m_depth;
+					int px = glm::clamp((int)(u * texWidth), 0, texWidth - 1);
+					int py = glm::clamp((int)(v * texHeight), 0, texHeight - 1);
+					for (int c = 0; c < 4; c++)
+						data.splat.push_back(filterPixels[(py*texWidth + px) * 4 + c]);
+				}
+			}
+
+			TerrainStreamer::writeTile(TerrainStreamer::getTilePath(directory, TerrainTileKey(ti, tj)), data);
+		}
+	}
+
+	//use the exported tiles :
+	m_streamer.clear();
+	m_streamer.setTileDirectory(directory);
+	m_streamer.setTileSize(tileSize);
+	m_streamer.setGridOrigin(glm::vec3(m_offset.x, 0, m_offset.z));
+	m_streamer.setGridTileCount(tileCountPerSide, tileCountZ);
+}
+
 void Terrain::updatePhysic(float deltaTime, std::vector<Physic::WindZone*>& windZones)
 {
 	//apply physic on grassField : 
@@ -1252,6 +1498,19 @@ void Terrain::save(Json::Value & rootComponent) const
 	rootComponent["depth"] = m_depth;
 	rootComponent["height"] = m_height;
 	rootComponent["offset"] = toJsonValue<glm::vec3>(m_offset);
+
+	//texture baking :
+	rootComponent["useCpuTextureBaker"] = m_useCpuTextureBaker;
+
+	//tile streaming :
+	rootComponent["isTiled"] = m_isTiled;
+	rootComponent["tileDirectory"] = m_streamer.getTileDirectory();
+	rootComponent["tileSize"] = m_streamer.getTileSize();
+	rootComponent["tileLoadingRadius"] = m_streamer.getLoadingRadius();
+	rootComponent["tileMemoryCap"] = (unsigned int)m_streamer.getMemoryCap();
+	rootComponent["tileUploadBudget"] = m_streamer.getUploadBudget();
+	rootComponent["tileCountX"] = m_streamer.getGridTileCountX();
+	rootComponent["tileCountZ"] = m_streamer.getGridTileCountZ();
 	
 	//noise :
 	rootComponent["seed"] = m_seed;
@@ -1280,9 +1539,9 @@ void Terrain::save(Json::Value & rootComponent) const
 	file.close();
 	//write to file : 
 	unsigned char* pixels = new unsigned char[m_filterTexture->w*m_filterTexture->h*3];
-	glBindTexture(GL_TEXTURE_2D, m_filterTexture->glId);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_filterTexture->glId);
 	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, 0);
 	stbi_write_bmp("test_terrain.bmp", m_filterTexture->w, m_filterTexture->h, 3, pixels);
 }
 
@@ -1295,6 +1554,21 @@ void Terrain::load(Json::Value & rootComponent)
 	m_height = rootComponent.get("height", 10).asFloat();
 	m_offset = fromJsonValue<glm::vec3>(rootComponent["offset"], glm::vec3(0,0,0));
 
+	//texture baking :
+	m_useCpuTextureBaker = rootComponent.get("useCpuTextureBaker", false).asBool();
+
+	//tile streaming :
+	m_streamer.setTileDirectory(rootComponent.get("tileDirectory", "terrainTiles").asString());
+	m_streamer.setTileSize(rootComponent.get("tileSize", 50.f).asFloat());
+	m_streamer.setGridOrigin(glm::vec3(m_offset.x, 0, m_offset.z));
+	m_streamer.setLoadingRadius(rootComponent.get("tileLoadingRadius", 150.f).asFloat());
+	m_streamer.setMemoryCap(rootComponent.get("tileMemoryCap", 64 * 1024 * 1024).asUInt());
+	m_streamer.setUploadBudget(rootComponent.get("tileUploadBudget", 0.002).asDouble());
+	m_streamer.setGridTileCount(rootComponent.get("tileCountX", 0).asInt(), rootComponent.get("tileCountZ", 0).asInt());
+	strncpy(m_tileDirectoryName, m_streamer.getTileDirectory().c_str(), sizeof(m_tileDirectoryName) - 1);
+	m_tileDirectoryName[sizeof(m_tileDirectoryName) - 1] = '\0';
+	setIsTiled(rootComponent.get("isTiled", false).asBool());
+
 	//noise : 
 	m_seed = rootComponent.get("seed", 10).asInt();
 	m_terrainNoise.load(rootComponent["terrainNoise"]);
@@ -1351,20 +1625,66 @@ void Terrain::render(const glm::mat4& projection, const glm::mat4& view)
 
 	m_material.use();
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, m_filterTexture->glId);
+	//tiled mode : tiles are in world space, each tile has its own filter texture : 
+	if (m_isTiled)
+	{
+		const std::vector<TerrainTile*>& tiles = m_streamer.getResidentTiles();
+		glm::mat4 tileMvp = projection * view;
+		glm::mat4 tileNormalMatrix(1);
+
+		for (int i = 0; i < m_terrainLayouts.size(); i++)
+		{
+			//diffuse
+			GLStateCache::get().activeTexture(GL_TEXTURE1);
+			GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getDiffuse()->glId);
+			//bump
+			GLStateCache::get().activeTexture(GL_TEXTURE2);
+			GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getBump()->glId);
+			//specular
+			GLStateCache::get().activeTexture(GL_TEXTURE3);
+			GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getSpecular()->glId);
+
+			m_material.setUniformFilterTexture(0);
+			m_material.setUniformDiffuseTexture(1);
+			m_material.setUniformBumpTexture(2);
+			m_material.setUniformSpecularTexture(3);
+
+			m_material.setUniformSpecularPower(m_terrainLayouts[i]->getSpecularPower());
+
+			float offsetMin = (i / (float)m_terrainLayouts.size());
+			float offsetMax = ((i + 1) / (float)m_terrainLayouts.size());
+			m_material.setUniformLayoutOffset(glm::vec2(offsetMin, offsetMax));
+			m_material.setUniformTextureRepetition(m_textureRepetitions[i]);
+
+			m_material.setUniform_MVP(tileMvp);
+			m_material.setUniform_normalMatrix(tileNormalMatrix);
+
+			for (auto& tile : tiles)
+			{
+				GLStateCache::get().activeTexture(GL_TEXTURE0);
+				GLStateCache::get().bindTexture(GL_TEXTURE_2D, tile->splatTexture);
+
+				tile->draw();
+			}
+		}
+
+		return;
+	}
+
+	GLStateCache::get().activeTexture(GL_TEXTURE0);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_filterTexture->glId);
 
 	for (int i = 0; i < m_terrainLayouts.size(); i++)
 	{
 		//diffuse
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getDiffuse()->glId);
+		GLStateCache::get().activeTexture(GL_TEXTURE1);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getDiffuse()->glId);
 		//bump
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getBump()->glId);
+		GLStateCache::get().activeTexture(GL_TEXTURE2);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getBump()->glId);
 		//specular
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getSpecular()->glId);
+		GLStateCache::get().activeTexture(GL_TEXTURE3);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, m_terrainLayouts[i]->getSpecular()->glId);
 
 		//filter texture : 
 		m_material.setUniformFilterTexture(0);
@@ -1385,9 +1705,9 @@ void Terrain::render(const glm::mat4& projection, const glm::mat4& view)
 		m_material.setUniform_MVP(mvp);
 		m_material.setUniform_normalMatrix(normalMatrix);
 
-		glBindVertexArray(vao);
+		GLStateCache::get().bindVertexArray(vao);
 		glDrawElements(GL_TRIANGLES, m_triangleCount * 3, GL_UNSIGNED_INT, (GLvoid*)0);
-		glBindVertexArray(0);
+		GLStateCache::get().bindVertexArray(0);
 	}
 }
 
@@ -1484,6 +1804,47 @@ void Terrain::drawUI()
 		ImGui::PushID("terrainMaterial");
 		m_material.drawUI();
 		ImGui::PopID();
+
+		bool useCpuTextureBaker = m_useCpuTextureBaker;
+		if (ImGui::Checkbox("bake terrain texture on CPU", &useCpuTextureBaker))
+		{
+			setUseCpuTextureBaker(useCpuTextureBaker);
+		}
+
+		//tile streaming :
+		bool isTiled = m_isTiled;
+		if (ImGui::Checkbox("streamed tiles", &isTiled))
+		{
+			setIsTiled(isTiled);
+		}
+		if (ImGui::InputText("tile directory", m_tileDirectoryName, sizeof(m_tileDirectoryName)))
+		{
+			m_streamer.setTileDirectory(m_tileDirectoryName);
+		}
+		ImGui::InputInt("tile count per side", &m_exportTileCount);
+		if (m_exportTileCount < 1)
+			m_exportTileCount = 1;
+		ImGui::SameLine();
+		if (ImGui::SmallButton("export tiles"))
+		{
+			exportTiles(m_tileDirectoryName, m_exportTileCount);
+		}
+		float tmpFloat = m_streamer.getLoadingRadius();
+		if (ImGui::InputFloat("tile loading radius", &tmpFloat))
+		{
+			m_streamer.setLoadingRadius(tmpFloat);
+		}
+		int tmpInt = m_streamer.getMemoryCap() / (1024 * 1024);
+		if (ImGui::InputInt("tile memory cap (Mo)", &tmpInt))
+		{
+			m_streamer.setMemoryCap(std::max(1, tmpInt) * 1024 * 1024);
+		}
+		tmpFloat = m_streamer.getUploadBudget() * 1000.0;
+		if (ImGui::InputFloat("tile upload budget (ms)", &tmpFloat))
+		{
+			m_streamer.setUploadBudget(tmpFloat / 1000.0);
+		}
+		ImGui::Text("resident tiles : %d, memory : %d Ko, pending : %d", (int)m_streamer.getResidentTiles().size(), (int)(m_streamer.getResidentMemory() / 1024), m_streamer.getPendingTileCount());
 	}
 	//if (ImGui::CollapsingHeader("draw material tool"))
 	else if (m_currentTerrainTool == TerrainTools::DRAW_MATERIAL)
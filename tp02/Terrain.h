@@ -17,6 +17,8 @@
 #include "Point.h"
 #include "Link.h"
 #include "WindZone.h"
+#include "TerrainStreamer.h"
+#include "TerrainTextureBaker.h"
 
 #include "btBulletCollisionCommon.h"
 #include "btBulletDynamicsCommon.h"
@@ -188,6 +190,10 @@ private:
 	std::vector<MaterialLit*> m_terrainLayouts;
 	std::vector<glm::vec2> m_textureRepetitions;
 
+	//if true, the terrain texture is baked on CPU instead of using the terrain FBO :
+	bool m_useCpuTextureBaker;
+	TerrainTextureBaker m_textureBaker;
+
 	float m_noiseMax;
 	float m_noiseMin;
 
@@ -215,6 +221,13 @@ private:
 	glm::vec3 m_aabbMin;
 	glm::vec3 m_aabbMax;
 
+	//tile streaming : 
+	bool m_isTiled; //if true, render and collide with the streamed tiles instead of the whole terrain
+	//the tiles are cut from the whole terrain, which stays in memory for the edition : streaming bounds the GPU and physic work, not the memory of the source heightmap.
+	TerrainStreamer m_streamer;
+	int m_exportTileCount;
+	char m_tileDirectoryName[100];
+
 
 public:
 
@@ -250,10 +263,17 @@ public:
 	btBvhTriangleMeshShape* getColliderShape() const;
 
 	void computeNoiseTexture(Perlin2D& perlin2D);
+	//composite the material layouts in the terrain texture, on GPU or on CPU depending on m_useCpuTextureBaker :
 	void generateTerrainTexture();
+	//CPU version of generateTerrainTexture, write directly in the pixels of the terrain textures and upload them if they are on GPU :
+	void bakeTerrainTextureOnCPU();
+	void setUseCpuTextureBaker(bool useCpuTextureBaker);
+	bool getUseCpuTextureBaker() const;
 
 	void drawMaterialOnTerrain(glm::vec3 position, float radius, int textureIdx);
 	void drawMaterialOnTerrain(glm::vec3 position);
+	//same brush as the drawOnTexture shader, applied to the pixels of the filter texture so the CPU baker sees the painted layouts. drawPosition and radius are in [-1, 1] texture space.
+	void drawMaterialOnFilterPixels(const glm::vec2& drawPosition, float radius, float greyValue);
 
 	bool isIntersectedByRay(const Ray& ray, CollisionInfo& collisionInfo) const;
 
@@ -266,6 +286,14 @@ public:
 
 	TerrainTools getCurrentTerrainTool() const;
 
+	//switch between the whole terrain and the streamed tiles : 
+	void setIsTiled(bool isTiled);
+	bool getIsTiled() const;
+	//request / upload / evict tiles around the camera, call it once per frame :
+	void updateStreaming(const glm::vec3& cameraPosition);
+	//cut the terrain in tileCountPerSide*tileCountPerSide tiles and write them in the given directory (which has to exist) :
+	void exportTiles(const std::string& directory, int tileCountPerSide);
+
 	//update physic : 
 	void updatePhysic(float deltaTime, std::vector<Physic::WindZone*>& windZones);
 
@@ -0,0 +1,660 @@
+#include "TerrainStreamer.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "Application.h"
+#include "GLStateCache.h"
+
+//magic number and version at the begining of each tile file :
+static const int TILE_FILE_MAGIC = 0x454C4954; // "TILE"
+static const int TILE_FILE_VERSION = 1;
+
+////////////////// TERRAIN TILE DATA ///////////////////
+
+TerrainTileData::TerrainTileData() : resolution(0), splatResolution(0), tileSize(0), origin(0, 0, 0)
+{
+
+}
+
+////////////////// TERRAIN TILE ///////////////////
+
+TerrainTile::TerrainTile(const TerrainTileKey& _key, const std::string& _path) : key(_key), state(UNLOADED), path(_path),
+	vao(0), vbo_index(0), vbo_vertices(0), vbo_normals(0), vbo_uvs(0), vbo_tangents(0), splatTexture(0), gpuMemorySize(0),
+	triangleIndexVertexArray(nullptr), collider(nullptr), rigidbody(nullptr), lastUsedFrame(0)
+{
+
+}
+
+TerrainTile::~TerrainTile()
+{
+	freeGl();
+	freePhysic();
+}
+
+void TerrainTile::buildFromData()
+{
+	const int resolution = data.resolution;
+	if (resolution < 2)
+		return;
+
+	const float step = data.tileSize / (float)(resolution - 1);
+
+	vertices.clear();
+	uvs.clear();
+	tangents.clear();
+	triangleIndex.clear();
+
+	vertices.reserve(resolution * resolution * 3);
+	uvs.reserve(resolution * resolution * 2);
+	tangents.reserve(resolution * resolution * 3);
+	triangleIndex.reserve((resolution - 1) * (resolution - 1) * 6);
+
+	glm::vec3 aabbMin(data.origin.x, data.origin.y, data.origin.z);
+	glm::vec3 aabbMax(data.origin.x + data.tileSize, data.origin.y, data.origin.z + data.tileSize);
+
+	for (int j = 0, k = 0; j < resolution; j++)
+	{
+		for (int i = 0; i < resolution; i++, k++)
+		{
+			float height = data.heights[k];
+
+			vertices.push_back(data.origin.x + i*step);
+			vertices.push_back(height);
+			vertices.push_back(data.origin.z + j*step);
+
+			if (height < aabbMin.y) aabbMin.y = height;
+			if (height > aabbMax.y) aabbMax.y = height;
+
+			//uvs are local to the tile, the splat texture cover the whole tile :
+			uvs.push_back(i / (float)(resolution - 1));
+			uvs.push_back(j / (float)(resolution - 1));
+
+			glm::vec3 normal(data.normals[k * 3], data.normals[k * 3 + 1], data.normals[k * 3 + 2]);
+			glm::vec3 tangent = glm::normalize(glm::cross(normal, glm::vec3(0, 0, 1)));
+			tangents.push_back(tangent.x);
+			tangents.push_back(tangent.y);
+			tangents.push_back(tangent.z);
+		}
+	}
+
+	//same winding than Terrain::generateTerrain :
+	for (int j = 0; j < resolution - 1; j++)
+	{
+		for (int i = 0; i < resolution - 1; i++)
+		{
+			int k = i + j * resolution;
+
+			triangleIndex.push_back(k);
+			triangleIndex.push_back(k + 1);
+			triangleIndex.push_back(k + resolution);
+
+			triangleIndex.push_back(k + 1);
+			triangleIndex.push_back(k + resolution + 1);
+			triangleIndex.push_back(k + resolution);
+		}
+	}
+
+	//physic : the collider reference vertices and triangleIndex, so they are kept until the tile is evicted.
+	freePhysic();
+	triangleIndexVertexArray = new btTriangleIndexVertexArray(triangleIndex.size() / 3, &triangleIndex[0], 3 * sizeof(int), vertices.size() / 3, (btScalar*)&vertices[0], 3 * sizeof(float));
+	float aabbOffset = 5;
+	collider = new btBvhTriangleMeshShape(triangleIndexVertexArray, true, btVector3(aabbMin.x - aabbOffset, aabbMin.y - aabbOffset, aabbMin.z - aabbOffset),
+																		btVector3(aabbMax.x + aabbOffset, aabbMax.y + aabbOffset, aabbMax.z + aabbOffset));
+}
+
+void TerrainTile::initGl()
+{
+	if (triangleIndex.size() == 0)
+		return;
+
+	glGenVertexArrays(1, &vao);
+	GLStateCache::get().bindVertexArray(vao);
+
+
+	glGenBuffers(1, &vbo_index);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_index);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangleIndex.size()*sizeof(int), &triangleIndex[0], GL_STATIC_DRAW);
+
+
+	glGenBuffers(1, &vbo_vertices);
+	glEnableVertexAttribArray(VERTICES);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_vertices);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(float), &vertices[0], GL_STATIC_DRAW);
+	glVertexAttribPointer(VERTICES, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 3, (void*)0);
+
+	glGenBuffers(1, &vbo_normals);
+	glEnableVertexAttribArray(NORMALS);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_normals);
+	glBufferData(GL_ARRAY_BUFFER, data.normals.size()*sizeof(float), &data.normals[0], GL_STATIC_DRAW);
+	glVertexAttribPointer(NORMALS, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 3, (void*)0);
+
+	glGenBuffers(1, &vbo_tangents);
+	glEnableVertexAttribArray(TANGENTS);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_tangents);
+	glBufferData(GL_ARRAY_BUFFER, tangents.size()*sizeof(float), &tangents[0], GL_STATIC_DRAW);
+	glVertexAttribPointer(TANGENTS, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 3, (void*)0);
+
+	glGenBuffers(1, &vbo_uvs);
+	glEnableVertexAttribArray(UVS);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_uvs);
+	glBufferData(GL_ARRAY_BUFFER, uvs.size()*sizeof(float), &uvs[0], GL_STATIC_DRAW);
+	glVertexAttribPointer(UVS, 2, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 2, (void*)0);
+
+
+	GLStateCache::get().bindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//splat texture :
+	glGenTextures(1, &splatTexture);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, splatTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, data.splatResolution, data.splatResolution, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data.splat[0]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GLStateCache::get().bindTexture(GL_TEXTURE_2D, 0);
+
+	gpuMemorySize = (triangleIndex.size() * sizeof(int)) + (vertices.size() + data.normals.size() + tangents.size() + uvs.size()) * sizeof(float) + data.splat.size();
+
+	//release cpu datas which are now on the GPU, keep vertices and triangleIndex for the collider :
+	std::vector<float>().swap(data.heights);
+	std::vector<float>().swap(data.normals);
+	std::vector<unsigned char>().swap(data.splat);
+	std::vector<float>().swap(uvs);
+	std::vector<float>().swap(tangents);
+}
+
+void TerrainTile::freeGl()
+{
+	if (vao == 0)
+		return;
+
+	GLStateCache::get().deleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo_index);
+	glDeleteBuffers(1, &vbo_vertices);
+	glDeleteBuffers(1, &vbo_uvs);
+	glDeleteBuffers(1, &vbo_normals);
+	glDeleteBuffers(1, &vbo_tangents);
+	GLStateCache::get().deleteTextures(1, &splatTexture);
+
+	vao = 0;
+	vbo_index = 0;
+	vbo_vertices = 0;
+	vbo_uvs = 0;
+	vbo_normals = 0;
+	vbo_tangents = 0;
+	splatTexture = 0;
+	gpuMemorySize = 0;
+}
+
+void TerrainTile::freePhysic()
+{
+	//the rigidbody has to be removed from the physic world before calling this function.
+	if (rigidbody != nullptr) {
+		rigidbody->setCollisionShape(nullptr);
+		delete rigidbody;
+		rigidbody = nullptr;
+	}
+	if (collider != nullptr) {
+		delete collider;
+		collider = nullptr;
+	}
+	if (triangleIndexVertexArray != nullptr) {
+		delete triangleIndexVertexArray;
+		triangleIndexVertexArray = nullptr;
+	}
+}
+
+void TerrainTile::draw()
+{
+	GLStateCache::get().bindVertexArray(vao);
+	glDrawElements(GL_TRIANGLES, triangleIndex.size(), GL_UNSIGNED_INT, (GLvoid*)0);
+	GLStateCache::get().bindVertexArray(0);
+}
+
+size_t TerrainTile::getMemorySize() const
+{
+	size_t cpuMemorySize = triangleIndex.size() * sizeof(int) + vertices.size() * sizeof(float);
+	return cpuMemorySize + gpuMemorySize;
+}
+
+////////////////// TERRAIN STREAMER ///////////////////
+
+TerrainStreamer::TerrainStreamer() : m_tileDirectory("terrainTiles"), m_tileSize(50.f), m_gridOrigin(0, 0, 0), m_gridTileCountX(0), m_gridTileCountZ(0), m_loadingRadius(150.f),
+	m_memoryCap(64 * 1024 * 1024), m_uploadBudget(0.002), m_ptrToPhysicWorld(nullptr), m_residentMemory(0), m_currentFrame(0), m_stopLoadingThread(false)
+{
+
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+	clear();
+}
+
+void TerrainStreamer::setTileDirectory(const std::string& directory)
+{
+	if (directory == m_tileDirectory)
+		return;
+
+	//tiles are identified by their path, we have to reload everything :
+	clear();
+	m_tileDirectory = directory;
+}
+
+void TerrainStreamer::setTileSize(float tileSize)
+{
+	if (tileSize == m_tileSize || tileSize <= 0)
+		return;
+
+	clear();
+	m_tileSize = tileSize;
+}
+
+void TerrainStreamer::setGridOrigin(const glm::vec3& gridOrigin)
+{
+	m_gridOrigin = gridOrigin;
+}
+
+void TerrainStreamer::setGridTileCount(int tileCountX, int tileCountZ)
+{
+	m_gridTileCountX = std::max(0, tileCountX);
+	m_gridTileCountZ = std::max(0, tileCountZ);
+}
+
+void TerrainStreamer::setLoadingRadius(float radius)
+{
+	m_loadingRadius = radius;
+}
+
+void TerrainStreamer::setMemoryCap(size_t memoryCap)
+{
+	m_memoryCap = memoryCap;
+}
+
+void TerrainStreamer::setUploadBudget(double budget)
+{
+	m_uploadBudget = budget;
+}
+
+void TerrainStreamer::setPhysicWorld(btDiscreteDynamicsWorld* physicWorld)
+{
+	//move resident rigidbodies to the new world :
+	for (auto& tile : m_residentTiles)
+	{
+		if (tile->rigidbody == nullptr)
+			continue;
+
+		if (m_ptrToPhysicWorld != nullptr)
+			m_ptrToPhysicWorld->removeRigidBody(tile->rigidbody);
+		if (physicWorld != nullptr)
+			physicWorld->addRigidBody(tile->rigidbody);
+	}
+
+	m_ptrToPhysicWorld = physicWorld;
+}
+
+const std::string& TerrainStreamer::getTileDirectory() const
+{
+	return m_tileDirectory;
+}
+
+float TerrainStreamer::getTileSize() const
+{
+	return m_tileSize;
+}
+
+glm::vec3 TerrainStreamer::getGridOrigin() const
+{
+	return m_gridOrigin;
+}
+
+int TerrainStreamer::getGridTileCountX() const
+{
+	return m_gridTileCountX;
+}
+
+int TerrainStreamer::getGridTileCountZ() const
+{
+	return m_gridTileCountZ;
+}
+
+float TerrainStreamer::getLoadingRadius() const
+{
+	return m_loadingRadius;
+}
+
+size_t TerrainStreamer::getMemoryCap() const
+{
+	return m_memoryCap;
+}
+
+double TerrainStreamer::getUploadBudget() const
+{
+	return m_uploadBudget;
+}
+
+size_t TerrainStreamer::getResidentMemory() const
+{
+	return m_residentMemory;
+}
+
+int TerrainStreamer::getPendingTileCount()
+{
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	return m_requestQueue.size() + m_loadedQueue.size();
+}
+
+void TerrainStreamer::update(const glm::vec3& cameraPosition)
+{
+	m_currentFrame++;
+
+	//request the tiles inside the loading radius :
+	int minI = (int)std::floor((cameraPosition.x - m_loadingRadius - m_gridOrigin.x) / m_tileSize);
+	int maxI = (int)std::floor((cameraPosition.x + m_loadingRadius - m_gridOrigin.x) / m_tileSize);
+	int minJ = (int)std::floor((cameraPosition.z - m_loadingRadius - m_gridOrigin.z) / m_tileSize);
+	int maxJ = (int)std::floor((cameraPosition.z + m_loadingRadius - m_gridOrigin.z) / m_tileSize);
+
+	//there is nothing to load outside of the exported grid :
+	if (m_gridTileCountX > 0 && m_gridTileCountZ > 0)
+	{
+		minI = std::max(minI, 0);
+		minJ = std::max(minJ, 0);
+		maxI = std::min(maxI, m_gridTileCountX - 1);
+		maxJ = std::min(maxJ, m_gridTileCountZ - 1);
+	}
+
+	for (int j = minJ; j <= maxJ; j++)
+	{
+		for (int i = minI; i <= maxI; i++)
+		{
+			TerrainTileKey key(i, j);
+			if (!isInsideLoadingRadius(key, cameraPosition))
+				continue;
+
+			auto found = m_tiles.find(key);
+			TerrainTile* tile = nullptr;
+			if (found == m_tiles.end())
+			{
+				tile = new TerrainTile(key, getTilePath(m_tileDirectory, key));
+				m_tiles[key] = tile;
+			}
+			else
+				tile = found->second;
+
+			tile->lastUsedFrame = m_currentFrame;
+
+			if (tile->state == TerrainTile::UNLOADED)
+				requestTile(tile);
+		}
+	}
+
+	//finish loading of tiles, in the limit of the upload budget (at least one tile per frame, to always make progress) :
+	double startTime = Application::get().getTime();
+	while (true)
+	{
+		std::pair<TerrainTile*, bool> loaded(nullptr, false);
+		{
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			if (m_loadedQueue.empty())
+				break;
+			loaded = m_loadedQueue.front();
+			m_loadedQueue.pop_front();
+		}
+
+		TerrainTile* tile = loaded.first;
+		if (!loaded.second)
+		{
+			tile->state = TerrainTile::MISSING;
+			continue;
+		}
+
+		tile->state = TerrainTile::LOADED;
+
+		//the camera moved away while the tile was loading :
+		if (tile->lastUsedFrame != m_currentFrame)
+		{
+			evict(tile);
+			continue;
+		}
+
+		makeResident(tile);
+
+		if (Application::get().getTime() - startTime > m_uploadBudget)
+			break;
+	}
+
+	//forget the missing tiles outside of the loading radius, they hold no datas but would stay in m_tiles forever :
+	for (auto it = m_tiles.begin(); it != m_tiles.end();)
+	{
+		if (it->second->state == TerrainTile::MISSING && it->second->lastUsedFrame != m_currentFrame)
+		{
+			delete it->second;
+			it = m_tiles.erase(it);
+		}
+		else
+			it++;
+	}
+
+	//evict the least recently used tiles while we are over the memory cap :
+	if (m_residentMemory > m_memoryCap)
+	{
+		std::vector<TerrainTile*> evictables;
+		for (auto& tile : m_residentTiles)
+		{
+			if (tile->lastUsedFrame != m_currentFrame)
+				evictables.push_back(tile);
+		}
+		std::sort(evictables.begin(), evictables.end(), [](const TerrainTile* a, const TerrainTile* b) { return a->lastUsedFrame < b->lastUsedFrame; });
+
+		for (int i = 0; i < evictables.size() && m_residentMemory > m_memoryCap; i++)
+		{
+			evict(evictables[i]);
+		}
+	}
+}
+
+void TerrainStreamer::clear()
+{
+	//wait for the loading thread, tiles in the request queue are just forgotten :
+	stopLoadingThread();
+
+	for (auto& it : m_tiles)
+	{
+		if (it.second->state == TerrainTile::RESIDENT && it.second->rigidbody != nullptr && m_ptrToPhysicWorld != nullptr)
+			m_ptrToPhysicWorld->removeRigidBody(it.second->rigidbody);
+		delete it.second;
+	}
+
+	m_tiles.clear();
+	m_residentTiles.clear();
+	m_requestQueue.clear();
+	m_loadedQueue.clear();
+	m_residentMemory = 0;
+}
+
+const std::vector<TerrainTile*>& TerrainStreamer::getResidentTiles() const
+{
+	return m_residentTiles;
+}
+
+std::string TerrainStreamer::getTilePath(const std::string& directory, const TerrainTileKey& key)
+{
+	std::stringstream ss;
+	ss << directory << "/tile_" << key.i << "_" << key.j << ".tile";
+	return ss.str();
+}
+
+bool TerrainStreamer::writeTile(const std::string& path, const TerrainTileData& data)
+{
+	if (data.heights.size() != data.resolution * data.resolution
+		|| data.normals.size() != data.resolution * data.resolution * 3
+		|| data.splat.size() != data.splatResolution * data.splatResolution * 4)
+	{
+		std::cout << "error, can't write tile : " << path << ", inconsistant datas." << std::endl;
+		return false;
+	}
+
+	std::ofstream file(path, std::ios::out | std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cout << "error, can't open file : " << path << std::endl;
+		return false;
+	}
+
+	file.write((const char*)&TILE_FILE_MAGIC, sizeof(int));
+	file.write((const char*)&TILE_FILE_VERSION, sizeof(int));
+	file.write((const char*)&data.resolution, sizeof(int));
+	file.write((const char*)&data.splatResolution, sizeof(int));
+	file.write((const char*)&data.tileSize, sizeof(float));
+	file.write((const char*)&data.origin[0], sizeof(float) * 3);
+
+	file.write((const char*)&data.heights[0], data.heights.size() * sizeof(float));
+	file.write((const char*)&data.normals[0], data.normals.size() * sizeof(float));
+	file.write((const char*)&data.splat[0], data.splat.size());
+
+	return file.good();
+}
+
+bool TerrainStreamer::readTile(const std::string& path, TerrainTileData& data)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	int magic = 0;
+	int version = 0;
+	file.read((char*)&magic, sizeof(int));
+	file.read((char*)&version, sizeof(int));
+	if (!file.good() || magic != TILE_FILE_MAGIC || version != TILE_FILE_VERSION)
+		return false;
+
+	file.read((char*)&data.resolution, sizeof(int));
+	file.read((char*)&data.splatResolution, sizeof(int));
+	file.read((char*)&data.tileSize, sizeof(float));
+	file.read((char*)&data.origin[0], sizeof(float) * 3);
+	if (!file.good() || data.resolution < 2 || data.splatResolution < 1)
+		return false;
+
+	data.heights.resize(data.resolution * data.resolution);
+	data.normals.resize(data.resolution * data.resolution * 3);
+	data.splat.resize(data.splatResolution * data.splatResolution * 4);
+
+	file.read((char*)&data.heights[0], data.heights.size() * sizeof(float));
+	file.read((char*)&data.normals[0], data.normals.size() * sizeof(float));
+	file.read((char*)&data.splat[0], data.splat.size());
+
+	return file.good();
+}
+
+void TerrainStreamer::startLoadingThread()
+{
+	if (m_loadingThread.joinable())
+		return;
+
+	m_stopLoadingThread = false;
+	m_loadingThread = std::thread(&TerrainStreamer::loadingThreadLoop, this);
+}
+
+void TerrainStreamer::stopLoadingThread()
+{
+	if (!m_loadingThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_stopLoadingThread = true;
+	}
+	m_queueCondition.notify_all();
+	m_loadingThread.join();
+}
+
+void TerrainStreamer::loadingThreadLoop()
+{
+	while (true)
+	{
+		TerrainTile* tile = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			m_queueCondition.wait(lock, [this]() { return m_stopLoadingThread || !m_requestQueue.empty(); });
+
+			if (m_stopLoadingThread)
+				return;
+
+			tile = m_requestQueue.front();
+			m_requestQueue.pop_front();
+		}
+
+		//disk read and cpu work, no gl calls here :
+		bool success = readTile(tile->path, tile->data);
+		if (success)
+			tile->buildFromData();
+
+		{
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			m_loadedQueue.push_back(std::make_pair(tile, success));
+		}
+	}
+}
+
+void TerrainStreamer::requestTile(TerrainTile* tile)
+{
+	startLoadingThread();
+
+	tile->state = TerrainTile::LOADING;
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_requestQueue.push_back(tile);
+	}
+	m_queueCondition.notify_one();
+}
+
+void TerrainStreamer::makeResident(TerrainTile* tile)
+{
+	tile->initGl();
+
+	if (tile->collider != nullptr)
+	{
+		tile->rigidbody = new btRigidBody(0, nullptr, tile->collider);
+		if (m_ptrToPhysicWorld != nullptr)
+			m_ptrToPhysicWorld->addRigidBody(tile->rigidbody);
+	}
+
+	tile->state = TerrainTile::RESIDENT;
+	m_residentTiles.push_back(tile);
+	m_residentMemory += tile->getMemorySize();
+}
+
+void TerrainStreamer::evict(TerrainTile* tile)
+{
+	//a loading tile is owned by the loading thread :
+	assert(tile->state != TerrainTile::LOADING);
+
+	if (tile->state == TerrainTile::RESIDENT)
+	{
+		if (tile->rigidbody != nullptr && m_ptrToPhysicWorld != nullptr)
+			m_ptrToPhysicWorld->removeRigidBody(tile->rigidbody);
+
+		m_residentMemory -= tile->getMemorySize();
+		m_residentTiles.erase(std::find(m_residentTiles.begin(), m_residentTiles.end(), tile));
+	}
+
+	m_tiles.erase(tile->key);
+	delete tile;
+}
+
+bool TerrainStreamer::isInsideLoadingRadius(const TerrainTileKey& key, const glm::vec3& cameraPosition) const
+{
+	//distance on the xz plane between the camera and the tile rectangle :
+	float minX = m_gridOrigin.x + key.i * m_tileSize;
+	float minZ = m_gridOrigin.z + key.j * m_tileSize;
+	float dx = std::max(std::max(minX - cameraPosition.x, 0.f), cameraPosition.x - (minX + m_tileSize));
+	float dz = std::max(std::max(minZ - cameraPosition.z, 0.f), cameraPosition.z - (minZ + m_tileSize));
+
+	return dx*dx + dz*dz <= m_loadingRadius*m_loadingRadius;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "glew/glew.h"
+
+#include "glm/glm.hpp"
+#include "glm/common.hpp"
+
+#include "btBulletCollisionCommon.h"
+#include "btBulletDynamicsCommon.h"
+
+//key to identify a tile in the tile grid
+struct TerrainTileKey
+{
+	int i;
+	int j;
+
+	inline TerrainTileKey(int _i = 0, int _j = 0) : i(_i), j(_j)
+	{}
+
+	inline bool operator<(const TerrainTileKey& other) const
+	{
+		return i < other.i || (i == other.i && j < other.j);
+	}
+
+	inline bool operator==(const TerrainTileKey& other) const
+	{
+		return i == other.i && j == other.j;
+	}
+};
+
+//what is stored on disk for a tile :
+//heights in world space, normals and splat (the filter texture of the tile, RGBA8)
+struct TerrainTileData
+{
+	int resolution; //vertex count on one side of the tile
+	int splatResolution; //pixel count on one side of the splat texture
+	float tileSize; //world size of the tile
+	glm::vec3 origin; //world position of the first vertex
+
+	std::vector<float> heights;
+	std::vector<float> normals;
+	std::vector<unsigned char> splat;
+
+	TerrainTileData();
+};
+
+struct TerrainTile
+{
+	//UNLOADED : not requested yet, LOADING : in the loading thread, LOADED : cpu datas ready, waiting for upload,
+	//RESIDENT : uploaded to GPU and inserted in the physic world, MISSING : no blob on disk for this tile
+	enum TileState { UNLOADED = 0, LOADING, LOADED, RESIDENT, MISSING };
+	enum Vbo_types { VERTICES = 0, NORMALS, UVS, TANGENTS };
+
+	TerrainTileKey key;
+	TileState state;
+	std::string path;
+
+	//cpu datas, filled by the loading thread :
+	TerrainTileData data;
+	std::vector<int> triangleIndex;
+	std::vector<float> vertices;
+	std::vector<float> uvs;
+	std::vector<float> tangents;
+
+	//gl datas :
+	GLuint vao;
+	GLuint vbo_index;
+	GLuint vbo_vertices;
+	GLuint vbo_normals;
+	GLuint vbo_uvs;
+	GLuint vbo_tangents;
+	GLuint splatTexture;
+	size_t gpuMemorySize;
+
+	//physic datas, the collider is built in the loading thread, the rigidbody is added on the main thread :
+	btTriangleIndexVertexArray* triangleIndexVertexArray;
+	btBvhTriangleMeshShape* collider;
+	btRigidBody* rigidbody;
+
+	//for LRU eviction :
+	int lastUsedFrame;
+
+	TerrainTile(const TerrainTileKey& _key, const std::string& _path);
+	~TerrainTile();
+
+	//build vertices, indices and the collider from the loaded datas. Called in the loading thread.
+	void buildFromData();
+	//upload datas to GPU and release the cpu datas we don't need anymore.
+	void initGl();
+	void freeGl();
+	void freePhysic();
+
+	//draw the tile, using its vao. The splat texture has to be bound before.
+	void draw();
+
+	//approximated size of the tile in memory (cpu + gpu)
+	size_t getMemorySize() const;
+};
+
+//Load terrain tiles around the camera in a background thread, finish gl uploads and physic insertion on the main thread,
+//and evict tiles outside the loading radius when the memory cap is reached.
+class TerrainStreamer
+{
+private:
+	std::string m_tileDirectory;
+	float m_tileSize;
+	glm::vec3 m_gridOrigin;
+	//tile count of the exported grid on x and z, tiles outside of it are never requested. 0 if unknown.
+	int m_gridTileCountX;
+	int m_gridTileCountZ;
+	float m_loadingRadius;
+	size_t m_memoryCap;
+	double m_uploadBudget; //time in seconds we can spent each frame to upload tiles
+
+	btDiscreteDynamicsWorld* m_ptrToPhysicWorld;
+
+	std::map<TerrainTileKey, TerrainTile*> m_tiles;
+	std::vector<TerrainTile*> m_residentTiles;
+	size_t m_residentMemory;
+	int m_currentFrame;
+
+	//loading thread :
+	std::thread m_loadingThread;
+	std::mutex m_queueMutex;
+	std::condition_variable m_queueCondition;
+	std::deque<TerrainTile*> m_requestQueue;
+	std::deque<std::pair<TerrainTile*, bool>> m_loadedQueue; //tile and loading success, the tile state is only modified on the main thread
+	bool m_stopLoadingThread;
+
+public:
+	TerrainStreamer();
+	~TerrainStreamer();
+
+	void setTileDirectory(const std::string& directory);
+	void setTileSize(float tileSize);
+	void setGridOrigin(const glm::vec3& gridOrigin);
+	void setGridTileCount(int tileCountX, int tileCountZ);
+	void setLoadingRadius(float radius);
+	void setMemoryCap(size_t memoryCap);
+	void setUploadBudget(double budget);
+	void setPhysicWorld(btDiscreteDynamicsWorld* physicWorld);
+
+	const std::string& getTileDirectory() const;
+	float getTileSize() const;
+	glm::vec3 getGridOrigin() const;
+	int getGridTileCountX() const;
+	int getGridTileCountZ() const;
+	float getLoadingRadius() const;
+	size_t getMemoryCap() const;
+	double getUploadBudget() const;
+	size_t getResidentMemory() const;
+	int getPendingTileCount();
+
+	//call it once per frame, on the main thread : request tiles near the camera, upload loaded tiles and evict old tiles.
+	void update(const glm::vec3& cameraPosition);
+	//evict all tiles (wait for the tiles which are loading).
+	void clear();
+
+	const std::vector<TerrainTile*>& getResidentTiles() const;
+
+	static std::string getTilePath(const std::string& directory, const TerrainTileKey& key);
+	static bool writeTile(const std::string& path, const TerrainTileData& data);
+	static bool readTile(const std::string& path, TerrainTileData& data);
+
+private:
+	void startLoadingThread();
+	void stopLoadingThread();
+	void loadingThreadLoop();
+
+	void requestTile(TerrainTile* tile);
+	//upload a loaded tile to the GPU and add its rigidbody to the physic world.
+	void makeResident(TerrainTile* tile);
+	//remove a tile from GPU, physic world and memory.
+	void evict(TerrainTile* tile);
+	bool isInsideLoadingRadius(const TerrainTileKey& key, const glm::vec3& cameraPosition) const;
+};
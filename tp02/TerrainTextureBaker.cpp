@@ -0,0 +1,242 @@
+#include "TerrainTextureBaker.h"
+
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+
+#include "Texture.h"
+
+TerrainBakeLayout::TerrainBakeLayout(const Texture* _diffuse, const Texture* _bump, const Texture* _specular, const glm::vec2& _textureRepetition)
+	: diffuse(_diffuse), bump(_bump), specular(_specular), textureRepetition(_textureRepetition)
+{
+
+}
+
+//number of bytes per pixel of a texture stored in RAM, 0 if we can't read it on CPU
+static int getTextureChannelCount(const Texture* texture)
+{
+	if (texture == nullptr || texture->pixels == nullptr || texture->type != GL_UNSIGNED_BYTE)
+		return 0;
+
+	switch (texture->format)
+	{
+	case GL_RED:
+		return 1;
+	case GL_RG:
+		return 2;
+	case GL_RGB:
+		return 3;
+	case GL_RGBA:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+//bilinear sampling with GL_REPEAT wrapping, as the shader does with the layout textures. Result is in [0, 255].
+static glm::vec3 sampleRepeat(const Texture* texture, int channelCount, const glm::vec2& uv)
+{
+	//same value as an unbound texture :
+	if (channelCount == 0)
+		return glm::vec3(0, 0, 0);
+
+	float x = (uv.x - std::floor(uv.x)) * texture->w - 0.5f;
+	float y = (uv.y - std::floor(uv.y)) * texture->h - 0.5f;
+	int x0 = (int)std::floor(x);
+	int y0 = (int)std::floor(y);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	x0 = (x0 % texture->w + texture->w) % texture->w;
+	y0 = (y0 % texture->h + texture->h) % texture->h;
+	int x1 = (x0 + 1) % texture->w;
+	int y1 = (y0 + 1) % texture->h;
+
+	const unsigned char* p00 = &texture->pixels[(y0*texture->w + x0) * channelCount];
+	const unsigned char* p10 = &texture->pixels[(y0*texture->w + x1) * channelCount];
+	const unsigned char* p01 = &texture->pixels[(y1*texture->w + x0) * channelCount];
+	const unsigned char* p11 = &texture->pixels[(y1*texture->w + x1) * channelCount];
+
+	glm::vec3 result(0, 0, 0);
+	for (int c = 0; c < 3; c++)
+	{
+		//grey textures are spread on the three channels :
+		int cc = std::min(c, channelCount - 1);
+		float top = p00[cc] * (1.f - fx) + p10[cc] * fx;
+		float bottom = p01[cc] * (1.f - fx) + p11[cc] * fx;
+		result[c] = top * (1.f - fy) + bottom * fy;
+	}
+	return result;
+}
+
+//bilinear sampling of the first channel of the filter, with GL_CLAMP_TO_EDGE wrapping (the filter covers the terrain once). Result is in [0, 1].
+static float sampleFilter(const unsigned char* filter, int filterChannels, int width, int height, const glm::vec2& uv)
+{
+	float x = glm::clamp(uv.x * width - 0.5f, 0.f, width - 1.f);
+	float y = glm::clamp(uv.y * height - 0.5f, 0.f, height - 1.f);
+	int x0 = (int)std::floor(x);
+	int y0 = (int)std::floor(y);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	int x1 = std::min(x0 + 1, width - 1);
+	int y1 = std::min(y0 + 1, height - 1);
+
+	float top = filter[(y0*width + x0) * filterChannels] * (1.f - fx) + filter[(y0*width + x1) * filterChannels] * fx;
+	float bottom = filter[(y1*width + x0) * filterChannels] * (1.f - fx) + filter[(y1*width + x1) * filterChannels] * fx;
+	return (top * (1.f - fy) + bottom * fy) / 255.f;
+}
+
+TerrainTextureBaker::TerrainTextureBaker(int threadCount, int tileSize) : m_threadCount(threadCount), m_tileSize(tileSize)
+{
+
+}
+
+void TerrainTextureBaker::setThreadCount(int threadCount)
+{
+	m_threadCount = threadCount;
+}
+
+int TerrainTextureBaker::getThreadCount() const
+{
+	return m_threadCount;
+}
+
+void TerrainTextureBaker::setTileSize(int tileSize)
+{
+	m_tileSize = std::max(1, tileSize);
+}
+
+int TerrainTextureBaker::getTileSize() const
+{
+	return m_tileSize;
+}
+
+void TerrainTextureBaker::bake(const unsigned char* filter, int filterChannels, int filterWidth, int filterHeight, const std::vector<TerrainBakeLayout>& layouts,
+	int width, int height, unsigned char* outDiffuse, unsigned char* outBump, unsigned char* outSpecular) const
+{
+	if (filter == nullptr || filterWidth <= 0 || filterHeight <= 0 || outDiffuse == nullptr || outBump == nullptr || outSpecular == nullptr || width <= 0 || height <= 0)
+		return;
+
+	const int tileCountX = (width + m_tileSize - 1) / m_tileSize;
+	const int tileCountY = (height + m_tileSize - 1) / m_tileSize;
+	const int tileCount = tileCountX * tileCountY;
+
+	int threadCount = m_threadCount > 0 ? m_threadCount : (int)std::thread::hardware_concurrency();
+	threadCount = glm::clamp(threadCount, 1, tileCount);
+
+	//each worker takes the next free tile, tiles don't overlap so the outputs are written without lock :
+	std::atomic<int> nextTile(0);
+	auto worker = [&]()
+	{
+		int tile = 0;
+		while ((tile = nextTile++) < tileCount)
+		{
+			bakeTile(tile % tileCountX, tile / tileCountX, filter, filterChannels, filterWidth, filterHeight, layouts, width, height, outDiffuse, outBump, outSpecular);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(worker));
+	//the calling thread works too :
+	worker();
+
+	for (auto& w : workers)
+		w.join();
+}
+
+void TerrainTextureBaker::bakeTile(int tileX, int tileY, const unsigned char* filter, int filterChannels, int filterWidth, int filterHeight, const std::vector<TerrainBakeLayout>& layouts,
+	int width, int height, unsigned char* outDiffuse, unsigned char* outBump, unsigned char* outSpecular) const
+{
+	const int layoutCount = layouts.size();
+
+	std::vector<int> diffuseChannels(layoutCount);
+	std::vector<int> bumpChannels(layoutCount);
+	std::vector<int> specularChannels(layoutCount);
+	for (int i = 0; i < layoutCount; i++)
+	{
+		diffuseChannels[i] = getTextureChannelCount(layouts[i].diffuse);
+		bumpChannels[i] = getTextureChannelCount(layouts[i].bump);
+		specularChannels[i] = getTextureChannelCount(layouts[i].specular);
+	}
+
+	const int beginX = tileX * m_tileSize;
+	const int beginY = tileY * m_tileSize;
+	const int endX = std::min(beginX + m_tileSize, width);
+	const int endY = std::min(beginY + m_tileSize, height);
+
+	for (int y = beginY; y < endY; y++)
+	{
+		for (int x = beginX; x < endX; x++)
+		{
+			const int k = (y*width + x) * 4;
+			glm::vec2 texcoord((x + 0.5f) / (float)width, (y + 0.5f) / (float)height);
+			float filterValue = sampleFilter(filter, filterChannels, filterWidth, filterHeight, texcoord);
+
+			//same test than the shader, for each layout :
+			int layout = -1;
+			for (int i = 0; i < layoutCount; i++)
+			{
+				float offsetMin = (i / (float)layoutCount);
+				float offsetMax = ((i + 1) / (float)layoutCount);
+				if (filterValue >= offsetMin && filterValue < offsetMax)
+					layout = i;
+			}
+
+			if (layout < 0)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					outDiffuse[k + c] = 0;
+					outBump[k + c] = 0;
+					outSpecular[k + c] = 0;
+				}
+				continue;
+			}
+
+			glm::vec2 repeatedTexcoord = texcoord * layouts[layout].textureRepetition;
+			glm::vec3 diffuse = sampleRepeat(layouts[layout].diffuse, diffuseChannels[layout], repeatedTexcoord);
+			glm::vec3 bump = sampleRepeat(layouts[layout].bump, bumpChannels[layout], repeatedTexcoord);
+			glm::vec3 specular = sampleRepeat(layouts[layout].specular, specularChannels[layout], repeatedTexcoord);
+
+			for (int c = 0; c < 3; c++)
+			{
+				outDiffuse[k + c] = (unsigned char)(diffuse[c] + 0.5f);
+				outBump[k + c] = (unsigned char)(bump[c] + 0.5f);
+				outSpecular[k + c] = (unsigned char)(specular[c] + 0.5f);
+			}
+			outDiffuse[k + 3] = 255;
+			outBump[k + 3] = 255;
+			outSpecular[k + 3] = 255;
+		}
+	}
+}
+
+void TerrainTextureBaker::filterFromHeights(const std::vector<float>& heights, int gridWidth, int gridDepth, int width, int height, std::vector<unsigned char>& outFilter)
+{
+	outFilter.resize(width * height);
+
+	if (heights.size() == 0 || gridWidth <= 0 || gridDepth <= 0)
+	{
+		std::fill(outFilter.begin(), outFilter.end(), 0);
+		return;
+	}
+
+	float heightMin = *std::min_element(heights.begin(), heights.end());
+	float heightMax = *std::max_element(heights.begin(), heights.end());
+	float heightRange = (heightMax - heightMin) > 0.f ? (heightMax - heightMin) : 1.f;
+
+	for (int j = 0, k = 0; j < height; j++)
+	{
+		for (int i = 0; i < width; i++, k++)
+		{
+			int gridX = std::min(gridWidth - 1, (i * gridWidth) / width);
+			int gridZ = std::min(gridDepth - 1, (j * gridDepth) / height);
+			float heightValue = heights[gridZ * gridWidth + gridX];
+
+			outFilter[k] = (unsigned char)(((heightValue - heightMin) / heightRange) * 255);
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/common.hpp"
+
+//forwards :
+struct Texture;
+
+//a material layout, as used by the terrain texture generation
+struct TerrainBakeLayout
+{
+	const Texture* diffuse;
+	const Texture* bump;
+	const Texture* specular;
+	glm::vec2 textureRepetition;
+
+	TerrainBakeLayout(const Texture* _diffuse = nullptr, const Texture* _bump = nullptr, const Texture* _specular = nullptr, const glm::vec2& _textureRepetition = glm::vec2(1, 1));
+};
+
+//CPU version of the terrainEdition shader : composite the material layouts, selected by the filter values, into diffuse, bump and specular RGBA8 buffers.
+//The texture is cut in tiles which are baked in parallel by worker threads. No gl calls are made, so it can run without gl context.
+class TerrainTextureBaker
+{
+private:
+	int m_threadCount;
+	int m_tileSize; //size in pixels of one side of a tile
+
+public:
+	TerrainTextureBaker(int threadCount = 0, int tileSize = 64);
+
+	//threadCount <= 0 means one thread per hardware thread.
+	void setThreadCount(int threadCount);
+	int getThreadCount() const;
+	void setTileSize(int tileSize);
+	int getTileSize() const;
+
+	//filter : filterWidth*filterHeight*filterChannels bytes, the first channel select the layout (layout i is used for values in [i/n, (i+1)/n[).
+	//outputs are width*height*4 bytes buffers (RGBA8). Pixels without layout are set to zero, like a cleared framebuffer.
+	void bake(const unsigned char* filter, int filterChannels, int filterWidth, int filterHeight, const std::vector<TerrainBakeLayout>& layouts,
+		int width, int height, unsigned char* outDiffuse, unsigned char* outBump, unsigned char* outSpecular) const;
+
+	//filter values computed from a height grid (like Terrain::computeNoiseTexture does), resampled to width*height, one channel.
+	static void filterFromHeights(const std::vector<float>& heights, int gridWidth, int gridDepth, int width, int height, std::vector<unsigned char>& outFilter);
+
+private:
+	void bakeTile(int tileX, int tileY, const unsigned char* filter, int filterChannels, int filterWidth, int filterHeight, const std::vector<TerrainBakeLayout>& layouts,
+		int width, int height, unsigned char* outDiffuse, unsigned char* outBump, unsigned char* outSpecular) const;
+};
@@ -1,4 +1,5 @@
 #include "Texture.h"
+#include "GLStateCache.h"
 
 
 Texture::Texture() : glId(0), path(""), internalFormat(GL_RGB), format(GL_RGB), type(GL_UNSIGNED_BYTE), generateMipMap(true), m_textureUseCounts(0), comp(3), pixels(0), w(1), h(1), textureWrapping_u(GL_REPEAT), textureWrapping_v(GL_REPEAT), minFilter(GL_LINEAR), magFilter(GL_LINEAR)
@@ -102,7 +103,7 @@ void Texture::initGL()
 	{
 		glGenTextures(1, &glId);
 
-		glBindTexture(GL_TEXTURE_2D, glId);
+		GLStateCache::get().bindTexture(GL_TEXTURE_2D, glId);
 		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, format, type, pixels);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, textureWrapping_u);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, textureWrapping_v);
@@ -124,7 +125,7 @@ void Texture::freeGL()
 
 	//if (m_textureUseCounts <= 0)
 	if(glId > 0){
-		glDeleteTextures(1, &glId);
+		GLStateCache::get().deleteTextures(1, &glId);
 	}
 }
 
@@ -181,7 +182,7 @@ void CubeTexture::initGL()
 	if (glId <= 0){
 
 		glGenTextures(1, &glId);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, glId);
+		GLStateCache::get().bindTexture(GL_TEXTURE_CUBE_MAP, glId);
 
 		for (int i = 0; i < 6; ++i)
 		{
@@ -202,13 +203,13 @@ void CubeTexture::initGL()
 		else
 			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+		GLStateCache::get().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
 	}
 }
 
 void CubeTexture::freeGL()
 {
 	if (glId > 0){
-			glDeleteTextures(1, &glId);
+			GLStateCache::get().deleteTextures(1, &glId);
 	}
 }
\ No newline at end of file
@@ -6,6 +6,8 @@
 #define TANGENT		 3
 #define BONE_IDS	 4
 #define BONE_WEIGHTS 5 
+#define INSTANCE_MODEL_MATRIX 6
+#define INSTANCE_NORMAL_MATRIX 10
 
 #define FRAG_COLOR	0
 
@@ -17,8 +19,14 @@ const unsigned int MAX_BONE_COUNT = 100;
 uniform mat4 MVP;
 uniform mat4 NormalMatrix;
 uniform vec2 TextureRepetition;
-uniform mat4 BonesTransform[MAX_BONE_COUNT];
+//bone palette of the instance, bound by the renderer :
+layout(std140) uniform BonePalette
+{
+	mat4 BonesTransform[MAX_BONE_COUNT];
+};
 uniform bool UseSkeleton = false;
+//instanced draws : MVP is the view projection and the model and normal matrices are per instance attributes :
+uniform bool UseInstancing = false;
 
 layout(location = POSITION) in vec3 Position;
 layout(location = NORMAL) in vec3 Normal;
@@ -26,6 +34,8 @@ layout(location = TEXCOORD) in vec2 TexCoord;
 layout(location = TANGENT) in vec3 Tangent;
 layout(location = BONE_IDS) in ivec4 BoneIds;
 layout(location = BONE_WEIGHTS) in vec4 BoneWeights;
+layout(location = INSTANCE_MODEL_MATRIX) in mat4 InstanceModelMatrix;
+layout(location = INSTANCE_NORMAL_MATRIX) in mat4 InstanceNormalMatrix;
 
 
 out block
@@ -46,6 +56,13 @@ void main()
 		boneTransform += BonesTransform[BoneIds[3]] * BoneWeights[3];
 	}
 
+	mat4 mvp = MVP;
+	mat4 normalMatrix = NormalMatrix;
+	if(UseInstancing){
+		mvp = MVP * InstanceModelMatrix;
+		normalMatrix = InstanceNormalMatrix;
+	}
+
 	vec3 pos = Position;
 
 	Out.TexCoord = TexCoord * TextureRepetition;
@@ -53,11 +70,11 @@ void main()
 	//Out.Normal =  normalize( vec3(NormalMatrix * vec4(Normal, 0)) );
 
 	//calculate TBN matrix : 
-	vec3 T = normalize( vec3(boneTransform * NormalMatrix * vec4(Tangent, 0.0)) );
-	vec3 N = normalize( vec3(boneTransform * NormalMatrix * vec4(Normal, 0.0)) );
+	vec3 T = normalize( vec3(boneTransform * normalMatrix * vec4(Tangent, 0.0)) );
+	vec3 N = normalize( vec3(boneTransform * normalMatrix * vec4(Normal, 0.0)) );
 	vec3 B = -cross(T, N);
 	Out.TBN = mat3(B, T, N);
 
-	gl_Position = MVP * boneTransform * vec4(Position,1);
+	gl_Position = mvp * boneTransform * vec4(Position,1);
 	
 }
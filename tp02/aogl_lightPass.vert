@@ -5,6 +5,9 @@
 
 layout(location = POSITION) in vec2 Position;
 
+//screen rectangle of the light in normalized device coordinates (x, y, width, height), the quad covers [-1, 1] :
+uniform vec4 Viewport;
+
 out block
 {
     vec2 Texcoord;
@@ -14,6 +17,8 @@ out block
 void main()
 {
 
-    Out.Texcoord = Position * 0.5 + 0.5;
-    gl_Position = vec4(Position.xy, 0.0, 1.0);
+    vec2 position = Viewport.xy + (Position * 0.5 + 0.5) * Viewport.zw;
+
+    Out.Texcoord = position * 0.5 + 0.5;
+    gl_Position = vec4(position, 0.0, 1.0);
 }
@@ -4,6 +4,9 @@
 #define NORMAL		1
 #define TEXCOORD	2
 #define TANGENT		3
+#define BONE_IDS	4
+#define BONE_WEIGHTS 5
+#define INSTANCE_MODEL_MATRIX 6
 #define FRAG_COLOR	0
 
 precision highp float;
@@ -14,10 +17,36 @@ layout(location = POSITION) in vec3 Position;
 layout(location = NORMAL) in vec3 Normal;
 layout(location = TEXCOORD) in vec2 TexCoord;
 layout(location = TANGENT) in vec3 Tangent;
+layout(location = BONE_IDS) in ivec4 BoneIds;
+layout(location = BONE_WEIGHTS) in vec4 BoneWeights;
+layout(location = INSTANCE_MODEL_MATRIX) in mat4 InstanceModelMatrix;
+
+const unsigned int MAX_BONE_COUNT = 100;
 
 uniform mat4 ModelMatrix;
+uniform bool UseSkeleton = false;
+//instanced draws : the model matrix is a per instance attribute :
+uniform bool UseInstancing = false;
+
+//same bone palette as the gPass :
+layout(std140) uniform BonePalette
+{
+	mat4 BonesTransform[MAX_BONE_COUNT];
+};
 
 void main()
 {	
-	gl_Position = ModelMatrix * vec4(Position,1);
+	mat4 boneTransform = mat4(1);
+	if(UseSkeleton){
+		boneTransform = BonesTransform[BoneIds[0]] * BoneWeights[0];
+		boneTransform += BonesTransform[BoneIds[1]] * BoneWeights[1];
+		boneTransform += BonesTransform[BoneIds[2]] * BoneWeights[2];
+		boneTransform += BonesTransform[BoneIds[3]] * BoneWeights[3];
+	}
+
+	mat4 modelMatrix = ModelMatrix;
+	if(UseInstancing)
+		modelMatrix = InstanceModelMatrix;
+
+	gl_Position = modelMatrix * boneTransform * vec4(Position,1);
 }